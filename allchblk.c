@@ -286,6 +286,9 @@ setup_header(hdr *hhdr, struct hblk *block, size_t lb_adjusted, int kind,
   hhdr->hb_obj_kind = (unsigned char)kind;
   hhdr->hb_flags = (unsigned char)flags;
   hhdr->hb_block = block;
+#ifdef ALLOC_TAGS
+  hhdr->hb_tag = (unsigned short)GC_current_alloc_tag();
+#endif
   descr = ok->ok_descriptor;
 #if ALIGNMENT > GC_DS_TAGS
   /*
@@ -1175,6 +1178,8 @@ GC_freehblk(struct hblk *hbp)
 
   GET_HDR(hbp, hhdr);
   size = HBLKSIZE * OBJ_SZ_TO_BLOCKS(hhdr->hb_sz);
+  if (GC_arrays._toggleref_arr != NULL && ADDR_GE((ptr_t)GC_arrays._toggleref_arr, (ptr_t)hbp) && ADDR_LT((ptr_t)GC_arrays._toggleref_arr, (ptr_t)hbp + size))
+    GC_printf("DBGH gc_no=%lu marked=%d nmarks=%u\n", (unsigned long)GC_gc_no, (int)GC_is_marked(GC_arrays._toggleref_arr), (unsigned)hhdr->hb_n_marks);
   if ((size & SIZET_SIGNB) != 0) {
     /*
      * Probably possible if we try to allocate more than half the address
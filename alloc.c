@@ -653,6 +653,18 @@ GC_get_on_collection_event(void)
   return fn;
 }
 
+/*
+ * Notify the client about the collection event, fire the tracepoint
+ * and record the event in the trace buffer.
+ */
+#define NOTIFY_COLLECTION_EVENT(event, probe) \
+  do {                                        \
+    if (GC_on_collection_event)               \
+      GC_on_collection_event(event);          \
+    GC_TRACE(event, probe, GC_gc_no);         \
+  } while (0)
+
+void GC_dbg_chk(const char *);
 GC_INNER GC_bool
 GC_try_to_collect_inner(GC_stop_func stop_func)
 {
@@ -666,8 +678,7 @@ GC_try_to_collect_inner(GC_stop_func stop_func)
   GC_ASSERT(GC_is_initialized);
   if (GC_dont_gc || (*stop_func)())
     return FALSE;
-  if (GC_on_collection_event)
-    GC_on_collection_event(GC_EVENT_START);
+  NOTIFY_COLLECTION_EVENT(GC_EVENT_START, gc__start);
   if (GC_incremental && GC_collection_in_progress()) {
     GC_COND_LOG_PRINTF(
         "GC_try_to_collect_inner: finishing collection in progress\n");
@@ -675,6 +686,7 @@ GC_try_to_collect_inner(GC_stop_func stop_func)
     do {
       if ((*stop_func)()) {
         /* TODO: Notify `GC_EVENT_ABANDON`. */
+        GC_TRACE(GC_TRACE_ABANDON, gc__abandon, GC_gc_no);
         return FALSE;
       }
       GC_collect_a_little_inner(1);
@@ -690,6 +702,7 @@ GC_try_to_collect_inner(GC_stop_func stop_func)
     GET_TIME(start_time);
   }
 #endif
+  GC_dbg_chk("before_reclaim_all");
   GC_promote_black_lists();
   /*
    * Make sure all blocks have been reclaimed, so sweep routines do not
@@ -707,8 +720,10 @@ GC_try_to_collect_inner(GC_stop_func stop_func)
     /* Aborted.  So far everything is still consistent. */
     EXIT_GC();
     /* TODO: Notify `GC_EVENT_ABANDON`. */
+    GC_TRACE(GC_TRACE_ABANDON, gc__abandon, GC_gc_no);
     return FALSE;
   }
+  GC_dbg_chk("after_reclaim_all");
   GC_invalidate_mark_state(); /*< flush mark stack */
   GC_clear_marks();
   SAVE_CALLERS_TO_LAST_STACK();
@@ -729,6 +744,7 @@ GC_try_to_collect_inner(GC_stop_func stop_func)
        */
     }
     /* TODO: Notify `GC_EVENT_ABANDON`. */
+    GC_TRACE(GC_TRACE_ABANDON, gc__abandon, GC_gc_no);
     return FALSE;
   }
   GC_finish_collection();
@@ -754,8 +770,7 @@ GC_try_to_collect_inner(GC_stop_func stop_func)
                     ns_frac_diff);
   }
 #endif
-  if (GC_on_collection_event)
-    GC_on_collection_event(GC_EVENT_END);
+  NOTIFY_COLLECTION_EVENT(GC_EVENT_END, gc__end);
   return TRUE;
 }
 
@@ -965,6 +980,7 @@ GC_stopped_mark(GC_stop_func stop_func)
   GC_cond_register_dynamic_libraries();
 #endif
 
+  GC_dbg_chk("stopped_mark");
 #if !defined(GC_NO_FINALIZATION) && !defined(GC_TOGGLE_REFS_NOT_NEEDED)
   GC_process_togglerefs();
 #endif
@@ -980,13 +996,11 @@ GC_stopped_mark(GC_stop_func stop_func)
   }
 #endif
 #ifdef THREADS
-  if (GC_on_collection_event)
-    GC_on_collection_event(GC_EVENT_PRE_STOP_WORLD);
+  NOTIFY_COLLECTION_EVENT(GC_EVENT_PRE_STOP_WORLD, stop__world__start);
 #endif
   STOP_WORLD();
 #ifdef THREADS
-  if (GC_on_collection_event)
-    GC_on_collection_event(GC_EVENT_POST_STOP_WORLD);
+  NOTIFY_COLLECTION_EVENT(GC_EVENT_POST_STOP_WORLD, stop__world__end);
 #  ifdef THREAD_LOCAL_ALLOC
   GC_world_stopped = TRUE;
 #  elif defined(CPPCHECK)
@@ -1002,8 +1016,7 @@ GC_stopped_mark(GC_stop_func stop_func)
 #endif
 
   /* Notify about marking from all roots. */
-  if (GC_on_collection_event)
-    GC_on_collection_event(GC_EVENT_MARK_START);
+  NOTIFY_COLLECTION_EVENT(GC_EVENT_MARK_START, mark__start);
 
   /* Minimize junk left in my registers and on the stack. */
   GC_clear_a_few_frames();
@@ -1035,26 +1048,24 @@ GC_stopped_mark(GC_stop_func stop_func)
     /* Give the mutator a chance. */
     GC_deficit = abandoned_at - 1;
     /* TODO: Notify `GC_EVENT_MARK_ABANDON`. */
+    GC_TRACE(GC_TRACE_MARK_ABANDON, mark__abandon, GC_gc_no);
   } else {
     GC_gc_no++;
     /* Check all debugged objects for consistency. */
     if (GC_debugging_started)
       GC_check_heap();
-    if (GC_on_collection_event)
-      GC_on_collection_event(GC_EVENT_MARK_END);
+    NOTIFY_COLLECTION_EVENT(GC_EVENT_MARK_END, mark__end);
   }
 
 #ifdef THREADS
-  if (GC_on_collection_event)
-    GC_on_collection_event(GC_EVENT_PRE_START_WORLD);
+  NOTIFY_COLLECTION_EVENT(GC_EVENT_PRE_START_WORLD, start__world__start);
 #endif
 #ifdef THREAD_LOCAL_ALLOC
   GC_world_stopped = FALSE;
 #endif
   START_WORLD();
 #ifdef THREADS
-  if (GC_on_collection_event)
-    GC_on_collection_event(GC_EVENT_POST_START_WORLD);
+  NOTIFY_COLLECTION_EVENT(GC_EVENT_POST_START_WORLD, start__world__end);
 #endif
 
 #ifndef NO_CLOCK
@@ -1360,8 +1371,7 @@ GC_finish_collection(void)
   if (GC_print_stats)
     GET_TIME(start_time);
 #endif
-  if (GC_on_collection_event)
-    GC_on_collection_event(GC_EVENT_RECLAIM_START);
+  NOTIFY_COLLECTION_EVENT(GC_EVENT_RECLAIM_START, reclaim__start);
 
 #ifndef GC_GET_HEAP_USAGE_NOT_NEEDED
   if (GC_bytes_found > 0)
@@ -1380,9 +1390,11 @@ GC_finish_collection(void)
     GC_start_reclaim(TRUE);
   }
 
+  GC_dbg_chk("before_finalize");
 #ifndef GC_NO_FINALIZATION
   GC_finalize();
 #endif
+  GC_dbg_chk("after_finalize");
 #ifndef NO_CLOCK
   if (GC_print_stats)
     GET_TIME(finalize_time);
@@ -1392,6 +1404,8 @@ GC_finish_collection(void)
     GC_traverse_back_graph();
   }
 #endif
+  GC_heap_profile_reclaim();
+  ALLOC_REC(GC_alloc_rec_collection());
 
   /*
    * Clear free-list mark bits, in case they got accidentally marked
@@ -1406,8 +1420,10 @@ GC_finish_collection(void)
   GC_VERBOSE_LOG_PRINTF("Bytes recovered before sweep - f.l. count = %ld\n",
                         (long)GC_bytes_found);
 
+  GC_dbg_chk("before_start_reclaim");
   /* Reconstruct free lists to contain everything not marked. */
   GC_start_reclaim(FALSE);
+  GC_dbg_chk("after_start_reclaim");
 
 #ifdef USE_MUNMAP
   if (GC_unmap_threshold > 0          /*< memory unmapping enabled? */
@@ -1443,8 +1459,7 @@ GC_finish_collection(void)
   GC_bytes_freed = 0;
   GC_finalizer_bytes_freed = 0;
 
-  if (GC_on_collection_event)
-    GC_on_collection_event(GC_EVENT_RECLAIM_END);
+  NOTIFY_COLLECTION_EVENT(GC_EVENT_RECLAIM_END, reclaim__end);
 #ifndef NO_CLOCK
   if (GC_print_stats) {
     CLOCK_TYPE done_time;
@@ -1734,7 +1749,7 @@ GC_print_heap_sects(void)
 void *GC_least_plausible_heap_addr = MAKE_CPTR(GC_WORD_MAX);
 void *GC_greatest_plausible_heap_addr = NULL;
 
-STATIC word GC_max_heapsize = 0;
+GC_INNER word GC_max_heapsize = 0;
 
 GC_API void GC_CALL
 GC_set_max_heap_size(GC_word n)
@@ -1794,6 +1809,7 @@ GC_expand_hp_inner(word n)
     return FALSE;
   }
   GC_last_heap_growth_gc_no = GC_gc_no;
+  GC_TRACE(GC_TRACE_EXPAND_HEAP, expand__heap, sz);
   GC_INFOLOG_PRINTF("Grow heap to %lu KiB after %lu bytes allocated\n",
                     TO_KiB_UL(GC_heapsize + sz),
                     (unsigned long)GC_bytes_allocd);
@@ -0,0 +1,484 @@
+/*
+ * THIS MATERIAL IS PROVIDED AS IS, WITH ABSOLUTELY NO WARRANTY EXPRESSED
+ * OR IMPLIED.  ANY USE IS AT YOUR OWN RISK.
+ *
+ * Permission is hereby granted to use or copy this program
+ * for any purpose, provided the above notices are retained on all copies.
+ * Permission to modify the code and to distribute modified code is granted,
+ * provided the above notices are retained, and a notice that the code was
+ * modified is included with the above copyright notice.
+ */
+
+#include "private/gc_priv.h"
+
+/*
+ * The allocation recorder.  While the recording is on, the allocations
+ * are made on the slow paths only (the thread-local and `GC_malloc_many`
+ * free lists get one object at a time), and the client allocations, the
+ * explicit deallocations, the pointer stores done by
+ * `GC_ptr_store_and_dirty()`, the collections and the heap blocks freed
+ * by the sweep are written (holding the allocator lock) to a buffer
+ * which is flushed to the file when full.  The internal allocations of
+ * the collector are not recorded.
+ *
+ * The recording starts with the header: `ALLOC_REC_MAGIC` (4 bytes),
+ * followed by the format version, the size of a word, `HBLKSIZE` and
+ * `GC_GRANULE_BYTES`.  Next, a sequence of records follows, each one is
+ * the record type (a byte) followed by the payload.  All the numbers
+ * (except for the magic) are encoded as LEB128 (i.e. 7 bits per byte,
+ * least significant first, the high bit is set in all bytes but the
+ * last one); the addresses are encoded as the zigzag-mapped difference
+ * from the address of the previous record (of any type); the time is
+ * the number of microseconds elapsed since the previous record having
+ * the time field.  The record types and their payload are:
+ *   - `ALLOC_REC_ALLOC`: the time, the requested size in bytes, the
+ *     object kind and the object address;
+ *   - `ALLOC_REC_FREE`: the address of the object deallocated explicitly;
+ *   - `ALLOC_REC_STORE`: the address of the (heap) object stored to, the
+ *     offset of the stored pointer in the object (shifted left by one bit,
+ *     the lowest bit is set if the pointer refers to a heap object) and,
+ *     if the bit is set, the address of the object the pointer refers to;
+ *   - `ALLOC_REC_COLLECT` (at the end of the mark phase): the time, the
+ *     collection number, the heap size and the number of bytes allocated
+ *     since the previous collection;
+ *   - `ALLOC_REC_RELEASE` (follows `ALLOC_REC_COLLECT`): the address and
+ *     the size of a heap block freed as no object in it is reachable;
+ *   - `ALLOC_REC_THREAD`: the id of the thread which the subsequent
+ *     records come from (written whenever the thread changes);
+ *   - `ALLOC_REC_END` (empty): marks the recording as complete.
+ * The objects found unreachable are not recorded individually (as the
+ * sweep is lazy), the reader should assume an object is dead if its
+ * address is reused by another allocation or is within a freed block.
+ * The format is read by `tests/allocreplay.c` file.
+ */
+
+#define ALLOC_REC_MAGIC "GCar"
+#define ALLOC_REC_VERSION 1
+
+#define ALLOC_REC_END 0
+#define ALLOC_REC_ALLOC 1
+#define ALLOC_REC_FREE 2
+#define ALLOC_REC_STORE 3
+#define ALLOC_REC_COLLECT 4
+#define ALLOC_REC_RELEASE 5
+#define ALLOC_REC_THREAD 6
+
+GC_INNER GC_bool GC_alloc_rec_on = FALSE;
+
+#if defined(UNIX_LIKE) || defined(CYGWIN32)
+
+#  include <errno.h>
+#  include <fcntl.h>
+#  include <sys/types.h>
+#  include <unistd.h>
+
+/* The size of the output buffer, i.e. of a single `write()` call. */
+#  ifndef ALLOC_REC_BUF_SIZE
+#    define ALLOC_REC_BUF_SIZE ((size_t)1 << 16)
+#  endif
+
+/* The maximum length of an encoded number. */
+#  define ALLOC_REC_NUM_LEN ((CPP_WORDSZ + 6) / 7)
+
+/*
+ * The maximum length of a record (including the preceding
+ * `ALLOC_REC_THREAD` one).
+ */
+#  define ALLOC_REC_MAX_LEN (2 + 6 * ALLOC_REC_NUM_LEN)
+
+#  ifdef THREADS
+#    ifdef GC_WIN32_THREADS
+#      define ALLOC_REC_SELF_ID() ((word)GetCurrentThreadId())
+#    else
+#      define ALLOC_REC_SELF_ID() ((word)NUMERIC_THREAD_ID(pthread_self()))
+#    endif
+#  else
+#    define ALLOC_REC_SELF_ID() 0
+#  endif
+
+STATIC int GC_alloc_rec_fd = -1;
+
+/*
+ * The process which started the recording.  The buffer is not flushed
+ * by a child process (after `fork()`), the recording is stopped there.
+ */
+STATIC pid_t GC_alloc_rec_pid;
+
+/* `GC_SUCCESS` or -1 (on a write failure). */
+STATIC int GC_alloc_rec_err = GC_SUCCESS;
+
+/* Allocated on the first record. */
+STATIC unsigned char *GC_alloc_rec_buf = NULL;
+STATIC size_t GC_alloc_rec_pos = 0;
+
+/* Whether the header is written to the buffer. */
+STATIC GC_bool GC_alloc_rec_header_done = FALSE;
+
+STATIC word GC_alloc_rec_last_addr = 0;
+STATIC word GC_alloc_rec_last_tid = 0;
+
+#  ifndef NO_CLOCK
+STATIC CLOCK_TYPE GC_alloc_rec_start_time;
+
+/* The time of the previous record (in microseconds). */
+STATIC word GC_alloc_rec_last_us = 0;
+#  endif
+
+/* The name of the file passed in `GC_ALLOC_RECORD_FILE` variable. */
+STATIC const char *GC_alloc_rec_exit_fname = NULL;
+
+STATIC void
+GC_alloc_rec_flush(void)
+{
+  size_t done = 0;
+
+  GC_ASSERT(I_HOLD_LOCK());
+  if (EXPECT(getpid() != GC_alloc_rec_pid, FALSE)) {
+    GC_alloc_rec_on = FALSE;
+    GC_alloc_rec_pos = 0;
+    return;
+  }
+  while (GC_alloc_rec_err == GC_SUCCESS && done < GC_alloc_rec_pos) {
+    ssize_t res = write(GC_alloc_rec_fd, GC_alloc_rec_buf + done,
+                        GC_alloc_rec_pos - done);
+
+    if (res < 0) {
+      if (EINTR == errno || EAGAIN == errno)
+        continue;
+      GC_alloc_rec_err = -1;
+      /* Stop recording, the trace is incomplete anyway. */
+      GC_alloc_rec_on = FALSE;
+    } else {
+      done += (size_t)res;
+    }
+  }
+  GC_alloc_rec_pos = 0;
+}
+
+STATIC unsigned char *
+GC_alloc_rec_put_num(unsigned char *q, word v)
+{
+  while (v >= 0x80) {
+    *q++ = (unsigned char)(v | 0x80);
+    v >>= 7;
+  }
+  *q++ = (unsigned char)v;
+  return q;
+}
+
+STATIC unsigned char *
+GC_alloc_rec_put_addr(unsigned char *q, ptr_t p)
+{
+  word d = ADDR(p) - GC_alloc_rec_last_addr;
+
+  GC_alloc_rec_last_addr = ADDR(p);
+  /* Map the signed difference to unsigned one (zigzag encoding). */
+  return GC_alloc_rec_put_num(
+      q, (d << 1) ^ (word)((GC_signed_word)d >> (CPP_WORDSZ - 1)));
+}
+
+STATIC unsigned char *
+GC_alloc_rec_put_time(unsigned char *q)
+{
+#  ifndef NO_CLOCK
+  CLOCK_TYPE now;
+  word us;
+
+  GET_TIME(now);
+  us = (word)MS_TIME_DIFF(now, GC_alloc_rec_start_time) * 1000
+       + (word)NS_FRAC_TIME_DIFF(now, GC_alloc_rec_start_time) / 1000;
+  q = GC_alloc_rec_put_num(q, us - GC_alloc_rec_last_us);
+  GC_alloc_rec_last_us = us;
+  return q;
+#  else
+  return GC_alloc_rec_put_num(q, 0);
+#  endif
+}
+
+/*
+ * Make room for a record of the given type and write its type (preceded
+ * by the thread record if needed).  Returns `NULL` if the recording is
+ * stopped.
+ */
+STATIC unsigned char *
+GC_alloc_rec_begin(unsigned type)
+{
+  unsigned char *q;
+  word tid = ALLOC_REC_SELF_ID();
+
+  GC_ASSERT(I_HOLD_LOCK());
+  if (EXPECT(NULL == GC_alloc_rec_buf, FALSE)) {
+    GC_alloc_rec_buf = (unsigned char *)GC_scratch_alloc(ALLOC_REC_BUF_SIZE);
+    if (NULL == GC_alloc_rec_buf) {
+      WARN("Out of memory for allocation recording buffer\n", 0);
+      GC_alloc_rec_on = FALSE;
+      return NULL;
+    }
+  }
+  if (!GC_alloc_rec_header_done) {
+    BCOPY(ALLOC_REC_MAGIC, GC_alloc_rec_buf, 4);
+    q = GC_alloc_rec_put_num(GC_alloc_rec_buf + 4, ALLOC_REC_VERSION);
+    q = GC_alloc_rec_put_num(q, sizeof(word));
+    q = GC_alloc_rec_put_num(q, HBLKSIZE);
+    q = GC_alloc_rec_put_num(q, GC_GRANULE_BYTES);
+    GC_alloc_rec_pos = (size_t)(q - GC_alloc_rec_buf);
+    GC_alloc_rec_header_done = TRUE;
+  }
+  if (ALLOC_REC_BUF_SIZE - GC_alloc_rec_pos < ALLOC_REC_MAX_LEN) {
+    GC_alloc_rec_flush();
+    if (!GC_alloc_rec_on)
+      return NULL;
+  }
+  q = GC_alloc_rec_buf + GC_alloc_rec_pos;
+  if (tid != GC_alloc_rec_last_tid) {
+    *q++ = ALLOC_REC_THREAD;
+    q = GC_alloc_rec_put_num(q, tid);
+    GC_alloc_rec_last_tid = tid;
+  }
+  *q++ = (unsigned char)type;
+  return q;
+}
+
+#  define GC_alloc_rec_end(q) \
+    (void)(GC_alloc_rec_pos = (size_t)((q) - GC_alloc_rec_buf))
+
+GC_INNER void
+GC_alloc_rec_obj(void *p, size_t lb, int kind)
+{
+  unsigned char *q;
+
+  if (NULL == p)
+    return;
+  q = GC_alloc_rec_begin(ALLOC_REC_ALLOC);
+  if (EXPECT(NULL == q, FALSE))
+    return;
+  q = GC_alloc_rec_put_time(q);
+  q = GC_alloc_rec_put_num(q, lb);
+  q = GC_alloc_rec_put_num(q, (word)kind);
+  q = GC_alloc_rec_put_addr(q, (ptr_t)p);
+  GC_alloc_rec_end(q);
+}
+
+GC_INNER void
+GC_alloc_rec_free(void *p)
+{
+  unsigned char *q = GC_alloc_rec_begin(ALLOC_REC_FREE);
+
+  if (EXPECT(NULL == q, FALSE))
+    return;
+  q = GC_alloc_rec_put_addr(q, (ptr_t)p);
+  GC_alloc_rec_end(q);
+}
+
+GC_INNER void
+GC_alloc_rec_store(void *p, const void *obj)
+{
+  ptr_t base;
+  unsigned char *q;
+
+  LOCK();
+  base = (ptr_t)GC_base(p);
+  /* The stores to the roots are not recorded. */
+  if (base != NULL && GC_alloc_rec_on) {
+    ptr_t obj_base
+        = obj != NULL ? (ptr_t)GC_base(GC_CAST_AWAY_CONST_PVOID(obj)) : NULL;
+
+    q = GC_alloc_rec_begin(ALLOC_REC_STORE);
+    if (EXPECT(q != NULL, TRUE)) {
+      q = GC_alloc_rec_put_addr(q, base);
+      q = GC_alloc_rec_put_num(q, ((word)((ptr_t)p - base) << 1)
+                                      | (obj_base != NULL ? 1 : 0));
+      if (obj_base != NULL)
+        q = GC_alloc_rec_put_addr(q, obj_base);
+      GC_alloc_rec_end(q);
+    }
+  }
+  UNLOCK();
+}
+
+GC_INNER void
+GC_alloc_rec_collection(void)
+{
+  unsigned char *q = GC_alloc_rec_begin(ALLOC_REC_COLLECT);
+
+  if (EXPECT(NULL == q, FALSE))
+    return;
+  q = GC_alloc_rec_put_time(q);
+  q = GC_alloc_rec_put_num(q, GC_gc_no);
+  q = GC_alloc_rec_put_num(q, GC_heapsize);
+  q = GC_alloc_rec_put_num(q, GC_bytes_allocd);
+  GC_alloc_rec_end(q);
+}
+
+GC_INNER void
+GC_alloc_rec_release(struct hblk *h, size_t bytes)
+{
+  unsigned char *q = GC_alloc_rec_begin(ALLOC_REC_RELEASE);
+
+  if (EXPECT(NULL == q, FALSE))
+    return;
+  q = GC_alloc_rec_put_addr(q, (ptr_t)h);
+  q = GC_alloc_rec_put_num(q, bytes);
+  GC_alloc_rec_end(q);
+}
+
+STATIC void
+GC_alloc_rec_start_inner(int fd)
+{
+  GC_ASSERT(I_HOLD_LOCK());
+  GC_alloc_rec_fd = fd;
+  GC_alloc_rec_pid = getpid();
+  GC_alloc_rec_err = GC_SUCCESS;
+  GC_alloc_rec_last_addr = 0;
+  GC_alloc_rec_last_tid = 0;
+#  ifndef NO_CLOCK
+  GET_TIME(GC_alloc_rec_start_time);
+  GC_alloc_rec_last_us = 0;
+#  endif
+  GC_alloc_rec_pos = 0;
+  GC_alloc_rec_header_done = FALSE;
+  GC_alloc_rec_on = TRUE;
+}
+
+/*
+ * Write the end record and flush the buffer.  Returns the recording
+ * error code.
+ */
+STATIC int
+GC_alloc_rec_stop_inner(void)
+{
+  unsigned char *q;
+  int err;
+
+  GC_ASSERT(I_HOLD_LOCK());
+  q = GC_alloc_rec_begin(ALLOC_REC_END);
+  if (q != NULL)
+    GC_alloc_rec_end(q);
+  if (GC_alloc_rec_buf != NULL)
+    GC_alloc_rec_flush();
+  err = GC_alloc_rec_err;
+  GC_alloc_rec_on = FALSE;
+  GC_alloc_rec_fd = -1;
+  return err;
+}
+
+GC_API int GC_CALL
+GC_start_alloc_recording(int fd)
+{
+  int result = GC_SUCCESS;
+
+  if (!EXPECT(GC_is_initialized, TRUE))
+    GC_init();
+  LOCK();
+  if (GC_alloc_rec_fd != -1) {
+    result = GC_DUPLICATE;
+  } else {
+    GC_alloc_rec_start_inner(fd);
+  }
+  UNLOCK();
+  return result;
+}
+
+GC_API int GC_CALL
+GC_stop_alloc_recording(void)
+{
+  int result = GC_NOT_FOUND;
+
+  LOCK();
+  if (GC_alloc_rec_fd != -1)
+    result = GC_alloc_rec_stop_inner();
+  UNLOCK();
+  return result;
+}
+
+STATIC void
+GC_alloc_rec_exit(void)
+{
+  int fd;
+  int err;
+
+  LOCK();
+  fd = GC_alloc_rec_fd;
+  err = fd != -1 ? GC_alloc_rec_stop_inner() : GC_SUCCESS;
+  UNLOCK();
+  if (fd != -1) {
+    if (err != GC_SUCCESS)
+      GC_err_printf("Failed to write allocation recording to %s\n",
+                    GC_alloc_rec_exit_fname);
+    (void)close(fd);
+  }
+}
+
+GC_INNER void
+GC_alloc_rec_start_at_init(const char *fname)
+{
+  int fd;
+
+  GC_ASSERT(I_HOLD_LOCK());
+  fd = open(fname, O_CREAT | O_WRONLY | O_TRUNC, 0644);
+  if (fd < 0) {
+    GC_err_printf("Failed to open %s as allocation recording file\n",
+                  fname);
+    return;
+  }
+  GC_alloc_rec_exit_fname = fname;
+  GC_alloc_rec_start_inner(fd);
+  atexit(GC_alloc_rec_exit);
+}
+
+#else
+
+GC_INNER void
+GC_alloc_rec_obj(void *p, size_t lb, int kind)
+{
+  UNUSED_ARG(p);
+  UNUSED_ARG(lb);
+  UNUSED_ARG(kind);
+}
+
+GC_INNER void
+GC_alloc_rec_free(void *p)
+{
+  UNUSED_ARG(p);
+}
+
+GC_INNER void
+GC_alloc_rec_store(void *p, const void *obj)
+{
+  UNUSED_ARG(p);
+  UNUSED_ARG(obj);
+}
+
+GC_INNER void
+GC_alloc_rec_collection(void)
+{
+}
+
+GC_INNER void
+GC_alloc_rec_release(struct hblk *h, size_t bytes)
+{
+  UNUSED_ARG(h);
+  UNUSED_ARG(bytes);
+}
+
+GC_INNER void
+GC_alloc_rec_start_at_init(const char *fname)
+{
+  UNUSED_ARG(fname);
+  WARN("Allocation recording is not supported on the platform\n", 0);
+}
+
+GC_API int GC_CALL
+GC_start_alloc_recording(int fd)
+{
+  UNUSED_ARG(fd);
+  return GC_UNIMPLEMENTED;
+}
+
+GC_API int GC_CALL
+GC_stop_alloc_recording(void)
+{
+  return GC_NOT_FOUND;
+}
+
+#endif
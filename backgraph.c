@@ -82,24 +82,35 @@ typedef struct back_edges_struct {
   struct back_edges_struct *cont;
 } back_edges;
 
+/*
+ * The number of `back_edges` structures allocated at once.  The chunks
+ * are acquired on demand and never released.
+ */
 #  define MAX_BACK_EDGE_STRUCTS 100000
 static back_edges *back_edge_space = NULL;
 
-/* Points to never-used `back_edges` space. */
-STATIC int GC_n_back_edge_structs = 0;
+/* The number of used entries in the current chunk of `back_edges`. */
+static size_t n_back_edge_space_used = 0;
+
+/* The total number of the ever-used `back_edges` structures. */
+STATIC word GC_n_back_edge_structs = 0;
 
 /* Pointer to free list of deallocated `back_edges` structures. */
 static back_edges *avail_back_edges = NULL;
 
-/*
- * Allocate a new back edge structure.  Should be more sophisticated
- * if this were production code.
- */
+/* Allocate a new back edge structure. */
 static back_edges *
 new_back_edges(void)
 {
   GC_ASSERT(I_HOLD_LOCK());
-  if (0 == back_edge_space) {
+  if (avail_back_edges != 0) {
+    back_edges *result = avail_back_edges;
+    avail_back_edges = result->cont;
+    result->cont = 0;
+    return result;
+  }
+  if (NULL == back_edge_space
+      || n_back_edge_space_used == MAX_BACK_EDGE_STRUCTS) {
     size_t bytes_to_get
         = ROUNDUP_PAGESIZE_IF_MMAP(MAX_BACK_EDGE_STRUCTS * sizeof(back_edges));
 
@@ -107,18 +118,10 @@ new_back_edges(void)
     back_edge_space = (back_edges *)GC_os_get_mem(bytes_to_get);
     if (NULL == back_edge_space)
       ABORT("Insufficient memory for back edges");
+    n_back_edge_space_used = 0;
   }
-  if (avail_back_edges != 0) {
-    back_edges *result = avail_back_edges;
-    avail_back_edges = result->cont;
-    result->cont = 0;
-    return result;
-  }
-  if (GC_n_back_edge_structs >= MAX_BACK_EDGE_STRUCTS - 1) {
-    ABORT("Needed too much space for back edges: adjust "
-          "MAX_BACK_EDGE_STRUCTS");
-  }
-  return back_edge_space + (GC_n_back_edge_structs++);
+  GC_n_back_edge_structs++;
+  return back_edge_space + (n_back_edge_space_used++);
 }
 
 /* Deallocate `p` and its associated continuation structures. */
@@ -229,7 +232,6 @@ ensure_struct(ptr_t p)
     }
     be->height = HEIGHT_UNKNOWN;
     be->height_gc_no = (unsigned short)(GC_gc_no - 1);
-    GC_ASSERT(ADDR_GE((ptr_t)be, (ptr_t)back_edge_space));
     SET_OH_BG_PTR(p, CPTR_SET_FLAGS(be, FLAG_MANY));
   }
 }
@@ -640,10 +642,520 @@ GC_print_back_graph_stats(void)
     GC_print_heap_obj(obj);
     LOCK();
   }
-  GC_COND_LOG_PRINTF("Needed max total of %d back-edge structs\n",
-                     GC_n_back_edge_structs);
+  GC_COND_LOG_PRINTF("Needed max total of %lu back-edge structs\n",
+                     (unsigned long)GC_n_back_edge_structs);
   GC_apply_to_each_object(reset_back_edge);
   GC_deepest_obj = NULL;
 }
 
+/*
+ * The dominator tree of the graph of the reachable objects.  An object
+ * `d` dominates `p` if every path from the roots to `p` goes through `d`,
+ * thus the retained size of `d` (the total size of the objects dominated
+ * by it, including `d` itself) is the amount of memory which would become
+ * unreachable if `d` were.  The graph is built (with the references
+ * recognized conservatively) from the marked objects right after
+ * a collection, and the dominators are computed by the Lengauer-Tarjan
+ * algorithm (its "simple" variant, i.e. with the path compression only).
+ * The objects are identified by their index in the (ascending) array of
+ * their addresses, the edges are kept in the compressed sparse row format.
+ * The precise roots are unknown here; the objects referenced from the
+ * static data, the ones not referenced by other objects and those left
+ * unreachable from both (e.g. a cycle referenced only from a thread stack)
+ * are considered as the children of a virtual root.
+ */
+
+GC_INNER unsigned GC_retained_size_top = 0;
+
+/* The maximum number of the reported objects. */
+#  define MAX_RETAINED_SIZE_TOP 100
+
+/* The "none" value for the node indices. */
+#  define DOM_NONE (~(unsigned32)0)
+
+struct dom_arrays_s {
+  ptr_t *node_addr;
+  unsigned32 *succ_start; /*< the edges of `i` are `succ[succ_start[i]..]` */
+  unsigned32 *succ;
+  unsigned32 *pred_start;
+  unsigned32 *pred;
+  word *root_bits; /*< the children of the virtual root */
+  unsigned32 *semi; /*< the DFS number, then the semi-dominator one */
+  unsigned32 *vertex; /*< the node by its DFS number */
+  unsigned32 *parent; /*< in the DFS spanning tree */
+  unsigned32 *ancestor; /*< in the forest built by the algorithm */
+  unsigned32 *label;
+  unsigned32 *idom; /*< the immediate dominator */
+  unsigned32 *stack; /*< the DFS stack, then the `compress` one */
+  unsigned32 *cursor; /*< the DFS edge cursor, then the bucket link */
+  unsigned32 *bucket;
+  word *retained;
+};
+
+/* The scratch space for the arrays, reused by the subsequent reports. */
+static ptr_t dom_space = NULL;
+static size_t dom_space_bytes = 0;
+
+/*
+ * Find the index of the node whose address is `p`; return `n` (the
+ * number of the nodes) if not found.
+ */
+static unsigned32
+dom_node_index(const ptr_t *node_addr, unsigned32 n, ptr_t p)
+{
+  unsigned32 lo = 0, hi = n;
+
+  while (lo < hi) {
+    unsigned32 mid = lo + (hi - lo) / 2;
+
+    if (ADDR_LT(node_addr[mid], p)) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo < n && node_addr[lo] == p ? lo : n;
+}
+
+/* Is `q` a reference to a reachable object?  If yes, then return its base. */
+static ptr_t
+dom_target(ptr_t q)
+{
+  ptr_t target;
+
+  FIXUP_POINTER(q);
+  if (ADDR(q) <= GC_least_real_heap_addr
+      || ADDR(q) >= GC_greatest_real_heap_addr)
+    return NULL;
+  target = (ptr_t)GC_base(q);
+  if (NULL == target || !GC_is_marked(target) || !GC_HAS_DEBUG_INFO(target))
+    return NULL;
+  return target;
+}
+
+/*
+ * Store the indices of the nodes referenced by the object at `p` to
+ * `out` (if non-`NULL`, at most `max_cnt` ones); return their count.
+ * The mutator is not stopped, thus the result may vary between calls.
+ */
+static size_t
+dom_scan_object(const ptr_t *node_addr, unsigned32 n, ptr_t p,
+                unsigned32 *out, size_t max_cnt)
+{
+  const hdr *hhdr = HDR(p);
+  word descr = hhdr->hb_descr;
+  ptr_t current_p = p + sizeof(oh);
+  size_t cnt = 0;
+
+  /* For now, fix up non-length descriptors conservatively. */
+  if ((descr & GC_DS_TAGS) != GC_DS_LENGTH)
+    descr = hhdr->hb_sz;
+  for (; ADDR_LT(current_p, p + descr); current_p += sizeof(ptr_t)) {
+    ptr_t q;
+    unsigned32 i;
+
+    LOAD_PTR_OR_CONTINUE(q, current_p);
+    q = dom_target(q);
+    if (NULL == q)
+      continue;
+    i = dom_node_index(node_addr, n, q);
+    if (i == n)
+      continue;
+    if (out != NULL) {
+      if (cnt == max_cnt)
+        break;
+      out[cnt] = i;
+    }
+    cnt++;
+  }
+  return cnt;
+}
+
+/*
+ * Store the addresses of the reachable objects to `node_addr` (if
+ * non-`NULL`, at most `max_cnt` ones) in the ascending order; return
+ * their count.
+ */
+static size_t
+dom_collect_nodes(ptr_t *node_addr, size_t max_cnt)
+{
+  struct hblk *h;
+  size_t cnt = 0;
+
+  for (h = GC_next_block(NULL, FALSE); h != NULL;) {
+    const hdr *hhdr = HDR(h);
+    size_t sz = hhdr->hb_sz;
+    size_t i, n_objs = sz > MAXOBJBYTES ? 1 : HBLK_OBJS(sz);
+    size_t bit_no = 0;
+
+    for (i = 0; i < n_objs; i++, bit_no += MARK_BIT_OFFSET(sz)) {
+      ptr_t p = h->hb_body + i * sz;
+
+      if (mark_bit_from_hdr(hhdr, bit_no) && GC_HAS_DEBUG_INFO(p)) {
+        if (node_addr != NULL) {
+          if (cnt == max_cnt)
+            return cnt;
+          node_addr[cnt] = p;
+        }
+        cnt++;
+      }
+    }
+    h = GC_next_block(h + OBJ_SZ_TO_BLOCKS(sz), FALSE);
+  }
+  return cnt;
+}
+
+#  define DOM_ROOT_BIT_SET(a, i) \
+    ((a)->root_bits[(i) / CPP_WORDSZ] |= (word)1 << ((i) % CPP_WORDSZ))
+#  define DOM_ROOT_BIT_TEST(a, i) \
+    (((a)->root_bits[(i) / CPP_WORDSZ] >> ((i) % CPP_WORDSZ)) & 1)
+
+/*
+ * Allocate the arrays for `n` nodes and `n_edges` edges.  Return `FALSE`
+ * on the memory shortage.
+ */
+static GC_bool
+dom_alloc_arrays(struct dom_arrays_s *a, size_t n, size_t n_edges)
+{
+  size_t n_bits_words = n / CPP_WORDSZ + 1;
+  size_t bytes = (n + 1) * sizeof(ptr_t) + (n + 1) * sizeof(word)
+                 + n_bits_words * sizeof(word)
+                 + (12 * (n + 2) + 2 * n_edges) * sizeof(unsigned32);
+  ptr_t p;
+
+  GC_ASSERT(I_HOLD_LOCK());
+  if (bytes > dom_space_bytes) {
+    size_t bytes_to_get = ROUNDUP_PAGESIZE_IF_MMAP(bytes);
+
+    p = GC_os_get_mem(bytes_to_get);
+    if (NULL == p)
+      return FALSE;
+#  ifndef GWW_VDB
+    if (dom_space != NULL)
+      GC_scratch_recycle_no_gww(dom_space, dom_space_bytes);
+#  endif
+    dom_space = p;
+    dom_space_bytes = bytes_to_get;
+  }
+  p = dom_space;
+  /* The word-aligned arrays go first. */
+  a->node_addr = (ptr_t *)p;
+  p += (n + 1) * sizeof(ptr_t);
+  a->retained = (word *)p;
+  p += (n + 1) * sizeof(word);
+  a->root_bits = (word *)p;
+  p += n_bits_words * sizeof(word);
+  BZERO(a->root_bits, n_bits_words * sizeof(word));
+#  define DOM_CARVE(field, cnt)  \
+    (void)(a->field = (unsigned32 *)p, p += (cnt) * sizeof(unsigned32))
+  DOM_CARVE(succ_start, n + 2);
+  DOM_CARVE(pred_start, n + 2);
+  DOM_CARVE(semi, n + 2);
+  DOM_CARVE(vertex, n + 2);
+  DOM_CARVE(parent, n + 2);
+  DOM_CARVE(ancestor, n + 2);
+  DOM_CARVE(label, n + 2);
+  DOM_CARVE(idom, n + 2);
+  DOM_CARVE(stack, n + 2);
+  DOM_CARVE(cursor, n + 2);
+  DOM_CARVE(bucket, n + 2);
+  DOM_CARVE(succ, n_edges);
+  DOM_CARVE(pred, n_edges);
+#  undef DOM_CARVE
+  GC_ASSERT(ADDR(p) <= ADDR(dom_space) + bytes);
+  return TRUE;
+}
+
+/*
+ * Number the nodes in the depth-first order starting from the virtual
+ * root (`n`).  The candidate children of the latter are scanned twice: at
+ * first, the ones referenced from the static data, then all the nodes
+ * left unvisited.
+ */
+static void
+dom_dfs(struct dom_arrays_s *a, unsigned32 n)
+{
+  unsigned32 n_visited = 0;
+  unsigned32 sp = 0;
+  unsigned32 i;
+
+  for (i = 0; i < n; i++)
+    a->semi[i] = DOM_NONE;
+  a->semi[n] = n_visited;
+  a->vertex[n_visited++] = n;
+  a->parent[n] = n;
+  a->cursor[n] = 0;
+  a->stack[sp++] = n;
+  while (sp > 0) {
+    unsigned32 v = a->stack[sp - 1];
+    unsigned32 w;
+
+    if (v == n) {
+      if (a->cursor[n] >= 2 * n) {
+        sp--;
+        continue;
+      }
+      w = a->cursor[n]++;
+      if (w < n) {
+        if (!DOM_ROOT_BIT_TEST(a, w))
+          continue;
+      } else {
+        w -= n;
+        if (a->semi[w] != DOM_NONE)
+          continue;
+        DOM_ROOT_BIT_SET(a, w);
+      }
+    } else if (a->cursor[v] < a->succ_start[v + 1]) {
+      w = a->succ[a->cursor[v]++];
+    } else {
+      sp--;
+      continue;
+    }
+    if (a->semi[w] == DOM_NONE) {
+      a->semi[w] = n_visited;
+      a->vertex[n_visited++] = w;
+      a->parent[w] = v;
+      a->cursor[w] = a->succ_start[w];
+      a->stack[sp++] = w;
+    }
+  }
+  GC_ASSERT(n_visited == n + 1);
+}
+
+/* The `eval` procedure of the algorithm (the path compression included). */
+static unsigned32
+dom_eval(struct dom_arrays_s *a, unsigned32 v)
+{
+  unsigned32 sp = 0;
+  unsigned32 x;
+
+  if (a->ancestor[v] == DOM_NONE)
+    return v;
+  for (x = v; a->ancestor[a->ancestor[x]] != DOM_NONE; x = a->ancestor[x])
+    a->stack[sp++] = x;
+  while (sp > 0) {
+    unsigned32 anc;
+
+    x = a->stack[--sp];
+    anc = a->ancestor[x];
+    if (a->semi[a->label[anc]] < a->semi[a->label[x]])
+      a->label[x] = a->label[anc];
+    a->ancestor[x] = a->ancestor[anc];
+  }
+  return a->label[v];
+}
+
+/* Compute `idom` of every node, `n` is the virtual root. */
+static void
+dom_compute_idoms(struct dom_arrays_s *a, unsigned32 n)
+{
+  unsigned32 *bucket_next = a->cursor; /*< not needed after DFS */
+  unsigned32 i;
+
+  for (i = 0; i <= n; i++) {
+    a->ancestor[i] = DOM_NONE;
+    a->label[i] = i;
+    a->bucket[i] = DOM_NONE;
+  }
+  for (i = n; i > 0; i--) {
+    unsigned32 w = a->vertex[i];
+    unsigned32 p = a->parent[w];
+    unsigned32 j, v;
+
+    for (j = a->pred_start[w]; j < a->pred_start[w + 1]; j++) {
+      unsigned32 u = dom_eval(a, a->pred[j]);
+
+      if (a->semi[u] < a->semi[w])
+        a->semi[w] = a->semi[u];
+    }
+    if (DOM_ROOT_BIT_TEST(a, w))
+      a->semi[w] = 0; /*< the virtual root is a predecessor */
+    v = a->vertex[a->semi[w]];
+    bucket_next[w] = a->bucket[v];
+    a->bucket[v] = w;
+    a->ancestor[w] = p; /*< link */
+    for (v = a->bucket[p]; v != DOM_NONE; v = bucket_next[v]) {
+      unsigned32 u = dom_eval(a, v);
+
+      a->idom[v] = a->semi[u] < a->semi[v] ? u : p;
+    }
+    a->bucket[p] = DOM_NONE;
+  }
+  for (i = 1; i <= n; i++) {
+    unsigned32 w = a->vertex[i];
+
+    if (a->idom[w] != a->vertex[a->semi[w]])
+      a->idom[w] = a->idom[a->idom[w]];
+  }
+  a->idom[n] = n;
+}
+
+/*
+ * Mark the nodes referenced from the static data in `[lo, hi)` range as
+ * the children of the virtual root.  The excluded ranges are skipped
+ * as done by the marker.
+ */
+static void
+dom_scan_roots(struct dom_arrays_s *a, unsigned32 n, ptr_t lo, ptr_t hi)
+{
+  while (ADDR_LT(lo, hi)) {
+    struct exclusion *next = GC_next_exclusion(lo);
+    ptr_t lim = hi;
+    ptr_t current_p;
+
+    if (next != NULL && ADDR_LT(next->e_start, hi))
+      lim = next->e_start;
+    current_p = PTR_ALIGN_UP(lo, ALIGNMENT);
+    for (; ADDR(current_p) + sizeof(ptr_t) <= ADDR(lim);
+         current_p += ALIGNMENT) {
+      ptr_t q;
+
+      LOAD_PTR_OR_CONTINUE(q, current_p);
+      q = dom_target(q);
+      if (q != NULL) {
+        unsigned32 i = dom_node_index(a->node_addr, n, q);
+
+        if (i < n)
+          DOM_ROOT_BIT_SET(a, i);
+      }
+    }
+    if (lim == hi)
+      break;
+    lo = next->e_end;
+  }
+}
+
+static void
+dom_fill_edges(struct dom_arrays_s *a, unsigned32 n, size_t n_edges)
+{
+  unsigned32 i;
+  size_t j;
+
+  a->succ_start[0] = 0;
+  for (i = 0; i < n; i++) {
+    a->succ_start[i + 1]
+        = a->succ_start[i]
+          + (unsigned32)dom_scan_object(a->node_addr, n, a->node_addr[i],
+                                        a->succ + a->succ_start[i],
+                                        n_edges - a->succ_start[i]);
+  }
+  a->succ_start[n + 1] = a->succ_start[n]; /*< the virtual root */
+
+  /* Build the reverse edges (`cursor` is used as the fill position). */
+  BZERO(a->pred_start, (n + 2) * sizeof(unsigned32));
+  for (j = 0; j < a->succ_start[n]; j++)
+    a->pred_start[a->succ[j] + 1]++;
+  for (i = 0; i <= n; i++)
+    a->pred_start[i + 1] += a->pred_start[i];
+  BCOPY(a->pred_start, a->cursor, (n + 1) * sizeof(unsigned32));
+  for (i = 0; i < n; i++) {
+    for (j = a->succ_start[i]; j < a->succ_start[i + 1]; j++)
+      a->pred[a->cursor[a->succ[j]]++] = i;
+  }
+
+  /* The nodes referenced from the static data, or from no other node. */
+  for (i = 0; i < n; i++) {
+    if (a->pred_start[i] == a->pred_start[i + 1])
+      DOM_ROOT_BIT_SET(a, i);
+  }
+  for (j = 0; j < n_root_sets; j++) {
+    dom_scan_roots(a, n, GC_static_roots[j].r_start,
+                   GC_static_roots[j].r_end);
+  }
+}
+
+GC_INNER void
+GC_print_retained_sizes(void)
+{
+  struct dom_arrays_s a;
+  ptr_t top_obj[MAX_RETAINED_SIZE_TOP];
+  word top_size[MAX_RETAINED_SIZE_TOP];
+  unsigned top_n = GC_retained_size_top;
+  unsigned n_found = 0;
+  size_t n_nodes, n_edges;
+  unsigned32 n, i;
+  word total;
+#  ifndef NO_CLOCK
+  CLOCK_TYPE start_time = CLOCK_TYPE_INITIALIZER;
+  CLOCK_TYPE done_time;
+
+  GET_TIME(start_time);
+#  endif
+
+  GC_ASSERT(I_HOLD_LOCK());
+  if (top_n > MAX_RETAINED_SIZE_TOP)
+    top_n = MAX_RETAINED_SIZE_TOP;
+
+  /* Allocate for the nodes, then (re)allocate for the edges too. */
+  n_nodes = dom_collect_nodes(NULL, 0);
+  if (n_nodes >= (size_t)DOM_NONE - 1
+      || !dom_alloc_arrays(&a, n_nodes, 0)) {
+    GC_err_printf("Too many objects for the dominator tree: %lu\n",
+                  (unsigned long)n_nodes);
+    return;
+  }
+  n = (unsigned32)dom_collect_nodes(a.node_addr, n_nodes);
+  for (i = 0, n_edges = 0; i < n; i++)
+    n_edges += dom_scan_object(a.node_addr, n, a.node_addr[i], NULL, 0);
+  if (n_edges >= (size_t)DOM_NONE
+      || !dom_alloc_arrays(&a, n_nodes, n_edges)) {
+    GC_err_printf("Too many references for the dominator tree: %lu\n",
+                  (unsigned long)n_edges);
+    return;
+  }
+  /* The arrays might be moved, thus collect the nodes again. */
+  n = (unsigned32)dom_collect_nodes(a.node_addr, n);
+  dom_fill_edges(&a, n, n_edges);
+  dom_dfs(&a, n);
+  dom_compute_idoms(&a, n);
+
+  /* Accumulate the sizes bottom-up the dominator tree. */
+  for (i = 0; i < n; i++)
+    a.retained[i] = HDR(a.node_addr[i])->hb_sz;
+  a.retained[n] = 0;
+  for (i = n; i > 0; i--) {
+    unsigned32 w = a.vertex[i];
+
+    a.retained[a.idom[w]] += a.retained[w];
+  }
+  total = a.retained[n];
+
+  /* Select the largest ones (by insertion into the sorted list). */
+  for (i = 0; i < n; i++) {
+    word sz = a.retained[i];
+    unsigned j;
+
+    if (n_found == top_n && (0 == top_n || sz <= top_size[top_n - 1]))
+      continue;
+    j = n_found < top_n ? n_found++ : top_n - 1;
+    for (; j > 0 && top_size[j - 1] < sz; j--) {
+      top_size[j] = top_size[j - 1];
+      top_obj[j] = top_obj[j - 1];
+    }
+    top_size[j] = sz;
+    top_obj[j] = a.node_addr[i];
+  }
+
+#  ifndef NO_CLOCK
+  GET_TIME(done_time);
+  GC_COND_LOG_PRINTF("Dominator tree of %lu objects (%lu references)"
+                     " computed in %lu ms\n",
+                     (unsigned long)n, (unsigned long)n_edges,
+                     MS_TIME_DIFF(done_time, start_time));
+#  endif
+  GC_printf("Largest retained sizes at GC #%lu (of %lu bytes reachable):\n",
+            (unsigned long)GC_gc_no, (unsigned long)total);
+  UNLOCK();
+  /*
+   * Note: the objects are not reclaimed until the next collection, which
+   * might happen concurrently though; this is tolerated by the debugging
+   * facility.
+   */
+  for (i = 0; i < n_found; i++) {
+    GC_err_printf("%lu bytes retained by ", (unsigned long)top_size[i]);
+    GC_print_heap_obj(top_obj[i]);
+  }
+  LOCK();
+}
+
 #endif /* MAKE_BACK_GRAPH */
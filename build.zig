@@ -154,11 +154,14 @@ pub fn build(b: *std.Build) void {
     source_files.appendSlice(&.{
         "allchblk.c",
         "alloc.c",
+        "allocrec.c",
         "blacklst.c",
         "dbg_mlc.c",
         "dyn_load.c",
         "finalize.c",
         "headers.c",
+        "heapprof.c",
+        "heapsnap.c",
         "mach_dep.c",
         "malloc.c",
         "mallocx.c",
@@ -169,6 +172,7 @@ pub fn build(b: *std.Build) void {
         "os_dep.c",
         "ptr_chck.c",
         "reclaim.c",
+        "tracebuf.c",
         "typd_mlc.c",
     }) catch unreachable;
 
@@ -612,6 +616,12 @@ pub fn build(b: *std.Build) void {
     addTest(b, gc, test_step, flags, "middletest", "tests/middle.c");
     addTest(b, gc, test_step, flags, "realloctest", "tests/realloc.c");
     addTest(b, gc, test_step, flags, "smashtest", "tests/smash.c");
+    addTest(b, gc, test_step, flags, "fnlzcycletest", "tests/fnlzcycle.c");
+    addTest(b, gc, test_step, flags, "allocreplay", "tests/allocreplay.c");
+    addTest(b, gc, test_step, flags, "gc_bench", "tests/gc_bench.c");
+    if (t.os.tag != .windows) {
+        addSnapshotTest(b, gc, test_step, flags);
+    }
     // TODO: add `staticroots` test
     if (enable_gc_debug) {
         addTest(b, gc, test_step, flags, "tracetest", "tests/trace.c");
@@ -686,6 +696,45 @@ fn addTestExt(b: *std.Build, gc: *std.Build.Step.Compile,
     test_step.dependOn(&run_test_exe.step);
 }
 
+// The heap snapshot written by `heapsnaptest` is read by `snapstat` tool.
+fn addSnapshotTest(b: *std.Build, gc: *std.Build.Step.Compile,
+                   test_step: *std.Build.Step,
+                   flags: std.ArrayList([]const u8)) void {
+    const test_exe = b.addExecutable(.{
+        .name = "heapsnaptest",
+        .root_module = b.createModule(.{
+            .optimize = gc.root_module.optimize.?,
+            .target = gc.root_module.resolved_target.?
+        })
+    });
+    test_exe.addCSourceFile(.{
+        .file = b.path("tests/heapsnap.c"),
+        .flags = flags.items
+    });
+    test_exe.addIncludePath(b.path("include"));
+    test_exe.linkLibrary(gc);
+    test_exe.linkLibC();
+    const run_test_exe = b.addRunArtifact(test_exe);
+    const snapshot = run_test_exe.addOutputFileArg("heapsnap.out");
+
+    const snapstat = b.addExecutable(.{
+        .name = "snapstat",
+        .root_module = b.createModule(.{
+            .optimize = gc.root_module.optimize.?,
+            .target = gc.root_module.resolved_target.?
+        })
+    });
+    snapstat.addCSourceFile(.{
+        .file = b.path("tools/snapstat.c"),
+        .flags = flags.items
+    });
+    snapstat.linkLibC();
+    const run_snapstat = b.addRunArtifact(snapstat);
+    run_snapstat.addArgs(&.{ "-n", "5" });
+    run_snapstat.addFileArg(snapshot);
+    test_step.dependOn(&run_snapstat.step);
+}
+
 fn installHeader(b: *std.Build, lib: *std.Build.Step.Compile,
                  hfile: []const u8) void {
    const src_path = b.pathJoin(&.{ "include", hfile });
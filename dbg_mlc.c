@@ -17,6 +17,7 @@
  */
 
 #include "private/dbg_mlc.h"
+#include "private/gc_pmark.h"
 
 #ifndef MSWINCE
 #  include <errno.h>
@@ -227,6 +228,146 @@ GC_generate_random_backtrace(void)
 
 #endif /* KEEP_BACK_PTRS */
 
+#ifdef CALL_CHAIN_IDS
+/*
+ * The table of the distinct call chains saved for the debug-allocated
+ * objects.  `GC_call_chains` holds the chains (the one with `id` value
+ * of `i` is at index `i - 1`), `GC_call_chain_slots` is an open
+ * addressing hash table (twice bigger than the capacity of the former)
+ * mapping a chain to its `id` (zero means empty slot).  The chains are
+ * never removed.  Accessed only with the allocator lock held.
+ */
+typedef struct callinfo call_chain_t[NFRAMES];
+
+STATIC call_chain_t *GC_call_chains = NULL;
+STATIC unsigned32 *GC_call_chain_slots = NULL;
+STATIC size_t GC_call_chains_cnt = 0;
+
+/* The log2 of the capacity of `GC_call_chains`. */
+STATIC unsigned GC_call_chains_log_size = 0;
+
+#  define CALL_CHAINS_MIN_LOG_SIZE 8
+#  define CALL_CHAINS_MAX_LOG_SIZE 30
+
+STATIC size_t
+GC_call_chain_hash(const struct callinfo info[NFRAMES])
+{
+  const word *pw = (const word *)info;
+  word h = 0;
+  size_t i;
+
+  for (i = 0; i < sizeof(call_chain_t) / sizeof(word); i++)
+    h = ((h << 7) | (h >> (CPP_WORDSZ - 7))) ^ pw[i];
+  return (size_t)(h ^ (h >> 17) ^ (h >> 31));
+}
+
+STATIC void
+GC_call_chain_slot_add(unsigned32 id)
+{
+  size_t mask = ((size_t)2 << GC_call_chains_log_size) - 1;
+  size_t i = GC_call_chain_hash(GC_call_chains[id - 1]) & mask;
+
+  while (GC_call_chain_slots[i] != 0)
+    i = (i + 1) & mask;
+  GC_call_chain_slots[i] = id;
+}
+
+/* Ensure there is room for one more chain.  Returns `FALSE` on failure. */
+STATIC GC_bool
+GC_call_chains_reserve(void)
+{
+  unsigned log_new_size;
+  call_chain_t *new_chains;
+  unsigned32 *new_slots;
+  size_t id;
+
+  GC_ASSERT(I_HOLD_LOCK());
+  if (GC_call_chains != NULL
+      && GC_call_chains_cnt < ((size_t)1 << GC_call_chains_log_size))
+    return TRUE;
+
+  log_new_size = NULL == GC_call_chains ? CALL_CHAINS_MIN_LOG_SIZE
+                                        : GC_call_chains_log_size + 1;
+  if (log_new_size > CALL_CHAINS_MAX_LOG_SIZE)
+    return FALSE;
+  new_chains = (call_chain_t *)GC_os_get_mem(
+      ROUNDUP_PAGESIZE_IF_MMAP(sizeof(call_chain_t) << log_new_size));
+  if (EXPECT(NULL == new_chains, FALSE))
+    return FALSE;
+  new_slots = (unsigned32 *)GC_os_get_mem(
+      ROUNDUP_PAGESIZE_IF_MMAP(sizeof(unsigned32) << (log_new_size + 1)));
+  if (EXPECT(NULL == new_slots, FALSE)) {
+#  ifndef GWW_VDB
+    GC_scratch_recycle_no_gww(
+        new_chains,
+        ROUNDUP_PAGESIZE_IF_MMAP(sizeof(call_chain_t) << log_new_size));
+#  endif
+    return FALSE;
+  }
+  BZERO(new_slots, sizeof(unsigned32) << (log_new_size + 1));
+  if (GC_call_chains != NULL) {
+    BCOPY(GC_call_chains, new_chains,
+          GC_call_chains_cnt * sizeof(call_chain_t));
+#  ifndef GWW_VDB
+    GC_scratch_recycle_no_gww(
+        GC_call_chains, ROUNDUP_PAGESIZE_IF_MMAP(sizeof(call_chain_t)
+                                                 << GC_call_chains_log_size));
+    GC_scratch_recycle_no_gww(
+        GC_call_chain_slots,
+        ROUNDUP_PAGESIZE_IF_MMAP(sizeof(unsigned32)
+                                 << (GC_call_chains_log_size + 1)));
+#  endif
+  }
+  GC_call_chains = new_chains;
+  GC_call_chain_slots = new_slots;
+  GC_call_chains_log_size = log_new_size;
+  for (id = 1; id <= GC_call_chains_cnt; id++)
+    GC_call_chain_slot_add((unsigned32)id);
+  return TRUE;
+}
+
+GC_INNER unsigned32
+GC_call_chain_id(const struct callinfo info[NFRAMES])
+{
+  unsigned32 id;
+
+  GC_ASSERT(I_HOLD_LOCK());
+  if (GC_call_chains != NULL) {
+    size_t mask = ((size_t)2 << GC_call_chains_log_size) - 1;
+    size_t i;
+
+    for (i = GC_call_chain_hash(info) & mask;
+         (id = GC_call_chain_slots[i]) != 0; i = (i + 1) & mask) {
+      if (memcmp(GC_call_chains[id - 1], info, sizeof(call_chain_t)) == 0)
+        return id;
+    }
+  }
+  if (EXPECT(!GC_call_chains_reserve(), FALSE))
+    return 0;
+  id = (unsigned32)(++GC_call_chains_cnt);
+  BCOPY(info, GC_call_chains[id - 1], sizeof(call_chain_t));
+  GC_call_chain_slot_add(id);
+  return id;
+}
+
+GC_INNER void
+GC_print_call_chain(unsigned32 id)
+{
+  call_chain_t info;
+  GC_bool found = FALSE;
+
+  READER_LOCK();
+  /* The `id` value might be smashed. */
+  if (id != 0 && id <= GC_call_chains_cnt) {
+    BCOPY(GC_call_chains[id - 1], info, sizeof(call_chain_t));
+    found = TRUE;
+  }
+  READER_UNLOCK();
+  if (found)
+    GC_print_callers(info);
+}
+#endif /* CALL_CHAIN_IDS */
+
 #define CROSSES_HBLK(p, sz) \
   ((ADDR((p) + (sizeof(oh) - 1) + (sz)) ^ ADDR(p)) >= HBLKSIZE)
 
@@ -404,6 +545,14 @@ GC_debug_print_heap_obj_proc(ptr_t base)
 
 #ifndef SHORT_DBG_HDRS
 STATIC void GC_check_heap_proc(void);
+#  ifdef PARALLEL_MARK
+/* The index of `GC_check_heap_mark_proc` in `GC_mark_procs`. */
+STATIC unsigned GC_check_heap_proc_index;
+
+STATIC struct GC_ms_entry *GC_CALLBACK
+GC_check_heap_mark_proc(GC_word *addr, struct GC_ms_entry *mark_stack_top,
+                        struct GC_ms_entry *mark_stack_limit, GC_word env);
+#  endif
 #elif !defined(NO_FIND_LEAK)
 static void
 do_nothing(void)
@@ -428,6 +577,9 @@ GC_start_debugging_inner(void)
 #ifndef SHORT_DBG_HDRS
   GC_check_heap = GC_check_heap_proc;
   GC_print_all_smashed = GC_print_all_smashed_proc;
+#  ifdef PARALLEL_MARK
+  GC_check_heap_proc_index = GC_new_proc_inner(GC_check_heap_mark_proc);
+#  endif
 #elif !defined(NO_FIND_LEAK)
   GC_check_heap = do_nothing;
   GC_print_all_smashed = do_nothing;
@@ -443,8 +595,10 @@ GC_start_debugging_inner(void)
 /*
  * Check the allocation is successful, store debugging info into `base`,
  * start the debugging mode (if not yet), and return displaced pointer.
+ * Not inlined, so that exactly one frame of the collector (that of the
+ * debug allocation function) is between this one and the client code.
  */
-static void *
+GC_ATTR_NOINLINE static void *
 store_debug_info(void *base, size_t lb, const char *fn, GC_EXTRA_PARAMS)
 {
   void *result;
@@ -458,11 +612,24 @@ store_debug_info(void *base, size_t lb, const char *fn, GC_EXTRA_PARAMS)
   if (!debugging_initialized)
     GC_start_debugging_inner();
   result = GC_store_debug_info_inner(base, lb, s, i);
-  ADD_CALL_CHAIN(base, ra);
+  ADD_CALL_CHAIN(base, ra, 1);
   UNLOCK();
   return result;
 }
 
+/*
+ * Return the result of `store_debug_info()` from a debug allocation
+ * function.  The call is not a tail one, thus the frame of the latter
+ * function remains on the stack (and is skipped by `ADD_CALL_CHAIN`).
+ */
+#define RETURN_STORE_DEBUG_INFO(base, lb, fn)                   \
+  do {                                                          \
+    void *result = store_debug_info(base, lb, fn, OPT_RA s, i); \
+                                                                \
+    GC_noop1_ptr(result);                                       \
+    return result;                                              \
+  } while (0)
+
 const size_t GC_debug_header_size = sizeof(oh);
 
 GC_API size_t GC_CALL
@@ -527,7 +694,7 @@ GC_debug_malloc(size_t lb, GC_EXTRA_PARAMS)
     GC_caller_func_offset(ra, &s, &i);
   }
 #endif
-  return store_debug_info(base, lb, "GC_debug_malloc", OPT_RA s, i);
+  RETURN_STORE_DEBUG_INFO(base, lb, "GC_debug_malloc");
 }
 
 GC_API GC_ATTR_MALLOC void *GC_CALL
@@ -535,8 +702,7 @@ GC_debug_malloc_ignore_off_page(size_t lb, GC_EXTRA_PARAMS)
 {
   void *base = GC_malloc_ignore_off_page(SIZET_SAT_ADD(lb, DEBUG_BYTES));
 
-  return store_debug_info(base, lb, "GC_debug_malloc_ignore_off_page",
-                          OPT_RA s, i);
+  RETURN_STORE_DEBUG_INFO(base, lb, "GC_debug_malloc_ignore_off_page");
 }
 
 GC_API GC_ATTR_MALLOC void *GC_CALL
@@ -545,8 +711,7 @@ GC_debug_malloc_atomic_ignore_off_page(size_t lb, GC_EXTRA_PARAMS)
   void *base
       = GC_malloc_atomic_ignore_off_page(SIZET_SAT_ADD(lb, DEBUG_BYTES));
 
-  return store_debug_info(base, lb, "GC_debug_malloc_atomic_ignore_off_page",
-                          OPT_RA s, i);
+  RETURN_STORE_DEBUG_INFO(base, lb, "GC_debug_malloc_atomic_ignore_off_page");
 }
 
 STATIC void *
@@ -555,7 +720,7 @@ GC_debug_generic_malloc(size_t lb, int kind, GC_EXTRA_PARAMS)
   void *base = GC_generic_malloc_aligned(SIZET_SAT_ADD(lb, DEBUG_BYTES), kind,
                                          0 /* `flags` */, 0 /* `align_m1` */);
 
-  return store_debug_info(base, lb, "GC_debug_generic_malloc", OPT_RA s, i);
+  RETURN_STORE_DEBUG_INFO(base, lb, "GC_debug_generic_malloc");
 }
 
 #ifdef DBG_HDRS_ALL
@@ -611,6 +776,7 @@ GC_debug_ptr_store_and_dirty(void *p, const void *q)
       = GC_is_valid_displacement(GC_CAST_AWAY_CONST_PVOID(q));
   GC_debug_end_stubborn_change(p);
   REACHABLE_AFTER_DIRTY(q);
+  ALLOC_REC(GC_alloc_rec_store(p, q));
 }
 
 GC_API GC_ATTR_MALLOC void *GC_CALL
@@ -618,7 +784,7 @@ GC_debug_malloc_atomic(size_t lb, GC_EXTRA_PARAMS)
 {
   void *base = GC_malloc_atomic(SIZET_SAT_ADD(lb, DEBUG_BYTES));
 
-  return store_debug_info(base, lb, "GC_debug_malloc_atomic", OPT_RA s, i);
+  RETURN_STORE_DEBUG_INFO(base, lb, "GC_debug_malloc_atomic");
 }
 
 GC_API GC_ATTR_MALLOC char *GC_CALL
@@ -691,8 +857,7 @@ GC_debug_malloc_uncollectable(size_t lb, GC_EXTRA_PARAMS)
   void *base
       = GC_malloc_uncollectable(SIZET_SAT_ADD(lb, UNCOLLECTABLE_DEBUG_BYTES));
 
-  return store_debug_info(base, lb, "GC_debug_malloc_uncollectable", OPT_RA s,
-                          i);
+  RETURN_STORE_DEBUG_INFO(base, lb, "GC_debug_malloc_uncollectable");
 }
 
 #ifdef GC_ATOMIC_UNCOLLECTABLE
@@ -702,8 +867,7 @@ GC_debug_malloc_atomic_uncollectable(size_t lb, GC_EXTRA_PARAMS)
   void *base = GC_malloc_atomic_uncollectable(
       SIZET_SAT_ADD(lb, UNCOLLECTABLE_DEBUG_BYTES));
 
-  return store_debug_info(base, lb, "GC_debug_malloc_atomic_uncollectable",
-                          OPT_RA s, i);
+  RETURN_STORE_DEBUG_INFO(base, lb, "GC_debug_malloc_atomic_uncollectable");
 }
 #endif /* GC_ATOMIC_UNCOLLECTABLE */
 
@@ -895,14 +1059,43 @@ GC_debug_generic_or_special_malloc(size_t lb, int kind, GC_EXTRA_PARAMS)
   }
 }
 
+/*
+ * The number of the collections the debug heap check is spread over.
+ * Could be set by `GC_CHECK_HEAP_SLICES` environment variable.
+ */
+STATIC unsigned GC_check_heap_slices = 1;
+
+GC_API void GC_CALL
+GC_set_check_heap_slices(unsigned n)
+{
+  GC_check_heap_slices = n > 0 ? n : 1;
+}
+
+GC_API unsigned GC_CALL
+GC_get_check_heap_slices(void)
+{
+  return GC_check_heap_slices;
+}
+
 #ifndef SHORT_DBG_HDRS
 
+#  ifdef PARALLEL_MARK
+/*
+ * The clobbered locations found by the marker threads.  Protected by the
+ * mark lock; moved to `GC_smashed` once the checking is done.
+ */
+STATIC ptr_t GC_par_smashed[MAX_SMASHED];
+STATIC unsigned GC_n_par_smashed = 0;
+#  endif
+
 /*
  * Check all marked objects in the given block for validity.
+ * `from_marker` means the caller is a marker thread (or the thread
+ * acting as one), thus the allocator lock might be not held.
  * Note: avoid `GC_apply_to_each_object` for performance reasons.
  */
-STATIC void GC_CALLBACK
-GC_check_heap_block(struct hblk *hbp, void *dummy)
+STATIC void
+GC_check_heap_block_inner(struct hblk *hbp, GC_bool from_marker)
 {
   const hdr *hhdr = HDR(hbp);
   ptr_t p = hbp->hb_body;
@@ -910,7 +1103,6 @@ GC_check_heap_block(struct hblk *hbp, void *dummy)
   size_t sz = hhdr->hb_sz;
   size_t bit_no;
 
-  UNUSED_ARG(dummy);
   GC_ASSERT((ptr_t)hhdr->hb_block == p);
   plim = sz > MAXOBJBYTES ? p : p + HBLKSIZE - sz;
   /* Go through all objects in block. */
@@ -918,12 +1110,99 @@ GC_check_heap_block(struct hblk *hbp, void *dummy)
     if (mark_bit_from_hdr(hhdr, bit_no) && GC_HAS_DEBUG_INFO(p)) {
       ptr_t clobbered = GC_check_annotated_obj((oh *)p);
 
-      if (clobbered != NULL)
-        GC_add_smashed(clobbered);
+      if (EXPECT(NULL == clobbered, TRUE))
+        continue;
+#  ifdef PARALLEL_MARK
+      if (from_marker) {
+        GC_acquire_mark_lock();
+        if (GC_n_par_smashed < MAX_SMASHED)
+          GC_par_smashed[GC_n_par_smashed++] = clobbered;
+        GC_release_mark_lock();
+        continue;
+      }
+#  else
+      UNUSED_ARG(from_marker);
+#  endif
+      GC_add_smashed(clobbered);
     }
   }
 }
 
+/*
+ * Is the block checked by the current collection?  The heap blocks are
+ * split into `GC_check_heap_slices` sets by the address; each collection
+ * checks one of the sets in turn.
+ */
+#  define IN_CHECK_HEAP_SLICE(hbp)                         \
+    (GC_check_heap_slices <= 1                             \
+     || (ADDR(hbp) >> LOG_HBLKSIZE) % GC_check_heap_slices \
+            == (word)GC_gc_no % GC_check_heap_slices)
+
+STATIC void GC_CALLBACK
+GC_check_heap_block(struct hblk *hbp, void *dummy)
+{
+  UNUSED_ARG(dummy);
+  if (IN_CHECK_HEAP_SLICE(hbp))
+    GC_check_heap_block_inner(hbp, FALSE);
+}
+
+#  ifdef PARALLEL_MARK
+/*
+ * The mark procedure invoked by the marker threads on each mark stack
+ * entry pushed by `GC_push_check_heap_block`.  Pushes nothing; `addr`
+ * is the heap block to check.
+ */
+STATIC struct GC_ms_entry *GC_CALLBACK
+GC_check_heap_mark_proc(GC_word *addr, struct GC_ms_entry *mark_stack_top,
+                        struct GC_ms_entry *mark_stack_limit, GC_word env)
+{
+  UNUSED_ARG(mark_stack_limit);
+  UNUSED_ARG(env);
+  GC_check_heap_block_inner(HBLKPTR(addr), TRUE);
+  return mark_stack_top;
+}
+
+STATIC void GC_CALLBACK
+GC_push_check_heap_block(struct hblk *hbp, void *drain_limit)
+{
+  mse *mark_stack_top;
+
+  if (!IN_CHECK_HEAP_SLICE(hbp))
+    return;
+  mark_stack_top = GC_mark_stack_top + 1;
+  mark_stack_top->mse_start = hbp->hb_body;
+  mark_stack_top->mse_descr = GC_MAKE_PROC(GC_check_heap_proc_index, 0);
+  GC_mark_stack_top = mark_stack_top;
+  if (ADDR_GE((ptr_t)mark_stack_top, (ptr_t)drain_limit))
+    GC_parallel_mark_from_mark_stack();
+}
+
+/*
+ * The same as `GC_apply_to_all_blocks(GC_check_heap_block, NULL)` but
+ * the blocks are checked by the parallel marker threads.  The blocks
+ * are pushed onto the global mark stack (as the entries with
+ * `GC_check_heap_mark_proc` descriptor) and the mark stack is processed
+ * once it is filled up to a quarter.
+ */
+STATIC void
+GC_check_heap_parallel(void)
+{
+  unsigned i, n;
+
+  GC_ASSERT(I_HOLD_LOCK());
+  GC_ASSERT(GC_mark_stack_empty());
+  GC_apply_to_all_blocks(GC_push_check_heap_block,
+                         GC_mark_stack + GC_mark_stack_size / 4);
+  GC_parallel_mark_from_mark_stack();
+
+  /* The marker threads are idle now. */
+  n = GC_n_par_smashed;
+  for (i = 0; i < n; i++)
+    GC_add_smashed(GC_par_smashed[i]);
+  GC_n_par_smashed = 0;
+}
+#  endif /* PARALLEL_MARK */
+
 /*
  * This assumes that all accessible objects are marked.
  * Normally called by collector.
@@ -934,6 +1213,12 @@ GC_check_heap_proc(void)
   GC_ASSERT(I_HOLD_LOCK());
   GC_STATIC_ASSERT((sizeof(oh) & (GC_GRANULE_BYTES - 1)) == 0);
   /* FIXME: Should we check for twice that alignment? */
+#  ifdef PARALLEL_MARK
+  if (GC_parallel && !GC_parallel_mark_disabled) {
+    GC_check_heap_parallel();
+    return;
+  }
+#  endif
   GC_apply_to_all_blocks(GC_check_heap_block, NULL);
 }
 
@@ -1202,7 +1487,7 @@ GC_debug_gcj_malloc(size_t lb, const void *vtable_ptr, GC_EXTRA_PARAMS)
   if (!debugging_initialized)
     GC_start_debugging_inner();
   result = GC_store_debug_info_inner(base, lb, s, i);
-  ADD_CALL_CHAIN(base, ra);
+  ADD_CALL_CHAIN(base, ra, 0);
   UNLOCK();
   GC_dirty(result);
   REACHABLE_AFTER_DIRTY(vtable_ptr);
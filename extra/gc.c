@@ -42,13 +42,17 @@
 #endif
 
 /* Small files go first... */
+#include "../allocrec.c"
 #include "../backgraph.c"
 #include "../blacklst.c"
 #include "../checksums.c"
 #include "../gcj_mlc.c"
 #include "../headers.c"
+#include "../heapprof.c"
+#include "../heapsnap.c"
 #include "../new_hblk.c"
 #include "../ptr_chck.c"
+#include "../tracebuf.c"
 
 #include "../allchblk.c"
 #include "../alloc.c"
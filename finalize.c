@@ -19,6 +19,15 @@
 
 #ifndef GC_NO_FINALIZATION
 #  include "gc/javaxfc.h" /*< to get `GC_finalize_all()` as `extern "C"` */
+#  ifdef ENABLE_DISCLAIM
+#    include "gc/gc_disclaim.h" /*< for `GC_invoke_disclaim_batches()` */
+#  endif
+
+#  if defined(GC_PTHREADS) && !defined(PLATFORM_THREADS) \
+      && !defined(SN_TARGET_PSP2)
+#    define FINALIZER_THREADS_SUPPORTED
+#    include <pthread.h>
+#  endif
 
 /*
  * Type of mark procedure used for marking from finalizable object.
@@ -71,6 +80,54 @@ struct finalizable_object {
 #    define SET_FINALIZE_NOW(fo) (void)(GC_fnlz_roots.finalize_now = (fo))
 #  endif /* !THREADS */
 
+/*
+ * Number of objects on `finalize_now` queue.  Protected by the
+ * allocator lock.
+ */
+STATIC size_t GC_finalize_now_entries = 0;
+
+#  if defined(THREADS) && !defined(DBG_HDRS_ALL)
+#    define DEFERRED_DL_REGISTRATION
+
+#    ifndef DL_PENDING_LOG_SHARDS
+#      define DL_PENDING_LOG_SHARDS 4
+#    endif
+#    define DL_PENDING_SHARDS ((size_t)1 << DL_PENDING_LOG_SHARDS)
+
+/*
+ * The number of the pending entries in a shard to initiate merging of
+ * the shard to `GC_dl_hashtbl` by the registering thread.
+ */
+#    ifndef DL_PENDING_MAX_ENTRIES
+#      define DL_PENDING_MAX_ENTRIES 128
+#    endif
+
+/*
+ * A shard of the short disappearing links registered (or unregistered)
+ * in the deferred registration mode but not merged to `GC_dl_hashtbl`
+ * yet.  The shard is selected by the link address, thus all the pending
+ * operations on a link are in the same shard.  Each shard is protected
+ * by its own spin lock which is never held while acquiring the allocator
+ * lock (the reverse order is allowed).  An entry with zero
+ * `dl_hidden_obj` is a pending unregistration of the link.
+ */
+struct dl_pending_shard_s {
+  struct disappearing_link *head;
+  volatile AO_t entries; /*< could be read without acquiring `lock` */
+  volatile AO_TS_t lock;
+};
+
+STATIC struct dl_pending_shard_s GC_dl_pending[DL_PENDING_SHARDS];
+
+/* Is the deferred registration mode on? */
+STATIC volatile AO_t GC_deferred_dl = 0;
+
+#    define DL_PENDING_LOCK(shard) GC_spin_lock(&(shard)->lock)
+#    define DL_PENDING_UNLOCK(shard) AO_CLEAR(&(shard)->lock)
+
+STATIC void GC_merge_pending_dls(GC_bool in_collection);
+#  endif /* THREADS && !DBG_HDRS_ALL */
+
 GC_API void GC_CALL
 GC_push_finalizer_structures(void)
 {
@@ -81,6 +138,11 @@ GC_push_finalizer_structures(void)
   GC_PUSH_ALL_SYM(GC_ll_hashtbl.head);
 #  endif
   GC_PUSH_ALL_SYM(GC_dl_hashtbl.head);
+  GC_ASSERT(ADDR(&GC_sl_hashtbl.head) % ALIGNMENT == 0);
+  GC_PUSH_ALL_SYM(GC_sl_hashtbl.head);
+#  ifdef DEFERRED_DL_REGISTRATION
+  GC_PUSH_ALL_SYM(GC_dl_pending);
+#  endif
   GC_PUSH_ALL_SYM(GC_fnlz_roots);
   /* `GC_toggleref_arr` is pushed specially by `GC_mark_togglerefs`. */
 }
@@ -96,18 +158,20 @@ GC_push_finalizer_structures(void)
 /*
  * Ensure the hash table has enough capacity.  `*table_ptr` is a pointer
  * to an array of hash headers.  `*log_size_ptr` is the log of its current
- * size.  We update both `*table_ptr` and `*log_size_ptr` on success.
+ * size.  `extra` is the number of entries to be added soon (in addition
+ * to `*entries_ptr` ones); the table is at least doubled anyway.  We
+ * update both `*table_ptr` and `*log_size_ptr` on success.
  */
 STATIC void
 GC_grow_table(struct hash_chain_entry ***table_ptr, unsigned *log_size_ptr,
-              const size_t *entries_ptr)
+              const size_t *entries_ptr, size_t extra)
 {
   size_t i;
   struct hash_chain_entry *p;
   unsigned log_old_size = *log_size_ptr;
   unsigned log_new_size = log_old_size + 1;
   size_t old_size = NULL == *table_ptr ? 0 : (size_t)1 << log_old_size;
-  size_t new_size = (size_t)1 << log_new_size;
+  size_t new_size;
   /* FIXME: Power-of-two size often gets rounded up to one more page. */
   struct hash_chain_entry **new_table;
 
@@ -125,10 +189,15 @@ GC_grow_table(struct hash_chain_entry ***table_ptr, unsigned *log_size_ptr,
     GC_gcollect_inner();
     RESTORE_CANCEL(cancel_state);
     /* `GC_finalize` might decrease entries value. */
-    if (*entries_ptr < ((size_t)1 << log_old_size) - (*entries_ptr >> 2))
+    if (*entries_ptr + extra
+        < ((size_t)1 << log_old_size) - ((*entries_ptr + extra) >> 2))
       return;
   }
 
+  while (log_new_size < sizeof(size_t) * 8 - 2
+         && ((size_t)1 << log_new_size) < *entries_ptr + extra)
+    log_new_size++;
+  new_size = (size_t)1 << log_new_size;
   new_table = (struct hash_chain_entry **)GC_INTERNAL_MALLOC_IGNORE_OFF_PAGE(
       new_size * sizeof(struct hash_chain_entry *), NORMAL);
   if (NULL == new_table) {
@@ -166,69 +235,57 @@ GC_register_disappearing_link(void **link)
   return GC_general_register_disappearing_link(link, base);
 }
 
-STATIC int
-GC_register_disappearing_link_inner(struct dl_hashtbl_s *dl_hashtbl,
-                                    void **link, const void *obj,
-                                    const char *tbl_log_name)
+/*
+ * Grow `dl_hashtbl` (if needed) before adding `n` more entries to it.
+ * `tbl_log_name` is used for logging only.
+ */
+STATIC void
+GC_reserve_dl_entries(struct dl_hashtbl_s *dl_hashtbl, size_t n,
+                      const char *tbl_log_name)
 {
-  struct disappearing_link *curr_dl;
-  size_t index;
-  struct disappearing_link *new_dl;
-
-  GC_ASSERT(GC_is_initialized);
-  if (EXPECT(GC_find_leak_inner, FALSE))
-    return GC_UNIMPLEMENTED;
-#  ifdef GC_ASSERTIONS
-  /* Just check accessibility. */
-  GC_noop1_ptr(*link);
-#  endif
-  LOCK();
-  GC_ASSERT(obj != NULL && GC_base_C(obj) == obj);
+  GC_ASSERT(I_HOLD_LOCK());
   if (EXPECT(NULL == dl_hashtbl->head, FALSE)
-      || EXPECT(dl_hashtbl->entries > ((size_t)1 << dl_hashtbl->log_size),
+      || EXPECT(dl_hashtbl->entries + n
+                    > ((size_t)1 << dl_hashtbl->log_size),
                 FALSE)) {
     GC_grow_table((struct hash_chain_entry ***)&dl_hashtbl->head,
-                  &dl_hashtbl->log_size, &dl_hashtbl->entries);
+                  &dl_hashtbl->log_size, &dl_hashtbl->entries, n);
     GC_COND_LOG_PRINTF("Grew %s table to %u entries\n", tbl_log_name,
                        1U << dl_hashtbl->log_size);
   }
+}
+
+/*
+ * Add `link` (pointing to `obj`) to `dl_hashtbl` or update the object
+ * of the already registered one.  The allocator lock is held.  `new_dl`
+ * (if non-`NULL`) is the entry to use instead of allocating a new one;
+ * it is consumed only if `GC_SUCCESS` is returned.  Returns
+ * `GC_NO_MEMORY` if the entry cannot be allocated.
+ */
+STATIC int
+GC_add_dl_entry_locked(struct dl_hashtbl_s *dl_hashtbl, void **link,
+                       const void *obj, size_t dl_sz,
+                       struct disappearing_link *new_dl)
+{
+  struct disappearing_link *curr_dl;
+  size_t index;
+
+  GC_ASSERT(I_HOLD_LOCK());
+  GC_ASSERT(obj != NULL && GC_base_C(obj) == obj);
   index = HASH2(link, dl_hashtbl->log_size);
   for (curr_dl = dl_hashtbl->head[index]; curr_dl != 0;
        curr_dl = dl_next(curr_dl)) {
     if (curr_dl->dl_hidden_link == GC_HIDE_POINTER(link)) {
       /* Alternatively, `GC_HIDE_NZ_POINTER()` could be used instead. */
       curr_dl->dl_hidden_obj = GC_HIDE_POINTER(obj);
-      UNLOCK();
       return GC_DUPLICATE;
     }
   }
-  new_dl = (struct disappearing_link *)GC_INTERNAL_MALLOC(
-      sizeof(struct disappearing_link), NORMAL);
-  if (EXPECT(NULL == new_dl, FALSE)) {
-    GC_oom_func oom_fn = GC_oom_fn;
-    UNLOCK();
-    new_dl = (struct disappearing_link *)(*oom_fn)(
-        sizeof(struct disappearing_link));
-    if (0 == new_dl) {
+  if (NULL == new_dl) {
+    GC_ASSERT(dl_sz >= sizeof(struct disappearing_link));
+    new_dl = (struct disappearing_link *)GC_INTERNAL_MALLOC(dl_sz, NORMAL);
+    if (EXPECT(NULL == new_dl, FALSE))
       return GC_NO_MEMORY;
-    }
-    /* It is not likely we will make it here, but... */
-    LOCK();
-    /* Recalculate `index` since the table may grow. */
-    index = HASH2(link, dl_hashtbl->log_size);
-    /* Check again that our disappearing link not in the table. */
-    for (curr_dl = dl_hashtbl->head[index]; curr_dl != 0;
-         curr_dl = dl_next(curr_dl)) {
-      if (curr_dl->dl_hidden_link == GC_HIDE_POINTER(link)) {
-        curr_dl->dl_hidden_obj = GC_HIDE_POINTER(obj);
-        UNLOCK();
-#  ifndef DBG_HDRS_ALL
-        /* Free unused `new_dl` returned by `GC_oom_fn()`. */
-        GC_free(new_dl);
-#  endif
-        return GC_DUPLICATE;
-      }
-    }
   }
   new_dl->dl_hidden_obj = GC_HIDE_POINTER(obj);
   new_dl->dl_hidden_link = GC_HIDE_POINTER(link);
@@ -237,16 +294,55 @@ GC_register_disappearing_link_inner(struct dl_hashtbl_s *dl_hashtbl,
   dl_hashtbl->head[index] = new_dl;
   dl_hashtbl->entries++;
   GC_dirty(dl_hashtbl->head + index);
-  UNLOCK();
   return GC_SUCCESS;
 }
 
-GC_API int GC_CALL
-GC_general_register_disappearing_link(void **link, const void *obj)
+STATIC int
+GC_register_disappearing_link_inner(struct dl_hashtbl_s *dl_hashtbl,
+                                    void **link, const void *obj,
+                                    size_t dl_sz, const char *tbl_log_name)
 {
-  if ((ADDR(link) & (ALIGNMENT - 1)) != 0 || !NONNULL_ARG_NOT_NULL(link))
-    ABORT("Bad arg to GC_general_register_disappearing_link");
-  return GC_register_disappearing_link_inner(&GC_dl_hashtbl, link, obj, "dl");
+  struct disappearing_link *new_dl;
+  GC_oom_func oom_fn;
+  int res;
+
+  GC_ASSERT(GC_is_initialized);
+  if (EXPECT(GC_find_leak_inner, FALSE))
+    return GC_UNIMPLEMENTED;
+#  ifdef GC_ASSERTIONS
+  /* Just check accessibility. */
+  GC_noop1_ptr(*link);
+#  endif
+  LOCK();
+  GC_reserve_dl_entries(dl_hashtbl, 0, tbl_log_name);
+#  ifdef DEFERRED_DL_REGISTRATION
+  /* Apply the pending operations first to preserve their order. */
+  if (dl_hashtbl == &GC_dl_hashtbl)
+    GC_merge_pending_dls(FALSE);
+#  endif
+  res = GC_add_dl_entry_locked(dl_hashtbl, link, obj, dl_sz, NULL);
+  if (EXPECT(res != GC_NO_MEMORY, TRUE)) {
+    UNLOCK();
+    return res;
+  }
+  oom_fn = GC_oom_fn;
+  UNLOCK();
+  new_dl = (struct disappearing_link *)(*oom_fn)(dl_sz);
+  if (0 == new_dl) {
+    return GC_NO_MEMORY;
+  }
+  /* It is not likely we will make it here, but... */
+  LOCK();
+  /* The table may grow, and `link` may be registered meanwhile. */
+  res = GC_add_dl_entry_locked(dl_hashtbl, link, obj, dl_sz, new_dl);
+  UNLOCK();
+#  ifndef DBG_HDRS_ALL
+  if (res != GC_SUCCESS) {
+    /* Free unused `new_dl` returned by `GC_oom_fn()`. */
+    GC_free(new_dl);
+  }
+#  endif
+  return res;
 }
 
 #  ifdef DBG_HDRS_ALL
@@ -288,6 +384,283 @@ GC_unregister_disappearing_link_inner(struct dl_hashtbl_s *dl_hashtbl,
   return curr_dl;
 }
 
+#  ifdef DEFERRED_DL_REGISTRATION
+/*
+ * Apply the pending operation `pend_dl` to `GC_dl_hashtbl`.  The table
+ * is not grown here (as this could be called during a collection), the
+ * registration grows it later if needed.  If `in_collection`, then the
+ * dropped entries are just left for the current collection to reclaim.
+ */
+STATIC void
+GC_merge_pending_dl(struct disappearing_link *pend_dl, GC_bool in_collection)
+{
+  struct disappearing_link *curr_dl;
+  void **link = (void **)GC_REVEAL_POINTER(pend_dl->dl_hidden_link);
+  size_t index;
+
+  GC_ASSERT(I_HOLD_LOCK());
+  GC_ASSERT(GC_dl_hashtbl.head != NULL);
+  if (0 == pend_dl->dl_hidden_obj) {
+    curr_dl = GC_unregister_disappearing_link_inner(&GC_dl_hashtbl, link);
+  } else {
+    index = HASH2(link, GC_dl_hashtbl.log_size);
+    for (curr_dl = GC_dl_hashtbl.head[index]; curr_dl != NULL;
+         curr_dl = dl_next(curr_dl)) {
+      if (curr_dl->dl_hidden_link == pend_dl->dl_hidden_link) {
+        curr_dl->dl_hidden_obj = pend_dl->dl_hidden_obj;
+        break;
+      }
+    }
+    if (NULL == curr_dl) {
+      dl_set_next(pend_dl, GC_dl_hashtbl.head[index]);
+      GC_dirty(pend_dl);
+      GC_dl_hashtbl.head[index] = pend_dl;
+      GC_dl_hashtbl.entries++;
+      GC_dirty(GC_dl_hashtbl.head + index);
+      return;
+    }
+    /* The link is already in the table, `pend_dl` is not needed. */
+    curr_dl = NULL;
+  }
+
+  if (in_collection) {
+    GC_clear_mark_bit(pend_dl);
+    if (curr_dl != NULL)
+      GC_clear_mark_bit(curr_dl);
+  } else {
+    GC_INTERNAL_FREE(pend_dl);
+    if (curr_dl != NULL)
+      GC_INTERNAL_FREE(curr_dl);
+  }
+}
+
+/* Merge all the pending entries of `shard` to `GC_dl_hashtbl`. */
+STATIC void
+GC_merge_dl_shard(struct dl_pending_shard_s *shard, GC_bool in_collection)
+{
+  struct disappearing_link *curr_dl, *next_dl;
+
+  GC_ASSERT(I_HOLD_LOCK());
+  DL_PENDING_LOCK(shard);
+  curr_dl = shard->head;
+  shard->head = NULL;
+  AO_store(&shard->entries, 0);
+  DL_PENDING_UNLOCK(shard);
+
+  /*
+   * The detached entries are not reachable by the collector but no
+   * collection could occur while we hold the allocator lock.
+   */
+  for (; curr_dl != NULL; curr_dl = next_dl) {
+    next_dl = dl_next(curr_dl);
+    GC_merge_pending_dl(curr_dl, in_collection);
+  }
+}
+
+/*
+ * Merge the pending entries of all the shards to `GC_dl_hashtbl`.
+ * Cheap if there are no such entries.
+ */
+STATIC void
+GC_merge_pending_dls(GC_bool in_collection)
+{
+  size_t i;
+
+  GC_ASSERT(I_HOLD_LOCK());
+  for (i = 0; i < DL_PENDING_SHARDS; i++) {
+    if (AO_load(&GC_dl_pending[i].entries) != 0)
+      GC_merge_dl_shard(&GC_dl_pending[i], in_collection);
+  }
+}
+
+/*
+ * Register `link` in the pending shard without acquiring the allocator
+ * lock.  Returns `GC_NO_MEMORY` if the registration should be retried
+ * with the allocator lock held.
+ */
+STATIC int
+GC_register_dl_deferred(void **link, const void *obj)
+{
+  struct dl_pending_shard_s *shard
+      = &GC_dl_pending[HASH2(link, DL_PENDING_LOG_SHARDS)];
+  struct disappearing_link *curr_dl, *new_dl;
+  GC_hidden_pointer hidden_link = GC_HIDE_POINTER(link);
+  AO_t entries;
+  int res;
+
+  /*
+   * The pending entries are merged at collection, the table should
+   * exist by then, thus the very first registration is done in the
+   * regular way.  Note: the table is never deallocated.
+   */
+  if (EXPECT(NULL == GC_cptr_load((volatile ptr_t *)&GC_dl_hashtbl.head),
+             FALSE))
+    return GC_NO_MEMORY;
+
+  /* Allocate the entry before acquiring the spin lock. */
+  new_dl = (struct disappearing_link *)GC_malloc_kind(
+      sizeof(struct disappearing_link), NORMAL);
+  if (EXPECT(NULL == new_dl, FALSE))
+    return GC_NO_MEMORY;
+  new_dl->dl_hidden_obj = GC_HIDE_POINTER(obj);
+  new_dl->dl_hidden_link = hidden_link;
+
+  DL_PENDING_LOCK(shard);
+  for (curr_dl = shard->head; curr_dl != NULL; curr_dl = dl_next(curr_dl)) {
+    if (curr_dl->dl_hidden_link == hidden_link)
+      break;
+  }
+  if (curr_dl != NULL) {
+    /* Override the pending registration or unregistration. */
+    res = curr_dl->dl_hidden_obj != 0 ? GC_DUPLICATE : GC_SUCCESS;
+    curr_dl->dl_hidden_obj = GC_HIDE_POINTER(obj);
+    DL_PENDING_UNLOCK(shard);
+    GC_free(new_dl);
+    return res;
+  }
+  dl_set_next(new_dl, shard->head);
+  GC_dirty(new_dl);
+  shard->head = new_dl;
+  entries = AO_load(&shard->entries) + 1;
+  AO_store(&shard->entries, entries);
+  DL_PENDING_UNLOCK(shard);
+
+  if (entries >= DL_PENDING_MAX_ENTRIES) {
+    LOCK();
+    /* Grow the table (if needed) in the same way as on registration. */
+    GC_reserve_dl_entries(&GC_dl_hashtbl, 0, "dl");
+    GC_merge_dl_shard(shard, FALSE);
+    UNLOCK();
+  }
+  return GC_SUCCESS;
+}
+
+/*
+ * Unregister `link` if it has a pending entry.  Returns -1 if the link
+ * has no pending entry, otherwise the result to be returned by
+ * `GC_unregister_disappearing_link`.
+ */
+STATIC int
+GC_unregister_dl_deferred(void **link)
+{
+  struct dl_pending_shard_s *shard
+      = &GC_dl_pending[HASH2(link, DL_PENDING_LOG_SHARDS)];
+  struct disappearing_link *curr_dl;
+  GC_hidden_pointer hidden_link = GC_HIDE_POINTER(link);
+  int res = -1;
+
+  if (0 == AO_load(&shard->entries))
+    return res;
+  DL_PENDING_LOCK(shard);
+  for (curr_dl = shard->head; curr_dl != NULL; curr_dl = dl_next(curr_dl)) {
+    if (curr_dl->dl_hidden_link == hidden_link) {
+      /*
+       * The link might be in `GC_dl_hashtbl` too, thus just turn the
+       * entry into a pending unregistration.
+       */
+      res = curr_dl->dl_hidden_obj != 0 ? 1 : 0;
+      curr_dl->dl_hidden_obj = 0;
+      break;
+    }
+  }
+  DL_PENDING_UNLOCK(shard);
+  return res;
+}
+#  endif /* DEFERRED_DL_REGISTRATION */
+
+GC_API int GC_CALL
+GC_general_register_disappearing_link(void **link, const void *obj)
+{
+  if ((ADDR(link) & (ALIGNMENT - 1)) != 0 || !NONNULL_ARG_NOT_NULL(link))
+    ABORT("Bad arg to GC_general_register_disappearing_link");
+#  ifdef DEFERRED_DL_REGISTRATION
+  if (AO_load(&GC_deferred_dl) && EXPECT(!GC_find_leak_inner, TRUE)) {
+    int res;
+
+    GC_ASSERT(GC_is_initialized);
+#    ifdef GC_ASSERTIONS
+    GC_ASSERT(NONNULL_ARG_NOT_NULL(obj) && GC_base_C(obj) == obj);
+    /* Just check accessibility. */
+    GC_noop1_ptr(*link);
+#    endif
+    res = GC_register_dl_deferred(link, obj);
+    if (EXPECT(res != GC_NO_MEMORY, TRUE))
+      return res;
+  }
+#  endif
+  return GC_register_disappearing_link_inner(
+      &GC_dl_hashtbl, link, obj, sizeof(struct disappearing_link), "dl");
+}
+
+GC_API int GC_CALL
+GC_general_register_disappearing_links(void **const *links,
+                                       const void *const *objs, size_t n)
+{
+  size_t i;
+
+  for (i = 0; i < n; i++) {
+    if ((ADDR(links[i]) & (ALIGNMENT - 1)) != 0 || NULL == links[i])
+      ABORT("Bad arg to GC_general_register_disappearing_links");
+#  ifdef GC_ASSERTIONS
+    GC_noop1_ptr(*links[i]);
+#  endif
+  }
+  GC_ASSERT(GC_is_initialized);
+  if (EXPECT(GC_find_leak_inner, FALSE))
+    return GC_UNIMPLEMENTED;
+  if (0 == n)
+    return GC_SUCCESS;
+
+  LOCK();
+  /* Grow the table at most once for the whole batch. */
+  GC_reserve_dl_entries(&GC_dl_hashtbl, n, "dl");
+#  ifdef DEFERRED_DL_REGISTRATION
+  GC_merge_pending_dls(FALSE);
+#  endif
+  for (i = 0; i < n; i++) {
+    if (GC_add_dl_entry_locked(&GC_dl_hashtbl, links[i], objs[i],
+                               sizeof(struct disappearing_link), NULL)
+        == GC_NO_MEMORY)
+      break;
+  }
+  UNLOCK();
+
+  /*
+   * Register the rest one by one (if out of memory), as `GC_oom_fn`
+   * should be called without holding the allocator lock.
+   */
+  for (; i < n; i++) {
+    if (GC_general_register_disappearing_link(links[i], objs[i])
+        == GC_NO_MEMORY)
+      return GC_NO_MEMORY;
+  }
+  return GC_SUCCESS;
+}
+
+GC_API void GC_CALL
+GC_set_deferred_dl_registration(int value)
+{
+#  ifdef DEFERRED_DL_REGISTRATION
+  LOCK();
+  AO_store(&GC_deferred_dl, (AO_t)(value != 0));
+  if (!value)
+    GC_merge_pending_dls(FALSE);
+  UNLOCK();
+#  else
+  UNUSED_ARG(value);
+#  endif
+}
+
+GC_API int GC_CALL
+GC_get_deferred_dl_registration(void)
+{
+#  ifdef DEFERRED_DL_REGISTRATION
+  return (int)AO_load(&GC_deferred_dl);
+#  else
+  return 0;
+#  endif
+}
+
 GC_API int GC_CALL
 GC_unregister_disappearing_link(void **link)
 {
@@ -298,7 +671,18 @@ GC_unregister_disappearing_link(void **link)
     return 0;
   }
 
+#  ifdef DEFERRED_DL_REGISTRATION
+  {
+    int res = GC_unregister_dl_deferred(link);
+
+    if (res >= 0)
+      return res;
+  }
+#  endif
   LOCK();
+#  ifdef DEFERRED_DL_REGISTRATION
+  GC_merge_pending_dls(FALSE);
+#  endif
   curr_dl = GC_unregister_disappearing_link_inner(&GC_dl_hashtbl, link);
   UNLOCK();
   if (NULL == curr_dl)
@@ -307,12 +691,36 @@ GC_unregister_disappearing_link(void **link)
   return 1;
 }
 
+#  ifdef PARALLEL_MARK
+#    ifndef FO_PARALLEL_MARK_MIN_ENTRIES
+/*
+ * The minimum number of the strong toggle-refs to mark from them by
+ * the parallel marker threads.
+ */
+#      define FO_PARALLEL_MARK_MIN_ENTRIES 4096
+#    endif
+
+#    ifndef FO_PARALLEL_MARK_MIN_STACK
+/*
+ * The minimum number of the mark stack entries (pushed while marking
+ * from a finalizable object) to process them by the parallel marker
+ * threads; less entries are processed by the current thread to avoid
+ * waking up the helpers for a small amount of work.
+ */
+#      define FO_PARALLEL_MARK_MIN_STACK 1024
+#    endif
+#  endif /* PARALLEL_MARK */
+
 /*
  * Mark from one finalizable object using the specified mark procedure.
  * May not mark the object pointed to by `real_ptr` (i.e, it is the job
  * of the caller, if appropriate).  Note that this is called with the
  * mutator running.  This is safe only if the mutator (client) gets
- * the allocator lock to reveal hidden pointers.
+ * the allocator lock to reveal hidden pointers.  If the mark stack
+ * grows large, then it is processed by the parallel marker threads
+ * (if any); as the marking from each object is still completed before
+ * returning, the caller can check whether the object is marked because
+ * of a finalization cycle.
  */
 GC_INLINE void
 GC_mark_fo(ptr_t real_ptr, finalization_mark_proc fo_mark_proc)
@@ -320,8 +728,17 @@ GC_mark_fo(ptr_t real_ptr, finalization_mark_proc fo_mark_proc)
   GC_ASSERT(I_HOLD_LOCK());
   fo_mark_proc(real_ptr);
   /* Process objects pushed by the mark procedure. */
-  while (!GC_mark_stack_empty())
+  while (!GC_mark_stack_empty()) {
+#  ifdef PARALLEL_MARK
+    if (GC_parallel && !GC_parallel_mark_disabled
+        && (size_t)(GC_mark_stack_top - GC_mark_stack)
+               >= FO_PARALLEL_MARK_MIN_STACK) {
+      GC_parallel_mark_from_mark_stack();
+      break;
+    }
+#  endif
     MARK_FROM_MARK_STACK();
+  }
 }
 
 /* Complete a collection in progress, if any. */
@@ -342,34 +759,163 @@ typedef union toggle_ref_u GCToggleRef;
 
 STATIC GC_toggleref_func GC_toggleref_callback = 0;
 
-GC_INNER void
-GC_process_togglerefs(void)
+/*
+ * The entries of `GC_toggleref_arr` are grouped by state: the first
+ * `GC_toggleref_strong_cnt` ones are strong, the rest are weak.
+ */
+
+/* Is the dirty tracking mode on? */
+STATIC GC_bool GC_toggleref_dirty_tracking = FALSE;
+
+/*
+ * Set if `GC_toggleref_dirty_set` could not be grown, thus the callback
+ * should be invoked for all the entries on the next collection.
+ */
+STATIC GC_bool GC_toggleref_all_dirty = FALSE;
+
+#    define TOGGLEREF_DIRTY_SET_SIZE() \
+      ((size_t)1 << GC_toggleref_dirty_log_size)
+
+/* Is the (hidden) `obj` in `GC_toggleref_dirty_set`? */
+STATIC GC_bool
+GC_toggleref_is_dirty(GC_hidden_pointer hidden_obj)
 {
-  size_t i;
-  size_t new_size = 0;
-  GC_bool needs_barrier = FALSE;
+  size_t mask = TOGGLEREF_DIRTY_SET_SIZE() - 1;
+  size_t i = HASH2(hidden_obj, GC_toggleref_dirty_log_size);
 
-  GC_ASSERT(I_HOLD_LOCK());
-  for (i = 0; i < GC_toggleref_array_size; ++i) {
-    GCToggleRef *r = &GC_toggleref_arr[i];
-    void *obj = r->strong_ref;
+  for (;; i = (i + 1) & mask) {
+    GC_hidden_pointer h = GC_toggleref_dirty_set[i];
 
-    if ((ADDR(obj) & 1) != 0) {
-      obj = GC_REVEAL_POINTER(r->weak_ref);
+    if (h == hidden_obj)
+      return TRUE;
+    if (0 == h)
+      return FALSE;
+  }
+}
+
+/* Put the hidden pointer to the set; the latter should have a free slot. */
+STATIC void
+GC_toggleref_dirty_set_put(GC_hidden_pointer *set, unsigned log_size,
+                           GC_hidden_pointer hidden_obj)
+{
+  size_t mask = ((size_t)1 << log_size) - 1;
+  size_t i = HASH2(hidden_obj, log_size);
+
+  for (; set[i] != 0; i = (i + 1) & mask) {
+    if (set[i] == hidden_obj)
+      return;
+  }
+  set[i] = hidden_obj;
+  GC_toggleref_dirty_cnt++;
+}
+
+/* Ensure the load factor of the dirty set is not more than one half. */
+STATIC GC_bool
+GC_toggleref_ensure_dirty_set(void)
+{
+  GC_hidden_pointer *new_set;
+  unsigned log_new_size;
+  size_t i;
+
+  GC_ASSERT(I_HOLD_LOCK());
+  if (GC_toggleref_dirty_set != NULL
+      && 2 * (GC_toggleref_dirty_cnt + 1) <= TOGGLEREF_DIRTY_SET_SIZE())
+    return TRUE;
+
+  log_new_size
+      = GC_toggleref_dirty_set != NULL ? GC_toggleref_dirty_log_size + 1 : 6;
+  if (log_new_size >= sizeof(size_t) * 8 - 4)
+    return FALSE;
+  new_set = (GC_hidden_pointer *)GC_INTERNAL_MALLOC_IGNORE_OFF_PAGE(
+      ((size_t)1 << log_new_size) * sizeof(GC_hidden_pointer), PTRFREE);
+  if (EXPECT(NULL == new_set, FALSE))
+    return FALSE;
+  BZERO(new_set, ((size_t)1 << log_new_size) * sizeof(GC_hidden_pointer));
+  if (GC_toggleref_dirty_set != NULL) {
+    GC_toggleref_dirty_cnt = 0;
+    for (i = 0; i < TOGGLEREF_DIRTY_SET_SIZE(); i++) {
+      if (GC_toggleref_dirty_set[i] != 0)
+        GC_toggleref_dirty_set_put(new_set, log_new_size,
+                                   GC_toggleref_dirty_set[i]);
+    }
+    GC_INTERNAL_FREE(GC_toggleref_dirty_set);
+  }
+  GC_toggleref_dirty_set = new_set;
+  GC_toggleref_dirty_log_size = log_new_size;
+  return TRUE;
+}
+
+/*
+ * Move the strong entries of `GC_toggleref_arr[0..GC_toggleref_array_size]`
+ * to the beginning of the array, and recompute `GC_toggleref_strong_cnt`.
+ */
+STATIC void
+GC_group_togglerefs(void)
+{
+  size_t i = 0;
+  size_t j = GC_toggleref_array_size;
+
+  for (;;) {
+    while (i < j && (ADDR(GC_toggleref_arr[i].strong_ref) & 1) == 0)
+      i++;
+    while (i < j && (ADDR(GC_toggleref_arr[j - 1].strong_ref) & 1) != 0)
+      j--;
+    if (i >= j)
+      break;
+    {
+      GCToggleRef t = GC_toggleref_arr[i];
+
+      GC_toggleref_arr[i] = GC_toggleref_arr[j - 1];
+      GC_toggleref_arr[j - 1] = t;
+    }
+  }
+  GC_toggleref_strong_cnt = i;
+}
+
+GC_INNER void
+GC_process_togglerefs(void)
+{
+  size_t i;
+  size_t new_size = 0;
+  GC_bool check_all
+      = !GC_toggleref_dirty_tracking || GC_toggleref_all_dirty;
+  GC_bool state_changed = FALSE;
+
+  GC_ASSERT(I_HOLD_LOCK());
+  if (!check_all && 0 == GC_toggleref_dirty_cnt) {
+    /* The states are unchanged since the previous collection. */
+    return;
+  }
+  for (i = 0; i < GC_toggleref_array_size; ++i) {
+    GCToggleRef *r = &GC_toggleref_arr[i];
+    void *obj = r->strong_ref;
+    GC_bool was_strong = TRUE;
+
+    if ((ADDR(obj) & 1) != 0) {
+      obj = GC_REVEAL_POINTER(r->weak_ref);
       GC_ASSERT((ADDR(obj) & 1) == 0);
+      was_strong = FALSE;
     }
     if (NULL == obj)
       continue;
 
+    if (!check_all && !GC_toggleref_is_dirty(GC_HIDE_POINTER(obj))) {
+      /* Keep the state. */
+      GC_toggleref_arr[new_size++] = *r;
+      continue;
+    }
     switch (GC_toggleref_callback(obj)) {
     case GC_TOGGLE_REF_DROP:
       break;
     case GC_TOGGLE_REF_STRONG:
       GC_toggleref_arr[new_size++].strong_ref = obj;
-      needs_barrier = TRUE;
+      if (!was_strong)
+        state_changed = TRUE;
       break;
     case GC_TOGGLE_REF_WEAK:
       GC_toggleref_arr[new_size++].weak_ref = GC_HIDE_POINTER(obj);
+      if (was_strong)
+        state_changed = TRUE;
       break;
     default:
       ABORT("Bad toggle-ref status returned by callback");
@@ -380,51 +926,98 @@ GC_process_togglerefs(void)
     BZERO(&GC_toggleref_arr[new_size],
           (GC_toggleref_array_size - new_size) * sizeof(GCToggleRef));
     GC_toggleref_array_size = new_size;
+    state_changed = TRUE; /*< the boundary might move */
   }
-  if (needs_barrier)
+  if (state_changed) {
+    GC_group_togglerefs();
     GC_dirty(GC_toggleref_arr); /*< entire object */
+  }
+
+  if (GC_toggleref_dirty_cnt > 0) {
+    BZERO(GC_toggleref_dirty_set,
+          TOGGLEREF_DIRTY_SET_SIZE() * sizeof(GC_hidden_pointer));
+    GC_toggleref_dirty_cnt = 0;
+  }
+  GC_toggleref_all_dirty = FALSE;
 }
 
 STATIC void GC_normal_finalize_mark_proc(ptr_t);
 
+void GC_dbg_chk(const char *where);
+void GC_dbg_chk(const char *where)
+{
+  static void *last_e0 = NULL;
+  void *e0;
+
+  if (NULL == GC_toggleref_arr || 0 == GC_toggleref_array_size) { last_e0 = NULL; return; }
+  e0 = GC_toggleref_arr[0].strong_ref;
+  if (last_e0 != NULL && NULL == e0)
+    GC_printf("DBGT lost at %s gc_no=%lu size=%lu\n", where, (unsigned long)GC_gc_no, (unsigned long)GC_toggleref_array_size);
+  last_e0 = e0;
+  {
+    static int last_m = -1;
+    int m = (int)GC_is_marked(GC_toggleref_arr);
+    if (m != last_m && GC_toggleref_array_size >= 20)
+      GC_printf("DBGK %s gc_no=%lu marked=%d ms=%d inc=%d\n", where, (unsigned long)GC_gc_no, m, (int)GC_mark_state, (int)GC_incremental);
+    last_m = m;
+  }
+}
+
 STATIC void
 GC_mark_togglerefs(void)
 {
-  size_t i;
-
   GC_ASSERT(I_HOLD_LOCK());
+  if (GC_toggleref_dirty_set != NULL)
+    GC_set_mark_bit(GC_toggleref_dirty_set);
   if (NULL == GC_toggleref_arr)
     return;
 
   GC_set_mark_bit(GC_toggleref_arr);
-  for (i = 0; i < GC_toggleref_array_size; ++i) {
-    void *obj = GC_toggleref_arr[i].strong_ref;
-    if (obj != NULL && (ADDR(obj) & 1) == 0) {
-      /* Push and mark the object. */
-      GC_mark_fo((ptr_t)obj, GC_normal_finalize_mark_proc);
-      GC_set_mark_bit(obj);
-      GC_complete_ongoing_collection();
-    }
+  if (0 == GC_toggleref_strong_cnt)
+    return;
+
+  /*
+   * Push the strong part of the array as a whole, the mark stack entry
+   * is split by the marker, so the strong references are marked from
+   * by the parallel markers if there are many of them.
+   */
+  GC_ASSERT(GC_mark_stack_empty());
+  GC_push_all(GC_toggleref_arr, GC_toggleref_arr + GC_toggleref_strong_cnt);
+#    ifdef PARALLEL_MARK
+  if (GC_parallel && !GC_parallel_mark_disabled
+      && GC_toggleref_strong_cnt >= FO_PARALLEL_MARK_MIN_ENTRIES) {
+    GC_parallel_mark_from_mark_stack();
+  } else
+#    endif
+  /* else */ {
+    while (!GC_mark_stack_empty())
+      MARK_FROM_MARK_STACK();
   }
+  GC_complete_ongoing_collection();
 }
 
 STATIC void
 GC_clear_togglerefs(void)
 {
   size_t i;
+  size_t new_size = GC_toggleref_strong_cnt;
 
   GC_ASSERT(I_HOLD_LOCK());
-  for (i = 0; i < GC_toggleref_array_size; ++i) {
+  /* Only the weak entries are checked and compacted. */
+  for (i = GC_toggleref_strong_cnt; i < GC_toggleref_array_size; ++i) {
     GCToggleRef *r = &GC_toggleref_arr[i];
 
-    if ((ADDR(r->strong_ref) & 1) != 0) {
-      if (!GC_is_marked(GC_REVEAL_POINTER(r->weak_ref))) {
-        r->weak_ref = 0;
-      } else {
-        /* No need to copy, this garbage collector is a non-moving one. */
-      }
+    GC_ASSERT((ADDR(r->strong_ref) & 1) != 0);
+    if (GC_is_marked(GC_REVEAL_POINTER(r->weak_ref))) {
+      /* No need to copy, this garbage collector is a non-moving one. */
+      GC_toggleref_arr[new_size++].weak_ref = r->weak_ref;
     }
   }
+  if (new_size < GC_toggleref_array_size) {
+    BZERO(&GC_toggleref_arr[new_size],
+          (GC_toggleref_array_size - new_size) * sizeof(GCToggleRef));
+    GC_toggleref_array_size = new_size;
+  }
 }
 
 GC_API void GC_CALL
@@ -446,6 +1039,25 @@ GC_get_toggleref_func(void)
   return fn;
 }
 
+GC_API void GC_CALL
+GC_set_toggleref_dirty_tracking(int value)
+{
+  LOCK();
+  GC_toggleref_dirty_tracking = (GC_bool)value;
+  UNLOCK();
+}
+
+GC_API int GC_CALL
+GC_get_toggleref_dirty_tracking(void)
+{
+  int value;
+
+  READER_LOCK();
+  value = (int)GC_toggleref_dirty_tracking;
+  READER_UNLOCK();
+  return value;
+}
+
 static GC_bool
 ensure_toggleref_capacity(size_t capacity_inc)
 {
@@ -500,7 +1112,11 @@ GC_toggleref_add(void *obj, int is_strong_ref)
       GCToggleRef *r = &GC_toggleref_arr[GC_toggleref_array_size];
 
       if (is_strong_ref) {
+        /* Keep the strong entries grouped. */
+        *r = GC_toggleref_arr[GC_toggleref_strong_cnt];
+        r = &GC_toggleref_arr[GC_toggleref_strong_cnt++];
         r->strong_ref = obj;
+        GC_dirty(r);
         GC_dirty(GC_toggleref_arr + GC_toggleref_array_size);
       } else {
         r->weak_ref = GC_HIDE_POINTER(obj);
@@ -512,6 +1128,23 @@ GC_toggleref_add(void *obj, int is_strong_ref)
   UNLOCK();
   return res;
 }
+
+GC_API void GC_CALL
+GC_toggleref_set_dirty(void *obj)
+{
+  GC_ASSERT(NONNULL_ARG_NOT_NULL(obj));
+  LOCK();
+  if (GC_toggleref_dirty_tracking && !GC_toggleref_all_dirty) {
+    if (GC_toggleref_ensure_dirty_set()) {
+      GC_toggleref_dirty_set_put(GC_toggleref_dirty_set,
+                                 GC_toggleref_dirty_log_size,
+                                 GC_HIDE_POINTER(obj));
+    } else {
+      GC_toggleref_all_dirty = TRUE;
+    }
+  }
+  UNLOCK();
+}
 #  endif /* !GC_TOGGLE_REFS_NOT_NEEDED */
 
 /* Finalizer callback support. */
@@ -543,8 +1176,8 @@ GC_register_long_link(void **link, const void *obj)
 {
   if ((ADDR(link) & (ALIGNMENT - 1)) != 0 || !NONNULL_ARG_NOT_NULL(link))
     ABORT("Bad arg to GC_register_long_link");
-  return GC_register_disappearing_link_inner(&GC_ll_hashtbl, link, obj,
-                                             "long dl");
+  return GC_register_disappearing_link_inner(
+      &GC_ll_hashtbl, link, obj, sizeof(struct disappearing_link), "long dl");
 }
 
 GC_API int GC_CALL
@@ -638,6 +1271,9 @@ GC_move_disappearing_link(void **link, void **new_link)
     return GC_NOT_FOUND;
   }
   LOCK();
+#    ifdef DEFERRED_DL_REGISTRATION
+  GC_merge_pending_dls(FALSE);
+#    endif
   result = GC_move_disappearing_link_inner(&GC_dl_hashtbl, link, new_link);
   UNLOCK();
   return result;
@@ -736,214 +1372,587 @@ GC_unreachable_finalize_mark_proc(ptr_t p)
   GC_normal_finalize_mark_proc(p);
 }
 
-/* Avoid the work if unreachable finalizable objects are not used. */
-/* TODO: Turn `need_unreachable_finalization` into a counter. */
-static GC_bool need_unreachable_finalization = FALSE;
+/* Ephemerons support. */
+
+struct ephemeron_s {
+  /* The next ephemeron in `GC_ephemerons` list (zero means none). */
+  GC_hidden_pointer eph_hidden_next;
+  GC_hidden_pointer eph_hidden_key;
+  GC_hidden_pointer eph_hidden_value;
+};
 
 /*
- * Register a finalization function.  See `gc.h` file for details.
- * The last parameter is a procedure that determines marking for
- * finalization ordering.  Any objects marked by that procedure will be
- * guaranteed to not have been finalized when this finalizer is invoked.
+ * The list of all the created ephemerons (zero means empty).
+ * The ephemerons are pointer-free objects, so neither the links nor
+ * keys and values are traced by the marker.  Protected by the allocator
+ * lock.
  */
-STATIC void
-GC_register_finalizer_inner(void *obj, GC_finalization_proc fn, void *cd,
-                            GC_finalization_proc *ofn, void **ocd,
-                            finalization_mark_proc mp)
+STATIC GC_hidden_pointer GC_ephemerons = 0;
+
+GC_API void *GC_CALL
+GC_new_ephemeron(const void *key, const void *value)
 {
-  struct finalizable_object *curr_fo;
-  size_t index;
-  struct finalizable_object *new_fo = 0;
-  const hdr *hhdr = NULL; /*< initialized to prevent warning */
+  struct ephemeron_s *eph;
 
-  GC_ASSERT(GC_is_initialized);
-  if (EXPECT(GC_find_leak_inner, FALSE)) {
-    /* No-op.  `*ocd` and `*ofn` remain unchanged. */
-    return;
-  }
+  if (NULL == GC_base(GC_CAST_AWAY_CONST_PVOID(key)))
+    ABORT("Bad key arg to GC_new_ephemeron");
+  eph = (struct ephemeron_s *)GC_malloc_atomic(sizeof(struct ephemeron_s));
+  if (EXPECT(NULL == eph, FALSE))
+    return NULL;
+
+  eph->eph_hidden_key = GC_HIDE_POINTER(key);
+  eph->eph_hidden_value = GC_HIDE_POINTER(value);
   LOCK();
-  GC_ASSERT(obj != NULL && GC_base_C(obj) == obj);
-  if (mp == GC_unreachable_finalize_mark_proc)
-    need_unreachable_finalization = TRUE;
-  if (EXPECT(NULL == GC_fnlz_roots.fo_head, FALSE)
-      || EXPECT(GC_fo_entries > ((size_t)1 << GC_log_fo_table_size), FALSE)) {
-    GC_grow_table((struct hash_chain_entry ***)&GC_fnlz_roots.fo_head,
-                  &GC_log_fo_table_size, &GC_fo_entries);
-    GC_COND_LOG_PRINTF("Grew fo table to %u entries\n",
-                       1U << GC_log_fo_table_size);
-  }
-  for (;;) {
-    struct finalizable_object *prev_fo = NULL;
-    GC_oom_func oom_fn;
+  eph->eph_hidden_next = GC_ephemerons;
+  GC_ephemerons = GC_HIDE_POINTER(eph);
+  UNLOCK();
+  return eph;
+}
 
-    index = HASH2(obj, GC_log_fo_table_size);
-    curr_fo = GC_fnlz_roots.fo_head[index];
-    while (curr_fo != NULL) {
-      GC_ASSERT(GC_size(curr_fo) >= sizeof(struct finalizable_object));
-      if (curr_fo->fo_hidden_base == GC_HIDE_POINTER(obj)) {
-        /*
-         * Interruption by a signal in the middle of this should be safe.
-         * The client may see only `*ocd` updated, but we will declare that
-         * to be his problem.
-         */
-        if (ocd)
-          *ocd = curr_fo->fo_client_data;
-        if (ofn)
-          *ofn = curr_fo->fo_fn;
-        /* Delete the structure for `obj`. */
-        if (prev_fo == 0) {
-          GC_fnlz_roots.fo_head[index] = fo_next(curr_fo);
-        } else {
-          fo_set_next(prev_fo, fo_next(curr_fo));
-          GC_dirty(prev_fo);
-        }
-        if (fn == 0) {
-          GC_fo_entries--;
-          /*
-           * May not happen if we get a signal.  But a high estimate will
-           * only make the table larger than necessary.
-           */
-#  if !defined(THREADS) && !defined(DBG_HDRS_ALL)
-          GC_free(curr_fo);
-#  endif
-        } else {
-          curr_fo->fo_fn = fn;
-          curr_fo->fo_client_data = (ptr_t)cd;
-          curr_fo->fo_mark_proc = mp;
-          GC_dirty(curr_fo);
-          /*
-           * Reinsert it.  We deleted it first to maintain consistency in
-           * the event of a signal.
-           */
-          if (prev_fo == 0) {
-            GC_fnlz_roots.fo_head[index] = curr_fo;
-          } else {
-            fo_set_next(prev_fo, curr_fo);
-            GC_dirty(prev_fo);
-          }
-        }
-        if (NULL == prev_fo)
-          GC_dirty(GC_fnlz_roots.fo_head + index);
-        UNLOCK();
-#  ifndef DBG_HDRS_ALL
-        /* Free unused `new_fo` returned by `GC_oom_fn()`. */
-        GC_free(new_fo);
-#  endif
-        return;
+GC_API void *GC_CALL
+GC_ephemeron_get_key(const void *eph)
+{
+  void *key;
+
+  READER_LOCK();
+  key = GC_REVEAL_POINTER(((const struct ephemeron_s *)eph)->eph_hidden_key);
+  READER_UNLOCK();
+  return key;
+}
+
+GC_API void *GC_CALL
+GC_ephemeron_get_value(const void *eph)
+{
+  void *value;
+
+  READER_LOCK();
+  value = GC_REVEAL_POINTER(
+      ((const struct ephemeron_s *)eph)->eph_hidden_value);
+  READER_UNLOCK();
+  return value;
+}
+
+/*
+ * Mark the values (and everything reachable from them) of the reachable
+ * ephemerons with a marked key.  Repeated until no more values are
+ * marked, since a newly marked value might make another ephemeron or
+ * a key reachable.
+ */
+STATIC void
+GC_mark_ephemerons(void)
+{
+  GC_bool marked_some;
+
+  GC_ASSERT(I_HOLD_LOCK());
+  do {
+    GC_hidden_pointer h;
+
+    marked_some = FALSE;
+    for (h = GC_ephemerons; h != 0;) {
+      struct ephemeron_s *eph = (struct ephemeron_s *)GC_REVEAL_POINTER(h);
+      ptr_t key, value;
+
+      h = eph->eph_hidden_next;
+      if (!GC_is_marked(eph))
+        continue;
+      key = (ptr_t)GC_base(GC_REVEAL_POINTER(eph->eph_hidden_key));
+      if (NULL == key || !GC_is_marked(key))
+        continue;
+      value = (ptr_t)GC_base(GC_REVEAL_POINTER(eph->eph_hidden_value));
+      if (value != NULL && !GC_is_marked(value)) {
+        GC_mark_fo(value, GC_normal_finalize_mark_proc);
+        GC_set_mark_bit(value);
+        GC_complete_ongoing_collection();
+        marked_some = TRUE;
       }
-      prev_fo = curr_fo;
-      curr_fo = fo_next(curr_fo);
     }
-    if (EXPECT(new_fo != 0, FALSE)) {
-      /* `new_fo` is returned by `GC_oom_fn()`. */
-      GC_ASSERT(fn != 0);
-#  ifdef LINT2
-      if (NULL == hhdr)
-        ABORT("Bad hhdr in GC_register_finalizer_inner");
-#  endif
-      break;
-    }
-    if (fn == 0) {
-      if (ocd)
-        *ocd = 0;
-      if (ofn)
-        *ofn = 0;
-      UNLOCK();
-      return;
+  } while (marked_some);
+}
+
+/*
+ * Clear the ephemerons whose key is unreachable, and unlink the
+ * unreachable ephemerons (these are cleared too, in case they are
+ * resurrected by a finalizer).
+ */
+STATIC void
+GC_clear_ephemerons(void)
+{
+  GC_hidden_pointer h = GC_ephemerons;
+  struct ephemeron_s *prev_eph = NULL;
+
+  GC_ASSERT(I_HOLD_LOCK());
+  while (h != 0) {
+    struct ephemeron_s *eph = (struct ephemeron_s *)GC_REVEAL_POINTER(h);
+    ptr_t key = (ptr_t)GC_base(GC_REVEAL_POINTER(eph->eph_hidden_key));
+
+    h = eph->eph_hidden_next;
+    if (NULL == key || !GC_is_marked(key) || !GC_is_marked(eph)) {
+      eph->eph_hidden_key = GC_HIDE_POINTER(NULL);
+      eph->eph_hidden_value = GC_HIDE_POINTER(NULL);
     }
-    GET_HDR(obj, hhdr);
-    if (EXPECT(NULL == hhdr, FALSE)) {
-      /* We will not collect it, hence finalizer would not be run. */
-      if (ocd)
-        *ocd = 0;
-      if (ofn)
-        *ofn = 0;
-      UNLOCK();
-      return;
+    if (GC_is_marked(eph)) {
+      prev_eph = eph;
+      continue;
     }
-    new_fo = (struct finalizable_object *)GC_INTERNAL_MALLOC(
-        sizeof(struct finalizable_object), NORMAL);
-    if (EXPECT(new_fo != 0, TRUE))
-      break;
-    oom_fn = GC_oom_fn;
-    UNLOCK();
-    new_fo = (struct finalizable_object *)(*oom_fn)(
-        sizeof(struct finalizable_object));
-    if (0 == new_fo) {
-      /* No enough memory.  `*ocd` and `*ofn` remain unchanged. */
-      return;
+
+    /* Unlink the ephemeron. */
+    if (NULL == prev_eph) {
+      GC_ephemerons = h;
+    } else {
+      prev_eph->eph_hidden_next = h;
     }
-    /* It is not likely we will make it here, but... */
-    LOCK();
-    /*
-     * Recalculate index since the table may grow and check again that
-     * our finalizer is not in the table.
-     */
+    eph->eph_hidden_next = 0;
   }
-  GC_ASSERT(GC_size(new_fo) >= sizeof(struct finalizable_object));
-  if (ocd)
-    *ocd = 0;
-  if (ofn)
-    *ofn = 0;
-  new_fo->fo_hidden_base = GC_HIDE_POINTER(obj);
-  new_fo->fo_fn = fn;
-  new_fo->fo_client_data = (ptr_t)cd;
-  new_fo->fo_object_sz = hhdr->hb_sz;
-  new_fo->fo_mark_proc = mp;
-  fo_set_next(new_fo, GC_fnlz_roots.fo_head[index]);
-  GC_dirty(new_fo);
-  GC_fo_entries++;
-  GC_fnlz_roots.fo_head[index] = new_fo;
-  GC_dirty(GC_fnlz_roots.fo_head + index);
-  UNLOCK();
 }
 
-GC_API void GC_CALL
-GC_register_finalizer(void *obj, GC_finalization_proc fn, void *cd,
-                      GC_finalization_proc *ofn, void **ocd)
-{
-  GC_register_finalizer_inner(obj, fn, cd, ofn, ocd,
-                              GC_normal_finalize_mark_proc);
-}
+/* Soft links support. */
+
+struct soft_link {
+  struct disappearing_link sl_dl;
+  /* The value of `GC_gc_no` at the latest access through the link. */
+  word sl_last_access;
+};
+
+/*
+ * The number of distinct link ages (in collections) used to order the
+ * soft links clearing.  The links of greater age are considered equally
+ * old.
+ */
+#  ifndef SOFT_LINK_AGE_BUCKETS
+#    define SOFT_LINK_AGE_BUCKETS 32
+#  endif
+
+/*
+ * The heap occupancy (in percents) up to which the targets of the soft
+ * links are retained.
+ */
+STATIC unsigned GC_soft_links_heap_threshold = 75;
 
 GC_API void GC_CALL
-GC_register_finalizer_ignore_self(void *obj, GC_finalization_proc fn, void *cd,
-                                  GC_finalization_proc *ofn, void **ocd)
+GC_set_soft_links_heap_threshold(unsigned percent)
 {
-  GC_register_finalizer_inner(obj, fn, cd, ofn, ocd,
-                              GC_ignore_self_finalize_mark_proc);
+  GC_ASSERT(percent <= 100);
+  GC_soft_links_heap_threshold = percent;
 }
 
-GC_API void GC_CALL
-GC_register_finalizer_no_order(void *obj, GC_finalization_proc fn, void *cd,
-                               GC_finalization_proc *ofn, void **ocd)
+GC_API unsigned GC_CALL
+GC_get_soft_links_heap_threshold(void)
 {
-  GC_register_finalizer_inner(obj, fn, cd, ofn, ocd,
-                              GC_null_finalize_mark_proc);
+  return GC_soft_links_heap_threshold;
 }
 
-GC_API void GC_CALL
-GC_register_finalizer_unreachable(void *obj, GC_finalization_proc fn, void *cd,
-                                  GC_finalization_proc *ofn, void **ocd)
+GC_API int GC_CALL
+GC_register_soft_link(void **link, const void *obj)
 {
-  GC_ASSERT(GC_java_finalization);
-  GC_register_finalizer_inner(obj, fn, cd, ofn, ocd,
-                              GC_unreachable_finalize_mark_proc);
+  int res;
+
+  if ((ADDR(link) & (ALIGNMENT - 1)) != 0 || !NONNULL_ARG_NOT_NULL(link))
+    ABORT("Bad arg to GC_register_soft_link");
+  res = GC_register_disappearing_link_inner(
+      &GC_sl_hashtbl, link, obj, sizeof(struct soft_link), "soft dl");
+  if (GC_SUCCESS == res || GC_DUPLICATE == res)
+    (void)GC_access_soft_link(link);
+  return res;
 }
 
-#  ifndef NO_DEBUGGING
-STATIC void
-GC_dump_finalization_links(const struct dl_hashtbl_s *dl_hashtbl)
+GC_API int GC_CALL
+GC_unregister_soft_link(void **link)
 {
-  size_t dl_size = (size_t)1 << dl_hashtbl->log_size;
-  size_t i;
+  struct disappearing_link *curr_dl;
 
-  if (NULL == dl_hashtbl->head) {
-    /* The table is empty. */
-    return;
+  if ((ADDR(link) & (ALIGNMENT - 1)) != 0) {
+    /* Nothing to do. */
+    return 0;
   }
+  LOCK();
+  curr_dl = GC_unregister_disappearing_link_inner(&GC_sl_hashtbl, link);
+  UNLOCK();
+  if (NULL == curr_dl)
+    return 0;
+  FREE_DL_ENTRY(curr_dl);
+  return 1;
+}
 
-  for (i = 0; i < dl_size; i++) {
+GC_API void *GC_CALL
+GC_access_soft_link(void **link)
+{
+  struct disappearing_link *curr_dl;
+  GC_hidden_pointer hidden_link = GC_HIDE_POINTER(link);
+  void *obj = NULL;
+
+  READER_LOCK();
+  if (EXPECT(GC_sl_hashtbl.head != NULL, TRUE)) {
+    size_t index = HASH2(link, GC_sl_hashtbl.log_size);
+
+    for (curr_dl = GC_sl_hashtbl.head[index]; curr_dl != NULL;
+         curr_dl = dl_next(curr_dl)) {
+      if (curr_dl->dl_hidden_link == hidden_link) {
+        struct soft_link *sl = (struct soft_link *)curr_dl;
+
+        obj = GC_REVEAL_POINTER(curr_dl->dl_hidden_obj);
+        /* Several readers might update the field concurrently. */
+#  ifdef AO_HAVE_store
+        AO_store((volatile AO_t *)&sl->sl_last_access, (AO_t)GC_gc_no);
+#  else
+        sl->sl_last_access = GC_gc_no;
+#  endif
+        break;
+      }
+    }
+  }
+  READER_UNLOCK();
+  return obj;
+}
+
+GC_INLINE unsigned
+soft_link_age(const struct soft_link *sl)
+{
+  word age = GC_gc_no - sl->sl_last_access;
+
+  return age < SOFT_LINK_AGE_BUCKETS ? (unsigned)age
+                                     : SOFT_LINK_AGE_BUCKETS - 1;
+}
+
+STATIC void GC_CALLBACK
+GC_add_marked_bytes(struct hblk *h, void *pmarked_bytes)
+{
+  const hdr *hhdr = HDR(h);
+
+  *(word *)pmarked_bytes += (word)hhdr->hb_sz * hhdr->hb_n_marks;
+}
+
+/*
+ * Mark the unreachable targets of the soft links (and everything
+ * reachable from them), so that these links are not cleared, unless
+ * the heap occupancy (the size of the marked objects and the kept
+ * targets relative to the heap size) exceeds the threshold.  In the
+ * latter case, the targets of the least recently accessed links are
+ * left unmarked first.  Only the sizes of the targets themselves are
+ * taken into account.  No target is kept if the heap size is near its
+ * maximum (i.e. exceeds the same percentage of the maximum heap size).
+ */
+STATIC void
+GC_keep_soft_link_targets(void)
+{
+  word bucket_bytes[SOFT_LINK_AGE_BUCKETS];
+  word marked_bytes = 0;
+  word limit;
+  size_t dl_size = (size_t)1 << GC_sl_hashtbl.log_size;
+  size_t i;
+  unsigned max_age;
+  GC_bool found = FALSE;
+
+  GC_ASSERT(I_HOLD_LOCK());
+  BZERO(bucket_bytes, sizeof(bucket_bytes));
+  for (i = 0; i < dl_size; i++) {
+    struct disappearing_link *curr_dl;
+
+    for (curr_dl = GC_sl_hashtbl.head[i]; curr_dl != NULL;
+         curr_dl = dl_next(curr_dl)) {
+      ptr_t real_ptr = (ptr_t)GC_REVEAL_POINTER(curr_dl->dl_hidden_obj);
+
+      if (!GC_is_marked(real_ptr)) {
+        bucket_bytes[soft_link_age((struct soft_link *)curr_dl)]
+            += (word)GC_size(real_ptr);
+        found = TRUE;
+      }
+    }
+  }
+  if (!found)
+    return;
+
+  limit = (GC_heapsize - GC_unmapped_bytes) / 100
+          * GC_soft_links_heap_threshold;
+  if (GC_max_heapsize != 0
+      && GC_heapsize > GC_max_heapsize / 100 * GC_soft_links_heap_threshold) {
+    limit = 0;
+  } else {
+    GC_apply_to_all_blocks(GC_add_marked_bytes, &marked_bytes);
+  }
+
+  /*
+   * Find the number of the youngest age buckets such that all their
+   * targets fit the limit.
+   */
+  for (max_age = 0; max_age < SOFT_LINK_AGE_BUCKETS; max_age++) {
+    if (marked_bytes + bucket_bytes[max_age] > limit)
+      break;
+    marked_bytes += bucket_bytes[max_age];
+  }
+  if (0 == max_age)
+    return;
+
+  for (i = 0; i < dl_size; i++) {
+    struct disappearing_link *curr_dl;
+
+    for (curr_dl = GC_sl_hashtbl.head[i]; curr_dl != NULL;
+         curr_dl = dl_next(curr_dl)) {
+      ptr_t real_ptr = (ptr_t)GC_REVEAL_POINTER(curr_dl->dl_hidden_obj);
+
+      if (!GC_is_marked(real_ptr)
+          && soft_link_age((struct soft_link *)curr_dl) < max_age) {
+        GC_mark_fo(real_ptr, GC_normal_finalize_mark_proc);
+        GC_set_mark_bit(real_ptr);
+        GC_complete_ongoing_collection();
+      }
+    }
+  }
+}
+
+/* Avoid the work if unreachable finalizable objects are not used. */
+/* TODO: Turn `need_unreachable_finalization` into a counter. */
+static GC_bool need_unreachable_finalization = FALSE;
+
+/* Grow the finalizers table (if needed) before adding `n` entries. */
+STATIC void
+GC_reserve_fo_entries(size_t n)
+{
+  GC_ASSERT(I_HOLD_LOCK());
+  if (EXPECT(NULL == GC_fnlz_roots.fo_head, FALSE)
+      || EXPECT(GC_fo_entries + n > ((size_t)1 << GC_log_fo_table_size),
+                FALSE)) {
+    GC_grow_table((struct hash_chain_entry ***)&GC_fnlz_roots.fo_head,
+                  &GC_log_fo_table_size, &GC_fo_entries, n);
+    GC_COND_LOG_PRINTF("Grew fo table to %u entries\n",
+                       1U << GC_log_fo_table_size);
+  }
+}
+
+/*
+ * Register (or unregister, if `fn` is 0) a finalization function of
+ * `obj`, with the allocator lock held.  `*pnew_fo` (if non-`NULL`) is
+ * the entry to use instead of allocating a new one; it is set to `NULL`
+ * once consumed.  Returns `FALSE` if the entry cannot be allocated,
+ * `*ocd` and `*ofn` remain unchanged in this case.
+ */
+STATIC GC_bool
+GC_register_finalizer_locked(void *obj, GC_finalization_proc fn, void *cd,
+                             GC_finalization_proc *ofn, void **ocd,
+                             finalization_mark_proc mp,
+                             struct finalizable_object **pnew_fo)
+{
+  struct finalizable_object *curr_fo;
+  struct finalizable_object *prev_fo = NULL;
+  size_t index;
+
+  GC_ASSERT(I_HOLD_LOCK());
+  GC_ASSERT(obj != NULL && GC_base_C(obj) == obj);
+  if (mp == GC_unreachable_finalize_mark_proc)
+    need_unreachable_finalization = TRUE;
+  index = HASH2(obj, GC_log_fo_table_size);
+  for (curr_fo = GC_fnlz_roots.fo_head[index]; curr_fo != NULL;
+       prev_fo = curr_fo, curr_fo = fo_next(curr_fo)) {
+    GC_ASSERT(GC_size(curr_fo) >= sizeof(struct finalizable_object));
+    if (curr_fo->fo_hidden_base != GC_HIDE_POINTER(obj))
+      continue;
+
+    /*
+     * Interruption by a signal in the middle of this should be safe.
+     * The client may see only `*ocd` updated, but we will declare that
+     * to be his problem.
+     */
+    if (ocd)
+      *ocd = curr_fo->fo_client_data;
+    if (ofn)
+      *ofn = curr_fo->fo_fn;
+    /* Delete the structure for `obj`. */
+    if (prev_fo == 0) {
+      GC_fnlz_roots.fo_head[index] = fo_next(curr_fo);
+    } else {
+      fo_set_next(prev_fo, fo_next(curr_fo));
+      GC_dirty(prev_fo);
+    }
+    if (fn == 0) {
+      GC_fo_entries--;
+      /*
+       * May not happen if we get a signal.  But a high estimate will
+       * only make the table larger than necessary.
+       */
+#  if !defined(THREADS) && !defined(DBG_HDRS_ALL)
+      GC_free(curr_fo);
+#  endif
+    } else {
+      curr_fo->fo_fn = fn;
+      curr_fo->fo_client_data = (ptr_t)cd;
+      curr_fo->fo_mark_proc = mp;
+      GC_dirty(curr_fo);
+      /*
+       * Reinsert it.  We deleted it first to maintain consistency in
+       * the event of a signal.
+       */
+      if (prev_fo == 0) {
+        GC_fnlz_roots.fo_head[index] = curr_fo;
+      } else {
+        fo_set_next(prev_fo, curr_fo);
+        GC_dirty(prev_fo);
+      }
+    }
+    if (NULL == prev_fo)
+      GC_dirty(GC_fnlz_roots.fo_head + index);
+    return TRUE;
+  }
+
+  if (fn != 0) {
+    struct finalizable_object *new_fo;
+    const hdr *hhdr;
+
+    GET_HDR(obj, hhdr);
+    /* If no `hhdr`, we will not collect it, hence finalizer not run. */
+    if (EXPECT(hhdr != NULL, TRUE)) {
+      new_fo = *pnew_fo;
+      if (NULL == new_fo) {
+        new_fo = (struct finalizable_object *)GC_INTERNAL_MALLOC(
+            sizeof(struct finalizable_object), NORMAL);
+        if (EXPECT(NULL == new_fo, FALSE))
+          return FALSE;
+      } else {
+        *pnew_fo = NULL;
+      }
+      GC_ASSERT(GC_size(new_fo) >= sizeof(struct finalizable_object));
+      new_fo->fo_hidden_base = GC_HIDE_POINTER(obj);
+      new_fo->fo_fn = fn;
+      new_fo->fo_client_data = (ptr_t)cd;
+      new_fo->fo_object_sz = hhdr->hb_sz;
+      new_fo->fo_mark_proc = mp;
+      fo_set_next(new_fo, GC_fnlz_roots.fo_head[index]);
+      GC_dirty(new_fo);
+      GC_fo_entries++;
+      GC_fnlz_roots.fo_head[index] = new_fo;
+      GC_dirty(GC_fnlz_roots.fo_head + index);
+    }
+  }
+  if (ocd)
+    *ocd = 0;
+  if (ofn)
+    *ofn = 0;
+  return TRUE;
+}
+
+/*
+ * Register a finalization function.  See `gc.h` file for details.
+ * The last parameter is a procedure that determines marking for
+ * finalization ordering.  Any objects marked by that procedure will be
+ * guaranteed to not have been finalized when this finalizer is invoked.
+ */
+STATIC void
+GC_register_finalizer_inner(void *obj, GC_finalization_proc fn, void *cd,
+                            GC_finalization_proc *ofn, void **ocd,
+                            finalization_mark_proc mp)
+{
+  struct finalizable_object *new_fo = NULL;
+  GC_oom_func oom_fn;
+
+  GC_ASSERT(GC_is_initialized);
+  if (EXPECT(GC_find_leak_inner, FALSE)) {
+    /* No-op.  `*ocd` and `*ofn` remain unchanged. */
+    return;
+  }
+  LOCK();
+  GC_reserve_fo_entries(0);
+  if (EXPECT(GC_register_finalizer_locked(obj, fn, cd, ofn, ocd, mp,
+                                          &new_fo),
+             TRUE)) {
+    UNLOCK();
+    return;
+  }
+  oom_fn = GC_oom_fn;
+  UNLOCK();
+  new_fo = (struct finalizable_object *)(*oom_fn)(
+      sizeof(struct finalizable_object));
+  if (0 == new_fo) {
+    /* No enough memory.  `*ocd` and `*ofn` remain unchanged. */
+    return;
+  }
+  /* It is not likely we will make it here, but... */
+  LOCK();
+  /* The table may grow, and `obj` may be registered meanwhile. */
+  (void)GC_register_finalizer_locked(obj, fn, cd, ofn, ocd, mp, &new_fo);
+  UNLOCK();
+#  ifndef DBG_HDRS_ALL
+  /* Free unused `new_fo` returned by `GC_oom_fn()` (if any). */
+  GC_free(new_fo);
+#  endif
+}
+
+GC_API void GC_CALL
+GC_register_finalizer(void *obj, GC_finalization_proc fn, void *cd,
+                      GC_finalization_proc *ofn, void **ocd)
+{
+  GC_register_finalizer_inner(obj, fn, cd, ofn, ocd,
+                              GC_normal_finalize_mark_proc);
+}
+
+GC_API void GC_CALL
+GC_register_finalizers(void *const *objs, size_t n, GC_finalization_proc fn,
+                       void *const *cds)
+{
+  size_t i;
+
+  GC_ASSERT(GC_is_initialized);
+  if (EXPECT(GC_find_leak_inner, FALSE) || 0 == n)
+    return;
+  LOCK();
+  /* Grow the table at most once for the whole batch. */
+  if (fn != 0)
+    GC_reserve_fo_entries(n);
+  for (i = 0; i < n; i++) {
+    struct finalizable_object *new_fo = NULL;
+
+    if (!GC_register_finalizer_locked(objs[i], fn,
+                                      cds != NULL ? cds[i] : NULL, 0, NULL,
+                                      GC_normal_finalize_mark_proc, &new_fo))
+      break;
+  }
+  UNLOCK();
+
+  /*
+   * Register the rest one by one (if out of memory), as `GC_oom_fn`
+   * should be called without holding the allocator lock.
+   */
+  for (; i < n; i++) {
+    GC_register_finalizer_inner(objs[i], fn, cds != NULL ? cds[i] : NULL, 0,
+                                NULL, GC_normal_finalize_mark_proc);
+  }
+}
+
+GC_API void GC_CALL
+GC_register_finalizer_ignore_self(void *obj, GC_finalization_proc fn, void *cd,
+                                  GC_finalization_proc *ofn, void **ocd)
+{
+  GC_register_finalizer_inner(obj, fn, cd, ofn, ocd,
+                              GC_ignore_self_finalize_mark_proc);
+}
+
+GC_API void GC_CALL
+GC_register_finalizer_no_order(void *obj, GC_finalization_proc fn, void *cd,
+                               GC_finalization_proc *ofn, void **ocd)
+{
+  GC_register_finalizer_inner(obj, fn, cd, ofn, ocd,
+                              GC_null_finalize_mark_proc);
+}
+
+GC_API void GC_CALL
+GC_register_finalizer_unreachable(void *obj, GC_finalization_proc fn, void *cd,
+                                  GC_finalization_proc *ofn, void **ocd)
+{
+  GC_ASSERT(GC_java_finalization);
+  GC_register_finalizer_inner(obj, fn, cd, ofn, ocd,
+                              GC_unreachable_finalize_mark_proc);
+}
+
+#  ifndef NO_DEBUGGING
+STATIC void
+GC_dump_finalization_links(const struct dl_hashtbl_s *dl_hashtbl)
+{
+  size_t dl_size = (size_t)1 << dl_hashtbl->log_size;
+  size_t i;
+
+  if (NULL == dl_hashtbl->head) {
+    /* The table is empty. */
+    return;
+  }
+
+  for (i = 0; i < dl_size; i++) {
     struct disappearing_link *curr_dl;
 
     for (curr_dl = dl_hashtbl->head[i]; curr_dl != 0;
@@ -957,121 +1966,594 @@ GC_dump_finalization_links(const struct dl_hashtbl_s *dl_hashtbl)
   }
 }
 
-GC_API void GC_CALL
-GC_dump_finalization(void)
+GC_API void GC_CALL
+GC_dump_finalization(void)
+{
+  struct finalizable_object *curr_fo;
+  size_t i;
+  size_t fo_size
+      = GC_fnlz_roots.fo_head == NULL ? 0 : (size_t)1 << GC_log_fo_table_size;
+
+  GC_printf("\n***Disappearing (short) links:\n");
+  GC_dump_finalization_links(&GC_dl_hashtbl);
+#    ifndef GC_LONG_REFS_NOT_NEEDED
+  GC_printf("\n***Disappearing long links:\n");
+  GC_dump_finalization_links(&GC_ll_hashtbl);
+#    endif
+  GC_printf("\n***Soft links:\n");
+  GC_dump_finalization_links(&GC_sl_hashtbl);
+  GC_printf("\n***Finalizers:\n");
+  for (i = 0; i < fo_size; i++) {
+    for (curr_fo = GC_fnlz_roots.fo_head[i]; curr_fo != NULL;
+         curr_fo = fo_next(curr_fo)) {
+      ptr_t real_ptr = (ptr_t)GC_REVEAL_POINTER(curr_fo->fo_hidden_base);
+
+      GC_printf("Finalizable object: %p\n", (void *)real_ptr);
+    }
+  }
+}
+#  endif /* !NO_DEBUGGING */
+
+#  ifndef SMALL_CONFIG
+STATIC size_t GC_old_dl_entries = 0; /*< for stats printing */
+#    ifndef GC_LONG_REFS_NOT_NEEDED
+STATIC size_t GC_old_ll_entries = 0;
+#    endif
+#  endif /* !SMALL_CONFIG */
+
+#  ifndef THREADS
+/*
+ * Checks and updates the level of finalizers recursion.
+ * Returns `NULL` if `GC_invoke_finalizers()` should not be called by
+ * the collector (to minimize the risk of a deep finalizers recursion),
+ * otherwise returns a pointer to `GC_finalizer_nested`.
+ */
+STATIC unsigned char *
+GC_check_finalizer_nested(void)
+{
+  unsigned nesting_level = GC_finalizer_nested;
+  if (nesting_level) {
+    /*
+     * We are inside another `GC_invoke_finalizers()`.  Skip some
+     * implicitly-called `GC_invoke_finalizers()` depending on the
+     * nesting (recursion) level.
+     */
+    if ((unsigned)(++GC_finalizer_skipped) < (1U << nesting_level))
+      return NULL;
+    GC_finalizer_skipped = 0;
+  }
+  GC_finalizer_nested = (unsigned char)(nesting_level + 1);
+  return &GC_finalizer_nested;
+}
+#  endif /* !THREADS */
+
+GC_INLINE void
+GC_make_disappearing_links_disappear(struct dl_hashtbl_s *dl_hashtbl,
+                                     GC_bool is_remove_dangling)
+{
+  size_t i;
+  size_t dl_size = (size_t)1 << dl_hashtbl->log_size;
+  GC_bool needs_barrier = FALSE;
+
+  GC_ASSERT(I_HOLD_LOCK());
+  if (NULL == dl_hashtbl->head) {
+    /* The table is empty. */
+    return;
+  }
+
+  for (i = 0; i < dl_size; i++) {
+    struct disappearing_link *curr_dl, *next_dl;
+    struct disappearing_link *prev_dl = NULL;
+
+    for (curr_dl = dl_hashtbl->head[i]; curr_dl != NULL; curr_dl = next_dl) {
+      next_dl = dl_next(curr_dl);
+#  if defined(GC_ASSERTIONS) && !defined(THREAD_SANITIZER)
+      /* Check accessibility of the location pointed by the link. */
+      GC_noop1_ptr(*(ptr_t *)GC_REVEAL_POINTER(curr_dl->dl_hidden_link));
+#  endif
+      if (is_remove_dangling) {
+        ptr_t real_link
+            = (ptr_t)GC_base(GC_REVEAL_POINTER(curr_dl->dl_hidden_link));
+
+        if (NULL == real_link || EXPECT(GC_is_marked(real_link), TRUE)) {
+          prev_dl = curr_dl;
+          continue;
+        }
+      } else {
+        if (EXPECT(
+                GC_is_marked((ptr_t)GC_REVEAL_POINTER(curr_dl->dl_hidden_obj)),
+                TRUE)) {
+          prev_dl = curr_dl;
+          continue;
+        }
+        *(ptr_t *)GC_REVEAL_POINTER(curr_dl->dl_hidden_link) = NULL;
+      }
+
+      /* Delete `curr_dl` entry from `dl_hashtbl`. */
+      if (NULL == prev_dl) {
+        dl_hashtbl->head[i] = next_dl;
+        needs_barrier = TRUE;
+      } else {
+        dl_set_next(prev_dl, next_dl);
+        GC_dirty(prev_dl);
+      }
+      GC_clear_mark_bit(curr_dl);
+      dl_hashtbl->entries--;
+    }
+  }
+  if (needs_barrier)
+    GC_dirty(dl_hashtbl->head); /*< entire object */
+}
+
+/* Ordered finalization of the cycles support. */
+
+/* Is the cycle finalization mode on?  Protected by the allocator lock. */
+STATIC GC_bool GC_cycle_finalization = FALSE;
+
+#  define SCC_NONE (~(size_t)0)
+
+/*
+ * A node of the graph of the unmarked objects reachable from the
+ * unreachable finalizable objects.  The edges are the pointers which
+ * the marker follows (see `GC_scc_next_child()`).
+ */
+struct scc_node_s {
+  ptr_t base;
+  /* The entry of `base` if it is an unreachable finalizable object. */
+  struct finalizable_object *fo;
+  /*
+   * The mark descriptor of the object (the per-object one is resolved).
+   * Only the length and bitmap descriptors are interpreted here.
+   */
+  word descr;
+  size_t dfs_index; /*< 1-based; zero means the node is not visited yet */
+  size_t lowlink;
+  size_t scc;      /*< `SCC_NONE` until the component is found */
+  size_t scan_pos; /*< the offset of the next field to scan */
+};
+
+/* Flags of a component. */
+#  define SCC_HAS_SOURCE 1 /*< has a finalizable object */
+#  define SCC_READY 2      /*< not reachable from the other components */
+
+/*
+ * The work area (allocated with `GC_os_get_mem()` and reused across
+ * the collections): the nodes, the Tarjan's stack, the depth-first
+ * search stack, the nodes grouped by component, the index of the first
+ * member of each component in the latter (plus one extra entry), the
+ * component flags.  All are indexed by the node number (except for the
+ * last two which are indexed by the component number), and have
+ * `GC_scc_cap` capacity (plus one for `GC_scc_first`).
+ */
+STATIC struct scc_node_s *GC_scc_nodes = NULL;
+STATIC size_t *GC_scc_stack;
+STATIC size_t *GC_scc_dfs_stack;
+STATIC size_t *GC_scc_members;
+STATIC size_t *GC_scc_first;
+STATIC unsigned char *GC_scc_flags;
+STATIC size_t GC_scc_cap = 0;
+STATIC size_t GC_scc_area_bytes;
+
+/* The open-addressing map of the objects to the node numbers plus one. */
+STATIC size_t *GC_scc_map = NULL;
+STATIC unsigned GC_scc_map_log_size;
+
+STATIC size_t GC_scc_nodes_cnt;
+STATIC size_t GC_scc_cnt;
+STATIC size_t GC_scc_stack_top;
+STATIC size_t GC_scc_dfs_index;
+
+/* Set if the computed components are valid for `GC_is_scc_ready()`. */
+STATIC GC_bool GC_scc_valid = FALSE;
+
+#  define SCC_MAP_SIZE() ((size_t)1 << GC_scc_map_log_size)
+
+STATIC size_t *
+GC_scc_map_slot(ptr_t base)
+{
+  size_t mask = SCC_MAP_SIZE() - 1;
+  size_t i = HASH2(base, GC_scc_map_log_size);
+
+  for (;; i = (i + 1) & mask) {
+    size_t v = GC_scc_map[i];
+
+    if (0 == v || GC_scc_nodes[v - 1].base == base)
+      return &GC_scc_map[i];
+  }
+}
+
+/* Ensure there is a room for one more node.  Returns `FALSE` on failure. */
+STATIC GC_bool
+GC_scc_reserve(void)
+{
+  GC_ASSERT(I_HOLD_LOCK());
+  if (GC_scc_nodes_cnt == GC_scc_cap) {
+    size_t new_cap = GC_scc_cap > 0 ? GC_scc_cap * 2 : 1024;
+    size_t bytes = ROUNDUP_PAGESIZE_IF_MMAP(
+        new_cap * (sizeof(struct scc_node_s) + 4 * sizeof(size_t) + 1)
+        + sizeof(size_t));
+    ptr_t area = GC_os_get_mem(bytes);
+    struct scc_node_s *new_nodes;
+    size_t *new_stack, *new_dfs_stack, *new_members, *new_first;
+
+    if (EXPECT(NULL == area, FALSE))
+      return FALSE;
+    new_nodes = (struct scc_node_s *)area;
+    new_stack = (size_t *)(new_nodes + new_cap);
+    new_dfs_stack = new_stack + new_cap;
+    new_members = new_dfs_stack + new_cap;
+    new_first = new_members + new_cap;
+    if (GC_scc_cap > 0) {
+      BCOPY(GC_scc_nodes, new_nodes,
+            GC_scc_nodes_cnt * sizeof(struct scc_node_s));
+      BCOPY(GC_scc_stack, new_stack, GC_scc_stack_top * sizeof(size_t));
+      BCOPY(GC_scc_dfs_stack, new_dfs_stack, GC_scc_cap * sizeof(size_t));
+      BCOPY(GC_scc_members, new_members, GC_scc_cap * sizeof(size_t));
+      BCOPY(GC_scc_first, new_first, (GC_scc_cnt + 1) * sizeof(size_t));
+      BCOPY(GC_scc_flags, new_first + new_cap + 1, GC_scc_cnt);
+#  ifndef GWW_VDB
+      GC_scratch_recycle_no_gww(GC_scc_nodes, GC_scc_area_bytes);
+#  endif
+    }
+    GC_scc_nodes = new_nodes;
+    GC_scc_stack = new_stack;
+    GC_scc_dfs_stack = new_dfs_stack;
+    GC_scc_members = new_members;
+    GC_scc_first = new_first;
+    GC_scc_flags = (unsigned char *)(new_first + new_cap + 1);
+    GC_scc_cap = new_cap;
+    GC_scc_area_bytes = bytes;
+  }
+
+  if (NULL == GC_scc_map || 2 * (GC_scc_nodes_cnt + 1) > SCC_MAP_SIZE()) {
+    unsigned log_new_size = NULL == GC_scc_map ? 11 : GC_scc_map_log_size + 1;
+    size_t bytes = ROUNDUP_PAGESIZE_IF_MMAP(((size_t)1 << log_new_size)
+                                            * sizeof(size_t));
+    size_t *new_map = (size_t *)GC_os_get_mem(bytes);
+    size_t i;
+
+    if (EXPECT(NULL == new_map, FALSE))
+      return FALSE;
+    BZERO(new_map, bytes);
+#  ifndef GWW_VDB
+    if (GC_scc_map != NULL)
+      GC_scratch_recycle_no_gww(GC_scc_map, SCC_MAP_SIZE() * sizeof(size_t));
+#  endif
+    GC_scc_map = new_map;
+    GC_scc_map_log_size = log_new_size;
+    for (i = 0; i < GC_scc_nodes_cnt; i++) {
+      *GC_scc_map_slot(GC_scc_nodes[i].base) = i + 1;
+    }
+  }
+  return TRUE;
+}
+
+/*
+ * Get the mark descriptor of the object at `base` like the marker does,
+ * i.e. resolve the per-object descriptor.  The result might be zero.
+ */
+STATIC word
+GC_scc_obj_descr(ptr_t base)
+{
+  const hdr *hhdr = HDR(base);
+  word descr = hhdr->hb_descr;
+
+  if (IS_PTRFREE(hhdr) || (descr & GC_DS_TAGS) != GC_DS_PER_OBJECT)
+    return descr;
+  if ((descr & SIGNB) == 0)
+    return *(word *)(base + descr - GC_DS_PER_OBJECT);
+  {
+    ptr_t type_descr = *(ptr_t *)base;
+
+    if (NULL == type_descr)
+      return 0;
+    return *(word *)(type_descr
+                     - ((GC_signed_word)descr
+                        + (GC_INDIR_PER_OBJ_BIAS - GC_DS_PER_OBJECT)));
+  }
+}
+
+/* Is the node of an object with a custom mark procedure? */
+#  define SCC_NODE_OPAQUE(node)                             \
+    (((node)->descr & GC_DS_TAGS) != GC_DS_LENGTH           \
+     && ((node)->descr & GC_DS_TAGS) != GC_DS_BITMAP)
+
+/*
+ * Return the number of the node for the object at `base`, adding the
+ * node if needed; `fo` is the finalizable object entry for a new node
+ * (if any).  Returns `SCC_NONE` on the memory allocation failure.
+ */
+STATIC size_t
+GC_scc_node_of(ptr_t base, struct finalizable_object *fo)
+{
+  size_t *slot;
+  size_t n;
+  struct scc_node_s *node;
+
+  if (EXPECT(!GC_scc_reserve(), FALSE))
+    return SCC_NONE;
+  slot = GC_scc_map_slot(base);
+  if (*slot != 0)
+    return *slot - 1;
+
+  n = GC_scc_nodes_cnt++;
+  node = &GC_scc_nodes[n];
+  node->base = base;
+  node->fo = fo;
+  if (fo != NULL && fo->fo_mark_proc == GC_ignore_self_finalize_mark_proc) {
+    /* The fields scanned by the latter (the self ones are skipped). */
+    const hdr *hhdr = HDR(base);
+
+    node->descr = (hhdr->hb_descr & GC_DS_TAGS) == GC_DS_LENGTH
+                      ? hhdr->hb_descr
+                      : (word)hhdr->hb_sz;
+  } else {
+    node->descr = GC_scc_obj_descr(base);
+  }
+  node->dfs_index = 0;
+  node->scc = SCC_NONE;
+  node->scan_pos = 0;
+  *slot = n + 1;
+  return n;
+}
+
+/*
+ * Return the base of the object `q` points to if the marker would mark
+ * the object by such a pointer (taking into account the valid interior
+ * pointer displacements), or `NULL` otherwise.
+ */
+STATIC ptr_t
+GC_scc_target(ptr_t q)
+{
+  ptr_t r = (ptr_t)GC_base(q);
+  size_t displ;
+
+  if (NULL == r)
+    return NULL;
+  displ = (size_t)(q - r);
+  if (displ >= VALID_OFFSET_SZ ? !GC_all_interior_pointers
+                               : !GC_valid_offsets[displ])
+    return NULL;
+  return r;
+}
+
+/*
+ * Return the next unmarked object referenced from the given node, or
+ * `NULL` if all the fields are scanned.  The fields are the ones the
+ * marker scans according to the length or bitmap descriptor.  The nodes
+ * with a custom mark procedure have no edges here (see
+ * `GC_mark_fo_in_scc_order()` how these are handled).
+ */
+STATIC ptr_t
+GC_scc_next_child(struct scc_node_s *node)
+{
+  ptr_t p = node->base;
+  word descr = node->descr;
+  GC_bool ignore_self
+      = node->fo != NULL
+        && node->fo->fo_mark_proc == GC_ignore_self_finalize_mark_proc;
+
+  for (;;) {
+    ptr_t current_p = p + node->scan_pos;
+    ptr_t q, r;
+
+    if ((descr & GC_DS_TAGS) == GC_DS_LENGTH) {
+      if (node->scan_pos + sizeof(ptr_t) > (size_t)descr)
+        return NULL;
+      node->scan_pos += ALIGNMENT;
+    } else if ((descr & GC_DS_TAGS) == GC_DS_BITMAP) {
+      word bits = (descr & ~(word)GC_DS_TAGS)
+                  << (node->scan_pos / sizeof(ptr_t));
+
+      if (0 == bits)
+        return NULL;
+      node->scan_pos += sizeof(ptr_t);
+      if ((bits & SIGNB) == 0)
+        continue;
+    } else {
+      return NULL;
+    }
+    LOAD_PTR_OR_CONTINUE(q, current_p);
+    r = GC_scc_target(q);
+    if (NULL == r || GC_is_marked(r) || (ignore_self && r == p))
+      continue;
+    return r;
+  }
+}
+
+STATIC void
+GC_scc_visit(size_t n, size_t *pdfs_top)
+{
+  GC_scc_nodes[n].dfs_index = ++GC_scc_dfs_index;
+  GC_scc_nodes[n].lowlink = GC_scc_dfs_index;
+  GC_scc_stack[GC_scc_stack_top++] = n;
+  GC_scc_dfs_stack[(*pdfs_top)++] = n;
+}
+
+/*
+ * Find the components reachable from the given node (the iterative
+ * Tarjan's algorithm).  The components are numbered in the order of
+ * their completion, i.e. an edge never leads to a component with
+ * a greater number.  Returns `FALSE` on the memory allocation failure.
+ */
+STATIC GC_bool
+GC_scc_strongconnect(size_t root)
+{
+  size_t dfs_top = 0;
+
+  GC_scc_visit(root, &dfs_top);
+  while (dfs_top > 0) {
+    size_t u = GC_scc_dfs_stack[dfs_top - 1];
+    ptr_t child = GC_scc_next_child(&GC_scc_nodes[u]);
+
+    if (child != NULL) {
+      size_t v = GC_scc_node_of(child, NULL);
+
+      if (EXPECT(SCC_NONE == v, FALSE))
+        return FALSE;
+      if (0 == GC_scc_nodes[v].dfs_index) {
+        GC_scc_visit(v, &dfs_top);
+      } else if (SCC_NONE == GC_scc_nodes[v].scc /* on stack */
+                 && GC_scc_nodes[v].dfs_index < GC_scc_nodes[u].lowlink) {
+        GC_scc_nodes[u].lowlink = GC_scc_nodes[v].dfs_index;
+      }
+      continue;
+    }
+
+    dfs_top--;
+    if (GC_scc_nodes[u].lowlink == GC_scc_nodes[u].dfs_index) {
+      size_t members_cnt = GC_scc_first[GC_scc_cnt];
+      size_t w;
+
+      GC_scc_flags[GC_scc_cnt] = 0;
+      do {
+        w = GC_scc_stack[--GC_scc_stack_top];
+        GC_scc_nodes[w].scc = GC_scc_cnt;
+        GC_scc_members[members_cnt++] = w;
+        if (GC_scc_nodes[w].fo != NULL)
+          GC_scc_flags[GC_scc_cnt] |= SCC_HAS_SOURCE;
+      } while (w != u);
+      GC_scc_first[++GC_scc_cnt] = members_cnt;
+    }
+    if (dfs_top > 0) {
+      size_t w = GC_scc_dfs_stack[dfs_top - 1];
+
+      if (GC_scc_nodes[u].lowlink < GC_scc_nodes[w].lowlink)
+        GC_scc_nodes[w].lowlink = GC_scc_nodes[u].lowlink;
+    }
+  }
+  return TRUE;
+}
+
+/* Is the finalizable object at `base` ready according to the components? */
+STATIC GC_bool
+GC_is_scc_ready(ptr_t base)
 {
-  struct finalizable_object *curr_fo;
-  size_t i;
-  size_t fo_size
-      = GC_fnlz_roots.fo_head == NULL ? 0 : (size_t)1 << GC_log_fo_table_size;
+  size_t v;
+  const struct scc_node_s *node;
+
+  if (!GC_scc_valid)
+    return FALSE;
+  v = *GC_scc_map_slot(base);
+  if (0 == v)
+    return FALSE;
+  node = &GC_scc_nodes[v - 1];
+  return node->fo != NULL
+         && node->fo->fo_mark_proc == GC_normal_finalize_mark_proc
+         && (GC_scc_flags[node->scc] & SCC_READY) != 0;
+}
+
+/*
+ * Mark all objects reachable from the unreachable finalizable objects
+ * like `GC_finalize()` does, but process the strongly connected
+ * components of the graph of the unmarked objects in the topological
+ * order (sources first).  A component with a finalizable object which
+ * is still unmarked when its turn comes is not reachable from the other
+ * finalizable objects, thus its objects registered by
+ * `GC_register_finalizer` are ready for finalization even if they are
+ * in a cycle.  Each object is scanned once to find the components, and
+ * marked once.  The components are found before any marking, thus
+ * nothing is marked if `FALSE` is returned (on the memory allocation
+ * failure).
+ */
+STATIC GC_bool
+GC_mark_fo_in_scc_order(size_t fo_size)
+{
+  size_t i, c;
+  size_t roots_cnt;
+  size_t cycles_cnt = 0;
+
+  GC_ASSERT(I_HOLD_LOCK());
+  GC_scc_valid = FALSE;
+  GC_scc_nodes_cnt = 0;
+  GC_scc_cnt = 0;
+  GC_scc_stack_top = 0;
+  GC_scc_dfs_index = 0;
+  if (GC_scc_map != NULL)
+    BZERO(GC_scc_map, SCC_MAP_SIZE() * sizeof(size_t));
 
-  GC_printf("\n***Disappearing (short) links:\n");
-  GC_dump_finalization_links(&GC_dl_hashtbl);
-#    ifndef GC_LONG_REFS_NOT_NEEDED
-  GC_printf("\n***Disappearing long links:\n");
-  GC_dump_finalization_links(&GC_ll_hashtbl);
-#    endif
-  GC_printf("\n***Finalizers:\n");
   for (i = 0; i < fo_size; i++) {
+    struct finalizable_object *curr_fo;
+
     for (curr_fo = GC_fnlz_roots.fo_head[i]; curr_fo != NULL;
          curr_fo = fo_next(curr_fo)) {
       ptr_t real_ptr = (ptr_t)GC_REVEAL_POINTER(curr_fo->fo_hidden_base);
 
-      GC_printf("Finalizable object: %p\n", (void *)real_ptr);
+      if (GC_is_marked(real_ptr))
+        continue;
+      if (curr_fo->fo_mark_proc == GC_null_finalize_mark_proc) {
+        GC_MARKED_FOR_FINALIZATION(real_ptr);
+        continue;
+      }
+      if (SCC_NONE == GC_scc_node_of(real_ptr, curr_fo))
+        return FALSE;
     }
   }
-}
-#  endif /* !NO_DEBUGGING */
-
-#  ifndef SMALL_CONFIG
-STATIC size_t GC_old_dl_entries = 0; /*< for stats printing */
-#    ifndef GC_LONG_REFS_NOT_NEEDED
-STATIC size_t GC_old_ll_entries = 0;
-#    endif
-#  endif /* !SMALL_CONFIG */
+  if (0 == GC_scc_nodes_cnt)
+    return FALSE;
 
-#  ifndef THREADS
-/*
- * Checks and updates the level of finalizers recursion.
- * Returns `NULL` if `GC_invoke_finalizers()` should not be called by
- * the collector (to minimize the risk of a deep finalizers recursion),
- * otherwise returns a pointer to `GC_finalizer_nested`.
- */
-STATIC unsigned char *
-GC_check_finalizer_nested(void)
-{
-  unsigned nesting_level = GC_finalizer_nested;
-  if (nesting_level) {
-    /*
-     * We are inside another `GC_invoke_finalizers()`.  Skip some
-     * implicitly-called `GC_invoke_finalizers()` depending on the
-     * nesting (recursion) level.
-     */
-    if ((unsigned)(++GC_finalizer_skipped) < (1U << nesting_level))
-      return NULL;
-    GC_finalizer_skipped = 0;
+  GC_scc_first[0] = 0;
+  roots_cnt = GC_scc_nodes_cnt;
+  for (i = 0; i < roots_cnt; i++) {
+    if (0 == GC_scc_nodes[i].dfs_index && !GC_scc_strongconnect(i))
+      return FALSE;
   }
-  GC_finalizer_nested = (unsigned char)(nesting_level + 1);
-  return &GC_finalizer_nested;
-}
-#  endif /* !THREADS */
 
-GC_INLINE void
-GC_make_disappearing_links_disappear(struct dl_hashtbl_s *dl_hashtbl,
-                                     GC_bool is_remove_dangling)
-{
-  size_t i;
-  size_t dl_size = (size_t)1 << dl_hashtbl->log_size;
-  GC_bool needs_barrier = FALSE;
+  /*
+   * The edges from the objects with a custom mark procedure are unknown,
+   * thus the topological order could be wrong for the objects reachable
+   * from the latter.  Mark such objects first, so that they are not
+   * considered ready (as they are reachable from some finalizable
+   * object anyway, this only prevents finalization of the cycles going
+   * through the objects with a custom mark procedure).
+   */
+  for (i = 0; i < GC_scc_nodes_cnt; i++) {
+    const struct scc_node_s *node = &GC_scc_nodes[i];
 
-  GC_ASSERT(I_HOLD_LOCK());
-  if (NULL == dl_hashtbl->head) {
-    /* The table is empty. */
-    return;
+    if (!SCC_NODE_OPAQUE(node))
+      continue;
+    if (NULL == node->fo) {
+      GC_mark_fo(node->base, GC_normal_finalize_mark_proc);
+    } else if (!GC_is_marked(node->base)) {
+      GC_MARKED_FOR_FINALIZATION(node->base);
+      GC_mark_fo(node->base, node->fo->fo_mark_proc);
+    }
   }
 
-  for (i = 0; i < dl_size; i++) {
-    struct disappearing_link *curr_dl, *next_dl;
-    struct disappearing_link *prev_dl = NULL;
+  for (c = GC_scc_cnt; c-- > 0;) {
+    size_t k;
 
-    for (curr_dl = dl_hashtbl->head[i]; curr_dl != NULL; curr_dl = next_dl) {
-      next_dl = dl_next(curr_dl);
-#  if defined(GC_ASSERTIONS) && !defined(THREAD_SANITIZER)
-      /* Check accessibility of the location pointed by the link. */
-      GC_noop1_ptr(*(ptr_t *)GC_REVEAL_POINTER(curr_dl->dl_hidden_link));
-#  endif
-      if (is_remove_dangling) {
-        ptr_t real_link
-            = (ptr_t)GC_base(GC_REVEAL_POINTER(curr_dl->dl_hidden_link));
+    if (0 == GC_scc_flags[c])
+      continue;
+    for (k = GC_scc_first[c]; k < GC_scc_first[c + 1]; k++) {
+      if (GC_is_marked(GC_scc_nodes[GC_scc_members[k]].base))
+        break;
+    }
+    if (k == GC_scc_first[c + 1]) {
+      GC_scc_flags[c] |= SCC_READY;
+      if (GC_scc_first[c + 1] - GC_scc_first[c] > 1)
+        cycles_cnt++;
+    }
 
-        if (NULL == real_link || EXPECT(GC_is_marked(real_link), TRUE)) {
-          prev_dl = curr_dl;
-          continue;
-        }
-      } else {
-        if (EXPECT(
-                GC_is_marked((ptr_t)GC_REVEAL_POINTER(curr_dl->dl_hidden_obj)),
-                TRUE)) {
-          prev_dl = curr_dl;
-          continue;
-        }
-        *(ptr_t *)GC_REVEAL_POINTER(curr_dl->dl_hidden_link) = NULL;
-      }
+    for (k = GC_scc_first[c]; k < GC_scc_first[c + 1]; k++) {
+      const struct scc_node_s *node = &GC_scc_nodes[GC_scc_members[k]];
 
-      /* Delete `curr_dl` entry from `dl_hashtbl`. */
-      if (NULL == prev_dl) {
-        dl_hashtbl->head[i] = next_dl;
-        needs_barrier = TRUE;
-      } else {
-        dl_set_next(prev_dl, next_dl);
-        GC_dirty(prev_dl);
+      if (NULL == node->fo || SCC_NODE_OPAQUE(node)
+          || GC_is_marked(node->base))
+        continue;
+      GC_MARKED_FOR_FINALIZATION(node->base);
+      GC_mark_fo(node->base, node->fo->fo_mark_proc);
+      if (GC_is_marked(node->base) && (GC_scc_flags[c] & SCC_READY) == 0) {
+        WARN("Finalization cycle involving %p\n", node->base);
       }
-      GC_clear_mark_bit(curr_dl);
-      dl_hashtbl->entries--;
     }
   }
-  if (needs_barrier)
-    GC_dirty(dl_hashtbl->head); /*< entire object */
+  GC_COND_LOG_PRINTF("Finalization order: %lu objects in %lu components,"
+                     " %lu cycle(s) ready\n",
+                     (unsigned long)GC_scc_nodes_cnt,
+                     (unsigned long)GC_scc_cnt, (unsigned long)cycles_cnt);
+  GC_scc_valid = TRUE;
+  return TRUE;
 }
 
 GC_INNER void
@@ -1085,6 +2567,9 @@ GC_finalize(void)
   GC_bool needs_barrier = FALSE;
 
   GC_ASSERT(I_HOLD_LOCK());
+#  ifdef DEFERRED_DL_REGISTRATION
+  GC_merge_pending_dls(TRUE);
+#  endif
 #  ifndef SMALL_CONFIG
   /* Save current `GC_dl_entries` value for stats printing. */
   GC_old_dl_entries = GC_dl_hashtbl.entries;
@@ -1097,35 +2582,48 @@ GC_finalize(void)
 #  ifndef GC_TOGGLE_REFS_NOT_NEEDED
   GC_mark_togglerefs();
 #  endif
+  if (GC_sl_hashtbl.entries > 0)
+    GC_keep_soft_link_targets();
+  if (GC_ephemerons != 0) {
+    GC_mark_ephemerons();
+    GC_clear_ephemerons();
+  }
   GC_make_disappearing_links_disappear(&GC_dl_hashtbl, FALSE);
+  GC_make_disappearing_links_disappear(&GC_sl_hashtbl, FALSE);
 
   /*
    * Mark all objects reachable via chains of 1 or more pointers from
    * finalizable objects.
    */
   GC_ASSERT(!GC_collection_in_progress());
-  for (i = 0; i < fo_size; i++) {
-    for (curr_fo = GC_fnlz_roots.fo_head[i]; curr_fo != NULL;
-         curr_fo = fo_next(curr_fo)) {
-      GC_ASSERT(GC_size(curr_fo) >= sizeof(struct finalizable_object));
-      real_ptr = (ptr_t)GC_REVEAL_POINTER(curr_fo->fo_hidden_base);
-      if (!GC_is_marked(real_ptr)) {
-        GC_MARKED_FOR_FINALIZATION(real_ptr);
-        GC_mark_fo(real_ptr, curr_fo->fo_mark_proc);
-        if (GC_is_marked(real_ptr)) {
-          WARN("Finalization cycle involving %p\n", real_ptr);
+  if (!GC_cycle_finalization || 0 == GC_fo_entries
+      || !GC_mark_fo_in_scc_order(fo_size)) {
+    for (i = 0; i < fo_size; i++) {
+      for (curr_fo = GC_fnlz_roots.fo_head[i]; curr_fo != NULL;
+           curr_fo = fo_next(curr_fo)) {
+        GC_ASSERT(GC_size(curr_fo) >= sizeof(struct finalizable_object));
+        real_ptr = (ptr_t)GC_REVEAL_POINTER(curr_fo->fo_hidden_base);
+        if (!GC_is_marked(real_ptr)) {
+          GC_MARKED_FOR_FINALIZATION(real_ptr);
+          GC_mark_fo(real_ptr, curr_fo->fo_mark_proc);
+          if (GC_is_marked(real_ptr)) {
+            WARN("Finalization cycle involving %p\n", real_ptr);
+          }
         }
       }
     }
   }
-  /* Enqueue for finalization all objects that are still unreachable. */
+  /*
+   * Enqueue for finalization all objects that are still unreachable
+   * (or are ready as a part of a cycle).
+   */
   GC_bytes_finalized = 0;
   for (i = 0; i < fo_size; i++) {
     curr_fo = GC_fnlz_roots.fo_head[i];
     prev_fo = NULL;
     while (curr_fo != NULL) {
       real_ptr = (ptr_t)GC_REVEAL_POINTER(curr_fo->fo_hidden_base);
-      if (!GC_is_marked(real_ptr)) {
+      if (!GC_is_marked(real_ptr) || GC_is_scc_ready(real_ptr)) {
         if (!GC_java_finalization) {
           GC_set_mark_bit(real_ptr);
         }
@@ -1150,6 +2648,7 @@ GC_finalize(void)
         fo_set_next(curr_fo, GC_fnlz_roots.finalize_now);
         GC_dirty(curr_fo);
         SET_FINALIZE_NOW(curr_fo);
+        GC_finalize_now_entries++;
         /* Unhide object pointer so any future collections will see it. */
         curr_fo->fo_hidden_base
             = (GC_hidden_pointer)GC_REVEAL_POINTER(curr_fo->fo_hidden_base);
@@ -1164,6 +2663,7 @@ GC_finalize(void)
       }
     }
   }
+  GC_scc_valid = FALSE;
 
   if (GC_java_finalization) {
     /*
@@ -1210,6 +2710,7 @@ GC_finalize(void)
           fo_set_next(prev_fo, next_fo);
           GC_dirty(prev_fo);
         }
+        GC_finalize_now_entries--;
         curr_fo->fo_hidden_base = GC_HIDE_POINTER(real_ptr);
         GC_bytes_finalized
             -= (word)curr_fo->fo_object_sz + sizeof(struct finalizable_object);
@@ -1229,6 +2730,7 @@ GC_finalize(void)
 
   /* Remove dangling disappearing links. */
   GC_make_disappearing_links_disappear(&GC_dl_hashtbl, TRUE);
+  GC_make_disappearing_links_disappear(&GC_sl_hashtbl, TRUE);
 
 #  ifndef GC_TOGGLE_REFS_NOT_NEEDED
   GC_clear_togglerefs();
@@ -1290,6 +2792,7 @@ GC_enqueue_all_finalizers(void)
       fo_set_next(curr_fo, GC_fnlz_roots.finalize_now);
       GC_dirty(curr_fo);
       SET_FINALIZE_NOW(curr_fo);
+      GC_finalize_now_entries++;
 
       /* Unhide object pointer so any future collections will see it. */
       curr_fo->fo_hidden_base
@@ -1325,6 +2828,25 @@ GC_finalize_all(void)
 
 #  endif /* !JAVA_FINALIZATION_NOT_NEEDED */
 
+GC_API void GC_CALL
+GC_set_cycle_finalization(int value)
+{
+  LOCK();
+  GC_cycle_finalization = (GC_bool)value;
+  UNLOCK();
+}
+
+GC_API int GC_CALL
+GC_get_cycle_finalization(void)
+{
+  int value;
+
+  READER_LOCK();
+  value = (int)GC_cycle_finalization;
+  READER_UNLOCK();
+  return value;
+}
+
 GC_API void GC_CALL
 GC_set_interrupt_finalizers(unsigned value)
 {
@@ -1344,14 +2866,36 @@ GC_get_interrupt_finalizers(void)
   return value;
 }
 
-GC_API int GC_CALL
-GC_should_invoke_finalizers(void)
-{
+/* Check (without the allocator lock) whether `finalize_now` is empty. */
 #  ifdef AO_HAVE_load
-  return GC_cptr_load((volatile ptr_t *)&GC_fnlz_roots.finalize_now) != NULL;
+#    define FINALIZE_NOW_EMPTY() \
+      (NULL == GC_cptr_load((volatile ptr_t *)&GC_fnlz_roots.finalize_now))
 #  else
-  return GC_fnlz_roots.finalize_now != NULL;
+#    define FINALIZE_NOW_EMPTY() (NULL == GC_fnlz_roots.finalize_now)
 #  endif /* !THREADS */
+
+#  ifdef ENABLE_DISCLAIM
+#    ifdef AO_HAVE_load
+#      define DISCLAIM_BATCHES_PENDING() \
+        (AO_load((volatile AO_t *)&GC_disclaim_quarantined) != 0)
+#    else
+#      define DISCLAIM_BATCHES_PENDING() (GC_disclaim_quarantined != 0)
+#    endif
+#  else
+#    define DISCLAIM_BATCHES_PENDING() FALSE
+#  endif
+
+/*
+ * Check whether there are ready finalizers or objects quarantined for
+ * the batch disclaim procedures.
+ */
+#  define FINALIZATION_WORK_PENDING() \
+    (!FINALIZE_NOW_EMPTY() || DISCLAIM_BATCHES_PENDING())
+
+GC_API int GC_CALL
+GC_should_invoke_finalizers(void)
+{
+  return !FINALIZE_NOW_EMPTY();
 }
 
 GC_API int GC_CALL
@@ -1361,7 +2905,7 @@ GC_invoke_finalizers(void)
   word bytes_freed_before = 0; /*< initialized to prevent warning */
 
   GC_ASSERT(I_DONT_HOLD_LOCK());
-  while (GC_should_invoke_finalizers()) {
+  while (!FINALIZE_NOW_EMPTY()) {
     struct finalizable_object *curr_fo;
     ptr_t real_ptr;
 
@@ -1382,6 +2926,7 @@ GC_invoke_finalizers(void)
     }
 #  endif
     SET_FINALIZE_NOW(fo_next(curr_fo));
+    GC_finalize_now_entries--;
     UNLOCK();
     fo_set_next(curr_fo, 0);
     real_ptr = (ptr_t)curr_fo->fo_hidden_base; /*< revealed */
@@ -1412,6 +2957,196 @@ GC_invoke_finalizers(void)
   return count;
 }
 
+#  ifdef FINALIZER_THREADS_SUPPORTED
+#    ifndef FINALIZER_THREADS_BATCH
+/*
+ * The maximum number of ready finalizers taken from `finalize_now`
+ * queue by a finalizer worker thread at once.
+ */
+#      define FINALIZER_THREADS_BATCH 64
+#    endif
+
+/*
+ * The number of the started finalizer worker threads.  Protected by
+ * the allocator lock.
+ */
+STATIC unsigned GC_finalizer_threads_cnt = 0;
+
+/* Used by the idle finalizer threads to wait for the work. */
+static pthread_mutex_t fnlz_threads_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t fnlz_threads_cond = PTHREAD_COND_INITIALIZER;
+
+/*
+ * Detach up to `FINALIZER_THREADS_BATCH` objects (but no more than
+ * `GC_interrupt_finalizers` one, if nonzero) from `finalize_now` queue
+ * (acquiring the allocator lock once), and run their finalizers.
+ * Returns the number of finalizers that were run.
+ */
+STATIC int
+GC_invoke_finalizers_batch(void)
+{
+  struct finalizable_object *batch;
+  struct finalizable_object *curr_fo;
+  word bytes_freed_before;
+  int count = 0;
+  int limit = FINALIZER_THREADS_BATCH;
+
+  GC_ASSERT(I_DONT_HOLD_LOCK());
+  LOCK();
+  batch = GC_fnlz_roots.finalize_now;
+  if (NULL == batch) {
+    UNLOCK();
+    return 0;
+  }
+  bytes_freed_before = GC_bytes_freed;
+  if (EXPECT(GC_interrupt_finalizers != 0, FALSE)
+      && GC_interrupt_finalizers < (unsigned)limit)
+    limit = (int)GC_interrupt_finalizers;
+  for (curr_fo = batch;; curr_fo = fo_next(curr_fo)) {
+    if (++count == limit || NULL == fo_next(curr_fo))
+      break;
+  }
+  SET_FINALIZE_NOW(fo_next(curr_fo));
+  GC_finalize_now_entries -= (size_t)count;
+  fo_set_next(curr_fo, 0);
+  UNLOCK();
+
+  /* The detached entries are reachable from the stack of this thread. */
+  for (curr_fo = batch; curr_fo != NULL;) {
+    struct finalizable_object *next_fo = fo_next(curr_fo);
+    ptr_t real_ptr = (ptr_t)curr_fo->fo_hidden_base; /*< revealed */
+
+    fo_set_next(curr_fo, 0);
+    curr_fo->fo_fn(real_ptr, curr_fo->fo_client_data);
+    curr_fo->fo_client_data = NULL;
+    curr_fo = next_fo;
+  }
+  if (bytes_freed_before != GC_bytes_freed) {
+    LOCK();
+    GC_finalizer_bytes_freed += (GC_bytes_freed - bytes_freed_before);
+    UNLOCK();
+  }
+  return count;
+}
+
+STATIC void
+GC_wake_finalizer_threads(void)
+{
+  (void)pthread_mutex_lock(&fnlz_threads_mutex);
+  (void)pthread_cond_broadcast(&fnlz_threads_cond);
+  (void)pthread_mutex_unlock(&fnlz_threads_mutex);
+}
+
+STATIC void *GC_CALLBACK
+GC_finalizer_thread_inner(struct GC_stack_base *sb, void *arg)
+{
+  UNUSED_ARG(arg);
+  /*
+   * The thread is already registered if `pthread_create()` is wrapped
+   * (e.g. by the linker), thus the result is ignored.
+   */
+  (void)GC_register_my_thread(sb);
+  for (;;) {
+    if (GC_invoke_finalizers_batch() > 0)
+      continue;
+#    ifdef ENABLE_DISCLAIM
+    if (DISCLAIM_BATCHES_PENDING() && GC_invoke_disclaim_batches() > 0)
+      continue;
+#    endif
+
+    (void)pthread_mutex_lock(&fnlz_threads_mutex);
+    while (!FINALIZATION_WORK_PENDING()) {
+      (void)pthread_cond_wait(&fnlz_threads_cond, &fnlz_threads_mutex);
+    }
+    (void)pthread_mutex_unlock(&fnlz_threads_mutex);
+  }
+  return NULL; /*< not reached */
+}
+
+STATIC void *
+GC_finalizer_thread(void *arg)
+{
+  return GC_call_with_stack_base(GC_finalizer_thread_inner, arg);
+}
+#  endif /* FINALIZER_THREADS_SUPPORTED */
+
+GC_API int GC_CALL
+GC_start_finalizer_threads(unsigned n)
+{
+#  ifdef FINALIZER_THREADS_SUPPORTED
+  pthread_attr_t attr;
+  unsigned i;
+
+  if (0 == n)
+    return GC_SUCCESS;
+  GC_init();
+  GC_allow_register_threads();
+  LOCK();
+  if (GC_finalizer_threads_cnt > 0) {
+    UNLOCK();
+    return GC_DUPLICATE;
+  }
+  /* Reserve the slot to prevent a concurrent start. */
+  GC_finalizer_threads_cnt = n;
+  UNLOCK();
+
+  if (pthread_attr_init(&attr) != 0)
+    ABORT("pthread_attr_init failed");
+  if (pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED) != 0)
+    ABORT("pthread_attr_setdetachstate failed");
+  for (i = 0; i < n; ++i) {
+    pthread_t new_thread;
+    int err = pthread_create(&new_thread, &attr, GC_finalizer_thread, NULL);
+
+    if (err != 0) {
+      WARN("Finalizer thread #%" WARN_PRIdPTR " creation failed\n",
+           (GC_signed_word)i);
+      break;
+    }
+  }
+  (void)pthread_attr_destroy(&attr);
+  LOCK();
+  GC_finalizer_threads_cnt = i;
+  UNLOCK();
+  if (0 == i)
+    return GC_NO_MEMORY;
+
+  GC_COND_LOG_PRINTF("Started %u finalizer threads\n", i);
+  /* Let the threads process the finalizers enqueued so far. */
+  GC_wake_finalizer_threads();
+  return GC_SUCCESS;
+#  else
+  UNUSED_ARG(n);
+  return GC_UNIMPLEMENTED;
+#  endif
+}
+
+GC_API unsigned GC_CALL
+GC_get_finalizer_threads(void)
+{
+#  ifdef FINALIZER_THREADS_SUPPORTED
+  unsigned n;
+
+  READER_LOCK();
+  n = GC_finalizer_threads_cnt;
+  READER_UNLOCK();
+  return n;
+#  else
+  return 0;
+#  endif
+}
+
+GC_API GC_word GC_CALL
+GC_get_finalizer_queue_depth(void)
+{
+  size_t value;
+
+  READER_LOCK();
+  value = GC_finalize_now_entries;
+  READER_UNLOCK();
+  return (GC_word)value;
+}
+
 static word last_finalizer_notification = 0;
 
 GC_INNER void
@@ -1424,7 +3159,7 @@ GC_notify_or_invoke_finalizers(void)
 
 #  if defined(THREADS) && !defined(KEEP_BACK_PTRS) && !defined(MAKE_BACK_GRAPH)
   /* Quick check (while unlocked) for an empty finalization queue. */
-  if (!GC_should_invoke_finalizers())
+  if (!FINALIZATION_WORK_PENDING())
     return;
 #  endif
   LOCK();
@@ -1465,14 +3200,24 @@ GC_notify_or_invoke_finalizers(void)
     if (GC_print_back_height) {
       GC_print_back_graph_stats();
     }
+    if (GC_retained_size_top > 0) {
+      GC_print_retained_sizes();
+    }
 #    endif
   }
 #  endif
-  if (NULL == GC_fnlz_roots.finalize_now) {
+  if (NULL == GC_fnlz_roots.finalize_now && !DISCLAIM_BATCHES_PENDING()) {
     UNLOCK();
     return;
   }
 
+#  ifdef FINALIZER_THREADS_SUPPORTED
+  if (GC_finalizer_threads_cnt > 0) {
+    UNLOCK();
+    GC_wake_finalizer_threads();
+    return;
+  }
+#  endif
   if (!GC_finalize_on_demand) {
     unsigned char *pnested;
 
@@ -1487,6 +3232,10 @@ GC_notify_or_invoke_finalizers(void)
     /* Skip `GC_invoke_finalizers()` if nested. */
     if (pnested != NULL) {
       (void)GC_invoke_finalizers();
+#  ifdef ENABLE_DISCLAIM
+      if (DISCLAIM_BATCHES_PENDING())
+        (void)GC_invoke_disclaim_batches();
+#  endif
       /* Reset since no more finalizers or interrupted. */
       *pnested = 0;
 #  ifndef THREADS
@@ -1524,20 +3273,16 @@ GC_notify_or_invoke_finalizers(void)
 GC_INNER void
 GC_print_finalization_stats(void)
 {
-  const struct finalizable_object *fo;
-  unsigned long ready = 0;
-
   GC_log_printf(
       "%lu finalization entries;"
       " %lu/%lu short/long disappearing links alive\n",
       (unsigned long)GC_fo_entries, (unsigned long)GC_dl_hashtbl.entries,
       (unsigned long)IF_LONG_REFS_PRESENT_ELSE(GC_ll_hashtbl.entries, 0));
 
-  for (fo = GC_fnlz_roots.finalize_now; fo != NULL; fo = fo_next(fo))
-    ++ready;
   GC_log_printf("%lu finalization-ready objects;"
                 " %ld/%ld short/long links cleared\n",
-                ready, (long)GC_old_dl_entries - (long)GC_dl_hashtbl.entries,
+                (unsigned long)GC_finalize_now_entries,
+                (long)GC_old_dl_entries - (long)GC_dl_hashtbl.entries,
                 (long)IF_LONG_REFS_PRESENT_ELSE(
                     GC_old_ll_entries - GC_ll_hashtbl.entries, 0));
 }
@@ -115,6 +115,172 @@ GC_register_disclaim_proc(int kind, GC_disclaim_proc proc,
   UNLOCK();
 }
 
+#  ifndef DISCLAIM_BATCH_SIZE
+/* The maximum number of objects passed to a batch disclaim procedure. */
+#    define DISCLAIM_BATCH_SIZE 256
+#  endif
+
+/*
+ * A chunk of the quarantined objects of a kind.  Allocated as
+ * an uncollectable object, thus the objects are kept (and marked
+ * from) until the batch procedure is invoked on them.
+ */
+struct disclaim_batch_s {
+  struct disclaim_batch_s *next;
+  GC_disclaim_batch_proc proc;
+  size_t n;
+  void *objs[DISCLAIM_BATCH_SIZE];
+};
+
+/*
+ * The registered batch procedures and the batches being filled, per
+ * kind; the filled batches; the spare ones.  Protected by the allocator
+ * lock.
+ */
+STATIC GC_disclaim_batch_proc GC_disclaim_batch_procs[MAXOBJKINDS] = { 0 };
+STATIC struct disclaim_batch_s *GC_curr_disclaim_batch[MAXOBJKINDS]
+    = { 0 };
+STATIC struct disclaim_batch_s *GC_ready_disclaim_batches = NULL;
+STATIC struct disclaim_batch_s *GC_spare_disclaim_batches = NULL;
+
+/* The number of objects not quarantined for the lack of spare batches. */
+STATIC word GC_disclaim_postponed_cnt = 0;
+
+GC_INNER word GC_disclaim_quarantined = 0;
+
+STATIC int GC_CALLBACK
+GC_quarantine_for_disclaim(void *obj)
+{
+  unsigned kind = HDR(obj)->hb_obj_kind;
+  struct disclaim_batch_s *b = GC_curr_disclaim_batch[kind];
+
+  GC_ASSERT(I_HOLD_LOCK());
+  GC_ASSERT(GC_disclaim_batch_procs[kind] != 0);
+  if (NULL == b || DISCLAIM_BATCH_SIZE == b->n) {
+    if (b != NULL) {
+      b->next = GC_ready_disclaim_batches;
+      GC_ready_disclaim_batches = b;
+    }
+    b = GC_spare_disclaim_batches;
+    GC_curr_disclaim_batch[kind] = b;
+    if (NULL == b) {
+      /* Just retain the object till the next collection. */
+      GC_disclaim_postponed_cnt++;
+      return 1;
+    }
+    GC_spare_disclaim_batches = b->next;
+    b->next = NULL;
+    b->proc = GC_disclaim_batch_procs[kind];
+  }
+  b->objs[b->n] = obj;
+  GC_dirty(&b->objs[b->n]);
+  b->n++;
+#  ifdef AO_HAVE_store
+  AO_store((volatile AO_t *)&GC_disclaim_quarantined,
+           (AO_t)(GC_disclaim_quarantined + 1));
+#  else
+  GC_disclaim_quarantined++;
+#  endif
+  /* The object is deallocated once `b->proc()` is invoked on it. */
+  return 1;
+}
+
+/* Allocate one more spare batch.  Returns `FALSE` on failure. */
+STATIC GC_bool
+GC_add_spare_disclaim_batch(void)
+{
+  struct disclaim_batch_s *b;
+
+  GC_ASSERT(I_HOLD_LOCK());
+  b = (struct disclaim_batch_s *)GC_INTERNAL_MALLOC(
+      sizeof(struct disclaim_batch_s), UNCOLLECTABLE);
+  if (EXPECT(NULL == b, FALSE))
+    return FALSE;
+  b->next = GC_spare_disclaim_batches;
+  GC_spare_disclaim_batches = b;
+  GC_dirty(b);
+  return TRUE;
+}
+
+GC_API void GC_CALL
+GC_register_disclaim_batch_proc(int kind, GC_disclaim_batch_proc proc,
+                                int mark_unconditionally)
+{
+  GC_ASSERT((unsigned)kind < MAXOBJKINDS);
+  GC_ASSERT(NONNULL_ARG_NOT_NULL(proc));
+  LOCK();
+  if (NULL == GC_spare_disclaim_batches)
+    (void)GC_add_spare_disclaim_batch();
+  GC_disclaim_batch_procs[kind] = proc;
+  GC_register_disclaim_proc_inner((unsigned)kind, GC_quarantine_for_disclaim,
+                                  (GC_bool)mark_unconditionally);
+  UNLOCK();
+}
+
+GC_API size_t GC_CALL
+GC_invoke_disclaim_batches(void)
+{
+  struct disclaim_batch_s *list;
+  struct disclaim_batch_s *b;
+  size_t count = 0;
+  unsigned kind;
+
+  GC_ASSERT(I_DONT_HOLD_LOCK());
+  LOCK();
+  list = GC_ready_disclaim_batches;
+  GC_ready_disclaim_batches = NULL;
+  for (kind = 0; kind < GC_n_kinds; kind++) {
+    b = GC_curr_disclaim_batch[kind];
+    if (b != NULL && b->n > 0) {
+      GC_curr_disclaim_batch[kind] = NULL;
+      b->next = list;
+      list = b;
+    }
+  }
+  GC_disclaim_quarantined = 0;
+  UNLOCK();
+  if (NULL == list)
+    return 0;
+
+  /* The detached batches are reachable from the stack of this thread. */
+  for (b = list; b != NULL; b = b->next) {
+    b->proc(b->objs, b->n);
+    count += b->n;
+  }
+
+  LOCK();
+  while (list != NULL) {
+    size_t i;
+
+    b = list;
+    list = b->next;
+    for (i = 0; i < b->n; i++) {
+      /* Note: the pointers refer to the object bases. */
+#  ifdef THREADS
+      GC_free_inner(b->objs[i]);
+#  else
+      GC_free(b->objs[i]);
+#  endif
+    }
+    BZERO(b->objs, b->n * sizeof(void *));
+    b->n = 0;
+    b->next = GC_spare_disclaim_batches;
+    GC_spare_disclaim_batches = b;
+  }
+  /*
+   * If not all the unreachable objects have fit the spare batches, then
+   * allocate more batches.
+   */
+  while (GC_disclaim_postponed_cnt > 0 && GC_add_spare_disclaim_batch()) {
+    GC_disclaim_postponed_cnt
+        = GC_disclaim_postponed_cnt > DISCLAIM_BATCH_SIZE
+              ? GC_disclaim_postponed_cnt - DISCLAIM_BATCH_SIZE
+              : 0;
+  }
+  UNLOCK();
+  return count;
+}
+
 GC_API GC_ATTR_MALLOC void *GC_CALL
 GC_finalized_malloc(size_t lb, const struct GC_finalizer_closure *fclos)
 {
@@ -127,8 +293,12 @@ GC_finalized_malloc(size_t lb, const struct GC_finalizer_closure *fclos)
 #  endif
   GC_ASSERT(NONNULL_ARG_NOT_NULL(fclos));
   GC_ASSERT((ADDR(fclos) & FINALIZER_CLOSURE_FLAG) == 0);
+#  ifdef THREAD_LOCAL_ALLOC
+  op = GC_malloc_finalized_kind(SIZET_SAT_ADD(lb, sizeof(ptr_t)));
+#  else
   op = GC_malloc_kind(SIZET_SAT_ADD(lb, sizeof(ptr_t)),
                       (int)GC_finalized_kind);
+#  endif
   if (EXPECT(NULL == op, FALSE))
     return NULL;
 
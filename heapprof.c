@@ -0,0 +1,549 @@
+/*
+ * THIS MATERIAL IS PROVIDED AS IS, WITH ABSOLUTELY NO WARRANTY EXPRESSED
+ * OR IMPLIED.  ANY USE IS AT YOUR OWN RISK.
+ *
+ * Permission is hereby granted to use or copy this program
+ * for any purpose, provided the above notices are retained on all copies.
+ * Permission to modify the code and to distribute modified code is granted,
+ * provided the above notices are retained, and a notice that the code was
+ * modified is included with the above copyright notice.
+ */
+
+#include "private/gc_priv.h"
+
+/*
+ * The sampling heap profiler.  The allocations are sampled at the
+ * points of a Poisson process over the allocated bytes counter, i.e.
+ * the distance between the consecutive sampling points is a random
+ * exponentially distributed number of bytes with the mean equal to
+ * the sample rate.  The check is done only on the allocator slow path
+ * (when a free list is refilled or a large object is allocated), thus
+ * the fast paths are not affected at all.  As a consequence, a sampling
+ * point is detected at the next slow path, which is taken by a client
+ * allocating objects of the same size and kind with the probability
+ * proportional to its allocation rate, so the estimations are still
+ * unbiased.  The stack trace of a sampled object is stored in a side
+ * table (along with the number of objects and bytes the sample stands
+ * for); the sampled objects found unreachable by a collection, or
+ * deallocated explicitly, are removed from the live heap profile.
+ */
+
+#if defined(GC_HAVE_BUILTIN_BACKTRACE) && !defined(REDIRECT_MALLOC)
+#  ifdef _MSC_VER
+EXTERN_C_BEGIN
+int backtrace(void *addresses[], int count);
+EXTERN_C_END
+#  else
+#    include <execinfo.h>
+#  endif
+#  define HEAP_PROFILE_USE_BACKTRACE
+#endif
+
+#ifndef HEAP_PROFILE_MAX_FRAMES
+#  define HEAP_PROFILE_MAX_FRAMES 32
+#endif
+
+#define HEAP_PROFILE_LOG_TRACE_BUCKETS 10
+
+/* The maximum number of the sampling points to iterate at once. */
+#define HEAP_PROFILE_MAX_POINTS 64
+
+struct heap_profile_trace_s {
+  struct heap_profile_trace_s *next;
+  word hash;
+  /* The estimated number of objects and bytes. */
+  word live_cnt;
+  word live_bytes;
+  word alloc_cnt;
+  word alloc_bytes;
+  size_t depth;
+  void *pcs[1]; /*< actually `depth` elements */
+};
+
+struct heap_profile_obj_s {
+  struct heap_profile_obj_s *next;
+  GC_hidden_pointer hidden_base;
+  struct heap_profile_trace_s *trace;
+  /* The number of objects and bytes the sample stands for. */
+  word cnt;
+  word bytes;
+};
+
+GC_INNER word GC_heap_profile_next_sample = GC_WORD_MAX;
+GC_INNER size_t GC_heap_profile_objs_cnt = 0;
+
+/* The mean number of bytes between the samples; zero means off. */
+STATIC word GC_heap_profile_rate = 0;
+
+/*
+ * The number of bytes allocated after the pending sampling point before
+ * the last collection (i.e. when `GC_bytes_allocd` was reset).
+ */
+STATIC word GC_heap_profile_lag = 0;
+
+STATIC GC_RAND_STATE_T GC_heap_profile_seed;
+
+/* The hash table of the distinct stack traces. */
+STATIC struct heap_profile_trace_s **GC_heap_profile_traces = NULL;
+
+/* The hash table of the sampled objects, and the free entries. */
+STATIC struct heap_profile_obj_s **GC_heap_profile_objs = NULL;
+STATIC unsigned GC_heap_profile_objs_log_size = 0;
+STATIC struct heap_profile_obj_s *GC_heap_profile_free_objs = NULL;
+
+#define HEAP_PROFILE_OBJS_SIZE() ((size_t)1 << GC_heap_profile_objs_log_size)
+
+#define HEAP_PROFILE_HASH(addr, log_size)                           \
+  ((size_t)((ADDR(addr) >> 3) ^ (ADDR(addr) >> (3 + (log_size)))) \
+   & (((size_t)1 << (log_size)) - 1))
+
+/*
+ * Return a random number of bytes to the next sampling point, i.e.
+ * the rate multiplied by `-ln(u)`, where `u` is uniform in (0, 1].
+ * The logarithm is approximated in fixed point arithmetic (within 1%).
+ */
+STATIC word
+GC_heap_profile_next_interval(void)
+{
+  word rate = GC_heap_profile_rate;
+  /* A value in range from 1 to 2**31 (inclusive). */
+  unsigned32 r = (unsigned32)GC_RAND_NEXT(&GC_heap_profile_seed) + 1;
+  unsigned k = 0;
+  unsigned32 f, ln_q8;
+  word res;
+
+  while ((r >> (k + 1)) != 0)
+    k++;
+  /* The fraction of `r / 2**k`, in Q16. */
+  f = (k >= 16 ? r >> (k - 16) : r << (16 - k)) & 0xffff;
+  /* `log2(1 + f)` is approximately `f + 0.3465 * f * (1 - f)`. */
+  f += (((f * (0x10000 - f)) >> 16) * 22708) >> 16;
+  /* `-ln(r / 2**31)`, in Q8. */
+  ln_q8 = (((((unsigned32)(31 - k) << 16) - f) >> 8) * 45426) >> 16;
+  if ((rate >> 8) > GC_WORD_MAX / (ln_q8 + 1))
+    return GC_WORD_MAX;
+  res = (rate >> 8) * ln_q8 + (((rate & 0xff) * ln_q8) >> 8);
+  return res > 0 ? res : 1;
+}
+
+STATIC void
+GC_heap_profile_schedule(word interval)
+{
+  GC_heap_profile_next_sample = GC_bytes_allocd < GC_WORD_MAX - interval
+                                    ? GC_bytes_allocd + interval
+                                    : GC_WORD_MAX - 1;
+}
+
+/* Return the entry of the given trace, adding it if needed. */
+STATIC struct heap_profile_trace_s *
+GC_heap_profile_get_trace(void **pcs, size_t depth)
+{
+  struct heap_profile_trace_s **bucket;
+  struct heap_profile_trace_s *t;
+  word hash = depth;
+  size_t i;
+
+  GC_ASSERT(I_HOLD_LOCK());
+  if (EXPECT(NULL == GC_heap_profile_traces, FALSE)) {
+    GC_heap_profile_traces = (struct heap_profile_trace_s **)GC_scratch_alloc(
+        sizeof(struct heap_profile_trace_s *)
+        << HEAP_PROFILE_LOG_TRACE_BUCKETS);
+    if (NULL == GC_heap_profile_traces)
+      return NULL;
+    BZERO(GC_heap_profile_traces, sizeof(struct heap_profile_trace_s *)
+                                      << HEAP_PROFILE_LOG_TRACE_BUCKETS);
+  }
+  for (i = 0; i < depth; i++) {
+    hash = (hash << 7) ^ (hash >> (CPP_WORDSZ - 7)) ^ ADDR(pcs[i]);
+  }
+  bucket = &GC_heap_profile_traces[(size_t)(hash ^ (hash >> 17))
+                                   & (((size_t)1
+                                       << HEAP_PROFILE_LOG_TRACE_BUCKETS)
+                                      - 1)];
+  for (t = *bucket; t != NULL; t = t->next) {
+    if (t->hash == hash && t->depth == depth
+        && (0 == depth || 0 == memcmp(t->pcs, pcs, depth * sizeof(void *))))
+      return t;
+  }
+
+  t = (struct heap_profile_trace_s *)GC_scratch_alloc(
+      sizeof(struct heap_profile_trace_s)
+      + (depth > 0 ? depth - 1 : 0) * sizeof(void *));
+  if (EXPECT(NULL == t, FALSE))
+    return NULL;
+  BZERO(t, sizeof(struct heap_profile_trace_s));
+  t->hash = hash;
+  t->depth = depth;
+  if (depth > 0)
+    BCOPY(pcs, t->pcs, depth * sizeof(void *));
+  t->next = *bucket;
+  *bucket = t;
+  return t;
+}
+
+/* Ensure there is a room in the table of sampled objects. */
+STATIC GC_bool
+GC_heap_profile_reserve_obj(void)
+{
+  struct heap_profile_obj_s **new_objs;
+  unsigned log_new_size;
+  size_t i;
+
+  GC_ASSERT(I_HOLD_LOCK());
+  if (GC_heap_profile_objs != NULL
+      && GC_heap_profile_objs_cnt < HEAP_PROFILE_OBJS_SIZE())
+    return TRUE;
+
+  log_new_size = NULL == GC_heap_profile_objs
+                     ? 8
+                     : GC_heap_profile_objs_log_size + 1;
+  new_objs = (struct heap_profile_obj_s **)GC_os_get_mem(
+      ROUNDUP_PAGESIZE_IF_MMAP(sizeof(struct heap_profile_obj_s *)
+                               << log_new_size));
+  if (EXPECT(NULL == new_objs, FALSE))
+    return GC_heap_profile_objs != NULL; /*< just the longer chains */
+  BZERO(new_objs, sizeof(struct heap_profile_obj_s *) << log_new_size);
+  if (GC_heap_profile_objs != NULL) {
+    for (i = 0; i < HEAP_PROFILE_OBJS_SIZE(); i++) {
+      struct heap_profile_obj_s *e = GC_heap_profile_objs[i];
+
+      while (e != NULL) {
+        struct heap_profile_obj_s *next = e->next;
+        size_t j = HEAP_PROFILE_HASH(GC_REVEAL_POINTER(e->hidden_base),
+                                     log_new_size);
+
+        e->next = new_objs[j];
+        new_objs[j] = e;
+        e = next;
+      }
+    }
+#ifndef GWW_VDB
+    GC_scratch_recycle_no_gww(
+        GC_heap_profile_objs,
+        ROUNDUP_PAGESIZE_IF_MMAP(sizeof(struct heap_profile_obj_s *)
+                                 << GC_heap_profile_objs_log_size));
+#endif
+  }
+  GC_heap_profile_objs = new_objs;
+  GC_heap_profile_objs_log_size = log_new_size;
+  return TRUE;
+}
+
+/* Remove the entry from the live profile and put it to the free list. */
+STATIC void
+GC_heap_profile_drop(struct heap_profile_obj_s **prev,
+                     struct heap_profile_obj_s *e)
+{
+  struct heap_profile_trace_s *t = e->trace;
+
+  t->live_cnt -= e->cnt;
+  t->live_bytes -= e->bytes;
+  *prev = e->next;
+  e->next = GC_heap_profile_free_objs;
+  GC_heap_profile_free_objs = e;
+  GC_heap_profile_objs_cnt--;
+}
+
+GC_INNER void
+GC_heap_profile_forget(ptr_t p)
+{
+  struct heap_profile_obj_s **prev;
+  struct heap_profile_obj_s *e;
+
+  GC_ASSERT(I_HOLD_LOCK());
+  if (0 == GC_heap_profile_objs_cnt)
+    return;
+  prev = &GC_heap_profile_objs[HEAP_PROFILE_HASH(
+      p, GC_heap_profile_objs_log_size)];
+  for (e = *prev; e != NULL; prev = &e->next, e = e->next) {
+    if (e->hidden_base == GC_HIDE_POINTER(p)) {
+      GC_heap_profile_drop(prev, e);
+      break;
+    }
+  }
+}
+
+GC_INNER void
+GC_heap_profile_sample(ptr_t p)
+{
+  void *pcs[HEAP_PROFILE_MAX_FRAMES + 1];
+  size_t depth = 0;
+  size_t sz = HDR(p)->hb_sz;
+  word passed, n_points, bytes, cnt;
+  struct heap_profile_trace_s *t;
+  struct heap_profile_obj_s *e;
+
+  GC_ASSERT(I_HOLD_LOCK());
+  GC_ASSERT(GC_base(p) == p);
+  if (EXPECT(0 == GC_heap_profile_rate, FALSE)) {
+    GC_heap_profile_next_sample = GC_WORD_MAX;
+    return;
+  }
+
+  /*
+   * The sample stands for all the sampling points passed since the
+   * previous check; the next point is counted from the last passed one
+   * (not from the current position) to keep the process unbiased.
+   */
+  passed = GC_heap_profile_lag + GC_bytes_allocd - GC_heap_profile_next_sample;
+  GC_heap_profile_lag = 0;
+  for (n_points = 1;; n_points++) {
+    word interval = GC_heap_profile_next_interval();
+
+    if (interval > passed) {
+      GC_heap_profile_schedule(interval - passed);
+      break;
+    }
+    passed -= interval;
+    if (EXPECT(n_points >= HEAP_PROFILE_MAX_POINTS, FALSE)) {
+      /* Too many points are passed, use the expected number. */
+      n_points += passed / GC_heap_profile_rate;
+      GC_heap_profile_schedule(GC_heap_profile_next_interval());
+      break;
+    }
+  }
+  bytes = n_points * GC_heap_profile_rate;
+  cnt = (bytes + (sz >> 1)) / sz;
+  if (0 == cnt)
+    cnt = 1;
+
+#ifdef HEAP_PROFILE_USE_BACKTRACE
+  {
+    /* Skip the frame of this function. */
+    int npcs = backtrace(pcs, HEAP_PROFILE_MAX_FRAMES + 1);
+
+    if (npcs > 1) {
+      depth = (size_t)npcs - 1;
+      BCOPY(&pcs[1], pcs, depth * sizeof(void *));
+    }
+  }
+#elif defined(SAVE_CALL_CHAIN)
+  {
+    struct callinfo info[NFRAMES];
+
+    GC_save_callers(info, 0);
+    for (; depth < NFRAMES && depth < HEAP_PROFILE_MAX_FRAMES; depth++) {
+      if (0 == info[depth].ci_pc)
+        break;
+      pcs[depth] = CAST_THRU_UINTPTR(void *, info[depth].ci_pc);
+    }
+  }
+#endif
+
+  t = GC_heap_profile_get_trace(pcs, depth);
+  if (EXPECT(NULL == t, FALSE) || !GC_heap_profile_reserve_obj())
+    return;
+  e = GC_heap_profile_free_objs;
+  if (e != NULL) {
+    GC_heap_profile_free_objs = e->next;
+  } else {
+    e = (struct heap_profile_obj_s *)GC_scratch_alloc(
+        sizeof(struct heap_profile_obj_s));
+    if (EXPECT(NULL == e, FALSE))
+      return;
+  }
+
+  /* The object might have been deallocated internally and reused. */
+  GC_heap_profile_forget(p);
+  t->alloc_cnt += cnt;
+  t->alloc_bytes += bytes;
+  t->live_cnt += cnt;
+  t->live_bytes += bytes;
+  e->hidden_base = GC_HIDE_POINTER(p);
+  e->trace = t;
+  e->cnt = cnt;
+  e->bytes = bytes;
+  {
+    size_t i = HEAP_PROFILE_HASH(p, GC_heap_profile_objs_log_size);
+
+    e->next = GC_heap_profile_objs[i];
+    GC_heap_profile_objs[i] = e;
+  }
+  GC_heap_profile_objs_cnt++;
+}
+
+GC_INNER void
+GC_heap_profile_reclaim(void)
+{
+  size_t i;
+
+  GC_ASSERT(I_HOLD_LOCK());
+  if (GC_heap_profile_objs_cnt > 0) {
+    for (i = 0; i < HEAP_PROFILE_OBJS_SIZE(); i++) {
+      struct heap_profile_obj_s **prev = &GC_heap_profile_objs[i];
+      struct heap_profile_obj_s *e;
+
+      while ((e = *prev) != NULL) {
+        if (!GC_is_marked(GC_REVEAL_POINTER(e->hidden_base))) {
+          GC_heap_profile_drop(prev, e);
+        } else {
+          prev = &e->next;
+        }
+      }
+    }
+  }
+
+  /* `GC_bytes_allocd` is reset at the end of the collection. */
+  if (GC_heap_profile_next_sample == GC_WORD_MAX) {
+    /* The profiler is off. */
+  } else if (GC_heap_profile_next_sample > GC_bytes_allocd) {
+    GC_heap_profile_next_sample -= GC_bytes_allocd;
+  } else {
+    /* The sampling point is passed but no object is sampled yet. */
+    GC_heap_profile_lag += GC_bytes_allocd - GC_heap_profile_next_sample;
+    GC_heap_profile_next_sample = 0;
+  }
+}
+
+GC_INNER void
+GC_heap_profile_set_rate_inner(word value)
+{
+  GC_heap_profile_rate = value;
+  GC_heap_profile_lag = 0;
+  if (0 == value) {
+    GC_heap_profile_next_sample = GC_WORD_MAX;
+  } else {
+    GC_heap_profile_schedule(GC_heap_profile_next_interval());
+  }
+}
+
+GC_API void GC_CALL
+GC_set_heap_profile_sample_rate(size_t value)
+{
+  LOCK();
+  GC_heap_profile_set_rate_inner((word)value);
+  UNLOCK();
+}
+
+GC_API size_t GC_CALL
+GC_get_heap_profile_sample_rate(void)
+{
+  word value;
+
+  READER_LOCK();
+  value = GC_heap_profile_rate;
+  READER_UNLOCK();
+  return (size_t)value;
+}
+
+GC_INNER char *
+GC_heap_profile_put_str(char *q, const char *s)
+{
+  size_t len = strlen(s);
+
+  BCOPY(s, q, len);
+  return q + len;
+}
+
+GC_INNER char *
+GC_heap_profile_put_num(char *q, word v, unsigned base)
+{
+  char digits[HEAP_PROFILE_NUM_LEN];
+  size_t len = 0;
+
+  do {
+    digits[len++] = "0123456789abcdef"[v % base];
+    v /= base;
+  } while (v != 0);
+  while (len > 0)
+    *q++ = digits[--len];
+  return q;
+}
+
+STATIC char *
+GC_heap_profile_put_counts(char *q, word live_cnt, word live_bytes,
+                           word alloc_cnt, word alloc_bytes)
+{
+  q = GC_heap_profile_put_num(q, live_cnt, 10);
+  q = GC_heap_profile_put_str(q, ": ");
+  q = GC_heap_profile_put_num(q, live_bytes, 10);
+  q = GC_heap_profile_put_str(q, " [");
+  q = GC_heap_profile_put_num(q, alloc_cnt, 10);
+  q = GC_heap_profile_put_str(q, ": ");
+  q = GC_heap_profile_put_num(q, alloc_bytes, 10);
+  return GC_heap_profile_put_str(q, "] @");
+}
+
+GC_API int GC_CALL
+GC_dump_heap_profile(GC_heap_profile_write_proc fn, void *client_data)
+{
+  static const char header[] = "heap profile: ";
+  static const char maps_header[] = "\nMAPPED_LIBRARIES:\n";
+  word live_cnt = 0, live_bytes = 0, alloc_cnt = 0, alloc_bytes = 0;
+  size_t bytes = sizeof(header) + 4 * HEAP_PROFILE_NUM_LEN + 32;
+  const char *maps = NULL;
+  char *buf, *q;
+  size_t i;
+  int res;
+
+  GC_ASSERT(NONNULL_ARG_NOT_NULL(fn));
+  LOCK();
+  if (GC_heap_profile_traces != NULL) {
+    for (i = 0; i < ((size_t)1 << HEAP_PROFILE_LOG_TRACE_BUCKETS); i++) {
+      const struct heap_profile_trace_s *t;
+
+      for (t = GC_heap_profile_traces[i]; t != NULL; t = t->next) {
+        live_cnt += t->live_cnt;
+        live_bytes += t->live_bytes;
+        alloc_cnt += t->alloc_cnt;
+        alloc_bytes += t->alloc_bytes;
+        bytes += 4 * HEAP_PROFILE_NUM_LEN + 16
+                 + t->depth * (HEAP_PROFILE_NUM_LEN + 3);
+      }
+    }
+  }
+#ifdef NEED_PROC_MAPS
+  {
+    IF_CANCEL(int cancel_state;)
+
+    DISABLE_CANCEL(cancel_state);
+    maps = GC_get_maps();
+    RESTORE_CANCEL(cancel_state);
+    bytes += sizeof(maps_header) + strlen(maps);
+  }
+#endif
+  bytes = ROUNDUP_PAGESIZE_IF_MMAP(bytes);
+  buf = (char *)GC_os_get_mem(bytes);
+  if (EXPECT(NULL == buf, FALSE)) {
+    UNLOCK();
+    return GC_NO_MEMORY;
+  }
+
+  /* The legacy `pprof` heap profile format. */
+  q = GC_heap_profile_put_str(buf, header);
+  q = GC_heap_profile_put_counts(q, live_cnt, live_bytes, alloc_cnt,
+                                 alloc_bytes);
+  q = GC_heap_profile_put_str(q, " heapprofile\n");
+  if (GC_heap_profile_traces != NULL) {
+    for (i = 0; i < ((size_t)1 << HEAP_PROFILE_LOG_TRACE_BUCKETS); i++) {
+      const struct heap_profile_trace_s *t;
+
+      for (t = GC_heap_profile_traces[i]; t != NULL; t = t->next) {
+        size_t j;
+
+        q = GC_heap_profile_put_counts(q, t->live_cnt, t->live_bytes,
+                                       t->alloc_cnt, t->alloc_bytes);
+        for (j = 0; j < t->depth; j++) {
+          q = GC_heap_profile_put_str(q, " 0x");
+          q = GC_heap_profile_put_num(q, ADDR(t->pcs[j]), 16);
+        }
+        *q++ = '\n';
+      }
+    }
+  }
+  if (maps != NULL) {
+    q = GC_heap_profile_put_str(q, maps_header);
+    q = GC_heap_profile_put_str(q, maps);
+  }
+  GC_ASSERT(ADDR_GE(buf + bytes, q));
+  UNLOCK();
+
+  res = fn(client_data, buf, (size_t)(q - buf));
+
+  LOCK();
+#ifndef GWW_VDB
+  GC_scratch_recycle_no_gww(buf, bytes);
+#endif
+  UNLOCK();
+  return res;
+}
@@ -0,0 +1,352 @@
+/*
+ * THIS MATERIAL IS PROVIDED AS IS, WITH ABSOLUTELY NO WARRANTY EXPRESSED
+ * OR IMPLIED.  ANY USE IS AT YOUR OWN RISK.
+ *
+ * Permission is hereby granted to use or copy this program
+ * for any purpose, provided the above notices are retained on all copies.
+ * Permission to modify the code and to distribute modified code is granted,
+ * provided the above notices are retained, and a notice that the code was
+ * modified is included with the above copyright notice.
+ */
+
+#include "private/gc_priv.h"
+
+/*
+ * The binary heap snapshot.  The snapshot is a sequence of records, each
+ * one starts with two 32-bit values: the record type and the length of
+ * the payload (in bytes) which follows.  All the values are written in
+ * the native byte order, the words (addresses and sizes) are of the
+ * pointer size.  The record types and their payload are:
+ *   - `SNAPSHOT_HEADER` (the first record): 32-bit values of the byte
+ *     order mark (`0x01020304`), the format version, the size of a word,
+ *     `HBLKSIZE`, `GC_GRANULE_BYTES` and the flags passed to
+ *     `GC_dump_heap_snapshot()`, followed by the words of the collection
+ *     number and of the heap size;
+ *   - `SNAPSHOT_BLOCK` (one per heap block holding objects, a large
+ *     object occupies one record): the words of the block address and of
+ *     the object size, 32-bit values of the object kind, the block flags,
+ *     the number of objects in the block and the number of the marked
+ *     ones, followed by the mark bits, one bit per object (the least
+ *     significant bit of the first byte is for the first object);
+ *   - `SNAPSHOT_EDGES` (only with `GC_HEAP_SNAPSHOT_EDGES`, follows the
+ *     record of the block): the word of a marked object address followed
+ *     by the words of the addresses of the marked objects it (potentially)
+ *     refers to; there could be several records for the same object;
+ *   - `SNAPSHOT_ROOTS` (only with `GC_HEAP_SNAPSHOT_EDGES`): the words of
+ *     the addresses of the marked objects referred from the static data
+ *     roots;
+ *   - `SNAPSHOT_END` (the last record, empty): marks the snapshot as
+ *     complete.
+ * The marked objects are the ones found reachable by the recent garbage
+ * collection.  The pointers are recognized conservatively (as done by
+ * the marker); the pointer-free objects are not scanned.  The format is
+ * read by `tools/snapstat.c` file.
+ */
+
+#define SNAPSHOT_HEADER 1
+#define SNAPSHOT_BLOCK 2
+#define SNAPSHOT_EDGES 3
+#define SNAPSHOT_ROOTS 4
+#define SNAPSHOT_END 5
+
+#define SNAPSHOT_VERSION 1
+
+#if defined(UNIX_LIKE) || defined(CYGWIN32)
+
+#  include <errno.h>
+#  include <unistd.h>
+
+#  if !defined(HAVE_NO_FORK) && !defined(NO_HEAP_SNAPSHOT_FORK) \
+      && (defined(CAN_HANDLE_FORK) || !defined(THREADS))
+#    include <sys/types.h>
+#    include <sys/wait.h>
+#    define HEAP_SNAPSHOT_USE_FORK
+#  endif
+
+/* The size of the output buffer, i.e. of a single `write()` call. */
+#  ifndef HEAP_SNAPSHOT_BUF_SIZE
+#    define HEAP_SNAPSHOT_BUF_SIZE ((size_t)1 << 20)
+#  endif
+
+/* The maximum number of the references in a single record. */
+#  define SNAPSHOT_MAX_REFS 256
+
+struct snapshot_writer_s {
+  int fd;
+  unsigned flags;
+  int err; /*< `GC_SUCCESS` or -1 (on a write failure) */
+  size_t pos;
+  char *buf;
+};
+
+STATIC void
+GC_snapshot_flush(struct snapshot_writer_s *w)
+{
+  size_t done = 0;
+
+  while (w->err == GC_SUCCESS && done < w->pos) {
+    ssize_t res = write(w->fd, w->buf + done, w->pos - done);
+
+    if (res < 0) {
+      if (EINTR == errno || EAGAIN == errno)
+        continue;
+      w->err = -1;
+    } else {
+      done += (size_t)res;
+    }
+  }
+  w->pos = 0;
+}
+
+STATIC void
+GC_snapshot_put(struct snapshot_writer_s *w, const void *p, size_t len)
+{
+  while (len > 0) {
+    size_t n = HEAP_SNAPSHOT_BUF_SIZE - w->pos;
+
+    if (0 == n) {
+      GC_snapshot_flush(w);
+      continue;
+    }
+    if (n > len)
+      n = len;
+    BCOPY(p, w->buf + w->pos, n);
+    w->pos += n;
+    p = (const char *)p + n;
+    len -= n;
+  }
+}
+
+STATIC void
+GC_snapshot_put_u32(struct snapshot_writer_s *w, unsigned32 v)
+{
+  GC_snapshot_put(w, &v, sizeof(v));
+}
+
+STATIC void
+GC_snapshot_put_word(struct snapshot_writer_s *w, word v)
+{
+  GC_snapshot_put(w, &v, sizeof(v));
+}
+
+STATIC void
+GC_snapshot_begin_record(struct snapshot_writer_s *w, unsigned type,
+                         size_t len)
+{
+  GC_snapshot_put_u32(w, (unsigned32)type);
+  GC_snapshot_put_u32(w, (unsigned32)len);
+}
+
+STATIC void
+GC_snapshot_put_refs_record(struct snapshot_writer_s *w, ptr_t src,
+                            const word *refs, size_t n)
+{
+  if (src != NULL) {
+    GC_snapshot_begin_record(w, SNAPSHOT_EDGES, (n + 1) * sizeof(word));
+    GC_snapshot_put_word(w, ADDR(src));
+  } else {
+    GC_snapshot_begin_record(w, SNAPSHOT_ROOTS, n * sizeof(word));
+  }
+  GC_snapshot_put(w, refs, n * sizeof(word));
+}
+
+/*
+ * Write the references to the marked objects found in `[p, lim)` range.
+ * `src` is the referring object, or `NULL` for a root.
+ */
+STATIC void
+GC_snapshot_put_refs(struct snapshot_writer_s *w, ptr_t src, ptr_t p,
+                     ptr_t lim)
+{
+  word refs[SNAPSHOT_MAX_REFS];
+  size_t n = 0;
+
+  GC_ASSERT(I_HOLD_LOCK());
+  for (; ADDR(p) + sizeof(ptr_t) <= ADDR(lim); p += sizeof(ptr_t)) {
+    ptr_t q = *(ptr_t *)p;
+    ptr_t base;
+
+    if (ADDR(q) < HBLKSIZE || NULL == HDR(q))
+      continue;
+    base = (ptr_t)GC_base(q);
+    if (NULL == base || !GC_is_marked(base))
+      continue;
+    refs[n++] = ADDR(base);
+    if (SNAPSHOT_MAX_REFS == n) {
+      GC_snapshot_put_refs_record(w, src, refs, n);
+      n = 0;
+    }
+  }
+  if (n > 0)
+    GC_snapshot_put_refs_record(w, src, refs, n);
+}
+
+STATIC void GC_CALLBACK
+GC_snapshot_block(struct hblk *h, void *client_data)
+{
+  struct snapshot_writer_s *w = (struct snapshot_writer_s *)client_data;
+  const hdr *hhdr = HDR(h);
+  size_t sz = hhdr->hb_sz;
+  size_t n_objs = sz > MAXOBJBYTES ? 1 : HBLK_OBJS(sz);
+  unsigned char bits[(HBLKSIZE / GC_GRANULE_BYTES + 7) / 8];
+  unsigned n_marks = 0;
+  size_t i, bit_no;
+
+  BZERO(bits, sizeof(bits));
+  for (i = 0, bit_no = 0; i < n_objs; i++, bit_no += MARK_BIT_OFFSET(sz)) {
+    if (mark_bit_from_hdr(hhdr, bit_no)) {
+      bits[i >> 3] |= (unsigned char)(1U << (i & 7));
+      n_marks++;
+    }
+  }
+  GC_snapshot_begin_record(w, SNAPSHOT_BLOCK,
+                           2 * sizeof(word) + 4 * sizeof(unsigned32)
+                               + (n_objs + 7) / 8);
+  GC_snapshot_put_word(w, ADDR(h));
+  GC_snapshot_put_word(w, (word)sz);
+  GC_snapshot_put_u32(w, (unsigned32)hhdr->hb_obj_kind);
+  GC_snapshot_put_u32(w, (unsigned32)hhdr->hb_flags);
+  GC_snapshot_put_u32(w, (unsigned32)n_objs);
+  GC_snapshot_put_u32(w, (unsigned32)n_marks);
+  GC_snapshot_put(w, bits, (n_objs + 7) / 8);
+
+  if ((w->flags & GC_HEAP_SNAPSHOT_EDGES) != 0 && n_marks > 0
+      && !IS_PTRFREE(hhdr)) {
+    word descr = hhdr->hb_descr;
+    size_t lim_ofs = sz;
+    ptr_t p = h->hb_body;
+
+    /* Only the length-based descriptor is trusted; else scan all. */
+    if ((descr & GC_DS_TAGS) == GC_DS_LENGTH && descr < sz)
+      lim_ofs = (size_t)descr;
+    for (i = 0; i < n_objs; i++, p += sz) {
+      if ((bits[i >> 3] & (1U << (i & 7))) != 0)
+        GC_snapshot_put_refs(w, p, p, p + lim_ofs);
+    }
+  }
+}
+
+STATIC void
+GC_snapshot_write(struct snapshot_writer_s *w)
+{
+  GC_ASSERT(I_HOLD_LOCK());
+  GC_snapshot_begin_record(w, SNAPSHOT_HEADER,
+                           6 * sizeof(unsigned32) + 2 * sizeof(word));
+  GC_snapshot_put_u32(w, 0x01020304);
+  GC_snapshot_put_u32(w, SNAPSHOT_VERSION);
+  GC_snapshot_put_u32(w, (unsigned32)sizeof(word));
+  GC_snapshot_put_u32(w, HBLKSIZE);
+  GC_snapshot_put_u32(w, GC_GRANULE_BYTES);
+  GC_snapshot_put_u32(w, (unsigned32)w->flags);
+  GC_snapshot_put_word(w, GC_gc_no);
+  GC_snapshot_put_word(w, GC_heapsize);
+
+  GC_apply_to_all_blocks(GC_snapshot_block, w);
+  if ((w->flags & GC_HEAP_SNAPSHOT_EDGES) != 0) {
+    size_t i;
+
+    for (i = 0; i < n_root_sets; i++) {
+      ptr_t lo = GC_static_roots[i].r_start;
+      ptr_t hi = GC_static_roots[i].r_end;
+
+      /* Skip the excluded ranges (as the marker does). */
+      while (ADDR_LT(lo, hi)) {
+        struct exclusion *next = GC_next_exclusion(lo);
+
+        if (NULL == next || ADDR_GE(next->e_start, hi)) {
+          GC_snapshot_put_refs(w, NULL, lo, hi);
+          break;
+        }
+        GC_snapshot_put_refs(w, NULL, lo, next->e_start);
+        lo = next->e_end;
+      }
+    }
+  }
+  GC_snapshot_begin_record(w, SNAPSHOT_END, 0);
+  GC_snapshot_flush(w);
+}
+
+GC_API int GC_CALL
+GC_dump_heap_snapshot(int fd, unsigned flags)
+{
+  struct snapshot_writer_s w;
+  size_t buf_sz = ROUNDUP_PAGESIZE_IF_MMAP(HEAP_SNAPSHOT_BUF_SIZE);
+  int result = -1;
+  IF_CANCEL(int cancel_state;)
+
+  if (!EXPECT(GC_is_initialized, TRUE))
+    GC_init();
+  w.fd = fd;
+  w.flags = flags;
+  w.err = GC_SUCCESS;
+  w.pos = 0;
+  LOCK();
+  w.buf = (char *)GC_os_get_mem(buf_sz);
+  UNLOCK();
+  if (EXPECT(NULL == w.buf, FALSE))
+    return GC_NO_MEMORY;
+
+  DISABLE_CANCEL(cancel_state);
+#  ifdef HEAP_SNAPSHOT_USE_FORK
+  if ((flags & GC_HEAP_SNAPSHOT_NO_FORK) == 0) {
+    pid_t pid;
+
+    /*
+     * The child process gets a copy of the heap taken at the moment of
+     * `fork()`, thus the world is stopped only for the duration of the
+     * latter.
+     */
+    GC_atfork_prepare();
+    pid = fork();
+    if (0 == pid) {
+      GC_atfork_child();
+      LOCK();
+      GC_snapshot_write(&w);
+      UNLOCK();
+      _exit(w.err == GC_SUCCESS ? 0 : 1);
+    }
+    GC_atfork_parent();
+    if (pid != -1) {
+      int status;
+
+      while (waitpid(pid, &status, 0) == -1) {
+        if (errno != EINTR) {
+          status = -1;
+          break;
+        }
+      }
+      if (status != -1 && WIFEXITED(status) && 0 == WEXITSTATUS(status))
+        result = GC_SUCCESS;
+      goto done;
+    }
+    /* `fork()` failed, write the snapshot in this process. */
+  }
+#  endif
+  LOCK();
+  GC_snapshot_write(&w);
+  UNLOCK();
+  result = w.err;
+
+#  ifdef HEAP_SNAPSHOT_USE_FORK
+done:
+#  endif
+  RESTORE_CANCEL(cancel_state);
+  LOCK();
+#  ifndef GWW_VDB
+  GC_scratch_recycle_no_gww(w.buf, buf_sz);
+#  endif
+  UNLOCK();
+  return result;
+}
+
+#else
+
+GC_API int GC_CALL
+GC_dump_heap_snapshot(int fd, unsigned flags)
+{
+  UNUSED_ARG(fd);
+  UNUSED_ARG(flags);
+  return GC_UNIMPLEMENTED;
+}
+
+#endif
@@ -270,6 +270,32 @@ GC_API GC_ATTR_DEPRECATED GC_finalizer_notifier_proc GC_finalizer_notifier;
 GC_API void GC_CALL GC_set_finalizer_notifier(GC_finalizer_notifier_proc);
 GC_API GC_finalizer_notifier_proc GC_CALL GC_get_finalizer_notifier(void);
 
+/**
+ * Start `n` finalizer worker threads (owned by the collector) which
+ * run the ready finalizers concurrently with the client threads.
+ * Each worker takes a batch of ready finalizers from the finalization
+ * queue at once (acquiring the allocator lock only to detach the batch)
+ * and runs them without holding the lock.  Once started, the workers
+ * are woken up instead of invoking the finalizers implicitly during
+ * allocations or calling `GC_finalizer_notifier` (but a client still
+ * may call `GC_invoke_finalizers()` explicitly).  The threads could not
+ * be stopped.  Returns `GC_SUCCESS` on success, `GC_DUPLICATE` if the
+ * threads have been already started, `GC_NO_MEMORY` if no thread could
+ * be created, `GC_UNIMPLEMENTED` if not supported on the platform
+ * (currently only pthreads-based targets are supported).  Does nothing
+ * if `n` is zero.  `GC_get_finalizer_threads()` returns the number of
+ * the started threads.
+ */
+GC_API int GC_CALL GC_start_finalizer_threads(unsigned /* `n` */);
+GC_API unsigned GC_CALL GC_get_finalizer_threads(void);
+
+/**
+ * Return the number of objects ready to be finalized, i.e. the ones
+ * whose finalizers have not been run (or taken by a finalizer thread)
+ * yet.  Acquires the allocator lock in the reader mode.
+ */
+GC_API GC_word GC_CALL GC_get_finalizer_queue_depth(void);
+
 /**
  * The functions called to report pointer checking errors.  Called without
  * the allocator lock held.  The default behavior is to fail with the
@@ -642,6 +668,30 @@ GC_API GC_ATTR_MALLOC char *GC_CALL GC_strndup(const char *, size_t)
 GC_API GC_ATTR_MALLOC GC_ATTR_ALLOC_SIZE(1) void *GC_CALL
     GC_malloc_uncollectable(size_t /* `size_in_bytes` */);
 
+/**
+ * Lifetime hints for `GC_malloc_hinted()` and `GC_malloc_atomic_hinted()`.
+ * Objects allocated with `GC_HINT_SHORT_LIVED` (e.g. the request-scoped
+ * ones) are placed in heap blocks separate from the ones used by
+ * `GC_malloc()` and `GC_malloc_atomic()`, thus a block of transient
+ * objects tends to become entirely free at once instead of staying
+ * partially occupied by a few long-lived objects.  `GC_HINT_NONE` and
+ * `GC_HINT_LONG_LIVED` objects are allocated the same way as by
+ * `GC_malloc()` (or `GC_malloc_atomic()`, respectively); any other hint
+ * value is treated as `GC_HINT_NONE`.  A hint is only a placement
+ * advice: it does not affect the object reachability, and the object
+ * could be passed to `GC_free()` and `GC_realloc()` as usual.
+ * The thread-local free lists (if any) are maintained per hint class.
+ * The functions are guaranteed never to return `NULL` unless
+ * `GC_oom_fn()` returns `NULL`.
+ */
+#define GC_HINT_NONE 0
+#define GC_HINT_SHORT_LIVED 1
+#define GC_HINT_LONG_LIVED 2
+GC_API GC_ATTR_MALLOC GC_ATTR_ALLOC_SIZE(1) void *GC_CALL
+    GC_malloc_hinted(size_t /* `size_in_bytes` */, int /* `hint` */);
+GC_API GC_ATTR_MALLOC GC_ATTR_ALLOC_SIZE(1) void *GC_CALL
+    GC_malloc_atomic_hinted(size_t /* `size_in_bytes` */, int /* `hint` */);
+
 /**
  * The allocation function which guarantees the requested alignment of
  * the allocated memory object.  The `align` argument should be nonzero
@@ -1112,6 +1162,115 @@ GC_API size_t GC_CALL GC_get_prof_stats_unsafe(struct GC_prof_stats_s *,
  */
 GC_API size_t GC_CALL GC_get_size_map_at(int i);
 
+/**
+ * Structure used to query the statistics of a size class of an object
+ * kind (see `GC_get_size_class_stats`).
+ */
+struct GC_size_class_stats_s {
+  /**
+   * Number of heap blocks (of `HBLKSIZE` bytes) currently holding the
+   * objects of the size class.
+   */
+  GC_word blocks_in_use;
+
+  /**
+   * Total size of the objects of the size class found reachable by the
+   * recent garbage collection.
+   */
+  GC_word live_bytes;
+
+  /**
+   * Number of objects on the free list of the size class (thread-local
+   * free lists are not counted).
+   */
+  GC_word free_objs;
+
+  /**
+   * Approximate number of bytes allocated in the size class since the
+   * recent collection (less the bytes deallocated explicitly).
+   */
+  GC_word allocd_bytes_since_gc;
+
+  /**
+   * Fraction of the space of the heap blocks of the size class not
+   * occupied by the reachable objects after the recent collection,
+   * in units of 1/1000.
+   */
+  GC_word fragmentation_permille;
+};
+
+/**
+ * Get the statistics per size class of each object kind.  `stats` should
+ * point to an array of `n_kinds * n_granules` elements; the element at
+ * index `k * n_granules + lg` receives the statistics of the objects of
+ * kind `k` whose size is `lg` granules (i.e. the same indexing as that of
+ * the free lists of a kind and of `GC_size_map`).  The element with `lg`
+ * of zero accumulates all large objects of the kind.  The kinds and size
+ * classes outside the array bounds are skipped, and the entries of
+ * nonexistent kinds are zeroed.  The live bytes and fragmentation are
+ * gathered during the sweep; until the next collection after the first
+ * call, they are estimated from the current mark bits.  Acquires the
+ * allocator lock.  Returns the number of the size classes (including the
+ * large one) per kind; thus passing `NULL` and zeros could be used to
+ * find out the needed value of `n_granules`.
+ */
+GC_API size_t GC_CALL
+GC_get_size_class_stats(struct GC_size_class_stats_s * /* `stats` */,
+                        unsigned /* `n_kinds` */, size_t /* `n_granules` */);
+
+/** The number of the allocation tags (see `GC_set_allocation_tag`). */
+#define GC_MAX_ALLOC_TAGS 1024
+
+/**
+ * Set the allocation tag of the current thread, e.g. the identifier of
+ * the tenant on whose behalf the thread is running.  The heap blocks
+ * the thread obtains afterwards for its allocations are attributed to
+ * the tag (see `GC_get_tag_stats`); thus, the objects allocated from
+ * a partially free block (or from the free list) are accounted to the
+ * tag of that block.  The tag should be less than `GC_MAX_ALLOC_TAGS`,
+ * otherwise zero (the default) is used.  Has no effect if the thread
+ * is not registered.  The setter and the getter do not acquire the
+ * allocator lock if the thread-local allocation is supported.
+ */
+GC_API void GC_CALL GC_set_allocation_tag(unsigned);
+GC_API unsigned GC_CALL GC_get_allocation_tag(void);
+
+/**
+ * Structure used to query the heap usage of an allocation tag (see
+ * `GC_get_tag_stats`).
+ */
+struct GC_tag_stats_s {
+  /** Total size of the heap blocks currently attributed to the tag. */
+  GC_word heap_bytes;
+
+  /**
+   * Total size and number of the objects in the blocks of the tag found
+   * reachable by the recent garbage collection.
+   */
+  GC_word live_bytes;
+  GC_word live_objs;
+
+  /**
+   * Approximate number of bytes allocated in the blocks of the tag since
+   * the recent collection (less the bytes deallocated explicitly).
+   */
+  GC_word allocd_bytes_since_gc;
+};
+
+/**
+ * Get the heap usage per allocation tag.  `stats` should point to an
+ * array of `n_tags` elements; the element at index `t` receives the
+ * statistics of tag `t`.  The sum of `live_bytes` and
+ * `allocd_bytes_since_gc` is the estimation of the current usage of
+ * a tag, which could be checked against a quota of the tenant.  The live
+ * bytes are gathered during the sweep; until the next collection after
+ * the first call, they are estimated from the current mark bits.
+ * Acquires the allocator lock.  Returns `GC_MAX_ALLOC_TAGS`, or zero if
+ * the allocation tags are not supported by the collector build.
+ */
+GC_API unsigned GC_CALL GC_get_tag_stats(struct GC_tag_stats_s *,
+                                         unsigned /* `n_tags` */);
+
 /**
  * Return the total memory use (in bytes) by all allocated blocks.
  * The result is equal to `GC_get_heap_size() - GC_get_free_bytes()`.
@@ -1119,6 +1278,131 @@ GC_API size_t GC_CALL GC_get_size_map_at(int i);
  */
 GC_API GC_word GC_CALL GC_get_memory_use(void);
 
+/**
+ * Set the mean number of allocated bytes between the samples taken by
+ * the built-in heap profiler.  Zero (the default) turns the profiler
+ * off.  If on, the collector records the stack traces of the sampled
+ * allocations (the distance between the sampled objects is randomized
+ * following the Poisson process), and tracks the sampled objects until
+ * they are found unreachable (or deallocated explicitly).  Only the
+ * allocator slow path is affected.  The initial value could be also
+ * set by `GC_HEAP_PROFILE_SAMPLE_RATE` environment variable.  Both the
+ * setter and the getter acquire the allocator lock (in the reader mode
+ * in case of the getter).
+ */
+GC_API void GC_CALL GC_set_heap_profile_sample_rate(size_t);
+GC_API size_t GC_CALL GC_get_heap_profile_sample_rate(void);
+
+/**
+ * The type of the output procedure of `GC_dump_heap_profile`.  Should
+ * write `len` bytes of `buf` and return zero on success.
+ */
+typedef int(GC_CALLBACK *GC_heap_profile_write_proc)(
+    void * /* `client_data` */, const char * /* `buf` */, size_t /* `len` */);
+
+/**
+ * Write the heap profile collected so far in the legacy `pprof` heap
+ * profile format.  For every distinct stack trace, both the live heap
+ * (the sampled objects not found unreachable yet) and the cumulative
+ * allocation estimated number of objects and bytes are reported, so
+ * both `inuse_space` and `alloc_space` views are available in `pprof`.
+ * The values are already scaled according to the sample rate.  On Linux,
+ * the memory map needed for symbolization is appended.  The output
+ * procedure is called once (with the whole profile) and not holding
+ * the allocator lock.  Returns `GC_NO_MEMORY` on the memory allocation
+ * failure, otherwise the value returned by the output procedure.
+ */
+GC_API int GC_CALL GC_dump_heap_profile(GC_heap_profile_write_proc,
+                                        void * /* `client_data` */)
+    GC_ATTR_NONNULL(1);
+
+/**
+ * Flags for `GC_dump_heap_snapshot`.  `GC_HEAP_SNAPSHOT_EDGES` means
+ * the references between the reachable objects (and from the static data
+ * roots to them) are written too.  `GC_HEAP_SNAPSHOT_NO_FORK` means the
+ * snapshot is written by the calling process while holding the allocator
+ * lock.
+ */
+#define GC_HEAP_SNAPSHOT_EDGES 1
+#define GC_HEAP_SNAPSHOT_NO_FORK 2
+
+/**
+ * Write a compact binary snapshot of the heap to the file descriptor
+ * `fd`: the heap block headers (address, kind and object size) along with
+ * the mark bits of the objects, and optionally the references between the
+ * marked objects (as found by the conservative scanner).  The format is
+ * described in `heapsnap.c` file; `tools/snapstat.c` computes per-kind
+ * histograms and retained sizes from a snapshot.  The marked objects are
+ * those found reachable by the recent collection, so the client might
+ * want to call `GC_gcollect()` just before.  Unless
+ * `GC_HEAP_SNAPSHOT_NO_FORK` is passed, the snapshot is written (using
+ * large sequential writes) by a forked child process, if supported, thus
+ * the allocator lock is held only for the duration of `fork()`.
+ * Returns `GC_SUCCESS`, `GC_NO_MEMORY`, `GC_UNIMPLEMENTED` (if not
+ * supported on the platform) or -1 on a write failure.
+ */
+GC_API int GC_CALL GC_dump_heap_snapshot(int /* `fd` */,
+                                         unsigned /* `flags` */);
+
+/**
+ * Set the capacity (the number of events, rounded up to a power of two)
+ * of the per-thread trace buffers.  Nonzero value turns on recording of
+ * the collection phases (including the world stop and restart), the
+ * allocation slow path, the heap growth, unmapping and the marker helper
+ * activity, each event along with its timestamp, to a lock-free ring
+ * buffer of the current thread (up to 64 threads are recorded).  The
+ * buffers are allocated on the first call with nonzero value, the later
+ * calls just turn the recording on or off (i.e. the capacity cannot be
+ * changed).  Zero (the default) turns the recording off.  The initial
+ * value could be also set by `GC_TRACE_BUFFER_SIZE` environment variable.
+ * Both the setter and the getter acquire the allocator lock (in the
+ * reader mode in case of the getter); the getter returns zero if the
+ * recording is off.
+ */
+GC_API void GC_CALL GC_set_trace_buffer_size(size_t);
+GC_API size_t GC_CALL GC_get_trace_buffer_size(void);
+
+/**
+ * Write the events kept in the trace buffers in Chrome trace-event JSON
+ * format (loadable by `perfetto` and `chrome://tracing`).  The phases
+ * are written as the duration events, the rest as the instant ones.  The
+ * timestamps (in microseconds) are taken from the monotonic clock (where
+ * available) used by the tracing tools on the platform, so the events
+ * could be lined up with the application trace.  The recording is not
+ * paused, the oldest events of a buffer are overwritten when the buffer
+ * is full.  The output procedure is called once (with the whole output)
+ * and not holding the allocator lock.  Returns `GC_NO_MEMORY` on the
+ * memory allocation failure, `GC_UNIMPLEMENTED` if the trace buffer is
+ * not supported by the collector build, otherwise the value returned by
+ * the output procedure.
+ */
+GC_API int GC_CALL GC_dump_trace_events(GC_heap_profile_write_proc,
+                                        void * /* `client_data` */)
+    GC_ATTR_NONNULL(1);
+
+/**
+ * Start recording the client allocations (the requested size, the kind,
+ * the thread and the timestamp of each one), the explicit deallocations,
+ * the pointer stores done by `GC_ptr_store_and_dirty` and the collections
+ * to the file descriptor `fd` in a compact binary format (described in
+ * `allocrec.c` file).  The recording could be replayed by
+ * `tests/allocreplay.c` program, e.g. to compare the heap growth policies
+ * on a realistic workload.  While the recording is on, all the
+ * allocations take the slow path (holding the allocator lock).  The
+ * recording could also be started by `GC_ALLOC_RECORD_FILE` environment
+ * variable.  Returns `GC_SUCCESS`, `GC_DUPLICATE` (if the recording is
+ * already started) or `GC_UNIMPLEMENTED` (if not supported on the
+ * platform).
+ */
+GC_API int GC_CALL GC_start_alloc_recording(int /* `fd` */);
+
+/**
+ * Stop the allocation recording, flush the recorded data to the file.
+ * The file descriptor is not closed.  Returns `GC_SUCCESS`, `GC_NOT_FOUND`
+ * (if the recording is not started) or -1 on a write failure.
+ */
+GC_API int GC_CALL GC_stop_alloc_recording(void);
+
 /**
  * Disable garbage collection.  Even `GC_gcollect()` calls will be
  * ineffective.
@@ -1147,7 +1431,9 @@ GC_API void GC_CALL GC_enable(void);
  * VDB mode should be used only if the client has the appropriate
  * `GC_END_STUBBORN_CHANGE()` and `GC_reachable_here()` (or,
  * alternatively, `GC_PTR_STORE_AND_DIRTY()`) calls (to ensure proper
- * write barriers).  The setter and the getter are not synchronized.
+ * write barriers).  `GC_CARD_DIRTY()` and `GC_PTR_STORE_AND_DIRTY_INLINE()`
+ * are the inline (cheaper) alternatives for the latter.  The setter and
+ * the getter are not synchronized.
  */
 GC_API void GC_CALL GC_set_manual_vdb_allowed(int);
 GC_API int GC_CALL GC_get_manual_vdb_allowed(void);
@@ -1337,6 +1623,22 @@ GC_API /* `realloc` attribute */ GC_ATTR_ALLOC_SIZE(2) void *GC_CALL
     GC_debug_realloc_replacement(void * /* `obj` */,
                                  size_t /* `size_in_bytes` */);
 
+/**
+ * Set the number of the collections over which the check of the objects
+ * allocated by the debugging allocator (for the overwritten debug
+ * headers and trailers) is spread.  After each collection, only about
+ * `1/n` of the heap blocks is checked, each block in turn, thus every
+ * live object is checked at least once per `n` collections.  Zero is
+ * treated as 1 (the default), i.e. the entire heap is checked after each
+ * collection.  A larger value makes the detection of a smashed object
+ * later but the check cheaper.  The check itself is done by the parallel
+ * marker threads if the latter are available.  Has no effect if the
+ * collector is built with `SHORT_DBG_HDRS` macro defined.  The setter
+ * and getter are unsynchronized.
+ */
+GC_API void GC_CALL GC_set_check_heap_slices(unsigned /* `n` */);
+GC_API unsigned GC_CALL GC_get_check_heap_slices(void);
+
 #ifdef __cplusplus
 #  define GC_CAST_AWAY_CONST_PVOID(p) \
     reinterpret_cast</* no const */ void *>(reinterpret_cast<GC_uintptr_t>(p))
@@ -1355,6 +1657,8 @@ GC_API /* `realloc` attribute */ GC_ATTR_ALLOC_SIZE(2) void *GC_CALL
       link, GC_base(GC_CAST_AWAY_CONST_PVOID(obj)))
 #define GC_REGISTER_LONG_LINK_SAFE(link, obj) \
   GC_register_long_link(link, GC_base(GC_CAST_AWAY_CONST_PVOID(obj)))
+#define GC_REGISTER_SOFT_LINK_SAFE(link, obj) \
+  GC_register_soft_link(link, GC_base(GC_CAST_AWAY_CONST_PVOID(obj)))
 
 /*
  * Convenient macros over debug and non-debug allocation functions.
@@ -1415,6 +1719,8 @@ GC_API /* `realloc` attribute */ GC_ATTR_ALLOC_SIZE(2) void *GC_CALL
     GC_GENERAL_REGISTER_DISAPPEARING_LINK_SAFE(link, obj)
 #  define GC_REGISTER_LONG_LINK(link, obj) \
     GC_REGISTER_LONG_LINK_SAFE(link, obj)
+#  define GC_REGISTER_SOFT_LINK(link, obj) \
+    GC_REGISTER_SOFT_LINK_SAFE(link, obj)
 #  define GC_REGISTER_DISPLACEMENT(n) GC_debug_register_displacement(n)
 #else
 #  define GC_FREE(p) GC_free(p)
@@ -1432,6 +1738,7 @@ GC_API /* `realloc` attribute */ GC_ATTR_ALLOC_SIZE(2) void *GC_CALL
 #  define GC_GENERAL_REGISTER_DISAPPEARING_LINK(link, obj) \
     GC_general_register_disappearing_link(link, obj)
 #  define GC_REGISTER_LONG_LINK(link, obj) GC_register_long_link(link, obj)
+#  define GC_REGISTER_SOFT_LINK(link, obj) GC_register_soft_link(link, obj)
 #  define GC_REGISTER_DISPLACEMENT(n) GC_register_displacement(n)
 #endif /* !GC_DEBUG */
 
@@ -1522,6 +1829,20 @@ GC_API void GC_CALL GC_debug_register_finalizer(
     GC_finalization_proc * /* `ofn` */, void ** /* `ocd` */)
     GC_ATTR_NONNULL(1);
 
+/**
+ * A batch variant of `GC_register_finalizer`.  Equivalent to calling
+ * `GC_register_finalizer(objs[i], fn, cds[i], NULL, NULL)` for each `i`
+ * less than `n`, but the allocator lock is acquired (and the finalizers
+ * table is grown, if needed) once for the whole batch.  `cds` may be
+ * `NULL` (meaning the client data is `NULL` for all the objects).
+ * The objects should not have debugging headers (i.e. should not be
+ * allocated by `GC_debug_malloc` and friends).
+ */
+GC_API void GC_CALL GC_register_finalizers(void *const * /* `objs` */,
+                                           size_t /* `n` */,
+                                           GC_finalization_proc /* `fn` */,
+                                           void *const * /* `cds` */);
+
 /**
  * Another variant of `GC_register_finalizer` but ignoring self-cycles,
  * i.e. pointers from a finalizable object to itself.  There is
@@ -1639,6 +1960,37 @@ GC_API int GC_CALL GC_general_register_disappearing_link(
     void ** /* `link` */, const void * /* `obj` */) GC_ATTR_NONNULL(1)
     GC_ATTR_NONNULL(2);
 
+/**
+ * A batch variant of `GC_general_register_disappearing_link`.  Registers
+ * `links[i]` with `objs[i]` for each `i` less than `n`, acquiring the
+ * allocator lock (and growing the links table, if needed) once for the
+ * whole batch.  Returns `GC_SUCCESS` if all the links are registered
+ * (including the already registered ones), `GC_NO_MEMORY` if the
+ * registration failed for lack of memory (some of the links might be
+ * registered in this case), `GC_UNIMPLEMENTED` if `GC_find_leak` is true.
+ */
+GC_API int GC_CALL GC_general_register_disappearing_links(
+    void **const * /* `links` */, const void *const * /* `objs` */,
+    size_t /* `n` */);
+
+/**
+ * Turn on or off the deferred registration mode of disappearing links.
+ * In this mode, `GC_general_register_disappearing_link()` (and
+ * `GC_register_disappearing_link()`) put the link to one of several
+ * pending buffers (selected by the link address) without acquiring the
+ * allocator lock, and `GC_unregister_disappearing_link()` does the same
+ * for a link having a pending registration.  The pending buffers are
+ * merged to the links table at the next collection (or once a buffer is
+ * full).  This reduces the contention between the client threads which
+ * register and unregister links frequently.  The drawback is that
+ * `GC_SUCCESS` (instead of `GC_DUPLICATE`) is returned if the link is
+ * already registered and merged.  Does not affect the long links.
+ * Off by default.  Has no effect in the single-threaded builds or if
+ * all the objects have debugging headers.
+ */
+GC_API void GC_CALL GC_set_deferred_dl_registration(int);
+GC_API int GC_CALL GC_get_deferred_dl_registration(void);
+
 /**
  * Moves a `link` previously registered via
  * `GC_general_register_disappearing_link` (or
@@ -1686,6 +2038,80 @@ GC_API int GC_CALL GC_move_long_link(void ** /* `link` */,
  */
 GC_API int GC_CALL GC_unregister_long_link(void ** /* `link` */);
 
+/**
+ * Similar to `GC_general_register_disappearing_link` but `obj` is kept
+ * alive (together with all objects reachable from it) by the collector
+ * even if it is no longer reachable otherwise, unless the heap occupancy
+ * is high.  This can be used to implement memory-sensitive caches.
+ * Specifically, the unreachable targets of the soft links are retained
+ * as long as the total size of the reachable objects and the retained
+ * targets does not exceed `GC_get_soft_links_heap_threshold()` percent
+ * of the heap size; otherwise the links accessed least recently (see
+ * `GC_access_soft_link`) are cleared first.  No target is retained if
+ * the heap size exceeds the same percent of the maximum heap size (if
+ * set by `GC_set_max_heap_size`).  The cleared soft links are handled in
+ * the same way as the short ones, i.e. before the objects are finalized.
+ * The result is the same as of `GC_general_register_disappearing_link`.
+ */
+GC_API int GC_CALL GC_register_soft_link(void ** /* `link` */,
+                                         const void * /* `obj` */)
+    GC_ATTR_NONNULL(1) GC_ATTR_NONNULL(2);
+
+/**
+ * Similar to `GC_unregister_disappearing_link` but for `link`
+ * registration done by `GC_register_soft_link()`.
+ */
+GC_API int GC_CALL GC_unregister_soft_link(void ** /* `link` */);
+
+/**
+ * Mark the soft `link` as accessed, this postpones its clearing on
+ * a memory pressure.  Returns the object `link` is registered with
+ * (a strong pointer, thus it is safe to use it even if `*link` holds
+ * a disguised pointer), or `NULL` if the link has been cleared or never
+ * registered.  Acquires the allocator lock in the reader mode.
+ */
+GC_API void *GC_CALL GC_access_soft_link(void ** /* `link` */);
+
+/**
+ * Set/get the heap occupancy threshold (in percents, 0..100) for the
+ * retaining of the soft links targets.  Zero means the targets are not
+ * retained at all (i.e. soft links behave as short ones).  The default
+ * value is 75.  The initial value could also be set by
+ * `GC_SOFT_LINKS_HEAP_THRESHOLD` environment variable.  The setter and
+ * the getter are unsynchronized.
+ */
+GC_API void GC_CALL GC_set_soft_links_heap_threshold(unsigned);
+GC_API unsigned GC_CALL GC_get_soft_links_heap_threshold(void);
+
+/**
+ * Create an ephemeron, i.e. a weak pair associating `value` with `key`.
+ * The value is kept alive by the ephemeron only while the key is
+ * reachable by other means (i.e. not through the value, and not through
+ * any other ephemeron value keyed by an unreachable object), thus
+ * a value which references its own key does not prevent the pair from
+ * being collected.  Once the key becomes inaccessible, both the key and
+ * the value of the ephemeron are cleared (at the same time as the short
+ * disappearing links, i.e. before the finalizers of the key or the value,
+ * if any, are run).  `key` should point into an object allocated by the
+ * collector; `value` may be `NULL` or point outside the collector heap.
+ * The result is a collectible object, which should not be deallocated
+ * explicitly; the association is dropped once the ephemeron object
+ * itself becomes unreachable.  Returns `NULL` if out of memory.
+ */
+GC_API GC_ATTR_MALLOC void *GC_CALL GC_new_ephemeron(const void * /* `key` */,
+                                                     const void * /* `value` */)
+    GC_ATTR_NONNULL(1);
+
+/**
+ * Return the key or the value of the given ephemeron (created by
+ * `GC_new_ephemeron`), or `NULL` if the ephemeron has been cleared.
+ * Both the functions acquire the allocator lock (in the reader mode).
+ */
+GC_API void *GC_CALL GC_ephemeron_get_key(const void * /* `eph` */)
+    GC_ATTR_NONNULL(1);
+GC_API void *GC_CALL GC_ephemeron_get_value(const void * /* `eph` */)
+    GC_ATTR_NONNULL(1);
+
 /*
  * Support of "toggle-refs" style of external memory management without
  * hooking up to the host retain/release machinery.  The idea of
@@ -1735,6 +2161,32 @@ GC_API int GC_CALL GC_debug_toggleref_add(void * /* `obj` */,
                                           int /* `is_strong` */)
     GC_ATTR_NONNULL(1);
 
+/**
+ * Turn on (or off) the dirty tracking mode of "toggle-refs" processing.
+ * In this mode, the callback is invoked only for the objects passed to
+ * `GC_toggleref_set_dirty` since the previous collection, the others
+ * keep their state (strong or weak) unchanged.  Off by default.
+ * Both the setter and the getter acquire the allocator lock (in the
+ * reader mode in case of the getter).
+ */
+GC_API void GC_CALL GC_set_toggleref_dirty_tracking(int);
+GC_API int GC_CALL GC_get_toggleref_dirty_tracking(void);
+
+/**
+ * Notify the collector that the native state of a given object
+ * (registered for "toggle-refs" processing) might have changed, thus
+ * the callback should be invoked on the object at the next collection.
+ * `obj` should be the same as passed to `GC_toggleref_add` (i.e.
+ * `GC_base()` of the object allocated by `GC_debug_malloc`).  No-op
+ * unless the dirty tracking mode is on.  Acquires the allocator lock on
+ * every call, thus the client changing the native state of an object
+ * often is recommended to call it only on the first change since the
+ * previous invocation of the callback on the object (e.g. by keeping
+ * a per-object flag cleared by the callback).
+ */
+GC_API void GC_CALL GC_toggleref_set_dirty(void * /* `obj` */)
+    GC_ATTR_NONNULL(1);
+
 /**
  * Finalizer callback support.  Invoked by the collector (with the allocator
  * lock held) for each unreachable object enqueued for finalization.
@@ -1755,14 +2207,32 @@ GC_API int GC_CALL GC_should_invoke_finalizers(void);
 
 /**
  * Set maximum amount of finalizers to run during a single invocation
- * of `GC_invoke_finalizers()`.  Zero means no limit.  Both the setter
- * and the getter acquire the allocator lock (in the reader mode in
- * case of the getter).  Note that invocation of `GC_finalize_all()`
- * resets the maximum amount value.
+ * of `GC_invoke_finalizers()` (or in a single batch taken by a finalizer
+ * worker thread).  Zero means no limit.  Both the setter and the getter
+ * acquire the allocator lock (in the reader mode in case of the getter).
+ * Note that invocation of `GC_finalize_all()` resets the maximum amount
+ * value.
  */
 GC_API void GC_CALL GC_set_interrupt_finalizers(unsigned);
 GC_API unsigned GC_CALL GC_get_interrupt_finalizers(void);
 
+/**
+ * Turn on (or off) the finalization of the unreachable cycles.  If on,
+ * an unreachable object registered by `GC_register_finalizer` (or its
+ * variants with the same ordering) whose finalization is blocked only
+ * by the objects of the same cycle (i.e. which is not reachable from
+ * any other unreachable finalizable object outside its cycle) is
+ * enqueued for finalization together with the other such members of
+ * the cycle, in an unspecified order.  Thus, a finalizer may observe
+ * another member of its cycle already finalized.  The cycle detection
+ * scans the objects conservatively, and costs one more traversal of
+ * the unreachable finalizable objects per collection.  Off by default.
+ * Both the setter and the getter acquire the allocator lock (in the
+ * reader mode in case of the getter).
+ */
+GC_API void GC_CALL GC_set_cycle_finalization(int);
+GC_API int GC_CALL GC_get_cycle_finalization(void);
+
 /**
  * Run finalizers for all objects that are ready to be finalized.
  * Return the number of finalizers that were run.  Normally this is
@@ -2358,6 +2828,55 @@ GC_API void GC_CALL GC_ptr_store_and_dirty(void * /* `p` */,
 GC_API void GC_CALL GC_debug_ptr_store_and_dirty(void * /* `p` */,
                                                  const void * /* `q` */);
 
+/*
+ * The card table used by the manual VDB mode (see
+ * `GC_set_manual_vdb_allowed`).  Each entry (byte) corresponds to
+ * a `GC_CARD_BYTES`-aligned chunk (card) of the address space; the cards
+ * are mapped to the entries by the address bits modulo the table size,
+ * thus marking a card might dirty some other cards spuriously.  A nonzero
+ * entry means some card mapped to it is dirty.  The client should not
+ * access the table directly but only by `GC_CARD_DIRTY()` or
+ * `GC_PTR_STORE_AND_DIRTY_INLINE()`.  Note: the values of
+ * `GC_LOG_CARD_BYTES` and `GC_LOG_CARD_TABLE_ENTRIES` are a part of ABI.
+ */
+#define GC_LOG_CARD_BYTES 12
+#define GC_CARD_BYTES ((GC_word)1 << GC_LOG_CARD_BYTES)
+#define GC_LOG_CARD_TABLE_ENTRIES 18
+#define GC_CARD_TABLE_ENTRIES ((GC_word)1 << GC_LOG_CARD_TABLE_ENTRIES)
+GC_API unsigned char GC_card_table[GC_CARD_TABLE_ENTRIES];
+
+/** The index of `GC_card_table` entry for the card containing `p`. */
+#define GC_CARD_INDEX(p)                             \
+  ((size_t)(((GC_uintptr_t)(p) >> GC_LOG_CARD_BYTES) \
+            & (GC_CARD_TABLE_ENTRIES - 1)))
+
+/**
+ * Mark the card containing `p` as dirty.  Equivalent to
+ * `GC_end_stubborn_change(p)` (in the manual VDB mode) but is inlined,
+ * i.e. it compiles to a shift, a mask and a byte store.  Does nothing
+ * useful (but is harmless) if the manual VDB mode is off.
+ */
+#define GC_CARD_DIRTY(p) (void)(GC_card_table[GC_CARD_INDEX(p)] = 1)
+
+/**
+ * An inline variant of `GC_PTR_STORE_AND_DIRTY(p, q)`.  This is
+ * a statement (not an expression).  In the debug mode, it is the same
+ * as `GC_PTR_STORE_AND_DIRTY()` (to perform the checks).
+ */
+#ifdef GC_DEBUG
+#  define GC_PTR_STORE_AND_DIRTY_INLINE(p, q) GC_PTR_STORE_AND_DIRTY(p, q)
+#else
+#  define GC_PTR_STORE_AND_DIRTY_INLINE(p, q)         \
+    do {                                              \
+      void **GC_psd_p = (void **)(p);                 \
+      const void *GC_psd_q = (q);                     \
+                                                      \
+      *GC_psd_p = GC_CAST_AWAY_CONST_PVOID(GC_psd_q); \
+      GC_CARD_DIRTY(GC_psd_p);                        \
+      GC_reachable_here(GC_psd_q);                    \
+    } while (0)
+#endif
+
 #ifdef GC_PTHREADS
 /*
  * For `pthreads` support, we generally need to intercept a number of
@@ -51,6 +51,51 @@ GC_API void GC_CALL GC_register_disclaim_proc(int /* `kind` */,
                                               GC_disclaim_proc /* `proc` */,
                                               int /* `mark_from_all` */);
 
+/**
+ * Type of a batch disclaim callback.  Called without the allocator lock
+ * held, with `n` (nonzero) quarantined objects of the same kind.
+ */
+typedef void(GC_CALLBACK *GC_disclaim_batch_proc)(void ** /* `objs` */,
+                                                  size_t /* `n` */);
+
+/**
+ * Register `proc` to be called on batches of objects (of given `kind`)
+ * ready to be reclaimed.  Unlike `GC_register_disclaim_proc`, the sweep
+ * only quarantines such objects (they are kept in the heap until
+ * `proc()` is invoked on them), and `proc()` is invoked later, without
+ * the allocator lock held, with many objects at once (e.g. to release
+ * the associated native resources in one system call).  The objects
+ * reachable from the quarantined ones are protected from collection
+ * only if `mark_from_all` is nonzero (it has the same meaning as for
+ * `GC_register_disclaim_proc`); otherwise, such objects could be
+ * reclaimed by the collection which has quarantined the referring
+ * objects, thus `proc()` should not dereference the pointers stored in
+ * the objects passed to it.  Once `proc()` returns, the objects of the
+ * batch are deallocated (as if by `GC_free`).  `proc()` should not
+ * resurrect the objects.  Like the non-batch disclaim procedure, `proc()`
+ * may be passed objects from the free list (e.g. those never allocated),
+ * thus a client should recognize them, e.g. by a nonzero tag stored in
+ * the objects.  The quarantined objects are passed to `proc()` by
+ * `GC_invoke_disclaim_batches`, which is called by the finalizer
+ * threads (if started) or after the implicit invocation of the
+ * finalizers during allocations.  If `GC_finalize_on_demand` is set,
+ * then `GC_finalizer_notifier` is called also when there are pending
+ * batches, and the client should call `GC_invoke_disclaim_batches`
+ * explicitly (`GC_invoke_finalizers` does not process the batches).
+ * Acquires the allocator lock.  In the find-leak mode,
+ * `proc()` is never invoked (but a spare batch is still allocated).
+ */
+GC_API void GC_CALL GC_register_disclaim_batch_proc(
+    int /* `kind` */, GC_disclaim_batch_proc /* `proc` */,
+    int /* `mark_from_all` */) GC_ATTR_NONNULL(2);
+
+/**
+ * Pass all the quarantined objects to the corresponding batch disclaim
+ * procedures, then deallocate the objects.  Returns the number of the
+ * processed objects.  Should not be called with the allocator lock held.
+ */
+GC_API size_t GC_CALL GC_invoke_disclaim_batches(void);
+
 /** The finalizer closure used by `GC_finalized_malloc`. */
 struct GC_finalizer_closure {
   GC_finalization_proc proc;
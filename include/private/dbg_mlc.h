@@ -108,9 +108,19 @@ typedef struct {
   GC_hidden_pointer oh_bg_ptr;
 #endif
   const char *oh_string; /*< object descriptor string (file name) */
+#if defined(CALL_CHAIN_IDS) && CPP_WORDSZ == 64
+  int oh_int; /*< object descriptor integer (line number) */
+
+  /* The call chain `id` (see `GC_call_chain_id()`); fits the same word. */
+  unsigned32 oh_ci_id;
+#else
   GC_signed_word oh_int; /*< object descriptor integer (line number) */
-#ifdef NEED_CALLINFO
+#  ifdef CALL_CHAIN_IDS
+  GC_uintptr_t oh_ci_id;
+  GC_uintptr_t oh_ci_pad; /*< to preserve double-pointer alignment */
+#  elif defined(NEED_CALLINFO)
   struct callinfo oh_ci[NFRAMES];
+#  endif
 #endif
 #ifndef SHORT_DBG_HDRS
   GC_uintptr_t oh_sz; /*< the original `malloc` argument */
@@ -135,35 +145,76 @@ typedef struct {
 
 /*
  * `ADD_CALL_CHAIN` stores a (partial) call chain into an object header;
- * it should be called with the allocator lock held.
+ * it should be called with the allocator lock held; `extra_skip` is the
+ * number of the (not inlined) collector functions between the caller
+ * of `ADD_CALL_CHAIN` and the client code.  E.g., it is 1 if called by
+ * `store_debug_info()`, which is called by `GC_debug_malloc()`.
  * `PRINT_CALL_CHAIN` prints the call chain stored in an object to `stderr`;
  * it requires we do not hold the allocator lock.
  */
+#if defined(CALL_CHAIN_IDS)
+/*
+ * Return the `id` of the given call chain, registering the chain in the
+ * table if it is not there yet.  The `id` values start from 1; zero is
+ * returned if the table could not be expanded.  The caller should hold
+ * the allocator lock.
+ */
+GC_INNER unsigned32 GC_call_chain_id(const struct callinfo info[NFRAMES]);
+
+/* Print the call chain with the given `id` to `stderr`. */
+GC_INNER void GC_print_call_chain(unsigned32 id);
+
+#  define SAVE_CALL_CHAIN_ID(base, save_callers_fn, extra_skip) \
+    do {                                                        \
+      struct callinfo ci[NFRAMES];                              \
+                                                                \
+      save_callers_fn(ci, extra_skip);                          \
+      ((oh *)(base))->oh_ci_id = GC_call_chain_id(ci);          \
+    } while (0)
+#  define ADD_CALL_CHAIN(base, ra, extra_skip) \
+    SAVE_CALL_CHAIN_ID(base, GC_save_callers, extra_skip)
+#endif
+
 #if defined(SAVE_CALL_CHAIN)
-#  define ADD_CALL_CHAIN(base, ra) GC_save_callers(((oh *)(base))->oh_ci)
+#  ifndef CALL_CHAIN_IDS
+#    define ADD_CALL_CHAIN(base, ra, extra_skip) \
+      GC_save_callers(((oh *)(base))->oh_ci, extra_skip)
+#  endif
 #  if defined(REDIRECT_MALLOC) && defined(THREADS) && defined(DBG_HDRS_ALL) \
       && NARGS == 0 && NFRAMES % 2 == 0 && defined(GC_HAVE_BUILTIN_BACKTRACE)
 /*
  * A dummy variant of `GC_save_callers()` which does not call
  * `backtrace()`.
  */
-GC_INNER void GC_save_callers_no_unlock(struct callinfo info[NFRAMES]);
+GC_INNER void GC_save_callers_no_unlock(struct callinfo info[NFRAMES],
+                                        int extra_skip);
 
-#    define ADD_CALL_CHAIN_INNER(base) \
-      GC_save_callers_no_unlock(((oh *)(base))->oh_ci)
+#    ifdef CALL_CHAIN_IDS
+#      define ADD_CALL_CHAIN_INNER(base) \
+        SAVE_CALL_CHAIN_ID(base, GC_save_callers_no_unlock, 0)
+#    else
+#      define ADD_CALL_CHAIN_INNER(base) \
+        GC_save_callers_no_unlock(((oh *)(base))->oh_ci, 0)
+#    endif
+#  endif
+#  ifdef CALL_CHAIN_IDS
+#    define PRINT_CALL_CHAIN(base) \
+      GC_print_call_chain((unsigned32)((oh *)(base))->oh_ci_id)
+#  else
+#    define PRINT_CALL_CHAIN(base) GC_print_callers(((oh *)(base))->oh_ci)
 #  endif
-#  define PRINT_CALL_CHAIN(base) GC_print_callers(((oh *)(base))->oh_ci)
 #elif defined(GC_ADD_CALLER)
-#  define ADD_CALL_CHAIN(base, ra) ((oh *)(base))->oh_ci[0].ci_pc = (ra)
+#  define ADD_CALL_CHAIN(base, ra, extra_skip) \
+    ((oh *)(base))->oh_ci[0].ci_pc = (ra)
 #  define PRINT_CALL_CHAIN(base) GC_print_callers(((oh *)(base))->oh_ci)
 #else
-#  define ADD_CALL_CHAIN(base, ra)
+#  define ADD_CALL_CHAIN(base, ra, extra_skip)
 #  define PRINT_CALL_CHAIN(base)
 #endif
 
 #if !defined(ADD_CALL_CHAIN_INNER) && defined(DBG_HDRS_ALL)
 /* A variant of `ADD_CALL_CHAIN()` used for internal allocations. */
-#  define ADD_CALL_CHAIN_INNER(base) ADD_CALL_CHAIN(base, GC_RETURN_ADDR)
+#  define ADD_CALL_CHAIN_INNER(base) ADD_CALL_CHAIN(base, GC_RETURN_ADDR, 0)
 #endif
 
 #ifdef GC_ADD_CALLER
@@ -187,6 +238,11 @@ GC_INNER void GC_save_callers_no_unlock(struct callinfo info[NFRAMES]);
 #else
 GC_INNER int GC_has_other_debug_info(ptr_t base);
 
+/* The maximum number of the smashed locations kept for printing. */
+#  ifndef MAX_SMASHED
+#    define MAX_SMASHED 20
+#  endif
+
 GC_INNER void GC_add_smashed(ptr_t smashed);
 
 /*
@@ -404,6 +404,18 @@ GC_INNER mse *GC_mark_from(mse *mark_stack_top, mse *mark_stack,
 #define GC_mark_stack_empty() \
   ADDR_LT((ptr_t)GC_mark_stack_top, (ptr_t)GC_mark_stack)
 
+#ifdef PARALLEL_MARK
+/*
+ * Process the entries of the global mark stack (if any) using the
+ * parallel marker threads; the mark stack is empty on return.  Unlike
+ * `GC_mark_some()`, this does not alter the mark state (except for
+ * setting it to `MS_INVALID` in case of a mark stack overflow).
+ * The caller should hold the allocator lock, and `GC_parallel` should
+ * be nonzero.
+ */
+GC_INNER void GC_parallel_mark_from_mark_stack(void);
+#endif
+
 /*
  * The current state of marking, as follows.  We say something is dirty
  * if it was written since the last time we retrieved dirty bits.
@@ -69,6 +69,10 @@
 #  include <stddef.h>
 #endif
 
+#ifdef USE_SDT_PROBES
+#  include <sys/sdt.h>
+#endif
+
 #ifdef DGUX
 #  include <sys/resource.h>
 #  include <sys/time.h>
@@ -466,10 +470,19 @@ GC_INNER void GC_process_togglerefs(void);
 #  ifndef SMALL_CONFIG
 GC_INNER void GC_print_finalization_stats(void);
 #  endif
+
 #else
 #  define GC_notify_or_invoke_finalizers() (void)0
 #endif /* GC_NO_FINALIZATION */
 
+#ifdef ENABLE_DISCLAIM
+/*
+ * The number of objects quarantined for the batch disclaim procedures
+ * but not passed to them yet.  Updated with the allocator lock held.
+ */
+GC_EXTERN word GC_disclaim_quarantined;
+#endif
+
 #if !defined(DONT_ADD_BYTE_AT_END)
 #  ifdef LINT2
 /*
@@ -517,9 +530,19 @@ struct callinfo {
 #  ifdef SAVE_CALL_CHAIN
 /*
  * Fill in the `pc` and argument information for up to `NFRAMES` of
- * my callers.  Ignore my frame and my callers frame.
+ * my callers.  Ignore my frame and my callers frame, and `extra_skip`
+ * (up to 2) more frames (those of the collector functions which called
+ * my caller, not inlined).
  */
-GC_INNER void GC_save_callers(struct callinfo info[NFRAMES]);
+GC_INNER void GC_save_callers(struct callinfo info[NFRAMES], int extra_skip);
+#  endif
+
+#  if defined(FRAME_POINTER_UNWIND) && defined(THREADS)
+/*
+ * Return the cold end of the stack of the current thread, or `NULL`
+ * if the thread is not registered.  Called with the allocator lock held.
+ */
+GC_INNER ptr_t GC_self_stack_end(void);
 #  endif
 
 /* Print `info` to `stderr`.  We do not hold the allocator lock. */
@@ -1205,6 +1228,11 @@ typedef unsigned short hb_map_entry_t;
 #  endif
 #endif /* !MARK_BIT_PER_OBJ */
 
+#if !defined(NO_ALLOC_TAGS) && !defined(GC_GET_HEAP_USAGE_NOT_NEEDED)
+/* Attribute the heap blocks to the allocation tags of the threads. */
+#  define ALLOC_TAGS
+#endif
+
 struct hblkhdr {
   /*
    * Link field for `hblk` free list and for lists of chunks waiting to
@@ -1260,6 +1288,14 @@ struct hblkhdr {
    */
   unsigned short hb_last_reclaimed;
 
+#ifdef ALLOC_TAGS
+  /*
+   * The allocation tag of the thread which allocated the block (less
+   * than `GC_MAX_ALLOC_TAGS`).  Not meaningful for a free block.
+   */
+  unsigned short hb_tag;
+#endif
+
 #ifdef MARK_BIT_PER_OBJ
 #  define LARGE_INV_SZ ((unsigned32)1 << 16)
 
@@ -1647,7 +1683,7 @@ struct _GC_arrays {
   volatile AO_TS_t _allocate_lock;
 #  endif
 #  if !defined(HAVE_LOCKFREE_AO_OR) && defined(AO_HAVE_test_and_set_acquire) \
-      && (!defined(NO_MANUAL_VDB) || defined(MPROTECT_VDB))
+      && defined(MPROTECT_VDB)
 #    define NEED_FAULT_HANDLER_LOCK
 #    define GC_fault_handler_lock GC_arrays._fault_handler_lock
   volatile AO_TS_t _fault_handler_lock;
@@ -1686,6 +1722,21 @@ struct _GC_arrays {
   GC_bool _explicit_typing_initialized;
 #endif
 
+  /*
+   * The kinds used for `GC_HINT_SHORT_LIVED` objects, indexed by
+   * `PTRFREE` and `NORMAL`.  Created on the first use (or by `GC_init`
+   * if `EAGER_SHORT_LIVED_KINDS` is defined).
+   */
+#define GC_short_lived_kinds GC_arrays._short_lived_kinds
+  unsigned _short_lived_kinds[2];
+#define GC_short_lived_kinds_initialized \
+  GC_arrays._short_lived_kinds_initialized
+#ifdef AO_HAVE_load_acquire
+  volatile AO_t _short_lived_kinds_initialized;
+#else
+  GC_bool _short_lived_kinds_initialized;
+#endif
+
   /* Number of bytes in the accessible composite objects. */
   word _composite_in_use;
 
@@ -1786,6 +1837,8 @@ struct _GC_arrays {
   struct dl_hashtbl_s _ll_hashtbl;
 #  endif
   struct dl_hashtbl_s _dl_hashtbl;
+#  define GC_sl_hashtbl GC_arrays._sl_hashtbl
+  struct dl_hashtbl_s _sl_hashtbl;
   struct fnlz_roots_s _fnlz_roots;
   unsigned _log_fo_table_size;
 
@@ -1796,6 +1849,18 @@ struct _GC_arrays {
   union toggle_ref_u *_toggleref_arr;
   size_t _toggleref_array_size;
   size_t _toggleref_array_capacity;
+#    define GC_toggleref_strong_cnt GC_arrays._toggleref_strong_cnt
+  size_t _toggleref_strong_cnt; /*< the strong entries are the first ones */
+  /*
+   * The open-addressing hash set of the hidden pointers to the objects
+   * passed to `GC_toggleref_set_dirty` since the previous collection.
+   */
+#    define GC_toggleref_dirty_set GC_arrays._toggleref_dirty_set
+#    define GC_toggleref_dirty_cnt GC_arrays._toggleref_dirty_cnt
+#    define GC_toggleref_dirty_log_size GC_arrays._toggleref_dirty_log_size
+  GC_hidden_pointer *_toggleref_dirty_set;
+  size_t _toggleref_dirty_cnt;
+  unsigned _toggleref_dirty_log_size;
 #  endif
 #endif
 
@@ -1863,7 +1928,8 @@ struct _GC_arrays {
    * because `backtrace()` may call `malloc()`.
    */
   struct callinfo _last_stack[NFRAMES];
-#  define SAVE_CALLERS_TO_LAST_STACK() GC_save_callers(GC_arrays._last_stack)
+#  define SAVE_CALLERS_TO_LAST_STACK() \
+    GC_save_callers(GC_arrays._last_stack, 0)
 #else
 #  define SAVE_CALLERS_TO_LAST_STACK() (void)0
 #endif
@@ -2675,6 +2741,12 @@ GC_INNER void GC_remove_roots_subregion(ptr_t b, ptr_t e);
  */
 GC_INNER void GC_exclude_static_roots_inner(ptr_t start, ptr_t finish);
 
+/*
+ * Return the first exclusion range that includes an address not lower
+ * than `start_addr`.
+ */
+GC_INNER struct exclusion *GC_next_exclusion(ptr_t start_addr);
+
 #if defined(ANY_MSWIN) || defined(DYNAMIC_LOADING)
 /* Add dynamic library data sections to the root set. */
 GC_INNER void GC_register_dynamic_libraries(void);
@@ -2715,6 +2787,16 @@ GC_INNER void GC_init_parallel(void);
 #  ifndef DONT_USE_ATEXIT
 GC_INNER GC_bool GC_is_main_thread(void);
 #  endif
+
+#  if !defined(GC_NO_FINALIZATION) && !defined(DBG_HDRS_ALL)
+/*
+ * Acquire the given spin lock (released by `AO_CLEAR()`) which is
+ * expected to be held for a short time only.  Spins with an exponential
+ * back-off, then yields the processor between the attempts.  Used by
+ * the deferred registration of the disappearing links.
+ */
+GC_INNER void GC_spin_lock(volatile AO_TS_t *lock);
+#  endif
 #else
 #  ifdef TRACE_BUF
 void GC_add_trace_entry(const char *caller_fn_name, ptr_t arg1, ptr_t arg2);
@@ -2873,6 +2955,9 @@ GC_INNER void GC_freehblk(struct hblk *p);
  */
 GC_INNER GC_bool GC_expand_hp_inner(word n);
 
+/* The maximum heap size set by the client (zero means unlimited). */
+GC_EXTERN word GC_max_heapsize;
+
 /*
  * Restore unmarked objects to free lists, or (if `abort_if_found` is `TRUE`)
  * report them.  (I.e. perform `GC_reclaim_block()` on the entire heap,
@@ -2946,6 +3031,41 @@ GC_INNER void GC_collect_a_little_inner(size_t n_blocks);
 GC_INNER void *GC_malloc_kind_aligned_global(size_t lb, int kind,
                                              size_t align_m1);
 
+/*
+ * Return the kind used for `GC_HINT_SHORT_LIVED` objects instead of
+ * `kind` (which should be `PTRFREE` or `NORMAL`).  Creates the
+ * short-lived kinds on the first call (unless they are created by
+ * `GC_init()`).  Never acquires the allocator lock once the kinds are
+ * created.  Should not be called with the allocator lock held.
+ */
+GC_INNER int GC_get_short_lived_kind(int kind);
+
+#if defined(THREADS) \
+    && (!defined(AO_HAVE_load_acquire) || !defined(AO_HAVE_store_release))
+/*
+ * Without the acquire and release primitives, the check of the lazily
+ * created kinds would need the allocator lock on every call, thus the
+ * short-lived kinds are created by `GC_init()` instead.
+ */
+#  define EAGER_SHORT_LIVED_KINDS
+GC_INNER void GC_init_short_lived_kinds(void);
+#endif
+
+/*
+ * Allocate an object of `PTRFREE` or `NORMAL` kind, or of the matching
+ * short-lived kind depending on `hint`.  Uses the thread-local free
+ * lists if available.
+ */
+GC_INNER void *GC_malloc_kind_hinted(size_t lb, int kind, int hint);
+
+#if defined(THREAD_LOCAL_ALLOC) && defined(ENABLE_DISCLAIM)
+/*
+ * Allocate an object of `GC_finalized_kind` using the thread-local free
+ * lists if available.  The first pointer of the object is cleared.
+ */
+GC_INNER void *GC_malloc_finalized_kind(size_t lb);
+#endif
+
 GC_INNER void *GC_generic_malloc_aligned(size_t lb, int kind, unsigned flags,
                                          size_t align_m1);
 
@@ -3169,6 +3289,19 @@ GC_rand_next(GC_RAND_STATE_T *pseed)
 #ifdef MAKE_BACK_GRAPH
 GC_EXTERN GC_bool GC_print_back_height;
 void GC_print_back_graph_stats(void);
+
+/*
+ * The number of the objects with the largest retained size to report
+ * after each collection; zero means no report.
+ */
+GC_EXTERN unsigned GC_retained_size_top;
+
+/*
+ * Compute the dominator tree of the reachable objects and print the
+ * objects retaining the most memory.  Called with the allocator lock
+ * held (released temporarily).
+ */
+GC_INNER void GC_print_retained_sizes(void);
 #endif
 
 #ifdef THREADS
@@ -3179,6 +3312,158 @@ void GC_print_back_graph_stats(void);
 GC_INNER void GC_free_inner(void *p);
 #endif
 
+/*
+ * The sampling heap profiler support.  `GC_heap_profile_next_sample` is
+ * the value of `GC_bytes_allocd` at which the next allocated object
+ * should be sampled (`GC_WORD_MAX` if the profiler is off).
+ * `GC_heap_profile_objs_cnt` is the number of the sampled objects
+ * currently tracked.
+ */
+GC_EXTERN word GC_heap_profile_next_sample;
+GC_EXTERN size_t GC_heap_profile_objs_cnt;
+
+/*
+ * Record the given (just allocated) object in the heap profile.
+ * Called by `HEAP_PROFILE_SAMPLE()` with the allocator lock held.
+ */
+GC_INNER void GC_heap_profile_sample(ptr_t p);
+
+/* Remove the explicitly deallocated object from the heap profile. */
+GC_INNER void GC_heap_profile_forget(ptr_t p);
+
+/*
+ * Remove the sampled objects which are not marked from the live heap
+ * profile.  Called after marking (and finalization) is complete but
+ * before the sweep.
+ */
+GC_INNER void GC_heap_profile_reclaim(void);
+
+/*
+ * Set the heap profile sample rate.  The same as
+ * `GC_set_heap_profile_sample_rate` but does not acquire the allocator
+ * lock (used by `GC_init`).
+ */
+GC_INNER void GC_heap_profile_set_rate_inner(word value);
+
+/* The maximum length of a decimal or hexadecimal `word` value. */
+#define HEAP_PROFILE_NUM_LEN (CPP_WORDSZ / 3 + 3)
+
+/*
+ * Copy the string, or print the number in the given base, to the
+ * buffer; return the pointer past the written characters.  Used to
+ * format the heap profile and the trace events.
+ */
+GC_INNER char *GC_heap_profile_put_str(char *q, const char *s);
+GC_INNER char *GC_heap_profile_put_num(char *q, word v, unsigned base);
+
+#ifdef ALLOC_TAGS
+/*
+ * Return the allocation tag of the current thread.  Called with the
+ * allocator lock held.
+ */
+GC_INNER unsigned GC_current_alloc_tag(void);
+#endif
+
+/*
+ * The allocation recorder (see `GC_start_alloc_recording`).
+ * `GC_alloc_rec_on` is set while the recording is on.  The functions
+ * are called by `ALLOC_REC()` with the allocator lock held, except for
+ * `GC_alloc_rec_store()` which acquires the lock.
+ */
+GC_EXTERN GC_bool GC_alloc_rec_on;
+GC_INNER void GC_alloc_rec_obj(void *p, size_t lb, int kind);
+GC_INNER void GC_alloc_rec_free(void *p);
+GC_INNER void GC_alloc_rec_store(void *p, const void *obj);
+GC_INNER void GC_alloc_rec_collection(void);
+GC_INNER void GC_alloc_rec_release(struct hblk *h, size_t bytes);
+
+/*
+ * Start recording to the given file (as requested by
+ * `GC_ALLOC_RECORD_FILE` environment variable); the recording is
+ * stopped and the file is closed at exit.  Called by `GC_init`.
+ */
+GC_INNER void GC_alloc_rec_start_at_init(const char *fname);
+
+#define ALLOC_REC(call)                 \
+  do {                                  \
+    if (EXPECT(GC_alloc_rec_on, FALSE)) \
+      call;                             \
+  } while (0)
+
+#define HEAP_PROFILE_SAMPLE(p)                                        \
+  do {                                                                \
+    if (EXPECT(GC_bytes_allocd >= GC_heap_profile_next_sample, FALSE) \
+        && (p) != NULL)                                               \
+      GC_heap_profile_sample((ptr_t)(p));                             \
+  } while (0)
+
+/*
+ * The collector tracepoints.  `GC_SDT_PROBE()` fires a USDT probe (of
+ * `bdwgc` provider) if the collector is built with `USE_SDT_PROBES`
+ * macro defined.  `GC_TRACE()` fires the probe and records the event
+ * (the collection event or one of `GC_TRACE_` ones below) in the trace
+ * buffer of the current thread if the latter is enabled.  Neither takes
+ * the allocator lock.
+ */
+#ifdef USE_SDT_PROBES
+#  define GC_SDT_PROBE(probe, arg) DTRACE_PROBE1(bdwgc, probe, arg)
+#else
+#  define GC_SDT_PROBE(probe, arg) (void)0
+#endif
+
+#define GC_TRACE_ABANDON 16
+#define GC_TRACE_MARK_ABANDON 17
+#define GC_TRACE_ALLOC_SLOW 18
+#define GC_TRACE_EXPAND_HEAP 19
+#define GC_TRACE_UNMAP 20
+#define GC_TRACE_MARKER_START 21
+#define GC_TRACE_MARKER_END 22
+
+#if !defined(NO_TRACE_BUFFER) && !defined(SMALL_CONFIG) \
+    && !defined(NO_CLOCK)                               \
+    && (!defined(THREADS)                               \
+        || (defined(AO_HAVE_compare_and_swap_release)   \
+            && defined(AO_HAVE_load_acquire)            \
+            && defined(AO_HAVE_store_release)           \
+            && defined(AO_HAVE_nop_full)))
+#  define TRACE_BUFFER
+#endif
+
+#ifdef TRACE_BUFFER
+/* Whether the trace events are recorded. */
+GC_EXTERN GC_bool GC_trace_on;
+
+/* Record the event in the trace buffer of the current thread. */
+GC_INNER void GC_trace_record(unsigned ev, word arg);
+
+/*
+ * Turn on the trace buffer of the given size (or turn it off if zero).
+ * The same as `GC_set_trace_buffer_size` but does not acquire the
+ * allocator lock (used by `GC_init`).
+ */
+GC_INNER void GC_trace_set_size_inner(size_t n);
+
+/* Dump the trace events to the given file at the process exit. */
+GC_INNER void GC_trace_dump_at_exit(const char *fname);
+
+#  ifdef THREADS
+/*
+ * Release the ring of the current thread (if any), so that it could be
+ * claimed by another thread.  Called when the thread is unregistered.
+ */
+GC_INNER void GC_trace_release_ring(void);
+#  endif
+
+#  define GC_TRACE(ev, probe, arg)        \
+    do {                                  \
+      GC_SDT_PROBE(probe, arg);           \
+      if (EXPECT(GC_trace_on, FALSE))     \
+        GC_trace_record(ev, (word)(arg)); \
+    } while (0)
+#else
+#  define GC_TRACE(ev, probe, arg) GC_SDT_PROBE(probe, arg)
+#endif
+
 #ifdef VALGRIND_TRACKING
 #  define FREE_PROFILER_HOOK(p) GC_free_profiler_hook(p)
 #else
@@ -3296,10 +3581,11 @@ GC_EXTERN GC_bool GC_manual_vdb;
 #  define GC_auto_incremental (GC_incremental && !GC_manual_vdb)
 
 /*
- * Manually mark the page containing `p` as dirty.  Logically, this
- * dirties the entire object.  Does not require locking.
+ * Manually mark the card (`GC_CARD_BYTES`-aligned chunk) containing `p`
+ * as dirty.  Logically, this dirties the entire object.  Does not require
+ * locking.
  */
-GC_INNER void GC_dirty_inner(const void *p);
+#  define GC_dirty_inner(p) GC_CARD_DIRTY(p)
 
 #  define GC_dirty(p) (GC_manual_vdb ? GC_dirty_inner(p) : (void)0)
 #  define REACHABLE_AFTER_DIRTY(p) GC_reachable_here(p)
@@ -3539,6 +3539,30 @@ extern ptr_t GC_data_start;
 #  define NEED_CALLINFO
 #endif
 
+/*
+ * `FRAME_POINTER_UNWIND` means `GC_save_callers()` first tries to walk
+ * the chain of the saved frame pointers (which requires neither locks
+ * nor memory allocation), and resorts to `backtrace()` only if the walk
+ * yields too few frames (e.g., if the code is compiled with
+ * `-fomit-frame-pointer` option).
+ */
+#if defined(SAVE_CALL_CHAIN) && NARGS == 0                     \
+    && defined(GC_HAVE_BUILTIN_BACKTRACE) && defined(__GNUC__) \
+    && defined(LINUX) && !defined(CHERI_PURECAP)               \
+    && (defined(I386) || defined(X86_64) || defined(AARCH64))  \
+    && !defined(NO_FRAME_POINTER_UNWIND)
+#  define FRAME_POINTER_UNWIND
+#endif
+
+/*
+ * `CALL_CHAIN_IDS` means the debug object headers hold a 32-bit index
+ * into a table of the distinct saved call chains instead of the chain
+ * itself.
+ */
+#if defined(SAVE_CALL_CHAIN) && NARGS == 0 && !defined(NO_CALL_CHAIN_IDS)
+#  define CALL_CHAIN_IDS
+#endif
+
 #if (defined(FREEBSD) || (defined(DARWIN) && !defined(_POSIX_C_SOURCE)) \
      || (defined(SOLARIS)                                               \
          && (!defined(_XOPEN_SOURCE) || defined(__EXTENSIONS__)))       \
@@ -283,6 +283,12 @@ struct GC_Thread_Rep {
 
 #  ifdef THREAD_LOCAL_ALLOC
   struct thread_local_freelists tlfs GC_ATTR_PTRT_ALIGNED;
+#  elif defined(ALLOC_TAGS)
+  /*
+   * The allocation tag of the thread, see `GC_set_allocation_tag()`.
+   * Protected by the allocator lock.
+   */
+  unsigned short alloc_tag;
 #  endif
 
 #  ifdef NACL
@@ -98,12 +98,8 @@ EXTERN_C_BEGIN
 #  endif /* !USE_x_SPECIFIC */
 
 #  ifndef THREAD_FREELISTS_KINDS
-#    ifdef ENABLE_DISCLAIM
-#      define THREAD_FREELISTS_KINDS (NORMAL + 2)
-#    else
-#      define THREAD_FREELISTS_KINDS (NORMAL + 1)
-#    endif
-#  endif /* !THREAD_FREELISTS_KINDS */
+#    define THREAD_FREELISTS_KINDS (NORMAL + 1)
+#  endif
 
 /*
  * The first `GC_TINY_FREELISTS` free lists correspond to the first
@@ -131,10 +127,24 @@ struct thread_local_freelists {
   void *_freelists[THREAD_FREELISTS_KINDS][GC_TINY_FREELISTS];
 #  define ptrfree_freelists _freelists[PTRFREE]
 #  define normal_freelists _freelists[NORMAL]
+
+  /*
+   * Free lists for `GC_HINT_SHORT_LIVED` objects, indexed by `PTRFREE`
+   * and `NORMAL`; these are of the kinds from `GC_short_lived_kinds`.
+   */
+  void *short_lived_freelists[NORMAL + 1][GC_TINY_FREELISTS];
+#  ifdef ENABLE_DISCLAIM
+  /* Free lists for `GC_finalized_kind` objects. */
+  void *finalized_freelists[GC_TINY_FREELISTS];
+#  endif
 #  ifdef GC_GCJ_SUPPORT
   void *gcj_freelists[GC_TINY_FREELISTS];
   /* A value used for `gcj_freelists[-1]`; allocation is erroneous. */
 #    define ERROR_FL GC_WORD_MAX
+#  endif
+#  ifdef ALLOC_TAGS
+  /* The allocation tag of the thread, see `GC_set_allocation_tag()`. */
+  unsigned short alloc_tag;
 #  endif
 
   /* Do not use local free lists for up to this much allocation. */
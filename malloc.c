@@ -268,9 +268,12 @@ GC_generic_malloc_aligned(size_t lb, int kind, unsigned flags, size_t align_m1)
     GC_print_all_errors();
   GC_notify_or_invoke_finalizers();
   GC_DBG_COLLECT_AT_MALLOC(lb);
+  GC_TRACE(GC_TRACE_ALLOC_SLOW, alloc__slow, lb);
   if (SMALL_OBJ(lb) && EXPECT(align_m1 < GC_GRANULE_BYTES, TRUE)) {
     LOCK();
     result = GC_generic_malloc_inner_small(lb, kind);
+    HEAP_PROFILE_SAMPLE(result);
+    ALLOC_REC(GC_alloc_rec_obj(result, lb, kind));
     UNLOCK();
   } else {
 #ifdef THREADS
@@ -328,6 +331,8 @@ GC_generic_malloc_aligned(size_t lb, int kind, unsigned flags, size_t align_m1)
 #endif
       }
     }
+    HEAP_PROFILE_SAMPLE(result);
+    ALLOC_REC(GC_alloc_rec_obj(result, lb, kind));
     UNLOCK();
 #ifdef THREADS
     if (init && !GC_debugging_started && result != NULL) {
@@ -385,6 +390,7 @@ GC_malloc_kind_aligned_global(size_t lb, int kind, size_t align_m1)
       if (kind != PTRFREE)
         obj_link(op) = NULL;
       GC_bytes_allocd += GRANULES_TO_BYTES((word)lg);
+      ALLOC_REC(GC_alloc_rec_obj(op, lb, kind));
       UNLOCK();
       GC_ASSERT((ADDR(op) & align_m1) == 0);
       return op;
@@ -422,6 +428,74 @@ GC_malloc(size_t lb)
   return GC_malloc_kind(lb, NORMAL);
 }
 
+#ifdef EAGER_SHORT_LIVED_KINDS
+GC_INNER void
+#else
+STATIC void
+#endif
+GC_init_short_lived_kinds(void)
+{
+  GC_ASSERT(I_HOLD_LOCK());
+  GC_short_lived_kinds[PTRFREE] = GC_new_kind_inner(
+      GC_new_free_list_inner(), 0 | GC_DS_LENGTH, FALSE, FALSE);
+  GC_short_lived_kinds[NORMAL] = GC_new_kind_inner(
+      GC_new_free_list_inner(), 0 | GC_DS_LENGTH, TRUE, TRUE);
+}
+
+GC_INNER int
+GC_get_short_lived_kind(int kind)
+{
+  GC_ASSERT(PTRFREE == kind || NORMAL == kind);
+#ifdef EAGER_SHORT_LIVED_KINDS
+  /* The kinds are created by `GC_init()`, no lock is needed. */
+  if (!EXPECT(GC_is_initialized, TRUE))
+    GC_init();
+  GC_ASSERT(GC_short_lived_kinds_initialized);
+#elif defined(THREADS)
+  if (!EXPECT(AO_load_acquire(&GC_short_lived_kinds_initialized), TRUE)) {
+    /* Initialize the collector just in case it is not done yet. */
+    GC_init();
+    LOCK();
+    if (!GC_short_lived_kinds_initialized) {
+      GC_init_short_lived_kinds();
+      AO_store_release(&GC_short_lived_kinds_initialized, TRUE);
+    }
+    UNLOCK();
+  }
+#else
+  if (!EXPECT(GC_short_lived_kinds_initialized, TRUE)) {
+    GC_init();
+    LOCK();
+    GC_init_short_lived_kinds();
+    GC_short_lived_kinds_initialized = TRUE;
+    UNLOCK();
+  }
+#endif
+  return (int)GC_short_lived_kinds[kind];
+}
+
+#ifndef THREAD_LOCAL_ALLOC
+GC_INNER void *
+GC_malloc_kind_hinted(size_t lb, int kind, int hint)
+{
+  if (hint == GC_HINT_SHORT_LIVED)
+    kind = GC_get_short_lived_kind(kind);
+  return GC_malloc_kind(lb, kind);
+}
+#endif
+
+GC_API GC_ATTR_MALLOC void *GC_CALL
+GC_malloc_hinted(size_t lb, int hint)
+{
+  return GC_malloc_kind_hinted(lb, NORMAL, hint);
+}
+
+GC_API GC_ATTR_MALLOC void *GC_CALL
+GC_malloc_atomic_hinted(size_t lb, int hint)
+{
+  return GC_malloc_kind_hinted(lb, PTRFREE, hint);
+}
+
 GC_API GC_ATTR_MALLOC void *GC_CALL
 GC_generic_malloc_uncollectable(size_t lb, int kind)
 {
@@ -469,6 +543,7 @@ GC_generic_malloc_uncollectable(size_t lb, int kind)
       /* For small objects, the free lists are completely marked. */
     }
     GC_ASSERT(GC_is_marked(op));
+    ALLOC_REC(GC_alloc_rec_obj(op, lb_orig, kind));
     UNLOCK();
   } else {
     op = GC_generic_malloc_aligned(lb, kind, 0 /* `flags` */,
@@ -690,6 +765,8 @@ free_internal(void *p, const hdr *hhdr)
   GC_bytes_freed += lb;
   if (IS_UNCOLLECTABLE(kind))
     GC_non_gc_bytes -= lb;
+  if (EXPECT(GC_heap_profile_objs_cnt > 0, FALSE))
+    GC_heap_profile_forget((ptr_t)p);
   if (EXPECT(lg <= MAXOBJGRANULES, TRUE)) {
     struct obj_kind *ok = &GC_obj_kinds[kind];
     void **flh;
@@ -748,6 +825,7 @@ GC_free(void *p)
   LOCK();
   free_internal(p, hhdr);
   FREE_PROFILER_HOOK(p);
+  ALLOC_REC(GC_alloc_rec_free(p));
   UNLOCK();
 }
 
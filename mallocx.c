@@ -278,12 +278,17 @@ GC_generic_malloc_many(size_t lb_adjusted, int kind, void **result)
   struct hblk **rlh;
 
   GC_ASSERT(lb_adjusted != 0 && (lb_adjusted & (GC_GRANULE_BYTES - 1)) == 0);
-  /* Currently a single object is always allocated if manual VDB. */
+  /*
+   * Currently a single object is always allocated if manual VDB, or
+   * if the allocation recorder is on (so that each object is recorded
+   * when it is handed out to the client).
+   */
   /*
    * TODO: `GC_dirty` should be called for each linked object (but the
    * last one) to support multiple objects allocation.
    */
-  if (!EXPECT(lb_adjusted <= MAXOBJBYTES, TRUE) || GC_manual_vdb) {
+  if (!EXPECT(lb_adjusted <= MAXOBJBYTES, TRUE) || GC_manual_vdb
+      || GC_alloc_rec_on) {
     op = GC_generic_malloc_aligned(lb_adjusted - EXTRA_BYTES, kind,
                                    0 /* `flags` */, 0 /* `align_m1` */);
     if (EXPECT(op != NULL, TRUE))
@@ -303,6 +308,7 @@ GC_generic_malloc_many(size_t lb_adjusted, int kind, void **result)
     GC_print_all_errors();
   GC_notify_or_invoke_finalizers();
   GC_DBG_COLLECT_AT_MALLOC(lb_adjusted - EXTRA_BYTES);
+  GC_TRACE(GC_TRACE_ALLOC_SLOW, alloc__slow, lb_adjusted);
   if (!EXPECT(GC_is_initialized, TRUE))
     GC_init();
   LOCK();
@@ -460,6 +466,7 @@ GC_generic_malloc_many(size_t lb_adjusted, int kind, void **result)
 
 out:
   *result = op;
+  HEAP_PROFILE_SAMPLE(op);
   UNLOCK();
   (void)GC_clear_stack(0);
 }
@@ -648,4 +655,5 @@ GC_ptr_store_and_dirty(void *p, const void *q)
   *(const void **)p = q;
   GC_dirty(p);
   REACHABLE_AFTER_DIRTY(q);
+  ALLOC_REC(GC_alloc_rec_store(p, q));
 }
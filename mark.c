@@ -1361,6 +1361,19 @@ GC_do_parallel_mark(void)
   GC_notify_all_marker();
 }
 
+GC_INNER void
+GC_parallel_mark_from_mark_stack(void)
+{
+  GC_ASSERT(I_HOLD_LOCK());
+  GC_ASSERT(GC_parallel);
+  if (GC_mark_stack_empty())
+    return;
+
+  GC_do_parallel_mark();
+  GC_ASSERT(ADDR_LT((ptr_t)GC_mark_stack_top, GC_first_nonempty));
+  GC_mark_stack_top = GC_mark_stack - 1;
+}
+
 GC_INNER void
 GC_help_marker(word my_mark_no)
 {
@@ -1388,8 +1401,10 @@ GC_help_marker(word my_mark_no)
     return;
   }
   GC_helper_count = (unsigned)my_id + 1;
+  GC_TRACE(GC_TRACE_MARKER_START, marker__start, my_id);
   GC_mark_local(local_mark_stack, (int)my_id);
   /* `GC_mark_local` decrements `GC_helper_count`. */
+  GC_TRACE(GC_TRACE_MARKER_END, marker__end, my_id);
 #  undef my_id
 }
 
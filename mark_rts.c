@@ -507,11 +507,7 @@ GC_clear_exclusion_table(void)
   GC_excl_table_entries = 0;
 }
 
-/*
- * Return the first exclusion range that includes an address not lower
- * than `start_addr`.
- */
-STATIC struct exclusion *
+GC_INNER struct exclusion *
 GC_next_exclusion(ptr_t start_addr)
 {
   size_t low = 0;
@@ -1197,6 +1197,12 @@ GC_init(void)
   }
 #  endif
 #endif
+  {
+    const char *str = TRUSTED_STRING(GETENV("GC_ALLOC_RECORD_FILE"));
+
+    if (str != NULL)
+      GC_alloc_rec_start_at_init(str);
+  }
 #if ((defined(UNIX_LIKE) && !defined(GC_ANDROID_LOG))                   \
      || (defined(CONSOLE_LOG) && defined(MSWIN32)) || defined(CYGWIN32) \
      || defined(SYMBIAN))                                               \
@@ -1288,6 +1294,22 @@ GC_init(void)
     GC_err_printf("Back height is not available!\n");
 #  endif
   }
+#endif
+#ifndef SMALL_CONFIG
+  {
+    const char *str = GETENV("GC_RETAINED_SIZE_TOP");
+
+    if (str != NULL) {
+#  ifdef MAKE_BACK_GRAPH
+      int top_n = atoi(str);
+
+      if (top_n > 0)
+        GC_retained_size_top = (unsigned)top_n;
+#  else
+      GC_err_printf("Retained sizes are not available!\n");
+#  endif
+    }
+  }
 #endif
   {
     const char *str = GETENV("GC_TRACE");
@@ -1341,6 +1363,73 @@ GC_init(void)
     }
   }
 #endif
+#ifndef GC_NO_FINALIZATION
+  {
+    const char *str = GETENV("GC_SOFT_LINKS_HEAP_THRESHOLD");
+
+    if (str != NULL) {
+      int percent = atoi(str);
+
+      if (percent < 0 || percent > 100) {
+        WARN("GC_SOFT_LINKS_HEAP_THRESHOLD environment variable has"
+             " bad value - ignoring\n",
+             0);
+      } else {
+        GC_set_soft_links_heap_threshold((unsigned)percent);
+      }
+    }
+  }
+#endif
+  {
+    const char *str = GETENV("GC_CHECK_HEAP_SLICES");
+
+    if (str != NULL) {
+      int n = atoi(str);
+
+      if (n <= 0) {
+        WARN("GC_CHECK_HEAP_SLICES environment variable has"
+             " bad value - ignoring\n",
+             0);
+      } else {
+        GC_set_check_heap_slices((unsigned)n);
+      }
+    }
+  }
+  {
+    const char *str = GETENV("GC_HEAP_PROFILE_SAMPLE_RATE");
+
+    if (str != NULL) {
+      long rate = atol(str);
+
+      if (rate < 0) {
+        WARN("GC_HEAP_PROFILE_SAMPLE_RATE environment variable has"
+             " bad value - ignoring\n",
+             0);
+      } else {
+        GC_heap_profile_set_rate_inner((word)rate);
+      }
+    }
+  }
+#ifdef TRACE_BUFFER
+  {
+    const char *str = GETENV("GC_TRACE_BUFFER_SIZE");
+
+    if (str != NULL) {
+      long n = atol(str);
+
+      if (n < 0) {
+        WARN("GC_TRACE_BUFFER_SIZE environment variable has bad value"
+             " - ignoring\n",
+             0);
+      } else {
+        GC_trace_set_size_inner((size_t)n);
+      }
+    }
+    str = TRUSTED_STRING(GETENV("GC_TRACE_FILE"));
+    if (str != NULL)
+      GC_trace_dump_at_exit(str);
+  }
+#endif
 #ifndef NO_BLACK_LISTING
   {
     char const *str = GETENV("GC_LARGE_ALLOC_WARN_INTERVAL");
@@ -1421,6 +1510,9 @@ GC_init(void)
 #endif
   GC_exclude_static_roots_inner(beginGC_arrays, endGC_arrays);
   GC_exclude_static_roots_inner(beginGC_obj_kinds, endGC_obj_kinds);
+  GC_exclude_static_roots_inner(
+      PTR_ALIGN_UP((ptr_t)GC_card_table, ALIGNMENT),
+      PTR_ALIGN_DOWN((ptr_t)GC_card_table + sizeof(GC_card_table), ALIGNMENT));
 #ifdef SEPARATE_GLOBALS
   GC_exclude_static_roots_inner(beginGC_objfreelist, endGC_objfreelist);
   GC_exclude_static_roots_inner(beginGC_aobjfreelist, endGC_aobjfreelist);
@@ -1571,6 +1663,10 @@ GC_init(void)
 #endif
     GC_gcollect_inner();
   }
+#ifdef EAGER_SHORT_LIVED_KINDS
+  GC_init_short_lived_kinds();
+  GC_short_lived_kinds_initialized = TRUE;
+#endif
 #if defined(GC_ASSERTIONS) && defined(GC_ALWAYS_MULTITHREADED)
   UNLOCK();
 #endif
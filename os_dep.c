@@ -2886,6 +2886,7 @@ block_unmap_inner(ptr_t start_addr, size_t len)
 {
   if (0 == start_addr)
     return;
+  GC_TRACE(GC_TRACE_UNMAP, unmap, len);
 
 #  ifdef USE_WINALLOC
   /*
@@ -3180,8 +3181,11 @@ GC_parse_version(int *pminor, const char *pverstr)
  *     the implementation is still correct.
  *
  *   - `MANUAL_VDB`: Stacks and static data are always considered dirty.
- *     Heap pages are considered dirty if `GC_dirty(p)` has been called on
- *     some `p` pointing to somewhere inside an object on that page.
+ *     Heap pages are considered dirty if `GC_dirty(p)` (or the client
+ *     `GC_CARD_DIRTY(p)`) has been called on some `p` pointing to somewhere
+ *     inside an object on that page.  The dirty cards are recorded in
+ *     `GC_card_table` (a byte per card, thus no atomic update is needed),
+ *     which is transferred to `GC_grungy_pages` by `GC_read_dirty()`.
  *     A `GC_dirty()` call on a large object directly dirties only a single
  *     page, but for the manual VDB we are careful to treat an object with
  *     a dirty page as completely dirty.  In order to avoid races, an object
@@ -3362,19 +3366,14 @@ GC_dirty_init(void)
 }
 #endif /* DEFAULT_VDB */
 
-#if !defined(NO_MANUAL_VDB) || defined(MPROTECT_VDB)
+#ifdef MPROTECT_VDB
 #  if !defined(THREADS) || defined(HAVE_LOCKFREE_AO_OR)
-#    ifdef MPROTECT_VDB
-#      define async_set_pht_entry_from_index(db, index) \
-        set_pht_entry_from_index_concurrent_volatile(db, index)
-#    else
-#      define async_set_pht_entry_from_index(db, index) \
-        set_pht_entry_from_index_concurrent(db, index)
-#    endif
+#    define async_set_pht_entry_from_index(db, index) \
+      set_pht_entry_from_index_concurrent_volatile(db, index)
 #  elif defined(NEED_FAULT_HANDLER_LOCK)
 /*
  * We need to lock around the bitmap update (in the write fault
- * handler or `GC_dirty`) in order to avoid the risk of losing a bit.
+ * handler) in order to avoid the risk of losing a bit.
  * We do this with a test-and-set spin lock if possible.
  */
 static void
@@ -3387,9 +3386,7 @@ async_set_pht_entry_from_index(volatile page_hash_table db, size_t index)
 #  else /* THREADS && !NEED_FAULT_HANDLER_LOCK */
 #    error No test_and_set operation: Introduces a race.
 #  endif
-#endif /* !NO_MANUAL_VDB || MPROTECT_VDB */
 
-#ifdef MPROTECT_VDB
 /*
  * This implementation maintains dirty bits itself by catching write
  * faults and keeping track of them.  We assume nobody else catches
@@ -4283,6 +4280,95 @@ detect_soft_dirty_supported(ptr_t vaddr)
   return TRUE; /*< success */
 }
 
+#  if !defined(NO_SOFT_VDB_PAGEMAP_SCAN) && !defined(CHECK_SOFT_VDB)
+/*
+ * Linux v6.7+ provides `PAGEMAP_SCAN` ioctl on the `pagemap` file which
+ * returns only the ranges of pages matching the given categories (e.g.
+ * the soft-dirty ones), thus the cost of harvesting the dirty bits is
+ * proportional to the number of written pages rather than to the heap
+ * size.  The definitions below match the kernel ABI; they are given here
+ * to avoid dependency on the recent kernel headers.  (`CHECK_SOFT_VDB`
+ * needs the clean pages to be visited too, so the ioctl is not used.)
+ */
+#    define SOFT_VDB_PAGEMAP_SCAN
+#    include <sys/ioctl.h>
+
+struct GC_page_region_s {
+  uint64_t start;
+  uint64_t end;
+  uint64_t categories;
+};
+
+struct GC_pm_scan_arg_s {
+  uint64_t size;
+  uint64_t flags;
+  uint64_t start;
+  uint64_t end;
+  uint64_t walk_end;
+  uint64_t vec;
+  uint64_t vec_len;
+  uint64_t max_pages;
+  uint64_t category_inverted;
+  uint64_t category_mask;
+  uint64_t category_anyof_mask;
+  uint64_t return_mask;
+};
+
+#    define GC_PAGE_IS_SOFT_DIRTY ((uint64_t)1 << 7)
+#    define GC_PAGEMAP_SCAN _IOWR('f', 16, struct GC_pm_scan_arg_s)
+
+/* The number of page regions fitting into `soft_vdb_buf`. */
+#    define PM_SCAN_VEC_LEN (VDB_BUF_SZ / sizeof(struct GC_page_region_s))
+
+/* Whether `PAGEMAP_SCAN` ioctl is known to work.  Set at initialization. */
+static GC_bool pagemap_scan_supported;
+
+/*
+ * Fetch the soft-dirty page regions within [`vaddr`, `limit`) into
+ * `soft_vdb_buf`.  Returns the number of the regions stored or -1 on
+ * failure; `*pwalk_end` is set to the address the scan has stopped at.
+ */
+static int
+pagemap_scan_soft_dirty(ptr_t vaddr, ptr_t limit, ptr_t *pwalk_end)
+{
+  struct GC_pm_scan_arg_s arg;
+  int res;
+
+  GC_ASSERT(ADDR(vaddr) % GC_page_size == 0);
+  GC_ASSERT(ADDR_LT(vaddr, limit));
+  BZERO(&arg, sizeof(arg));
+  arg.size = sizeof(arg);
+  arg.start = (uint64_t)ADDR(vaddr);
+  arg.end = (uint64_t)((ADDR(limit) + GC_page_size - 1)
+                       & ~(word)(GC_page_size - 1));
+  arg.vec = (uint64_t)ADDR(soft_vdb_buf);
+  arg.vec_len = PM_SCAN_VEC_LEN;
+  arg.category_mask = GC_PAGE_IS_SOFT_DIRTY;
+  arg.return_mask = GC_PAGE_IS_SOFT_DIRTY;
+  res = ioctl(pagemap_fd, GC_PAGEMAP_SCAN, &arg);
+  if (res >= 0) {
+    GC_ASSERT((unsigned)res <= PM_SCAN_VEC_LEN);
+    *pwalk_end = (ptr_t)(GC_uintptr_t)arg.walk_end;
+  }
+  return res;
+}
+
+/*
+ * Probe whether `PAGEMAP_SCAN` ioctl is supported by the kernel.  Should
+ * be called after `detect_soft_dirty_supported()` which has made the page
+ * of `vaddr` soft-dirty.
+ */
+static GC_bool
+detect_pagemap_scan_supported(ptr_t vaddr)
+{
+  ptr_t walk_end;
+  ptr_t page = (ptr_t)(ADDR(vaddr) & ~(word)(GC_page_size - 1));
+
+  *vaddr = 1; /*< make it dirty again */
+  return pagemap_scan_soft_dirty(page, page + GC_page_size, &walk_end) > 0;
+}
+#  endif /* !NO_SOFT_VDB_PAGEMAP_SCAN */
+
 #  ifndef NO_SOFT_VDB_LINUX_VER_RUNTIME_CHECK
 #    include <string.h> /*< for strcmp() */
 #    include <sys/utsname.h>
@@ -4356,6 +4442,12 @@ GC_dirty_init(void)
     close(pagemap_fd);
     return FALSE;
   }
+#  ifdef SOFT_VDB_PAGEMAP_SCAN
+  pagemap_scan_supported = detect_pagemap_scan_supported((ptr_t)soft_vdb_buf);
+  if (pagemap_scan_supported) {
+    GC_COND_LOG_PRINTF("Using PAGEMAP_SCAN ioctl to get soft-dirty pages\n");
+  }
+#  endif
   return TRUE;
 }
 
@@ -4432,6 +4524,109 @@ pagemap_buffered_read(size_t *pres, off_t fpos, size_t len,
   return &soft_vdb_buf[ofs / sizeof(pagemap_elem_t)];
 }
 
+/*
+ * Mark the heap blocks (or the static root ones) of the given page as
+ * dirty.  `vaddr` is the page start, the blocks are limited to the
+ * [`start`, `limit`) range.
+ */
+static void
+soft_set_grungy_page(ptr_t vaddr, ptr_t start, ptr_t limit,
+                     GC_bool is_static_root)
+{
+  struct hblk *h;
+  ptr_t next_vaddr = vaddr + GC_page_size;
+
+  if (EXPECT(ADDR_LT(limit, next_vaddr), FALSE)) {
+    next_vaddr = limit;
+  }
+
+  /*
+   * If the bit is set, the respective PTE was written to since clearing
+   * the soft-dirty bits.
+   */
+#  ifdef DEBUG_DIRTY_BITS
+  if (is_static_root)
+    GC_log_printf("static root dirty page at: %p\n", (void *)vaddr);
+#  endif
+  h = (struct hblk *)vaddr;
+  if (EXPECT(ADDR_LT(vaddr, start), FALSE))
+    h = (struct hblk *)start;
+  for (; ADDR_LT((ptr_t)h, next_vaddr); h++) {
+    size_t index = PHT_HASH(h);
+
+    /*
+     * Filter out the blocks without pointers.  It might worth for the case
+     * when the heap is large enough for the hash collisions to occur
+     * frequently.  Thus, off by default.
+     */
+#  if defined(FILTER_PTRFREE_HBLKS_IN_SOFT_VDB) || defined(CHECKSUMS) \
+      || defined(DEBUG_DIRTY_BITS)
+    if (!is_static_root) {
+      hdr *hhdr;
+
+#    ifdef CHECKSUMS
+      set_pht_entry_from_index(GC_written_pages, index);
+#    endif
+      GET_HDR(h, hhdr);
+      if (NULL == hhdr)
+        continue;
+
+      (void)GC_find_starting_hblk(h, &hhdr);
+      if (HBLK_IS_FREE(hhdr) || IS_PTRFREE(hhdr))
+        continue;
+#    ifdef DEBUG_DIRTY_BITS
+      GC_log_printf("dirty page (hblk) at: %p\n", (void *)h);
+#    endif
+    }
+#  else
+    UNUSED_ARG(is_static_root);
+#  endif
+    set_pht_entry_from_index(GC_grungy_pages, index);
+  }
+}
+
+#  ifdef SOFT_VDB_PAGEMAP_SCAN
+/*
+ * Same as `soft_set_grungy_pages` but uses `PAGEMAP_SCAN` ioctl.
+ * Returns `FALSE` if the ioctl has failed (the caller should fall back
+ * to reading the `pagemap` file then).
+ */
+static GC_bool
+soft_scan_grungy_pages(ptr_t start, ptr_t limit, GC_bool is_static_root)
+{
+  ptr_t vaddr = (ptr_t)HBLK_PAGE_ALIGNED(start);
+
+  GC_ASSERT(I_HOLD_LOCK());
+  while (ADDR_LT(vaddr, limit)) {
+    ptr_t walk_end;
+    int i;
+    int n = pagemap_scan_soft_dirty(vaddr, limit, &walk_end);
+    const struct GC_page_region_s *regions
+        = (const struct GC_page_region_s *)soft_vdb_buf;
+
+    if (n < 0) {
+      /* The caller rereads the whole range (some pages might be marked). */
+      return FALSE;
+    }
+    for (i = 0; i < n; i++) {
+      ptr_t p = (ptr_t)(GC_uintptr_t)regions[i].start;
+      ptr_t region_end = (ptr_t)(GC_uintptr_t)regions[i].end;
+
+      GC_ASSERT((regions[i].categories & GC_PAGE_IS_SOFT_DIRTY) != 0);
+      for (; ADDR_LT(p, region_end) && ADDR_LT(p, limit); p += GC_page_size) {
+        soft_set_grungy_page(p, start, limit, is_static_root);
+      }
+    }
+    if (!ADDR_LT(vaddr, walk_end)) {
+      /* No progress, should not happen. */
+      return FALSE;
+    }
+    vaddr = walk_end;
+  }
+  return TRUE;
+}
+#  endif /* SOFT_VDB_PAGEMAP_SCAN */
+
 static void
 soft_set_grungy_pages(ptr_t start, ptr_t limit, ptr_t next_start_hint,
                       GC_bool is_static_root)
@@ -4443,6 +4638,17 @@ soft_set_grungy_pages(ptr_t start, ptr_t limit, ptr_t next_start_hint,
   GC_ASSERT(I_HOLD_LOCK());
   GC_ASSERT(modHBLKSZ(ADDR(start)) == 0);
   GC_ASSERT(GC_log_pagesize != 0);
+#  ifdef SOFT_VDB_PAGEMAP_SCAN
+  if (pagemap_scan_supported) {
+    if (EXPECT(soft_scan_grungy_pages(start, limit, is_static_root), TRUE))
+      return;
+
+    /* Fall back to reading of `pagemap` file (till the process end). */
+    GC_COND_LOG_PRINTF("PAGEMAP_SCAN ioctl failed, errno= %d\n", errno);
+    pagemap_scan_supported = FALSE;
+    pagemap_buf_len = 0; /*< `soft_vdb_buf` content is clobbered */
+  }
+#  endif
   while (ADDR_LT(vaddr, limit)) {
     size_t res;
     ptr_t limit_buf;
@@ -4463,56 +4669,7 @@ soft_set_grungy_pages(ptr_t start, ptr_t limit, ptr_t next_start_hint,
     limit_buf = vaddr + ((res / sizeof(pagemap_elem_t)) << GC_log_pagesize);
     for (; ADDR_LT(vaddr, limit_buf); vaddr += GC_page_size, bufp++) {
       if ((*bufp & PM_SOFTDIRTY_MASK) != 0) {
-        struct hblk *h;
-        ptr_t next_vaddr = vaddr + GC_page_size;
-
-        if (EXPECT(ADDR_LT(limit, next_vaddr), FALSE)) {
-          next_vaddr = limit;
-        }
-
-        /*
-         * If the bit is set, the respective PTE was written to
-         * since clearing the soft-dirty bits.
-         */
-#  ifdef DEBUG_DIRTY_BITS
-        if (is_static_root)
-          GC_log_printf("static root dirty page at: %p\n", (void *)vaddr);
-#  endif
-        h = (struct hblk *)vaddr;
-        if (EXPECT(ADDR_LT(vaddr, start), FALSE))
-          h = (struct hblk *)start;
-        for (; ADDR_LT((ptr_t)h, next_vaddr); h++) {
-          size_t index = PHT_HASH(h);
-
-          /*
-           * Filter out the blocks without pointers.  It might worth for
-           * the case when the heap is large enough for the hash collisions
-           * to occur frequently.  Thus, off by default.
-           */
-#  if defined(FILTER_PTRFREE_HBLKS_IN_SOFT_VDB) || defined(CHECKSUMS) \
-      || defined(DEBUG_DIRTY_BITS)
-          if (!is_static_root) {
-            hdr *hhdr;
-
-#    ifdef CHECKSUMS
-            set_pht_entry_from_index(GC_written_pages, index);
-#    endif
-            GET_HDR(h, hhdr);
-            if (NULL == hhdr)
-              continue;
-
-            (void)GC_find_starting_hblk(h, &hhdr);
-            if (HBLK_IS_FREE(hhdr) || IS_PTRFREE(hhdr))
-              continue;
-#    ifdef DEBUG_DIRTY_BITS
-            GC_log_printf("dirty page (hblk) at: %p\n", (void *)h);
-#    endif
-          }
-#  else
-          UNUSED_ARG(is_static_root);
-#  endif
-          set_pht_entry_from_index(GC_grungy_pages, index);
-        }
+        soft_set_grungy_page(vaddr, start, limit, is_static_root);
       } else {
 #  if defined(CHECK_SOFT_VDB) /* `&& defined(MPROTECT_VDB)` */
         /*
@@ -4588,22 +4745,53 @@ GC_soft_read_dirty(GC_bool output_unneeded)
 }
 #endif /* SOFT_VDB */
 
+/*
+ * Note: the card table is defined even if the manual VDB is unsupported
+ * as the client might use `GC_CARD_DIRTY()` regardless of the mode.
+ */
+unsigned char GC_card_table[GC_CARD_TABLE_ENTRIES];
+
 #ifndef NO_MANUAL_VDB
 GC_INNER GC_bool GC_manual_vdb = FALSE;
 
-GC_INNER void
-GC_dirty_inner(const void *p)
+/*
+ * The index of `GC_grungy_pages` entry corresponding to the given index
+ * of `GC_card_table` (used only if the manual VDB is on).
+ */
+#  define CARD_PHT_INDEX(card_index) ((card_index) & (PHT_ENTRIES - 1))
+
+/*
+ * Transfer the dirty cards to `GC_grungy_pages` (unless `output_unneeded`)
+ * and clear the card table.  The table is examined a word at a time as
+ * typically most cards are clean.
+ */
+STATIC void
+GC_read_dirty_cards(GC_bool output_unneeded)
 {
-  size_t index = PHT_HASH(p);
+  size_t i;
 
-#  if defined(MPROTECT_VDB)
-  /*
-   * Do not update `GC_dirty_pages` if it should be followed by the
-   * page unprotection.
-   */
-  GC_ASSERT(GC_manual_vdb);
-#  endif
-  async_set_pht_entry_from_index(GC_dirty_pages, index);
+  GC_ASSERT(I_HOLD_LOCK());
+  if (output_unneeded) {
+    BZERO(GC_card_table, sizeof(GC_card_table));
+    return;
+  }
+
+  BZERO(GC_grungy_pages, sizeof(GC_grungy_pages));
+  for (i = 0; i < GC_CARD_TABLE_ENTRIES; i += sizeof(word)) {
+    word w;
+    size_t j;
+
+    BCOPY(&GC_card_table[i], &w, sizeof(word));
+    if (EXPECT(0 == w, TRUE))
+      continue;
+
+    for (j = i; j < i + sizeof(word); j++) {
+      if (GC_card_table[j] != 0) {
+        GC_card_table[j] = 0;
+        set_pht_entry_from_index(GC_grungy_pages, CARD_PHT_INDEX(j));
+      }
+    }
+  }
 }
 #endif /* !NO_MANUAL_VDB */
 
@@ -4615,21 +4803,22 @@ GC_read_dirty(GC_bool output_unneeded)
 #  ifdef DEBUG_DIRTY_BITS
   GC_log_printf("read dirty begin\n");
 #  endif
-  if (GC_manual_vdb
-#  if defined(MPROTECT_VDB)
-      || !GC_GWW_AVAILABLE()
+#  ifndef NO_MANUAL_VDB
+  if (GC_manual_vdb) {
+    GC_read_dirty_cards(output_unneeded);
+    return;
+  }
 #  endif
-  ) {
+#  if defined(MPROTECT_VDB)
+  if (!GC_GWW_AVAILABLE()) {
     if (!output_unneeded)
       BCOPY(CAST_AWAY_VOLATILE_PVOID(GC_dirty_pages), GC_grungy_pages,
             sizeof(GC_dirty_pages));
     BZERO(CAST_AWAY_VOLATILE_PVOID(GC_dirty_pages), sizeof(GC_dirty_pages));
-#  ifdef MPROTECT_VDB
-    if (!GC_manual_vdb)
-      GC_protect_heap();
-#  endif
+    GC_protect_heap();
     return;
   }
+#  endif
 
 #  ifdef GWW_VDB
   GC_gww_read_dirty(output_unneeded);
@@ -4665,21 +4854,32 @@ GC_is_vdb_for_static_roots(void)
 GC_INNER GC_bool
 GC_page_was_dirty(struct hblk *h)
 {
-  size_t index;
+#  ifndef NO_MANUAL_VDB
+  if (GC_manual_vdb) {
+    ptr_t p;
 
-#  ifdef DEFAULT_VDB
-  if (!GC_manual_vdb)
-    return TRUE;
-#  elif defined(PROC_VDB)
-  /* Unless manual VDB is on, the bitmap covers all process memory. */
-  if (GC_manual_vdb)
-#  endif
-  {
     if (NULL == HDR(h))
       return TRUE;
+    /* Note: the block could occupy several cards or share a card. */
+    for (p = (ptr_t)h; ADDR_LT(p, (ptr_t)(h + 1)); p += GC_CARD_BYTES) {
+      if (get_pht_entry_from_index(GC_grungy_pages,
+                                   CARD_PHT_INDEX(GC_CARD_INDEX(p))))
+        return TRUE;
+    }
+    return FALSE;
   }
-  index = PHT_HASH(h);
-  return get_pht_entry_from_index(GC_grungy_pages, index);
+#  endif
+#  ifdef DEFAULT_VDB
+  UNUSED_ARG(h);
+  return TRUE;
+#  else
+#    ifndef PROC_VDB
+  /* Unless it is `PROC_VDB`, the bitmap covers the heap only. */
+  if (NULL == HDR(h))
+    return TRUE;
+#    endif
+  return get_pht_entry_from_index(GC_grungy_pages, PHT_HASH(h));
+#  endif
 }
 
 #  if defined(CHECKSUMS) || defined(PROC_VDB)
@@ -5649,9 +5849,10 @@ STATIC GC_bool GC_in_save_callers = FALSE;
 #          include "private/dbg_mlc.h"
 
 GC_INNER void
-GC_save_callers_no_unlock(struct callinfo info[NFRAMES])
+GC_save_callers_no_unlock(struct callinfo info[NFRAMES], int extra_skip)
 {
   GC_ASSERT(I_HOLD_LOCK());
+  UNUSED_ARG(extra_skip);
   info[0].ci_pc
       = CAST_THRU_UINTPTR(GC_return_addr_t, GC_save_callers_no_unlock);
   BZERO(&info[1], sizeof(void *) * (NFRAMES - 1));
@@ -5659,10 +5860,110 @@ GC_save_callers_no_unlock(struct callinfo info[NFRAMES])
 #        endif
 #      endif /* REDIRECT_MALLOC */
 
-GC_INNER void
-GC_save_callers(struct callinfo info[NFRAMES])
+#      ifdef FRAME_POINTER_UNWIND
+/*
+ * The maximum distance between adjacent frame records which is still
+ * considered valid by the walker.
+ */
+#        ifndef FP_UNWIND_MAX_FRAME_SIZE
+#          define FP_UNWIND_MAX_FRAME_SIZE (128 * 1024)
+#        endif
+
+/*
+ * The walk which yields less frames than this is considered failed
+ * (most probably, frame pointers are omitted by the compiler).
+ */
+#        ifndef FP_UNWIND_MIN_FRAMES
+#          define FP_UNWIND_MIN_FRAMES 2
+#        endif
+
+/*
+ * Store up to `NFRAMES` return addresses to `info` following the chain
+ * of frame records starting at `fp`; the first `skip` records are passed
+ * but not stored.  Each record consists of the saved frame pointer of
+ * the caller followed by the return address (this holds for x86, x86_64
+ * and AArch64 targets).  The walk stops at the first
+ * record which is misaligned, not strictly above the previous one, too
+ * far from it, or not below `stack_end`; thus only the stack memory of
+ * the current thread is read.  Neither acquires a lock nor allocates
+ * memory.  Returns the number of stored entries.
+ */
+STATIC int
+GC_walk_frame_pointers(struct callinfo info[NFRAMES], ptr_t fp,
+                       ptr_t stack_end, int skip)
+{
+  ptr_t lo = fp;
+  int n = 0;
+
+  while (n < NFRAMES) {
+    ptr_t ra;
+
+    if (ADDR_LT(fp, lo) || ADDR_GE(fp, stack_end)
+        || (ADDR(fp) & (sizeof(ptr_t) - 1)) != 0
+        || ADDR(fp) - ADDR(lo) > FP_UNWIND_MAX_FRAME_SIZE
+        || ADDR(stack_end) - ADDR(fp) < 2 * sizeof(ptr_t))
+      break;
+    ra = ((ptr_t *)fp)[1];
+    if (NULL == ra)
+      break;
+    if (skip > 0) {
+      skip--;
+    } else {
+      info[n++].ci_pc = CAST_THRU_UINTPTR(GC_return_addr_t, ra);
+    }
+    lo = fp + 2 * sizeof(ptr_t);
+    fp = *(ptr_t *)fp;
+  }
+  return n;
+}
+#      endif /* FRAME_POINTER_UNWIND */
+
+/*
+ * The number of the leading entries always skipped by `GC_save_callers()`:
+ * the frame of the function itself and that of its caller (the latter is
+ * a frame of the collector, e.g. `GC_debug_gcj_malloc`).  Note that
+ * `GC_save_callers()` should not be inlined for this to hold.
+ */
+#      define SAVE_CALLERS_SKIP 2
+
+/* The maximum value of `extra_skip` argument of `GC_save_callers()`. */
+#      define SAVE_CALLERS_MAX_EXTRA_SKIP 2
+
+#      if defined(FRAME_POINTER_UNWIND) && defined(GC_ASSERTIONS)
+/*
+ * Used by `GC_check_save_callers()` to force one of the methods of
+ * `GC_save_callers()`: 1 means the frame pointers walk, 2 means the
+ * `backtrace()` one.
+ */
+STATIC int GC_save_callers_method = 0;
+
+/*
+ * Check that both the methods of `GC_save_callers()` skip the same
+ * number of the frames (also if an extra frame is requested to be
+ * skipped), i.e. return the same first entry.  The frame pointer is forced for
+ * this function (so the walk passes through it).
+ */
+GC_ATTR_NOINLINE STATIC void
+GC_check_save_callers(void)
+{
+  struct callinfo fp_info[NFRAMES], bt_info[NFRAMES];
+
+  GC_ASSERT(I_HOLD_LOCK());
+  GC_noop1_ptr(__builtin_frame_address(0));
+  GC_save_callers_method = 1;
+  GC_save_callers(fp_info, 1);
+  GC_save_callers_method = 2;
+  GC_save_callers(bt_info, 1);
+  GC_save_callers_method = 0;
+  /* The walk yields nothing if frame pointers are omitted. */
+  GC_ASSERT(0 == fp_info[0].ci_pc || fp_info[0].ci_pc == bt_info[0].ci_pc);
+}
+#      endif
+
+GC_ATTR_NOINLINE GC_INNER void
+GC_save_callers(struct callinfo info[NFRAMES], int extra_skip)
 {
-  void *tmp_info[NFRAMES + 1];
+  void *tmp_info[NFRAMES + SAVE_CALLERS_SKIP + SAVE_CALLERS_MAX_EXTRA_SKIP];
   int npcs, i;
 
   /*
@@ -5673,6 +5974,45 @@ GC_save_callers(struct callinfo info[NFRAMES])
   GC_ASSERT(I_HOLD_LOCK());
 
   GC_STATIC_ASSERT(sizeof(struct callinfo) == sizeof(void *));
+  GC_ASSERT(extra_skip >= 0 && extra_skip <= SAVE_CALLERS_MAX_EXTRA_SKIP);
+#      ifdef FRAME_POINTER_UNWIND
+#        ifdef GC_ASSERTIONS
+  {
+    static GC_bool checked = FALSE;
+
+    if (EXPECT(!checked, FALSE)) {
+      checked = TRUE;
+      GC_check_save_callers();
+    }
+  }
+  if (GC_save_callers_method != 2)
+#        endif
+  {
+    ptr_t stack_end;
+    ptr_t fp = (ptr_t)__builtin_frame_address(0);
+
+#        ifdef THREADS
+    stack_end = GC_self_stack_end();
+#        else
+    stack_end = GC_stackbottom;
+#        endif
+    if (EXPECT(stack_end != NULL, TRUE)) {
+      /* The first record holds the return address to our caller. */
+      i = GC_walk_frame_pointers(info, fp, stack_end,
+                                 SAVE_CALLERS_SKIP - 1 + extra_skip);
+      if (EXPECT(i >= FP_UNWIND_MIN_FRAMES, TRUE)) {
+        BZERO(&info[i], sizeof(void *) * (unsigned)(NFRAMES - i));
+        return;
+      }
+#        ifdef GC_ASSERTIONS
+      if (1 == GC_save_callers_method) {
+        BZERO(info, sizeof(void *) * NFRAMES);
+        return;
+      }
+#        endif
+    }
+  }
+#      endif
 #      ifdef REDIRECT_MALLOC
   if (GC_in_save_callers) {
     info[0].ci_pc = CAST_THRU_UINTPTR(GC_return_addr_t, GC_save_callers);
@@ -5682,19 +6022,23 @@ GC_save_callers(struct callinfo info[NFRAMES])
   GC_in_save_callers = TRUE;
   /* `backtrace()` might call a redirected `malloc`. */
   UNLOCK();
-  npcs = backtrace((void **)tmp_info, NFRAMES + 1);
+  npcs = backtrace((void **)tmp_info,
+                   NFRAMES + SAVE_CALLERS_SKIP + extra_skip);
   LOCK();
 #      else
-  npcs = backtrace((void **)tmp_info, NFRAMES + 1);
+  npcs = backtrace((void **)tmp_info,
+                   NFRAMES + SAVE_CALLERS_SKIP + extra_skip);
 #      endif
   /*
-   * We retrieve `NFRAMES + 1` `pc` values, but discard the first one,
-   * since it points to our own frame.
+   * We retrieve `NFRAMES + SAVE_CALLERS_SKIP + extra_skip` `pc` values,
+   * but discard the first ones, since these point to our own frame and
+   * those of the collector callers.
    */
+  extra_skip += SAVE_CALLERS_SKIP;
   i = 0;
-  if (npcs > 1) {
-    i = npcs - 1;
-    BCOPY(&tmp_info[1], info, (unsigned)i * sizeof(void *));
+  if (npcs > extra_skip) {
+    i = npcs - extra_skip;
+    BCOPY(&tmp_info[extra_skip], info, (unsigned)i * sizeof(void *));
   }
   BZERO(&info[i], sizeof(void *) * (unsigned)(NFRAMES - i));
 #      ifdef REDIRECT_MALLOC
@@ -5719,7 +6063,7 @@ GC_save_callers(struct callinfo info[NFRAMES])
 #      endif
 
 GC_INNER void
-GC_save_callers(struct callinfo info[NFRAMES])
+GC_save_callers(struct callinfo info[NFRAMES], int extra_skip)
 {
   struct frame *frame;
   struct frame *fp;
@@ -5745,6 +6089,12 @@ GC_save_callers(struct callinfo info[NFRAMES])
     int i;
 #      endif
 
+    if (extra_skip > 0) {
+      /* Skip a frame of the collector. */
+      extra_skip--;
+      nframes--;
+      continue;
+    }
     info[nframes].ci_pc = (GC_return_addr_t)fp->FR_SAVPC;
 #      if NARGS > 0
     for (i = 0; i < NARGS; i++) {
@@ -934,6 +934,52 @@ GC_self_thread(void)
   return p;
 }
 
+#  if defined(ALLOC_TAGS) && !defined(THREAD_LOCAL_ALLOC)
+GC_API void GC_CALL
+GC_set_allocation_tag(unsigned tag)
+{
+  GC_thread me;
+
+  if (!EXPECT(GC_is_initialized, TRUE))
+    GC_init();
+  LOCK();
+  me = GC_self_thread_inner();
+  if (EXPECT(me != NULL, TRUE))
+    me->alloc_tag = (unsigned short)(tag < GC_MAX_ALLOC_TAGS ? tag : 0);
+  UNLOCK();
+}
+
+GC_API unsigned GC_CALL
+GC_get_allocation_tag(void)
+{
+  GC_thread me = GC_self_thread();
+
+  return me != NULL ? me->alloc_tag : 0;
+}
+
+GC_INNER unsigned
+GC_current_alloc_tag(void)
+{
+  GC_thread me;
+
+  GC_ASSERT(I_HOLD_LOCK());
+  me = GC_self_thread_inner();
+  return me != NULL ? me->alloc_tag : 0;
+}
+#  endif
+
+#  ifdef FRAME_POINTER_UNWIND
+GC_INNER ptr_t
+GC_self_stack_end(void)
+{
+  GC_thread me;
+
+  GC_ASSERT(I_HOLD_LOCK());
+  me = GC_self_thread_inner();
+  return NULL == me ? NULL : me->crtn->stack_end;
+}
+#  endif
+
 #  ifndef GC_NO_FINALIZATION
 GC_INNER void
 GC_reset_finalizer_nested(void)
@@ -2383,6 +2429,9 @@ GC_unregister_my_thread_inner(GC_thread me)
 #  if defined(THREAD_LOCAL_ALLOC)
   GC_destroy_thread_local(&me->tlfs);
 #  endif
+#  ifdef TRACE_BUFFER
+  GC_trace_release_ring();
+#  endif
 #  ifdef NACL
   GC_nacl_shutdown_gc_thread();
 #  endif
@@ -2911,14 +2960,11 @@ GC_wrap_pthread_create(pthread_t *new_thread,
 
 #  endif /* GC_PTHREADS && !PLATFORM_THREADS && !SN_TARGET_PSP2 */
 
-#  if ((defined(GC_PTHREADS_PARAMARK) || defined(USE_PTHREAD_LOCKS)) \
-       && !defined(NO_PTHREAD_TRYLOCK))                              \
-      || defined(USE_SPIN_LOCK)
 /*
  * Spend a few cycles in a way that cannot introduce contention with
  * other threads.
  */
-#    define GC_PAUSE_SPIN_CYCLES 10
+#  define GC_PAUSE_SPIN_CYCLES 10
 STATIC void
 GC_pause(void)
 {
@@ -2926,20 +2972,46 @@ GC_pause(void)
 
   for (i = 0; i < GC_PAUSE_SPIN_CYCLES; ++i) {
     /* Something that is unlikely to be optimized away. */
-#    if defined(AO_HAVE_compiler_barrier) && !defined(BASE_ATOMIC_OPS_EMULATED)
+#  if defined(AO_HAVE_compiler_barrier) && !defined(BASE_ATOMIC_OPS_EMULATED)
     AO_compiler_barrier();
-#    else
+#  else
     GC_noop1(i);
-#    endif
+#  endif
   }
 }
-#  endif /* USE_SPIN_LOCK || !NO_PTHREAD_TRYLOCK */
 
 #  ifndef SPIN_MAX
 /* Maximum number of calls to `GC_pause()` before give up. */
 #    define SPIN_MAX 128
 #  endif
 
+#  if !defined(GC_NO_FINALIZATION) && !defined(DBG_HDRS_ALL)
+GC_INNER void
+GC_spin_lock(volatile AO_TS_t *lock)
+{
+  unsigned pause_length = 1;
+
+  while (AO_test_and_set_acquire(lock) == AO_TS_SET) {
+    if (pause_length <= (unsigned)SPIN_MAX) {
+      unsigned i;
+
+      /* Exponential back-off, the same as in `GC_generic_lock()`. */
+      for (i = 0; i < pause_length; ++i) {
+        GC_pause();
+      }
+      pause_length <<= 1;
+    } else {
+      /* The holder is probably preempted. */
+#    ifdef GC_WIN32_THREADS
+      Sleep(0);
+#    else
+      sched_yield();
+#    endif
+    }
+  }
+}
+#  endif
+
 #  if (!defined(USE_SPIN_LOCK) && !defined(NO_PTHREAD_TRYLOCK) \
        && defined(USE_PTHREAD_LOCKS))                          \
       || defined(GC_PTHREADS_PARAMARK)
@@ -49,10 +49,6 @@ STATIC void GC_reclaim_unconditionally_marked(void);
 
 #  include "private/dbg_mlc.h"
 
-#  ifndef MAX_SMASHED
-#    define MAX_SMASHED 20
-#  endif
-
 /*
  * List of smashed (clobbered) locations.  We defer printing these,
  * since we cannot always print them nicely with the allocator lock held.
@@ -480,6 +476,10 @@ GC_reclaim_generic(struct hblk *hbp, hdr *hhdr, size_t sz, GC_bool init,
   GC_ASSERT(I_HOLD_LOCK());
 #endif
   GC_ASSERT(GC_find_header(hbp) == hhdr);
+  if (GC_arrays._toggleref_arr != NULL && HBLKPTR(GC_arrays._toggleref_arr) == hbp && !GC_is_marked(GC_arrays._toggleref_arr)) {
+    GC_printf("DBGF gc_no=%lu last=%u coll=%d\n", (unsigned long)GC_gc_no, (unsigned)hhdr->hb_last_reclaimed, (int)GC_collection_in_progress());
+    GC_print_callers(GC_arrays._last_stack);
+  }
 #ifndef GC_DISABLE_INCREMENTAL
   GC_remove_protection(hbp, 1, IS_PTRFREE_SAFE(hhdr));
 #endif
@@ -554,11 +554,70 @@ GC_disclaim_and_reclaim_or_free_small_block(struct hblk *hbp)
   } else {
     GC_ASSERT(hbp == hhdr->hb_block);
     GC_bytes_found += (GC_signed_word)HBLKSIZE;
+    ALLOC_REC(GC_alloc_rec_release(hbp, HBLKSIZE));
     GC_freehblk(hbp);
   }
 }
 #endif /* ENABLE_DISCLAIM */
 
+#ifndef GC_GET_HEAP_USAGE_NOT_NEEDED
+/*
+ * The per-size-class counters gathered during the sweep: the number of
+ * the heap blocks in use and the total size of the marked objects in
+ * them.  Indexed by kind and object size in granules (zero is for the
+ * large objects).  Allocated on the first call of
+ * `GC_get_size_class_stats()`.
+ */
+struct size_class_sweep_s {
+  word blocks;
+  word live_bytes;
+};
+
+STATIC struct size_class_sweep_s (*GC_size_class_sweep)[MAXOBJGRANULES + 1]
+    = NULL;
+
+GC_INLINE void
+GC_size_class_sweep_add(const hdr *hhdr, size_t sz, word live_bytes)
+{
+  struct size_class_sweep_s *p;
+
+  GC_ASSERT(GC_size_class_sweep != NULL);
+  if (sz > MAXOBJBYTES) {
+    p = &GC_size_class_sweep[hhdr->hb_obj_kind][0];
+    p->blocks += OBJ_SZ_TO_BLOCKS(sz);
+  } else {
+    p = &GC_size_class_sweep[hhdr->hb_obj_kind][BYTES_TO_GRANULES(sz)];
+    p->blocks++;
+  }
+  p->live_bytes += live_bytes;
+}
+#endif /* !GC_GET_HEAP_USAGE_NOT_NEEDED */
+
+#ifdef ALLOC_TAGS
+/*
+ * The per-tag counters gathered during the sweep: the total size and
+ * the number of the marked objects.  Indexed by the allocation tag.
+ * Allocated on the first call of `GC_get_tag_stats()`.
+ */
+struct tag_sweep_s {
+  word live_bytes;
+  word live_objs;
+};
+
+STATIC struct tag_sweep_s *GC_tag_sweep = NULL;
+
+GC_INLINE void
+GC_tag_sweep_add(const hdr *hhdr, size_t sz, size_t n_marks)
+{
+  struct tag_sweep_s *p;
+
+  GC_ASSERT(GC_tag_sweep != NULL && hhdr->hb_tag < GC_MAX_ALLOC_TAGS);
+  p = &GC_tag_sweep[hhdr->hb_tag];
+  p->live_bytes += (word)sz * n_marks;
+  p->live_objs += n_marks;
+}
+#endif
+
 /*
  * Restore an unmarked large object or an entirely empty block of
  * small objects to the heap block free list.  Otherwise enqueue the
@@ -612,6 +671,7 @@ GC_reclaim_block(struct hblk *hbp, void *report_if_found)
           GC_large_allocd_bytes -= HBLKSIZE * OBJ_SZ_TO_BLOCKS(sz);
         }
         GC_bytes_found += (GC_signed_word)sz;
+        ALLOC_REC(GC_alloc_rec_release(hbp, HBLKSIZE * OBJ_SZ_TO_BLOCKS(sz)));
         GC_freehblk(hbp);
         FREE_PROFILER_HOOK(hbp);
       }
@@ -624,6 +684,14 @@ GC_reclaim_block(struct hblk *hbp, void *report_if_found)
       } else {
         GC_composite_in_use += sz;
       }
+#ifndef GC_GET_HEAP_USAGE_NOT_NEEDED
+      if (GC_size_class_sweep != NULL && !report_if_found)
+        GC_size_class_sweep_add(hhdr, sz, sz);
+#endif
+#ifdef ALLOC_TAGS
+      if (GC_tag_sweep != NULL && !report_if_found)
+        GC_tag_sweep_add(hhdr, sz, 1);
+#endif
     }
   } else {
     GC_bool empty = GC_block_empty(hhdr);
@@ -672,6 +740,7 @@ GC_reclaim_block(struct hblk *hbp, void *report_if_found)
 #endif
       /* else */ {
         GC_bytes_found += (GC_signed_word)HBLKSIZE;
+        ALLOC_REC(GC_alloc_rec_release(hbp, HBLKSIZE));
         GC_freehblk(hbp);
         FREE_PROFILER_HOOK(hbp);
       }
@@ -697,6 +766,14 @@ GC_reclaim_block(struct hblk *hbp, void *report_if_found)
     } else {
       GC_composite_in_use += (word)sz * hhdr->hb_n_marks;
     }
+#ifndef GC_GET_HEAP_USAGE_NOT_NEEDED
+    if (GC_size_class_sweep != NULL && !report_if_found && !empty)
+      GC_size_class_sweep_add(hhdr, sz, (word)sz * hhdr->hb_n_marks);
+#endif
+#ifdef ALLOC_TAGS
+    if (GC_tag_sweep != NULL && !report_if_found && !empty)
+      GC_tag_sweep_add(hhdr, sz, hhdr->hb_n_marks);
+#endif
   }
 }
 
@@ -873,6 +950,64 @@ GC_clear_fl_links(void **flp)
   }
 }
 
+#ifndef RECLAIM_ORDER_BUCKETS
+/* The number of the occupancy classes used by `GC_sort_reclaim_list`. */
+#  define RECLAIM_ORDER_BUCKETS 8
+#endif
+
+/*
+ * Reorder the blocks of the given reclaim list by their occupancy (i.e.
+ * the number of marked objects), the fullest blocks first.  Thus the
+ * allocation refills from the fullest reusable blocks first, and the
+ * nearly empty blocks are swept last (if at all before the next
+ * collection), giving them a chance to become entirely free and to be
+ * returned to the heap block free list.  This is a stable bucket sort,
+ * which touches only the block headers; `hb_n_marks` may be slightly
+ * inaccurate in case of the parallel marking, which is OK here.
+ */
+STATIC void
+GC_sort_reclaim_list(struct hblk **rlh, size_t lg)
+{
+  struct hblk *heads[RECLAIM_ORDER_BUCKETS];
+  struct hblk **tails[RECLAIM_ORDER_BUCKETS];
+  size_t n_objs = HBLK_OBJS(GRANULES_TO_BYTES(lg));
+  struct hblk *hbp;
+  int i;
+
+  if (NULL == *rlh || NULL == HDR(*rlh)->hb_next) {
+    /* Nothing to reorder. */
+    return;
+  }
+
+  for (i = 0; i < RECLAIM_ORDER_BUCKETS; i++) {
+    heads[i] = NULL;
+    tails[i] = &heads[i];
+  }
+  for (hbp = *rlh; hbp != NULL;) {
+    hdr *hhdr = HDR(hbp);
+    size_t n_marks = hhdr->hb_n_marks;
+    struct hblk *next = hhdr->hb_next;
+
+    /* The fullest bucket goes first. */
+    i = RECLAIM_ORDER_BUCKETS - 1
+        - (int)(n_marks < n_objs ? n_marks * RECLAIM_ORDER_BUCKETS / n_objs
+                                 : RECLAIM_ORDER_BUCKETS - 1);
+    hhdr->hb_next = NULL;
+    *tails[i] = hbp;
+    tails[i] = &hhdr->hb_next;
+    hbp = next;
+  }
+
+  /* Concatenate the buckets. */
+  for (i = 0; i < RECLAIM_ORDER_BUCKETS; i++) {
+    if (heads[i] != NULL) {
+      *rlh = heads[i];
+      rlh = tails[i];
+    }
+  }
+  *rlh = NULL;
+}
+
 GC_INNER void
 GC_start_reclaim(GC_bool report_if_found)
 {
@@ -885,6 +1020,15 @@ GC_start_reclaim(GC_bool report_if_found)
   /* Reset in-use counters.  `GC_reclaim_block` recomputes them. */
   GC_composite_in_use = 0;
   GC_atomic_in_use = 0;
+#ifndef GC_GET_HEAP_USAGE_NOT_NEEDED
+  if (GC_size_class_sweep != NULL && !report_if_found)
+    BZERO(GC_size_class_sweep,
+          sizeof(GC_size_class_sweep[0]) * (size_t)MAXOBJKINDS);
+#endif
+#ifdef ALLOC_TAGS
+  if (GC_tag_sweep != NULL && !report_if_found)
+    BZERO(GC_tag_sweep, sizeof(struct tag_sweep_s) * GC_MAX_ALLOC_TAGS);
+#endif
 
   /* Clear reclaim- and free-lists. */
   for (kind = 0; kind < (int)GC_n_kinds; kind++) {
@@ -922,6 +1066,19 @@ GC_start_reclaim(GC_bool report_if_found)
    */
   GC_apply_to_all_blocks(GC_reclaim_block, NUMERIC_TO_VPTR(report_if_found));
 
+  if (!report_if_found) {
+    for (kind = 0; kind < (int)GC_n_kinds; kind++) {
+      struct hblk **rlist = GC_obj_kinds[kind].ok_reclaim_list;
+      size_t lg;
+
+      if (NULL == rlist)
+        continue;
+      for (lg = 1; lg <= MAXOBJGRANULES; lg++) {
+        GC_sort_reclaim_list(rlist + lg, lg);
+      }
+    }
+  }
+
 #ifdef EAGER_SWEEP
   /*
    * This is a very stupid thing to do.  We make it possible anyway.
@@ -1099,3 +1256,289 @@ GC_enumerate_reachable_objects_inner(GC_reachable_object_proc proc,
   ed.client_data = client_data;
   GC_apply_to_all_blocks(GC_do_enumerate_reachable_objects, &ed);
 }
+
+#ifndef GC_GET_HEAP_USAGE_NOT_NEEDED
+/*
+ * Estimate the sweep counters from the current mark bits.  Used only
+ * once, when the counters are allocated.
+ */
+STATIC void GC_CALLBACK
+GC_size_class_sweep_init(struct hblk *hbp, void *dummy)
+{
+  const hdr *hhdr = HDR(hbp);
+  size_t sz = hhdr->hb_sz;
+
+  UNUSED_ARG(dummy);
+  if (sz > MAXOBJBYTES) {
+    if (mark_bit_from_hdr(hhdr, 0))
+      GC_size_class_sweep_add(hhdr, sz, sz);
+  } else if (!GC_block_empty(hhdr)) {
+    GC_size_class_sweep_add(hhdr, sz, (word)sz * hhdr->hb_n_marks);
+  }
+}
+
+struct size_class_stats_s {
+  struct GC_size_class_stats_s *stats;
+  unsigned n_kinds;
+  size_t n_granules;
+};
+
+STATIC void GC_CALLBACK
+GC_size_class_stats_add_block(struct hblk *hbp, void *client_data)
+{
+  const struct size_class_stats_s *pss
+      = (const struct size_class_stats_s *)client_data;
+  const hdr *hhdr = HDR(hbp);
+  size_t sz = hhdr->hb_sz;
+  size_t lg = sz > MAXOBJBYTES ? 0 : BYTES_TO_GRANULES(sz);
+  /* The block is swept (or allocated) since the recent collection. */
+  GC_bool is_recent = hhdr->hb_last_reclaimed == (unsigned short)GC_gc_no;
+  struct GC_size_class_stats_s *p;
+
+  if (hhdr->hb_obj_kind >= pss->n_kinds || lg >= pss->n_granules)
+    return;
+  p = &pss->stats[hhdr->hb_obj_kind * pss->n_granules + lg];
+  if (0 == lg) {
+    p->blocks_in_use += OBJ_SZ_TO_BLOCKS(sz);
+    if (is_recent && !mark_bit_from_hdr(hhdr, 0))
+      p->allocd_bytes_since_gc += sz;
+  } else {
+    size_t n_objs = HBLK_OBJS(sz);
+    size_t n_marks = hhdr->hb_n_marks;
+
+    p->blocks_in_use++;
+    /*
+     * The unmarked objects of such a block are either allocated or on
+     * the free list (the latter ones are subtracted by the caller).
+     */
+    if (is_recent && n_marks < n_objs)
+      p->allocd_bytes_since_gc += (word)(n_objs - n_marks) * sz;
+  }
+}
+
+GC_API size_t GC_CALL
+GC_get_size_class_stats(struct GC_size_class_stats_s *stats, unsigned n_kinds,
+                        size_t n_granules)
+{
+  struct size_class_stats_s ss;
+  unsigned kind;
+  size_t lg;
+
+  if (0 == n_kinds || 0 == n_granules)
+    return MAXOBJGRANULES + 1;
+  GC_ASSERT(stats != NULL);
+  BZERO(stats, sizeof(struct GC_size_class_stats_s) * n_kinds * n_granules);
+  if (!EXPECT(GC_is_initialized, TRUE))
+    GC_init();
+
+  LOCK();
+  if (NULL == GC_size_class_sweep) {
+    GC_size_class_sweep = (struct size_class_sweep_s(*)[MAXOBJGRANULES + 1])
+        GC_scratch_alloc(sizeof(GC_size_class_sweep[0])
+                         * (size_t)MAXOBJKINDS);
+    if (GC_size_class_sweep != NULL) {
+      BZERO(GC_size_class_sweep,
+            sizeof(GC_size_class_sweep[0]) * (size_t)MAXOBJKINDS);
+      if (!GC_collection_in_progress())
+        GC_apply_to_all_blocks(GC_size_class_sweep_init, NULL);
+    }
+  }
+  ss.stats = stats;
+  ss.n_kinds = n_kinds < GC_n_kinds ? n_kinds : GC_n_kinds;
+  ss.n_granules
+      = n_granules < MAXOBJGRANULES + 1 ? n_granules : MAXOBJGRANULES + 1;
+  GC_apply_to_all_blocks(GC_size_class_stats_add_block, &ss);
+
+  for (kind = 0; kind < ss.n_kinds; kind++) {
+    void **fl = GC_obj_kinds[kind].ok_freelist;
+
+    for (lg = 0; lg < ss.n_granules; lg++) {
+      struct GC_size_class_stats_s *p = &stats[kind * n_granules + lg];
+
+      if (lg > 0 && fl != NULL) {
+        word free_bytes;
+        void *q;
+
+        for (q = fl[lg]; q != NULL; q = obj_link(q))
+          p->free_objs++;
+        free_bytes = p->free_objs * GRANULES_TO_BYTES(lg);
+        p->allocd_bytes_since_gc = p->allocd_bytes_since_gc > free_bytes
+                                       ? p->allocd_bytes_since_gc - free_bytes
+                                       : 0;
+      }
+      if (GC_size_class_sweep != NULL) {
+        const struct size_class_sweep_s *psw = &GC_size_class_sweep[kind][lg];
+        word total = psw->blocks * HBLKSIZE;
+
+        p->live_bytes = psw->live_bytes;
+        if (total > psw->live_bytes) {
+          word waste = total - psw->live_bytes;
+
+          p->fragmentation_permille = total < GC_WORD_MAX / 1000
+                                          ? waste * 1000 / total
+                                          : waste / (total / 1000);
+        }
+      }
+    }
+  }
+  UNLOCK();
+  return MAXOBJGRANULES + 1;
+}
+#endif /* !GC_GET_HEAP_USAGE_NOT_NEEDED */
+
+#ifdef ALLOC_TAGS
+#  ifndef THREADS
+STATIC unsigned short GC_alloc_tag = 0;
+
+GC_API void GC_CALL
+GC_set_allocation_tag(unsigned tag)
+{
+  GC_alloc_tag = (unsigned short)(tag < GC_MAX_ALLOC_TAGS ? tag : 0);
+}
+
+GC_API unsigned GC_CALL
+GC_get_allocation_tag(void)
+{
+  return GC_alloc_tag;
+}
+
+GC_INNER unsigned
+GC_current_alloc_tag(void)
+{
+  return GC_alloc_tag;
+}
+#  endif
+
+/*
+ * Estimate the per-tag sweep counters from the current mark bits.
+ * Used only once, when the counters are allocated.
+ */
+STATIC void GC_CALLBACK
+GC_tag_sweep_init(struct hblk *hbp, void *dummy)
+{
+  const hdr *hhdr = HDR(hbp);
+  size_t sz = hhdr->hb_sz;
+
+  UNUSED_ARG(dummy);
+  if (sz > MAXOBJBYTES) {
+    if (mark_bit_from_hdr(hhdr, 0))
+      GC_tag_sweep_add(hhdr, sz, 1);
+  } else if (!GC_block_empty(hhdr)) {
+    GC_tag_sweep_add(hhdr, sz, hhdr->hb_n_marks);
+  }
+}
+
+struct tag_stats_s {
+  struct GC_tag_stats_s *stats;
+  unsigned n_tags;
+};
+
+STATIC void GC_CALLBACK
+GC_tag_stats_add_block(struct hblk *hbp, void *client_data)
+{
+  const struct tag_stats_s *pts = (const struct tag_stats_s *)client_data;
+  const hdr *hhdr = HDR(hbp);
+  size_t sz = hhdr->hb_sz;
+  /* The block is swept (or allocated) since the recent collection. */
+  GC_bool is_recent = hhdr->hb_last_reclaimed == (unsigned short)GC_gc_no;
+  struct GC_tag_stats_s *p;
+
+  if (hhdr->hb_tag >= pts->n_tags)
+    return;
+  p = &pts->stats[hhdr->hb_tag];
+  p->heap_bytes += HBLKSIZE * OBJ_SZ_TO_BLOCKS(sz);
+  if (sz > MAXOBJBYTES) {
+    if (is_recent && !mark_bit_from_hdr(hhdr, 0))
+      p->allocd_bytes_since_gc += sz;
+  } else {
+    size_t n_objs = HBLK_OBJS(sz);
+    size_t n_marks = hhdr->hb_n_marks;
+
+    /* The free-list objects are subtracted by the caller. */
+    if (is_recent && n_marks < n_objs)
+      p->allocd_bytes_since_gc += (word)(n_objs - n_marks) * sz;
+  }
+}
+
+GC_API unsigned GC_CALL
+GC_get_tag_stats(struct GC_tag_stats_s *stats, unsigned n_tags)
+{
+  struct tag_stats_s ts;
+  unsigned kind, tag;
+  size_t lg;
+
+  if (0 == n_tags)
+    return GC_MAX_ALLOC_TAGS;
+  GC_ASSERT(stats != NULL);
+  BZERO(stats, sizeof(struct GC_tag_stats_s) * n_tags);
+  if (!EXPECT(GC_is_initialized, TRUE))
+    GC_init();
+
+  LOCK();
+  if (NULL == GC_tag_sweep) {
+    GC_tag_sweep = (struct tag_sweep_s *)GC_scratch_alloc(
+        sizeof(struct tag_sweep_s) * GC_MAX_ALLOC_TAGS);
+    if (GC_tag_sweep != NULL) {
+      BZERO(GC_tag_sweep, sizeof(struct tag_sweep_s) * GC_MAX_ALLOC_TAGS);
+      if (!GC_collection_in_progress())
+        GC_apply_to_all_blocks(GC_tag_sweep_init, NULL);
+    }
+  }
+  ts.stats = stats;
+  ts.n_tags = n_tags < GC_MAX_ALLOC_TAGS ? n_tags : GC_MAX_ALLOC_TAGS;
+  GC_apply_to_all_blocks(GC_tag_stats_add_block, &ts);
+
+  for (kind = 0; kind < GC_n_kinds; kind++) {
+    void **fl = GC_obj_kinds[kind].ok_freelist;
+
+    if (NULL == fl)
+      continue;
+    for (lg = 1; lg <= MAXOBJGRANULES; lg++) {
+      void *q;
+
+      for (q = fl[lg]; q != NULL; q = obj_link(q)) {
+        struct GC_tag_stats_s *p;
+
+        tag = HDR(q)->hb_tag;
+        if (tag >= ts.n_tags)
+          continue;
+        p = &stats[tag];
+        p->allocd_bytes_since_gc
+            = p->allocd_bytes_since_gc > GRANULES_TO_BYTES(lg)
+                  ? p->allocd_bytes_since_gc - GRANULES_TO_BYTES(lg)
+                  : 0;
+      }
+    }
+  }
+  if (GC_tag_sweep != NULL) {
+    for (tag = 0; tag < ts.n_tags; tag++) {
+      stats[tag].live_bytes = GC_tag_sweep[tag].live_bytes;
+      stats[tag].live_objs = GC_tag_sweep[tag].live_objs;
+    }
+  }
+  UNLOCK();
+  return GC_MAX_ALLOC_TAGS;
+}
+
+#else /* !ALLOC_TAGS */
+
+GC_API void GC_CALL
+GC_set_allocation_tag(unsigned tag)
+{
+  UNUSED_ARG(tag);
+}
+
+GC_API unsigned GC_CALL
+GC_get_allocation_tag(void)
+{
+  return 0;
+}
+
+GC_API unsigned GC_CALL
+GC_get_tag_stats(struct GC_tag_stats_s *stats, unsigned n_tags)
+{
+  UNUSED_ARG(stats);
+  UNUSED_ARG(n_tags);
+  return 0;
+}
+#endif /* !ALLOC_TAGS */
@@ -0,0 +1,672 @@
+/*
+ * THIS MATERIAL IS PROVIDED AS IS, WITH ABSOLUTELY NO WARRANTY EXPRESSED
+ * OR IMPLIED.  ANY USE IS AT YOUR OWN RISK.
+ *
+ * Permission is hereby granted to use or copy this program
+ * for any purpose, provided the above notices are retained on all copies.
+ * Permission to modify the code and to distribute modified code is granted,
+ * provided the above notices are retained, and a notice that the code was
+ * modified is included with the above copyright notice.
+ */
+
+/*
+ * Replay an allocation recording (see `GC_start_alloc_recording`)
+ * against the collector: the objects of the same sizes and kinds are
+ * allocated in the same order, the recorded pointer stores and explicit
+ * deallocations are repeated, so the effect of the allocation policy
+ * settings (e.g. `GC_FREE_SPACE_DIVISOR` or `GC_INITIAL_HEAP_SIZE`) could
+ * be measured on a realistic workload.  Usage: `allocreplay [<file>]`.
+ * Without the argument, a small workload is recorded and replayed.
+ *
+ * The recording does not have the exact death points of the objects;
+ * an object is considered dead since the latest recorded collection
+ * preceding the reuse of its address (by another allocation) or the
+ * deallocation of the heap block containing it, thus the replay drops
+ * the reference to the object just before that collection.  The replay
+ * is single-threaded, the recorded timestamps and threads are ignored.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "gc.h"
+
+/* Keep in sync with `allocrec.c` file. */
+#define ALLOC_REC_MAGIC "GCar"
+#define ALLOC_REC_VERSION 1
+
+#define ALLOC_REC_END 0
+#define ALLOC_REC_ALLOC 1
+#define ALLOC_REC_FREE 2
+#define ALLOC_REC_STORE 3
+#define ALLOC_REC_COLLECT 4
+#define ALLOC_REC_RELEASE 5
+#define ALLOC_REC_THREAD 6
+
+/* The object kinds (as `GC_I_PTRFREE` and `GC_I_NORMAL`). */
+#define KIND_PTRFREE 0
+#define KIND_UNCOLLECTABLE 2
+
+#define NO_OBJ ((size_t)-1)
+
+/* Marks the end of the list of objects of a freed block. */
+#define FREED_BLOCK ((size_t)-2)
+
+#define CHECK_OUT_OF_MEMORY(p)            \
+  do {                                    \
+    if (NULL == (p)) {                    \
+      fprintf(stderr, "Out of memory\n"); \
+      exit(69);                           \
+    }                                     \
+  } while (0)
+
+struct reader_s {
+  const unsigned char *p;
+  const unsigned char *lim;
+  GC_word last_addr;
+};
+
+static int
+get_num(struct reader_s *r, GC_word *pv)
+{
+  GC_word v = 0;
+  unsigned shift = 0;
+
+  for (;;) {
+    unsigned char c;
+
+    if (r->p == r->lim || shift >= sizeof(GC_word) * 8)
+      return 0;
+    c = *r->p++;
+    v |= (GC_word)(c & 0x7f) << shift;
+    if ((c & 0x80) == 0)
+      break;
+    shift += 7;
+  }
+  *pv = v;
+  return 1;
+}
+
+static int
+get_addr(struct reader_s *r, GC_word *pv)
+{
+  GC_word d;
+
+  if (!get_num(r, &d))
+    return 0;
+  /* Undo the zigzag encoding. */
+  r->last_addr += (d >> 1) ^ (~(d & 1) + 1);
+  *pv = r->last_addr;
+  return 1;
+}
+
+/* A decoded record. */
+struct rec_s {
+  unsigned type;
+  GC_word addr; /*< the object or block address */
+  GC_word size; /*< the object or block size, or the store offset */
+  GC_word kind;
+  GC_word dest; /*< the stored address, or zero */
+};
+
+/* Returns 0 on the end of the recording, -1 if the data is malformed. */
+static int
+next_record(struct reader_s *r, struct rec_s *rec)
+{
+  GC_word v;
+
+  for (;;) {
+    if (r->p == r->lim)
+      return -1;
+    rec->type = *r->p++;
+    if (rec->type != ALLOC_REC_THREAD)
+      break;
+    if (!get_num(r, &v))
+      return -1;
+  }
+  switch (rec->type) {
+  case ALLOC_REC_END:
+    return 0;
+  case ALLOC_REC_ALLOC:
+    if (!get_num(r, &v) || !get_num(r, &rec->size) || !get_num(r, &rec->kind)
+        || !get_addr(r, &rec->addr))
+      return -1;
+    break;
+  case ALLOC_REC_FREE:
+    if (!get_addr(r, &rec->addr))
+      return -1;
+    break;
+  case ALLOC_REC_STORE:
+    if (!get_addr(r, &rec->addr) || !get_num(r, &v))
+      return -1;
+    rec->size = v >> 1;
+    rec->dest = 0;
+    if ((v & 1) != 0 && !get_addr(r, &rec->dest))
+      return -1;
+    break;
+  case ALLOC_REC_COLLECT:
+    /* The time, the collection number, heap size and bytes allocated. */
+    if (!get_num(r, &v) || !get_num(r, &rec->addr) || !get_num(r, &rec->size)
+        || !get_num(r, &rec->kind))
+      return -1;
+    break;
+  case ALLOC_REC_RELEASE:
+    if (!get_addr(r, &rec->addr) || !get_num(r, &rec->size))
+      return -1;
+    break;
+  default:
+    return -1;
+  }
+  return 1;
+}
+
+/* The map from an address to the index of the recent object there. */
+struct addr_map_s {
+  GC_word *keys;
+  size_t *values;
+  size_t log_size;
+  size_t count;
+};
+
+static size_t *
+map_slot(struct addr_map_s *m, GC_word a)
+{
+  size_t mask = ((size_t)1 << m->log_size) - 1;
+  size_t i = (size_t)((a >> 3) * 0x9E3779B1UL) & mask;
+
+  while (m->values[i] != NO_OBJ && m->keys[i] != a)
+    i = (i + 1) & mask;
+  m->keys[i] = a;
+  return &m->values[i];
+}
+
+static void
+map_init(struct addr_map_s *m, size_t log_size)
+{
+  size_t i;
+  size_t n = (size_t)1 << log_size;
+
+  m->keys = (GC_word *)malloc(n * sizeof(GC_word));
+  m->values = (size_t *)malloc(n * sizeof(size_t));
+  CHECK_OUT_OF_MEMORY(m->keys);
+  CHECK_OUT_OF_MEMORY(m->values);
+  for (i = 0; i < n; i++)
+    m->values[i] = NO_OBJ;
+  m->log_size = log_size;
+  m->count = 0;
+}
+
+static size_t
+map_get(struct addr_map_s *m, GC_word a)
+{
+  return *map_slot(m, a);
+}
+
+static void
+map_put(struct addr_map_s *m, GC_word a, size_t idx)
+{
+  size_t *pv;
+
+  if (2 * (m->count + 1) > ((size_t)1 << m->log_size)) {
+    struct addr_map_s old = *m;
+    size_t i;
+
+    map_init(m, old.log_size + 1);
+    for (i = 0; i < ((size_t)1 << old.log_size); i++) {
+      if (old.values[i] != NO_OBJ) {
+        *map_slot(m, old.keys[i]) = old.values[i];
+        m->count++;
+      }
+    }
+    free(old.keys);
+    free(old.values);
+  }
+  pv = map_slot(m, a);
+  if (NO_OBJ == *pv)
+    m->count++;
+  *pv = idx;
+}
+
+static void
+map_free(struct addr_map_s *m)
+{
+  free(m->keys);
+  free(m->values);
+}
+
+static void *
+grow_array(void *a, size_t *pcap, size_t elem_sz)
+{
+  *pcap = *pcap != 0 ? *pcap * 2 : 1024;
+  a = realloc(a, *pcap * elem_sz);
+  CHECK_OUT_OF_MEMORY(a);
+  return a;
+}
+
+/*
+ * The replayed objects.  Only the objects which are not dropped yet are
+ * kept in the (uncollectable) table of slots, thus the size of the table
+ * is proportional to the live objects.
+ */
+struct obj_table_s {
+  void **slots;
+  size_t *free_slots;
+  size_t n_free;
+  size_t top;
+  size_t cap;
+  size_t *slot_of; /*< per object: its slot, or `NO_OBJ` */
+};
+
+static void *
+obj_get(struct obj_table_s *t, size_t idx)
+{
+  size_t s = t->slot_of[idx];
+
+  return s != NO_OBJ ? t->slots[s] : NULL;
+}
+
+static void
+obj_set(struct obj_table_s *t, size_t idx, void *p)
+{
+  size_t s;
+
+  if (t->n_free > 0) {
+    s = t->free_slots[--t->n_free];
+  } else {
+    if (t->top == t->cap) {
+      size_t cap = t->cap != 0 ? t->cap * 2 : 1024;
+      void **slots = (void **)GC_MALLOC_UNCOLLECTABLE(cap * sizeof(void *));
+
+      CHECK_OUT_OF_MEMORY(slots);
+      if (t->slots != NULL) {
+        memcpy(slots, t->slots, t->cap * sizeof(void *));
+        GC_FREE(t->slots);
+      }
+      t->slots = slots;
+      t->free_slots = (size_t *)realloc(t->free_slots, cap * sizeof(size_t));
+      CHECK_OUT_OF_MEMORY(t->free_slots);
+      t->cap = cap;
+    }
+    s = t->top++;
+  }
+  t->slots[s] = p;
+  t->slot_of[idx] = s;
+}
+
+static void
+obj_drop(struct obj_table_s *t, size_t idx)
+{
+  size_t s = t->slot_of[idx];
+
+  if (s != NO_OBJ) {
+    t->slots[s] = NULL;
+    t->free_slots[t->n_free++] = s;
+    t->slot_of[idx] = NO_OBJ;
+  }
+}
+
+struct replay_stats_s {
+  size_t n_allocs;
+  size_t n_stores;
+  size_t n_frees;
+  size_t n_collections;
+  GC_word alloc_bytes;
+  GC_word last_heap_size; /*< as recorded */
+};
+
+/*
+ * Replay the recording held in the given buffer.  Returns 0 on success,
+ * -1 if the recording is malformed.
+ */
+static int
+replay(const unsigned char *buf, size_t len, struct replay_stats_s *st)
+{
+  struct reader_s r;
+  struct rec_s rec;
+  struct addr_map_s map;
+  GC_word v, hblk_sz = 0;
+  size_t n_allocs = 0, allocs_cap = 0;
+  size_t n_gcs = 0;
+  size_t *death_gc = NULL;  /*< per object: the collection to drop it at */
+  size_t *birth_gc = NULL;  /*< per object: the next collection */
+  size_t *next_drop = NULL; /*< per object: the next one to drop */
+  size_t *blk_next = NULL;  /*< per object: the next one in the block */
+  size_t *drop_head = NULL; /*< per collection */
+  struct addr_map_s blk_map; /*< block address to its recent object */
+  struct obj_table_s objs;
+  GC_word *sizes;
+  unsigned char *kinds;
+  size_t i;
+  int res;
+
+  memset(st, 0, sizeof(*st));
+  if (len < 4 || memcmp(buf, ALLOC_REC_MAGIC, 4) != 0)
+    return -1;
+  r.p = buf + 4;
+  r.lim = buf + len;
+  r.last_addr = 0;
+  if (!get_num(&r, &v) || v != ALLOC_REC_VERSION || !get_num(&r, &v)
+      || !get_num(&r, &hblk_sz) || !get_num(&r, &v) || 0 == hblk_sz
+      || (hblk_sz & (hblk_sz - 1)) != 0)
+    return -1;
+
+  /*
+   * The first pass: find the collection before which each object should
+   * be dropped.
+   */
+  map_init(&map, 10);
+  map_init(&blk_map, 10);
+  {
+    struct reader_s r1 = r;
+
+    while ((res = next_record(&r1, &rec)) > 0) {
+      size_t idx;
+
+      switch (rec.type) {
+      case ALLOC_REC_ALLOC:
+        if (n_allocs == allocs_cap) {
+          size_t cap = allocs_cap;
+
+          death_gc = (size_t *)grow_array(death_gc, &cap, sizeof(size_t));
+          cap = allocs_cap;
+          birth_gc = (size_t *)grow_array(birth_gc, &cap, sizeof(size_t));
+          cap = allocs_cap;
+          blk_next = (size_t *)grow_array(blk_next, &cap, sizeof(size_t));
+          allocs_cap = cap;
+        }
+        idx = map_get(&map, rec.addr);
+        if (idx != NO_OBJ && NO_OBJ == death_gc[idx]
+            && birth_gc[idx] < n_gcs)
+          death_gc[idx] = n_gcs - 1;
+        death_gc[n_allocs] = NO_OBJ;
+        birth_gc[n_allocs] = n_gcs;
+        map_put(&map, rec.addr, n_allocs);
+        blk_next[n_allocs] = map_get(&blk_map, rec.addr & ~(hblk_sz - 1));
+        map_put(&blk_map, rec.addr & ~(hblk_sz - 1), n_allocs);
+        n_allocs++;
+        break;
+      case ALLOC_REC_COLLECT:
+        n_gcs++;
+        break;
+      case ALLOC_REC_RELEASE:
+        for (v = 0; v < rec.size; v += hblk_sz) {
+          for (idx = map_get(&blk_map, rec.addr + v);
+               idx != NO_OBJ && idx != FREED_BLOCK; idx = blk_next[idx]) {
+            if (NO_OBJ == death_gc[idx] && birth_gc[idx] < n_gcs)
+              death_gc[idx] = n_gcs - 1;
+          }
+          map_put(&blk_map, rec.addr + v, FREED_BLOCK);
+        }
+        break;
+      }
+    }
+    if (res < 0)
+      return -1;
+  }
+  map_free(&blk_map);
+  free(blk_next);
+  free(birth_gc);
+
+  /* Build the per-collection lists of the objects to drop. */
+  next_drop = (size_t *)malloc((n_allocs + 1) * sizeof(size_t));
+  drop_head = (size_t *)malloc((n_gcs + 1) * sizeof(size_t));
+  CHECK_OUT_OF_MEMORY(next_drop);
+  CHECK_OUT_OF_MEMORY(drop_head);
+  for (i = 0; i <= n_gcs; i++)
+    drop_head[i] = NO_OBJ;
+  for (i = 0; i < n_allocs; i++) {
+    if (death_gc[i] != NO_OBJ) {
+      next_drop[i] = drop_head[death_gc[i]];
+      drop_head[death_gc[i]] = i;
+    }
+  }
+  free(death_gc);
+
+  /* The second pass: do the allocations. */
+  memset(&objs, 0, sizeof(objs));
+  objs.slot_of = (size_t *)malloc((n_allocs + 1) * sizeof(size_t));
+  sizes = (GC_word *)malloc((n_allocs + 1) * sizeof(GC_word));
+  kinds = (unsigned char *)malloc(n_allocs + 1);
+  CHECK_OUT_OF_MEMORY(objs.slot_of);
+  CHECK_OUT_OF_MEMORY(sizes);
+  CHECK_OUT_OF_MEMORY(kinds);
+  map_free(&map);
+  map_init(&map, 10);
+  n_allocs = 0;
+  n_gcs = 0;
+  while ((res = next_record(&r, &rec)) > 0) {
+    size_t idx;
+
+    switch (rec.type) {
+    case ALLOC_REC_ALLOC: {
+      void *p;
+
+      switch (rec.kind) {
+      case KIND_PTRFREE:
+        p = GC_MALLOC_ATOMIC((size_t)rec.size);
+        break;
+      case KIND_UNCOLLECTABLE:
+        p = GC_MALLOC_UNCOLLECTABLE((size_t)rec.size);
+        break;
+      default:
+        p = GC_MALLOC((size_t)rec.size);
+      }
+      CHECK_OUT_OF_MEMORY(p);
+      obj_set(&objs, n_allocs, p);
+      sizes[n_allocs] = rec.size;
+      kinds[n_allocs] = (unsigned char)(rec.kind != KIND_PTRFREE);
+      map_put(&map, rec.addr, n_allocs);
+      n_allocs++;
+      st->alloc_bytes += rec.size;
+      break;
+    }
+    case ALLOC_REC_FREE:
+      idx = map_get(&map, rec.addr);
+      if (idx != NO_OBJ && obj_get(&objs, idx) != NULL) {
+        GC_FREE(obj_get(&objs, idx));
+        obj_drop(&objs, idx);
+        st->n_frees++;
+      }
+      break;
+    case ALLOC_REC_STORE:
+      idx = map_get(&map, rec.addr);
+      if (idx != NO_OBJ && obj_get(&objs, idx) != NULL && kinds[idx] != 0) {
+        GC_word ofs = rec.size & ~(GC_word)(sizeof(void *) - 1);
+        size_t dest_idx = rec.dest != 0 ? map_get(&map, rec.dest) : NO_OBJ;
+        char *p = (char *)obj_get(&objs, idx) + ofs;
+
+        if (ofs + sizeof(void *) <= sizes[idx]) {
+          *(void **)p = dest_idx != NO_OBJ ? obj_get(&objs, dest_idx) : NULL;
+          GC_END_STUBBORN_CHANGE(p);
+          st->n_stores++;
+        }
+      }
+      break;
+    case ALLOC_REC_COLLECT:
+      for (idx = drop_head[n_gcs]; idx != NO_OBJ; idx = next_drop[idx])
+        obj_drop(&objs, idx);
+      n_gcs++;
+      st->last_heap_size = rec.size;
+      break;
+    }
+  }
+  st->n_allocs = n_allocs;
+  st->n_collections = n_gcs;
+  map_free(&map);
+  free(next_drop);
+  free(drop_head);
+  free(sizes);
+  free(kinds);
+  free(objs.slot_of);
+  free(objs.free_slots);
+  GC_FREE(objs.slots);
+  return res < 0 ? -1 : 0;
+}
+
+static int
+replay_file(const char *fname)
+{
+  FILE *f = fopen(fname, "rb");
+  unsigned char *buf;
+  long len;
+  struct replay_stats_s st;
+  GC_word gc_no;
+  clock_t start;
+  int res;
+
+  if (NULL == f) {
+    fprintf(stderr, "Cannot open %s\n", fname);
+    return 2;
+  }
+  if (fseek(f, 0, SEEK_END) != 0 || (len = ftell(f)) < 0
+      || fseek(f, 0, SEEK_SET) != 0) {
+    fprintf(stderr, "Cannot read %s\n", fname);
+    fclose(f);
+    return 2;
+  }
+  buf = (unsigned char *)malloc((size_t)len + 1);
+  CHECK_OUT_OF_MEMORY(buf);
+  if (fread(buf, 1, (size_t)len, f) != (size_t)len) {
+    fprintf(stderr, "Cannot read %s\n", fname);
+    fclose(f);
+    return 2;
+  }
+  fclose(f);
+
+  gc_no = GC_get_gc_no();
+  start = clock();
+  res = replay(buf, (size_t)len, &st);
+  free(buf);
+  if (res != 0) {
+    fprintf(stderr, "Malformed or incomplete recording: %s\n", fname);
+    return 1;
+  }
+  printf("Replayed %lu allocations (%lu bytes), %lu stores, %lu frees"
+         " in %lu ms\n",
+         (unsigned long)st.n_allocs, (unsigned long)st.alloc_bytes,
+         (unsigned long)st.n_stores, (unsigned long)st.n_frees,
+         (unsigned long)((clock() - start) * 1000 / CLOCKS_PER_SEC));
+  printf("Collections: %lu recorded, %lu replayed;"
+         " heap size: %lu recorded, %lu replayed\n",
+         (unsigned long)st.n_collections,
+         (unsigned long)(GC_get_gc_no() - gc_no),
+         (unsigned long)st.last_heap_size, (unsigned long)GC_get_heap_size());
+  return 0;
+}
+
+#define N_LISTS 20
+#define LIST_LEN 2000
+
+struct node_s {
+  struct node_s *next;
+  char *data;
+};
+
+static struct node_s *lists[N_LISTS];
+
+/* Record a workload, then replay the recording. */
+static int
+self_test(void)
+{
+  FILE *f = tmpfile();
+  unsigned char *buf;
+  long len;
+  struct replay_stats_s st;
+  int i, j, res;
+
+  if (NULL == f) {
+    fprintf(stderr, "Cannot create temporary file\n");
+    return 2;
+  }
+  res = GC_start_alloc_recording(fileno(f));
+  if (GC_UNIMPLEMENTED == res) {
+    printf("Allocation recording is not supported\n");
+    fclose(f);
+    return 0;
+  }
+  if (res != GC_SUCCESS) {
+    fprintf(stderr, "GC_start_alloc_recording failed: %d\n", res);
+    return 1;
+  }
+  for (i = 0; i < N_LISTS * 5; i++) {
+    struct node_s **pl = &lists[i % N_LISTS];
+
+    /* Drop the previous list (if any). */
+    *pl = NULL;
+    for (j = 0; j < LIST_LEN; j++) {
+      struct node_s *n = GC_NEW(struct node_s);
+      char *data = (char *)GC_MALLOC_ATOMIC((size_t)(j % 100) + 1);
+
+      CHECK_OUT_OF_MEMORY(n);
+      CHECK_OUT_OF_MEMORY(data);
+      GC_PTR_STORE_AND_DIRTY(&n->data, data);
+      GC_PTR_STORE_AND_DIRTY(&n->next, *pl);
+      *pl = n;
+      if (j % 10 == 0) {
+        GC_PTR_STORE_AND_DIRTY(&n->data, NULL);
+        GC_FREE(data);
+      }
+    }
+    if (i % N_LISTS == 0)
+      GC_gcollect();
+  }
+  res = GC_stop_alloc_recording();
+  if (res != GC_SUCCESS || GC_stop_alloc_recording() != GC_NOT_FOUND) {
+    fprintf(stderr, "GC_stop_alloc_recording failed: %d\n", res);
+    return 1;
+  }
+  memset(lists, 0, sizeof(lists));
+
+  if (fseek(f, 0, SEEK_END) != 0 || (len = ftell(f)) <= 0
+      || fseek(f, 0, SEEK_SET) != 0) {
+    fprintf(stderr, "Cannot read recording\n");
+    return 2;
+  }
+  buf = (unsigned char *)malloc((size_t)len);
+  CHECK_OUT_OF_MEMORY(buf);
+  if (fread(buf, 1, (size_t)len, f) != (size_t)len) {
+    fprintf(stderr, "Cannot read recording\n");
+    return 2;
+  }
+  fclose(f);
+  if (replay(buf, (size_t)len, &st) != 0) {
+    fprintf(stderr, "Malformed recording\n");
+    return 1;
+  }
+  free(buf);
+  printf("Recorded %lu bytes: %lu allocations, %lu stores, %lu frees,"
+         " %lu collections\n",
+         (unsigned long)len, (unsigned long)st.n_allocs,
+         (unsigned long)st.n_stores, (unsigned long)st.n_frees,
+         (unsigned long)st.n_collections);
+  if (st.n_allocs < 2 * N_LISTS * 5 * LIST_LEN
+#ifndef GC_DEBUG
+      /* `GC_debug_free` defers the deallocation of collectable objects. */
+      || st.n_frees < N_LISTS * 5 * (LIST_LEN / 10)
+#endif
+      || st.n_stores < N_LISTS * 5 * LIST_LEN
+      || st.n_collections < 5) {
+    fprintf(stderr, "Allocation recording is incomplete\n");
+    return 1;
+  }
+  return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+  GC_INIT();
+  if (GC_get_find_leak())
+    printf("This test program is not designed for leak detection mode\n");
+  if (argc > 2) {
+    fprintf(stderr, "Usage: %s [<recording_file>]\n", argv[0]);
+    return 2;
+  }
+  return argc == 2 ? replay_file(argv[1]) : self_test();
+}
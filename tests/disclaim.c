@@ -105,6 +105,58 @@ test_misc_sizes(void)
   }
 }
 
+#define BATCH_OBJ_TAG ((GC_word)0x5a5a5a5bUL)
+#define N_BATCH_OBJS 1000
+
+static size_t batch_disclaimed_cnt;
+
+static void GC_CALLBACK
+batch_dct(void **objs, size_t n)
+{
+  size_t i;
+
+  my_assert(n > 0);
+  for (i = 0; i < n; ++i) {
+    GC_word *p = (GC_word *)objs[i];
+
+    my_assert(GC_base(p) == p);
+    if (p[0] != BATCH_OBJ_TAG) {
+      /* A free-list fragment. */
+      continue;
+    }
+    my_assert(p[1] == ~BATCH_OBJ_TAG);
+    p[0] = 0;
+    batch_disclaimed_cnt++;
+  }
+}
+
+static void
+test_disclaim_batches(void)
+{
+  int kind = (int)GC_new_kind(GC_new_free_list(), GC_DS_LENGTH, 1, 1);
+  int i;
+
+  GC_register_disclaim_batch_proc(kind, batch_dct, 0);
+  for (i = 0; i < N_BATCH_OBJS; ++i) {
+    GC_word *p = (GC_word *)GC_generic_malloc(4 * sizeof(GC_word), kind);
+
+    CHECK_OUT_OF_MEMORY(p);
+    p[0] = BATCH_OBJ_TAG;
+    p[1] = ~BATCH_OBJ_TAG;
+  }
+  for (i = 0; i < 3; ++i) {
+    GC_gcollect();
+    (void)GC_invoke_disclaim_batches();
+  }
+  if (batch_disclaimed_cnt < N_BATCH_OBJS / 2) {
+    fprintf(stderr, "Too few objects disclaimed in batches: %u\n",
+            (unsigned)batch_disclaimed_cnt);
+    exit(1);
+  }
+  printf("Disclaimed in batches: %u objects\n",
+         (unsigned)batch_disclaimed_cnt);
+}
+
 typedef struct pair_s *pair_t;
 
 struct pair_s {
@@ -274,6 +326,8 @@ main(void)
     printf("This test program is not designed for leak detection mode\n");
 
   test_misc_sizes();
+  if (!GC_get_find_leak())
+    test_disclaim_batches();
 
 #if NTHREADS > 0
   printf("Threaded disclaim test.\n");
@@ -0,0 +1,138 @@
+/*
+ * THIS MATERIAL IS PROVIDED AS IS, WITH ABSOLUTELY NO WARRANTY EXPRESSED
+ * OR IMPLIED.  ANY USE IS AT YOUR OWN RISK.
+ *
+ * Permission is hereby granted to use or copy this program
+ * for any purpose, provided the above notices are retained on all copies.
+ * Permission to modify the code and to distribute modified code is granted,
+ * provided the above notices are retained, and a notice that the code was
+ * modified is included with the above copyright notice.
+ */
+
+/*
+ * Check that the finalization cycles are reported (by a warning) both
+ * when the marking from the finalizable objects is done by the current
+ * thread and when it is done by the parallel marker threads.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gc.h"
+
+/* The number of the finalization cycles created at once. */
+#define N_CYCLES 10
+
+/*
+ * The number of the objects reachable from each cycle; enough for the
+ * mark stack to be processed by the parallel marker threads.
+ */
+#define N_CHILDREN 5000
+
+/*
+ * The number of the other (reachable) finalizable objects, to have many
+ * finalizers registered.
+ */
+#define N_LIVE_FINALIZABLE 5000
+
+#define CHECK_OUT_OF_MEMORY(p)            \
+  do {                                    \
+    if (NULL == (p)) {                    \
+      fprintf(stderr, "Out of memory\n"); \
+      exit(69);                           \
+    }                                     \
+  } while (0)
+
+static unsigned cycle_warnings;
+static unsigned finalized_cnt;
+
+void *live_finalizable[N_LIVE_FINALIZABLE];
+
+static void GC_CALLBACK
+count_warn_proc(const char *msg, GC_uintptr_t arg)
+{
+  (void)arg;
+  if (strstr(msg, "Finalization cycle") != NULL)
+    cycle_warnings++;
+}
+
+static void GC_CALLBACK
+finalizer(void *obj, void *client_data)
+{
+  (void)obj;
+  (void)client_data;
+  finalized_cnt++;
+}
+
+/*
+ * Create a cycle of two finalizable objects, the first of which also
+ * references many other objects.
+ */
+static void
+make_cycle(void)
+{
+  void **a = (void **)GC_MALLOC((N_CHILDREN + 1) * sizeof(void *));
+  void **b = (void **)GC_MALLOC(2 * sizeof(void *));
+  int i;
+
+  CHECK_OUT_OF_MEMORY(a);
+  CHECK_OUT_OF_MEMORY(b);
+  for (i = 0; i < N_CHILDREN; i++) {
+    a[i] = GC_MALLOC(2 * sizeof(void *));
+    CHECK_OUT_OF_MEMORY(a[i]);
+  }
+  a[N_CHILDREN] = b;
+  b[0] = a;
+  GC_REGISTER_FINALIZER(a, finalizer, NULL, NULL, NULL);
+  GC_REGISTER_FINALIZER(b, finalizer, NULL, NULL, NULL);
+}
+
+static void
+check_cycles_reported(const char *what)
+{
+  int i;
+
+  for (i = 0; i < N_CYCLES; i++)
+    make_cycle();
+  cycle_warnings = 0;
+  GC_gcollect();
+  /* Some cycles might be still referenced from the stack. */
+  if (cycle_warnings < N_CYCLES / 2) {
+    fprintf(stderr, "Too few finalization cycles reported (%s): %u\n", what,
+            cycle_warnings);
+    exit(1);
+  }
+  printf("Reported finalization cycles (%s): %u\n", what, cycle_warnings);
+}
+
+int
+main(void)
+{
+  int i;
+
+  /* Use the parallel marking once the marker threads are started. */
+  GC_set_markers_count(4);
+  GC_INIT();
+  if (GC_get_find_leak()) {
+    printf("This test does not work in the find-leak mode\n");
+    return 0;
+  }
+  GC_set_warn_proc(count_warn_proc);
+  for (i = 0; i < N_LIVE_FINALIZABLE; i++) {
+    live_finalizable[i] = GC_MALLOC(sizeof(void *));
+    CHECK_OUT_OF_MEMORY(live_finalizable[i]);
+    GC_REGISTER_FINALIZER(live_finalizable[i], finalizer, NULL, NULL, NULL);
+  }
+  check_cycles_reported("serial");
+
+  GC_start_mark_threads();
+  check_cycles_reported(GC_get_parallel() ? "parallel" : "serial");
+  (void)GC_invoke_finalizers();
+  if (finalized_cnt != 0) {
+    fprintf(stderr, "Object of a finalization cycle was finalized\n");
+    exit(1);
+  }
+  printf("SUCCEEDED\n");
+  return 0;
+}
@@ -0,0 +1,575 @@
+/*
+ * THIS MATERIAL IS PROVIDED AS IS, WITH ABSOLUTELY NO WARRANTY EXPRESSED
+ * OR IMPLIED.  ANY USE IS AT YOUR OWN RISK.
+ *
+ * Permission is hereby granted to use or copy this program
+ * for any purpose, provided the above notices are retained on all copies.
+ * Permission to modify the code and to distribute modified code is granted,
+ * provided the above notices are retained, and a notice that the code was
+ * modified is included with the above copyright notice.
+ */
+
+/*
+ * A set of the collector benchmarks.  Each scenario exercises a hot path
+ * of the collector: the small-object allocation, mixed-size allocation,
+ * large-object churn (through the block allocator), finalizers, weak
+ * references (the disappearing links), marking of a deep linked list and
+ * of a wide tree, scanning the stacks of many threads.  The allocation
+ * scenarios are run at 1, 2, 4, etc. up to the given number of threads.
+ *
+ * Usage: `gc_bench [-s <scale>] [-t <max_threads>] [<scenario>...]`.
+ * The scale multiplies the amount of work (the default is 1, which
+ * takes a few seconds in total).  The results are printed one line per
+ * run, as a JSON object with the following fields: `scenario`, `threads`,
+ * `ops` (the number of the operations, e.g. allocations, done),
+ * `elapsed_ms`, `ops_per_sec`, `gc_count`, `pause_count` (the number of
+ * collections observed by the collection event callback, i.e. the time
+ * from `GC_EVENT_START` to `GC_EVENT_END`), `pause_p50_us`,
+ * `pause_p90_us`, `pause_p99_us`, `pause_max_us`, `heap_size` (in bytes,
+ * at the end of the run) and `peak_rss_kb` (the process peak resident set
+ * size during the run on Linux, the peak since the process start on the
+ * other Unix-like systems, -1 if unknown).
+ *
+ * The multi-threaded runs are supported only with pthreads.
+ */
+
+#ifdef HAVE_CONFIG_H
+/* For `GC_THREADS` macro. */
+#  include "config.h"
+#endif
+
+#undef GC_NO_THREAD_REDIRECTS
+#include "gc.h"
+
+#define NOT_GCBUILD
+#include "private/gc_priv.h"
+
+#include <string.h>
+
+#if defined(UNIX_LIKE) && !defined(LINUX)
+#  include <sys/resource.h>
+#endif
+
+#ifdef GC_PTHREADS
+#  include <pthread.h>
+#  include <unistd.h>
+#endif
+
+#define CHECK_OUT_OF_MEMORY(p)            \
+  do {                                    \
+    if (NULL == (p)) {                    \
+      fprintf(stderr, "Out of memory\n"); \
+      exit(69);                           \
+    }                                     \
+  } while (0)
+
+#ifndef MAX_PAUSES
+#  define MAX_PAUSES 100000
+#endif
+
+/* The stack threads count for `many_threads` scenario. */
+#ifndef STACK_THREADS
+#  define STACK_THREADS 64
+#endif
+
+static long scale = 1;
+
+/* The collection durations (in microseconds) of the current run. */
+static unsigned long pauses[MAX_PAUSES];
+static size_t n_pauses;
+
+static unsigned long
+now_us(void)
+{
+#ifndef NO_CLOCK
+  static CLOCK_TYPE start_time;
+  static int start_time_set = 0;
+  CLOCK_TYPE now;
+
+  GET_TIME(now);
+  if (!start_time_set) {
+    start_time = now;
+    start_time_set = 1;
+  }
+  return MS_TIME_DIFF(now, start_time) * 1000
+         + NS_FRAC_TIME_DIFF(now, start_time) / 1000;
+#else
+  return (unsigned long)(clock() / (CLOCKS_PER_SEC / 1000000.0));
+#endif
+}
+
+static unsigned long gc_start_us;
+
+/* Called with the allocator lock held. */
+static void GC_CALLBACK
+on_collection_event(GC_EventType event)
+{
+  if (GC_EVENT_START == event) {
+    gc_start_us = now_us();
+  } else if (GC_EVENT_END == event && n_pauses < MAX_PAUSES) {
+    pauses[n_pauses++] = now_us() - gc_start_us;
+  }
+}
+
+static void
+reset_peak_rss(void)
+{
+#ifdef LINUX
+  /* Reset the peak resident set size (`VmHWM`) of the process. */
+  FILE *f = fopen("/proc/self/clear_refs", "w");
+
+  if (f != NULL) {
+    fputs("5", f);
+    fclose(f);
+  }
+#endif
+}
+
+static long
+get_peak_rss_kb(void)
+{
+#ifdef LINUX
+  FILE *f = fopen("/proc/self/status", "r");
+  char line[128];
+  long kb = -1;
+
+  if (NULL == f)
+    return -1;
+  while (fgets(line, sizeof(line), f) != NULL) {
+    if (strncmp(line, "VmHWM:", 6) == 0) {
+      kb = atol(line + 6);
+      break;
+    }
+  }
+  fclose(f);
+  return kb;
+#elif defined(UNIX_LIKE)
+  struct rusage ru;
+
+  if (getrusage(RUSAGE_SELF, &ru) != 0)
+    return -1;
+#  ifdef DARWIN
+  /* The value is in bytes. */
+  return (long)(ru.ru_maxrss / 1024);
+#  else
+  return (long)ru.ru_maxrss;
+#  endif
+#else
+  return -1;
+#endif
+}
+
+/* The scenarios.  Each one returns the number of the operations done. */
+
+struct node_s {
+  struct node_s *next;
+  struct node_s *child;
+  GC_word value;
+};
+
+static unsigned long
+small_alloc(unsigned tid)
+{
+  void *window[1024];
+  long i, n = 200000 * scale;
+
+  (void)tid;
+  memset(window, 0, sizeof(window));
+  for (i = 0; i < n; i++) {
+    void *p = GC_MALLOC(16 + (size_t)(i & 3) * 8);
+
+    CHECK_OUT_OF_MEMORY(p);
+    window[i & 1023] = p;
+  }
+  GC_reachable_here(window[0]);
+  return (unsigned long)n;
+}
+
+static unsigned long
+mixed_sizes(unsigned tid)
+{
+  GC_RAND_STATE_T seed = tid + 1;
+  void *window[256];
+  long i, n = 50000 * scale;
+
+  memset(window, 0, sizeof(window));
+  for (i = 0; i < n; i++) {
+    unsigned r = (unsigned)GC_RAND_NEXT(&seed);
+    size_t lb;
+    void *p;
+
+    if (r % 100 < 80) {
+      lb = 8 + (r >> 8) % 248;
+    } else if (r % 100 < 98) {
+      lb = 256 + (r >> 8) % (4096 - 256);
+    } else {
+      lb = 4096 + (r >> 8) % (65536 - 4096);
+    }
+    p = (r & 0x80) != 0 ? GC_MALLOC_ATOMIC(lb) : GC_MALLOC(lb);
+    CHECK_OUT_OF_MEMORY(p);
+    window[i & 255] = p;
+  }
+  GC_reachable_here(window[0]);
+  return (unsigned long)n;
+}
+
+static unsigned long
+large_churn(unsigned tid)
+{
+  GC_RAND_STATE_T seed = tid + 1;
+  void *window[16];
+  long i, n = 5000 * scale;
+
+  memset(window, 0, sizeof(window));
+  for (i = 0; i < n; i++) {
+    unsigned r = (unsigned)GC_RAND_NEXT(&seed);
+    void *p = GC_MALLOC_ATOMIC(HBLKSIZE * (1 + r % 32));
+
+    CHECK_OUT_OF_MEMORY(p);
+    /* Deallocate some of the evicted objects explicitly. */
+    if ((i & 3) == 0 && window[i & 15] != NULL)
+      GC_FREE(window[i & 15]);
+    window[i & 15] = p;
+  }
+  GC_reachable_here(window[0]);
+  return (unsigned long)n;
+}
+
+#ifndef GC_NO_FINALIZATION
+static void GC_CALLBACK
+count_finalized(void *obj, void *client_data)
+{
+  (void)obj;
+  /* A race is OK, the counter is not reported. */
+  ++*(GC_word *)client_data;
+}
+
+static GC_word finalized_cnt;
+
+static unsigned long
+finalizers(unsigned tid)
+{
+  void *window[64];
+  long i, n = 50000 * scale;
+
+  (void)tid;
+  memset(window, 0, sizeof(window));
+  for (i = 0; i < n; i++) {
+    void *p = GC_MALLOC(sizeof(struct node_s));
+
+    CHECK_OUT_OF_MEMORY(p);
+    GC_REGISTER_FINALIZER(p, count_finalized, &finalized_cnt, NULL, NULL);
+    window[i & 63] = p;
+  }
+  GC_reachable_here(window[0]);
+  return (unsigned long)n;
+}
+
+static unsigned long
+weak_refs(unsigned tid)
+{
+  void *objs[64];
+  void **links[512];
+  long i, n = 50000 * scale;
+
+  (void)tid;
+  memset(objs, 0, sizeof(objs));
+  memset(links, 0, sizeof(links));
+  for (i = 0; i < n; i++) {
+    void *p = GC_MALLOC(sizeof(struct node_s));
+    /* The link is in a pointer-free object, so it does not keep `p`. */
+    void **link = (void **)GC_MALLOC_ATOMIC(sizeof(void *));
+
+    CHECK_OUT_OF_MEMORY(p);
+    CHECK_OUT_OF_MEMORY(link);
+    *link = p;
+    if (GC_GENERAL_REGISTER_DISAPPEARING_LINK(link, p) == GC_NO_MEMORY) {
+      fprintf(stderr, "Out of memory\n");
+      exit(69);
+    }
+    objs[i & 63] = p;
+    links[i & 511] = link;
+  }
+  GC_reachable_here(objs[0]);
+  GC_reachable_here(links[0]);
+  return (unsigned long)n;
+}
+#endif /* !GC_NO_FINALIZATION */
+
+#define N_FULL_COLLECTIONS 5
+
+static unsigned long
+deep_list(unsigned tid)
+{
+  struct node_s *head = NULL;
+  long i, n = 500000 * scale;
+
+  (void)tid;
+  for (i = 0; i < n; i++) {
+    struct node_s *p = GC_NEW(struct node_s);
+
+    CHECK_OUT_OF_MEMORY(p);
+    p->next = head;
+    p->value = (GC_word)i;
+    head = p;
+  }
+  for (i = 0; i < N_FULL_COLLECTIONS; i++)
+    GC_gcollect();
+  GC_reachable_here(head);
+  /* The number of the objects marked. */
+  return (unsigned long)(n * N_FULL_COLLECTIONS);
+}
+
+#define TREE_FANOUT 1000
+
+static unsigned long
+wide_tree(unsigned tid)
+{
+  struct node_s **children;
+  long i, j, n_leaves = 500 * scale;
+
+  (void)tid;
+  children = (struct node_s **)GC_MALLOC(TREE_FANOUT
+                                         * sizeof(struct node_s *));
+  CHECK_OUT_OF_MEMORY(children);
+  for (i = 0; i < TREE_FANOUT; i++) {
+    struct node_s **leaves = (struct node_s **)GC_MALLOC(
+        (size_t)n_leaves * sizeof(struct node_s *));
+
+    CHECK_OUT_OF_MEMORY(leaves);
+    for (j = 0; j < n_leaves; j++) {
+      leaves[j] = GC_NEW(struct node_s);
+      CHECK_OUT_OF_MEMORY(leaves[j]);
+    }
+    children[i] = (struct node_s *)leaves;
+  }
+  for (i = 0; i < N_FULL_COLLECTIONS; i++)
+    GC_gcollect();
+  GC_reachable_here(children);
+  return (unsigned long)(TREE_FANOUT * (n_leaves + 1) * N_FULL_COLLECTIONS);
+}
+
+#ifdef GC_PTHREADS
+static volatile int stack_threads_stop;
+static volatile int stack_threads_ready;
+static pthread_mutex_t stack_threads_ml = PTHREAD_MUTEX_INITIALIZER;
+
+#  define STACK_DEPTH 200
+
+/* Build a chain of the stack frames each referring a heap object. */
+static void
+deep_stack(int depth)
+{
+  struct node_s *p = GC_NEW(struct node_s);
+
+  CHECK_OUT_OF_MEMORY(p);
+  if (depth > 0) {
+    deep_stack(depth - 1);
+  } else {
+    pthread_mutex_lock(&stack_threads_ml);
+    stack_threads_ready++;
+    pthread_mutex_unlock(&stack_threads_ml);
+    while (!stack_threads_stop)
+      usleep(1000);
+  }
+  GC_reachable_here(p);
+}
+
+static void *
+stack_thread(void *arg)
+{
+  deep_stack(STACK_DEPTH);
+  return arg;
+}
+
+static unsigned long
+many_threads(unsigned tid)
+{
+  pthread_t th[STACK_THREADS];
+  int i, n, ready;
+  long cnt = 20 * scale;
+
+  (void)tid;
+  stack_threads_stop = 0;
+  stack_threads_ready = 0;
+  for (n = 0; n < STACK_THREADS; n++) {
+    if (pthread_create(&th[n], NULL, stack_thread, NULL) != 0)
+      break;
+  }
+  do {
+    usleep(1000);
+    pthread_mutex_lock(&stack_threads_ml);
+    ready = stack_threads_ready;
+    pthread_mutex_unlock(&stack_threads_ml);
+  } while (ready < n);
+  for (i = 0; i < cnt; i++)
+    GC_gcollect();
+  stack_threads_stop = 1;
+  for (i = 0; i < n; i++)
+    pthread_join(th[i], NULL);
+  return (unsigned long)cnt;
+}
+#endif /* GC_PTHREADS */
+
+struct scenario_s {
+  const char *name;
+  unsigned long (*fn)(unsigned);
+  int threaded; /*< run at several thread counts */
+};
+
+static const struct scenario_s scenarios[] = {
+  { "small_alloc", small_alloc, 1 },
+  { "mixed_sizes", mixed_sizes, 1 },
+  { "large_churn", large_churn, 1 },
+#ifndef GC_NO_FINALIZATION
+  { "finalizers", finalizers, 1 },
+  { "weak_refs", weak_refs, 1 },
+#endif
+  { "deep_list", deep_list, 0 },
+  { "wide_tree", wide_tree, 0 },
+#ifdef GC_PTHREADS
+  { "many_threads", many_threads, 0 },
+#endif
+};
+
+#define N_SCENARIOS (sizeof(scenarios) / sizeof(scenarios[0]))
+
+#ifdef GC_PTHREADS
+struct worker_s {
+  const struct scenario_s *sc;
+  unsigned tid;
+  unsigned long ops;
+};
+
+static void *
+worker(void *arg)
+{
+  struct worker_s *w = (struct worker_s *)arg;
+
+  w->ops = w->sc->fn(w->tid);
+  return NULL;
+}
+#endif
+
+static int
+cmp_ulong(const void *a, const void *b)
+{
+  unsigned long x = *(const unsigned long *)a;
+  unsigned long y = *(const unsigned long *)b;
+
+  return x < y ? -1 : x > y ? 1 : 0;
+}
+
+static unsigned long
+percentile(size_t n, unsigned pct)
+{
+  return n > 0 ? pauses[(n - 1) * pct / 100] : 0;
+}
+
+static void
+run(const struct scenario_s *sc, unsigned n_threads)
+{
+  unsigned long start, elapsed, ops = 0;
+  GC_word gc_no;
+  size_t n;
+
+  GC_gcollect();
+  reset_peak_rss();
+  GC_alloc_lock();
+  n_pauses = 0;
+  GC_alloc_unlock();
+  gc_no = GC_get_gc_no();
+  start = now_us();
+#ifdef GC_PTHREADS
+  if (n_threads > 1) {
+    pthread_t th[64];
+    struct worker_s w[64];
+    unsigned i;
+
+    for (i = 0; i < n_threads; i++) {
+      w[i].sc = sc;
+      w[i].tid = i;
+      w[i].ops = 0;
+      if (pthread_create(&th[i], NULL, worker, &w[i]) != 0) {
+        fprintf(stderr, "Thread creation failed\n");
+        exit(1);
+      }
+    }
+    for (i = 0; i < n_threads; i++) {
+      pthread_join(th[i], NULL);
+      ops += w[i].ops;
+    }
+  } else
+#endif
+  /* else */ {
+    ops = sc->fn(0);
+  }
+  elapsed = now_us() - start;
+  GC_alloc_lock();
+  n = n_pauses;
+  GC_alloc_unlock();
+  qsort(pauses, n, sizeof(pauses[0]), cmp_ulong);
+  printf("{\"scenario\":\"%s\",\"threads\":%u,\"ops\":%lu,"
+         "\"elapsed_ms\":%lu,\"ops_per_sec\":%.0f,\"gc_count\":%lu,"
+         "\"pause_count\":%lu,\"pause_p50_us\":%lu,\"pause_p90_us\":%lu,"
+         "\"pause_p99_us\":%lu,\"pause_max_us\":%lu,\"heap_size\":%lu,"
+         "\"peak_rss_kb\":%ld}\n",
+         sc->name, n_threads, ops, elapsed / 1000,
+         elapsed > 0 ? (double)ops * 1e6 / (double)elapsed : 0.0,
+         (unsigned long)(GC_get_gc_no() - gc_no), (unsigned long)n,
+         percentile(n, 50), percentile(n, 90), percentile(n, 99),
+         n > 0 ? pauses[n - 1] : 0UL, (unsigned long)GC_get_heap_size(),
+         get_peak_rss_kb());
+  fflush(stdout);
+}
+
+int
+main(int argc, char **argv)
+{
+  unsigned max_threads = 4;
+  int i, first_name;
+  size_t k;
+
+  GC_INIT();
+  if (GC_get_find_leak())
+    printf("This test program is not designed for leak detection mode\n");
+  for (i = 1; i < argc - 1 && argv[i][0] == '-'; i += 2) {
+    if (strcmp(argv[i], "-s") == 0) {
+      scale = atol(argv[i + 1]);
+    } else if (strcmp(argv[i], "-t") == 0) {
+      max_threads = (unsigned)atoi(argv[i + 1]);
+    } else {
+      break;
+    }
+  }
+  if ((i < argc && argv[i][0] == '-') || scale <= 0 || 0 == max_threads
+      || max_threads > 64) {
+    fprintf(stderr,
+            "Usage: %s [-s <scale>] [-t <max_threads>] [<scenario>...]\n",
+            argv[0]);
+    return 2;
+  }
+#ifndef GC_PTHREADS
+  max_threads = 1;
+#endif
+  first_name = i;
+  GC_set_on_collection_event(on_collection_event);
+  for (k = 0; k < N_SCENARIOS; k++) {
+    const struct scenario_s *sc = &scenarios[k];
+    unsigned n_threads;
+
+    if (first_name < argc) {
+      for (i = first_name; i < argc; i++) {
+        if (strcmp(argv[i], sc->name) == 0)
+          break;
+      }
+      if (i == argc)
+        continue;
+    }
+    for (n_threads = 1; n_threads <= (sc->threaded ? max_threads : 1);
+         n_threads *= 2) {
+      run(sc, n_threads);
+    }
+  }
+  return 0;
+}
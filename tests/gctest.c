@@ -111,6 +111,10 @@ static int print_stats = 0;
 
 #if defined(GC_PTHREADS) && !defined(GC_WIN32_PTHREADS)
 #  include <pthread.h>
+#  ifdef LINUX
+#    include <sys/syscall.h>
+#    include <unistd.h>
+#  endif
 #endif
 
 #if ((defined(DARWIN) && defined(MPROTECT_VDB) && !defined(THREADS) \
@@ -230,6 +234,9 @@ checkOOM(void *p)
 #  define AO_fetch_and_add1(p) ((*(p))++)
 /* This is used only to update counters. */
 #endif
+#ifndef AO_HAVE_load
+#  define AO_load(p) (*(const volatile AO_t *)(p))
+#endif
 
 /* The allocation statistics.  Synchronization is not strictly necessary. */
 static AO_t uncollectable_count = 0;
@@ -249,6 +256,31 @@ static AO_t extra_count = 0;
 #  define FAIL ABORT("Test failed")
 #endif
 
+static int GC_CALLBACK
+never_stop_func(void)
+{
+  return 0;
+}
+
+/*
+ * Perform a full collection.  Unlike `GC_gcollect()`, this is retried
+ * while the collection is disabled temporarily (e.g. by another thread
+ * being cancelled or exiting by `pthread_exit()`), so that the tests
+ * could check the effect of the collection.
+ */
+static void
+gcollect_retried(void)
+{
+  unsigned long i;
+
+  for (i = 0; !GC_try_to_collect(never_stop_func); i++) {
+    if (i > 10UL * 1000 * 1000) {
+      GC_printf("Collection is disabled for too long\n");
+      FAIL;
+    }
+  }
+}
+
 /*
  * `AT_END` may be defined to exercise the interior pointer test if the
  * collector is configured with `ALL_INTERIOR_POINTERS`.  As it stands,
@@ -1114,8 +1146,8 @@ mktree(int n)
     CHECK_OUT_OF_MEMORY(left);
     tmp = left->rchild;
     CHECK_OUT_OF_MEMORY(right);
-    GC_PTR_STORE_AND_DIRTY(&left->rchild, right->lchild);
-    GC_PTR_STORE_AND_DIRTY(&right->lchild, tmp);
+    GC_PTR_STORE_AND_DIRTY_INLINE(&left->rchild, right->lchild);
+    GC_PTR_STORE_AND_DIRTY_INLINE(&right->lchild, tmp);
   }
   if (AO_fetch_and_add1(&extra_count) % 119 == 0) {
 #ifndef GC_NO_FINALIZATION
@@ -1379,6 +1411,633 @@ tree_test(void)
 #endif
 }
 
+#ifndef GC_NO_FINALIZATION
+#  define N_EPHEMERONS 100
+
+/* Create an ephemeron whose value refers back to the given key. */
+static void *
+new_cyclic_ephemeron(void **key)
+{
+  void **value = (void **)checkOOM(GC_MALLOC(2 * sizeof(void *)));
+
+  AO_fetch_and_add1(&collectable_count);
+  value[0] = key;
+  GC_END_STUBBORN_CHANGE(value);
+  return checkOOM(GC_new_ephemeron(key, value));
+}
+
+static void
+ephemeron_test(void)
+{
+  void **ephs;
+  void **key, **value;
+  void *eph;
+  int i, cleared = 0;
+
+  key = (void **)checkOOM(GC_MALLOC(2 * sizeof(void *)));
+  AO_fetch_and_add1(&collectable_count);
+  eph = new_cyclic_ephemeron(key);
+  ephs = (void **)checkOOM(GC_MALLOC(N_EPHEMERONS * sizeof(void *)));
+  AO_fetch_and_add1(&collectable_count);
+  for (i = 0; i < N_EPHEMERONS; i++) {
+    void **dead_key = (void **)checkOOM(GC_MALLOC(2 * sizeof(void *)));
+
+    AO_fetch_and_add1(&collectable_count);
+    ephs[i] = new_cyclic_ephemeron(dead_key);
+  }
+  GC_END_STUBBORN_CHANGE(ephs);
+
+  /* A reachable key keeps the value alive. */
+  GC_gcollect();
+  value = (void **)GC_ephemeron_get_value(eph);
+  if (GC_ephemeron_get_key(eph) != key || NULL == value || value[0] != key) {
+    GC_printf("Ephemeron with live key has been cleared\n");
+    FAIL;
+  }
+
+  /* The values referring to unreachable keys do not keep the keys. */
+  if (GC_is_disabled() || GC_get_find_leak())
+    return;
+  gcollect_retried();
+  for (i = 0; i < N_EPHEMERONS; i++) {
+    if (NULL == GC_ephemeron_get_key(ephs[i])) {
+      if (GC_ephemeron_get_value(ephs[i]) != NULL) {
+        GC_printf("Ephemeron value is not cleared along with the key\n");
+        FAIL;
+      }
+      cleared++;
+    }
+  }
+  if (0 == cleared) {
+    GC_printf("No ephemeron has been cleared\n");
+    FAIL;
+  }
+}
+
+#  define N_SOFT_LINKS 100
+
+static AO_t soft_link_test_cnt = 0;
+
+static void
+soft_link_test(void)
+{
+  GC_hidden_pointer *links;
+  unsigned threshold = GC_get_soft_links_heap_threshold();
+  int i, cleared = 0;
+
+  /* The threshold is global, thus the test is run by one thread. */
+  if (AO_fetch_and_add1(&soft_link_test_cnt) != 0 || GC_is_disabled()
+      || GC_get_find_leak())
+    return;
+  links = (GC_hidden_pointer *)checkOOM(
+      GC_MALLOC_ATOMIC(N_SOFT_LINKS * sizeof(GC_hidden_pointer)));
+  AO_fetch_and_add1(&atomic_count);
+  for (i = 0; i < N_SOFT_LINKS; i++) {
+    void *p = checkOOM(GC_MALLOC(2 * sizeof(void *)));
+
+    AO_fetch_and_add1(&collectable_count);
+    links[i] = GC_HIDE_POINTER(p);
+    if (GC_REGISTER_SOFT_LINK((void **)&links[i], p) != GC_SUCCESS) {
+      GC_printf("GC_register_soft_link failed\n");
+      FAIL;
+    }
+  }
+
+  /* The targets are retained while the heap occupancy is below 100%. */
+  GC_set_soft_links_heap_threshold(100);
+  GC_gcollect();
+  for (i = 0; i < N_SOFT_LINKS; i++) {
+    if (0 == links[i] || GC_access_soft_link((void **)&links[i]) == NULL) {
+      GC_printf("Soft link has been cleared unexpectedly\n");
+      FAIL;
+    }
+  }
+
+  /* Zero threshold makes the soft links behave as the short ones. */
+  GC_set_soft_links_heap_threshold(0);
+  gcollect_retried();
+  GC_set_soft_links_heap_threshold(threshold);
+  for (i = 0; i < N_SOFT_LINKS; i++) {
+    if (0 == links[i]) {
+      if (GC_access_soft_link((void **)&links[i]) != NULL) {
+        GC_printf("Cleared soft link is still registered\n");
+        FAIL;
+      }
+      cleared++;
+    } else if (GC_unregister_soft_link((void **)&links[i]) != 1
+               && links[i] != 0 /*< not cleared by another collection */) {
+      GC_printf("GC_unregister_soft_link failed\n");
+      FAIL;
+    }
+  }
+  if (0 == cleared) {
+    GC_printf("No soft link has been cleared\n");
+    FAIL;
+  }
+}
+
+#  define N_BATCH_OBJS 50
+
+static void
+batch_register_test(void)
+{
+  void *objs[N_BATCH_OBJS];
+  void **links[N_BATCH_OBJS];
+  GC_hidden_pointer *hidden_ptrs;
+  int i;
+
+  if (GC_get_find_leak())
+    return;
+  hidden_ptrs = (GC_hidden_pointer *)checkOOM(
+      GC_MALLOC_ATOMIC(N_BATCH_OBJS * sizeof(GC_hidden_pointer)));
+  AO_fetch_and_add1(&atomic_count);
+  for (i = 0; i < N_BATCH_OBJS; i++) {
+    objs[i] = GC_base(checkOOM(GC_MALLOC(2 * sizeof(void *))));
+    AO_fetch_and_add1(&collectable_count);
+    hidden_ptrs[i] = GC_HIDE_POINTER(objs[i]);
+    links[i] = (void **)&hidden_ptrs[i];
+  }
+  GC_register_finalizers(objs, N_BATCH_OBJS, dummy_finalizer, NULL);
+  if (GC_general_register_disappearing_links(
+          links, (const void *const *)objs, N_BATCH_OBJS)
+          != GC_SUCCESS
+      || GC_general_register_disappearing_links(
+             links, (const void *const *)objs, N_BATCH_OBJS / 2)
+             != GC_SUCCESS) {
+    GC_printf("GC_general_register_disappearing_links failed\n");
+    FAIL;
+  }
+  for (i = 0; i < N_BATCH_OBJS; i++) {
+    GC_finalization_proc ofn = 0;
+    void *ocd = objs;
+
+    GC_register_finalizer(objs[i], 0, NULL, &ofn, &ocd);
+    if (ofn != dummy_finalizer || ocd != NULL) {
+      GC_printf("GC_register_finalizers failed\n");
+      FAIL;
+    }
+    if (GC_unregister_disappearing_link(links[i]) != 1) {
+      GC_printf("Batch-registered link is not found\n");
+      FAIL;
+    }
+  }
+}
+
+#  define N_DEFERRED_LINKS 100
+
+static AO_t deferred_dl_test_cnt = 0;
+
+static void
+deferred_dl_test(void)
+{
+  GC_hidden_pointer *links;
+  void **objs;
+  int prev_mode = GC_get_deferred_dl_registration();
+  int i, cleared = 0;
+
+  /* The mode is global, thus the test is run by one thread only. */
+  if (AO_fetch_and_add1(&deferred_dl_test_cnt) != 0 || GC_is_disabled()
+      || GC_get_find_leak())
+    return;
+  links = (GC_hidden_pointer *)checkOOM(
+      GC_MALLOC_ATOMIC(N_DEFERRED_LINKS * sizeof(GC_hidden_pointer)));
+  AO_fetch_and_add1(&atomic_count);
+  /*
+   * The objects are kept reachable till the pending registrations are
+   * dropped, as a collection might occur (initiated by another thread).
+   */
+  objs = (void **)checkOOM(GC_MALLOC(N_DEFERRED_LINKS * sizeof(void *)));
+  AO_fetch_and_add1(&collectable_count);
+  GC_set_deferred_dl_registration(1);
+  for (i = 0; i < N_DEFERRED_LINKS; i++) {
+    void *p = GC_base(checkOOM(GC_MALLOC(2 * sizeof(void *))));
+
+    AO_fetch_and_add1(&collectable_count);
+    objs[i] = p;
+    links[i] = GC_HIDE_POINTER(p);
+    if (GC_general_register_disappearing_link((void **)&links[i], p)
+        != GC_SUCCESS) {
+      GC_printf("Deferred disappearing link registration failed\n");
+      FAIL;
+    }
+  }
+  GC_END_STUBBORN_CHANGE(objs);
+
+  /* Drop a pending registration for every other link. */
+  for (i = 0; i < N_DEFERRED_LINKS; i += 2) {
+    if (GC_unregister_disappearing_link((void **)&links[i]) != 1) {
+      GC_printf("Pending disappearing link is not found\n");
+      FAIL;
+    }
+  }
+
+  BZERO(objs, N_DEFERRED_LINKS * sizeof(void *));
+  GC_END_STUBBORN_CHANGE(objs);
+
+  /* The pending links are merged (and processed) at the collection. */
+  gcollect_retried();
+  GC_set_deferred_dl_registration(prev_mode);
+  for (i = 0; i < N_DEFERRED_LINKS; i++) {
+    if (0 == links[i]) {
+      if ((i & 1) == 0) {
+        GC_printf("Unregistered disappearing link has been cleared\n");
+        FAIL;
+      }
+      cleared++;
+    } else if ((i & 1) != 0
+               && GC_unregister_disappearing_link((void **)&links[i]) != 1
+               && links[i] != 0 /*< not cleared by another collection */) {
+      GC_printf("Merged disappearing link is not found\n");
+      FAIL;
+    }
+  }
+  if (0 == cleared) {
+    GC_printf("No deferred disappearing link has been cleared\n");
+    FAIL;
+  }
+}
+
+#  ifndef GC_TOGGLE_REFS_NOT_NEEDED
+#    define N_TOGGLEREF_OBJS 20
+
+/* The objects of `toggleref_test`, hidden, and their native states. */
+static GC_hidden_pointer toggleref_objs[N_TOGGLEREF_OBJS];
+static GC_ToggleRefStatus toggleref_states[N_TOGGLEREF_OBJS];
+
+/* Updated with the allocator lock held. */
+static unsigned toggleref_callback_cnt = 0;
+
+static GC_ToggleRefStatus GC_CALLBACK
+toggleref_callback(void *obj)
+{
+  int i;
+
+  for (i = 0; i < N_TOGGLEREF_OBJS; i++) {
+    if (toggleref_objs[i] == GC_HIDE_POINTER(obj)) {
+      toggleref_callback_cnt++;
+      return toggleref_states[i];
+    }
+  }
+  /* The objects registered by `run_one_test` are not needed anymore. */
+  return GC_TOGGLE_REF_DROP;
+}
+
+static AO_t toggleref_test_cnt = 0;
+
+static void
+toggleref_test(void)
+{
+  GC_hidden_pointer *links;
+  unsigned cnt;
+  int i, cleared = 0;
+
+  /* The callback and the mode are global, thus run by one thread. */
+  if (AO_fetch_and_add1(&toggleref_test_cnt) != 0 || GC_is_disabled()
+      || GC_get_find_leak())
+    return;
+  links = (GC_hidden_pointer *)checkOOM(
+      GC_MALLOC_ATOMIC(N_TOGGLEREF_OBJS * sizeof(GC_hidden_pointer)));
+  AO_fetch_and_add1(&atomic_count);
+  GC_set_toggleref_func(toggleref_callback);
+  GC_set_toggleref_dirty_tracking(1);
+  for (i = 0; i < N_TOGGLEREF_OBJS; i++) {
+    void *p = GC_base(checkOOM(GC_MALLOC_ATOMIC(sizeof(void *))));
+
+    AO_fetch_and_add1(&atomic_count);
+    toggleref_states[i] = GC_TOGGLE_REF_STRONG;
+    toggleref_objs[i] = GC_HIDE_POINTER(p);
+    links[i] = GC_HIDE_POINTER(p);
+    if (GC_general_register_disappearing_link((void **)&links[i], p)
+            != GC_SUCCESS
+        || GC_toggleref_add(p, 1) != GC_SUCCESS) {
+      GC_printf("Toggle-ref registration failed\n");
+      FAIL;
+    }
+  }
+
+  /* Nothing is dirty, thus the callback should not be invoked. */
+  gcollect_retried();
+  GC_alloc_lock();
+  cnt = toggleref_callback_cnt;
+  GC_alloc_unlock();
+  if (cnt != 0) {
+    GC_printf("Toggle-ref callback invoked for clean objects\n");
+    FAIL;
+  }
+
+  /* Make a half of the objects weak. */
+  for (i = 0; i < N_TOGGLEREF_OBJS; i += 2) {
+    GC_alloc_lock();
+    toggleref_states[i] = GC_TOGGLE_REF_WEAK;
+    GC_alloc_unlock();
+    GC_toggleref_set_dirty(GC_REVEAL_POINTER(toggleref_objs[i]));
+  }
+  gcollect_retried();
+  GC_alloc_lock();
+  cnt = toggleref_callback_cnt;
+  GC_alloc_unlock();
+  if (cnt != N_TOGGLEREF_OBJS / 2) {
+    GC_printf("Toggle-ref callback invoked %u times, expected %d\n", cnt,
+              N_TOGGLEREF_OBJS / 2);
+    FAIL;
+  }
+  for (i = 0; i < N_TOGGLEREF_OBJS; i++) {
+    if (0 == links[i]) {
+      if (toggleref_states[i] != GC_TOGGLE_REF_WEAK) {
+        GC_printf("Strong toggle-ref object has been collected\n");
+        FAIL;
+      }
+      cleared++;
+    } else {
+      (void)GC_unregister_disappearing_link((void **)&links[i]);
+    }
+  }
+  if (0 == cleared) {
+    GC_printf("No weak toggle-ref object has been collected\n");
+    FAIL;
+  }
+
+  /* Drop all the toggle-refs at the next collection. */
+  GC_alloc_lock();
+  BZERO(toggleref_objs, sizeof(toggleref_objs));
+  GC_alloc_unlock();
+  GC_set_toggleref_dirty_tracking(0);
+}
+#  endif
+
+#  define N_CYCLE_FINALIZE_PAIRS 10
+
+static AO_t cycle_finalized_cnt = 0;
+
+static void GC_CALLBACK
+cycle_finalizer(void *obj, void *client_data)
+{
+  UNUSED_ARG(obj);
+  UNUSED_ARG(client_data);
+  AO_fetch_and_add1(&cycle_finalized_cnt);
+}
+
+/* Create the unreachable pairs of the finalizable objects. */
+static void GC_ATTR_NOINLINE
+make_finalizable_cycles(void)
+{
+  int i;
+
+  for (i = 0; i < N_CYCLE_FINALIZE_PAIRS; i++) {
+    void **a = (void **)checkOOM(GC_MALLOC(2 * sizeof(void *)));
+    void **b = (void **)checkOOM(GC_MALLOC(2 * sizeof(void *)));
+
+    AO_fetch_and_add1(&collectable_count);
+    AO_fetch_and_add1(&collectable_count);
+    GC_PTR_STORE_AND_DIRTY(a, b);
+    GC_PTR_STORE_AND_DIRTY(b, a);
+    GC_REGISTER_FINALIZER(a, cycle_finalizer, NULL, NULL, NULL);
+    GC_REGISTER_FINALIZER(b, cycle_finalizer, NULL, NULL, NULL);
+  }
+}
+
+static AO_t cycle_finalization_test_cnt = 0;
+
+static void
+cycle_finalization_test(void)
+{
+  int i;
+
+  /* The mode is global, thus run by one thread. */
+  if (AO_fetch_and_add1(&cycle_finalization_test_cnt) != 0
+      || GC_is_disabled() || GC_get_find_leak())
+    return;
+  GC_set_cycle_finalization(1);
+  make_finalizable_cycles();
+  for (i = 0;
+       i < 10 && AO_load(&cycle_finalized_cnt) < 2 * N_CYCLE_FINALIZE_PAIRS;
+       i++) {
+    gcollect_retried();
+    GC_invoke_finalizers();
+  }
+  GC_set_cycle_finalization(0);
+  if (AO_load(&cycle_finalized_cnt) != 2 * N_CYCLE_FINALIZE_PAIRS) {
+    GC_printf("Finalized %u objects of cycles, expected %u\n",
+              (unsigned)AO_load(&cycle_finalized_cnt),
+              2U * N_CYCLE_FINALIZE_PAIRS);
+    FAIL;
+  }
+}
+#endif /* !GC_NO_FINALIZATION */
+
+/* The number of the stack trace lines in the heap profile. */
+static int heap_profile_traces_cnt = -1;
+
+static int GC_CALLBACK
+heap_profile_write(void *client_data, const char *buf, size_t len)
+{
+  static const char header[] = "heap profile: ";
+  size_t i;
+  int cnt = 0;
+
+  UNUSED_ARG(client_data);
+  if (len < sizeof(header) - 1
+      || strncmp(buf, header, sizeof(header) - 1) != 0) {
+    GC_printf("Bad heap profile header\n");
+    FAIL;
+  }
+  for (i = 0; i < len; i++) {
+    if (buf[i] == '\n') {
+      cnt++;
+      /* An empty line precedes the memory map. */
+      if (i + 1 < len && buf[i + 1] == '\n')
+        break;
+    }
+  }
+  /* Exclude the header line. */
+  heap_profile_traces_cnt = cnt - 1;
+  return 0;
+}
+
+static AO_t heap_profile_test_cnt = 0;
+
+static void
+heap_profile_test(void)
+{
+  size_t old_rate;
+  int i;
+
+  /* The sample rate is global, thus run by one thread. */
+  if (AO_fetch_and_add1(&heap_profile_test_cnt) != 0)
+    return;
+  old_rate = GC_get_heap_profile_sample_rate();
+  GC_set_heap_profile_sample_rate(1024);
+  for (i = 0; i < 20; i++) {
+    (void)checkOOM(GC_MALLOC(HBLKSIZE));
+    AO_fetch_and_add1(&collectable_count);
+  }
+  if (GC_dump_heap_profile(heap_profile_write, NULL) != 0) {
+    GC_printf("GC_dump_heap_profile failed\n");
+    FAIL;
+  }
+  if (heap_profile_traces_cnt <= 0) {
+    GC_printf("No allocation sampled by heap profiler\n");
+    FAIL;
+  }
+  GC_set_heap_profile_sample_rate(old_rate);
+}
+
+#ifndef NO_TEST_HANDLE_FORK
+static AO_t heap_snapshot_test_cnt = 0;
+
+static void
+heap_snapshot_test(void)
+{
+  FILE *f;
+  off_t len;
+
+  if (AO_fetch_and_add1(&heap_snapshot_test_cnt) != 0)
+    return;
+  f = tmpfile();
+  if (NULL == f)
+    return; /*< cannot test */
+  if (GC_dump_heap_snapshot(fileno(f), GC_HEAP_SNAPSHOT_EDGES) != 0) {
+    GC_printf("GC_dump_heap_snapshot failed\n");
+    FAIL;
+  }
+  len = lseek(fileno(f), 0, SEEK_END);
+  (void)fclose(f);
+  if (len <= 0) {
+    GC_printf("Empty heap snapshot\n");
+    FAIL;
+  }
+}
+#endif
+
+static GC_bool trace_events_collection_seen = FALSE;
+
+#if defined(GC_PTHREADS) && defined(LINUX) && defined(SYS_gettid)
+#  define TEST_TRACE_RING_REUSE
+/*
+ * The number of the threads (created one after another) emitting the
+ * trace events; greater than the number of the rings.
+ */
+#  define TRACE_RING_REUSE_THREADS 100
+
+/* The `"tid":` field (with the thread id) to be found in the dump. */
+static char trace_events_tid_field[40];
+static GC_bool trace_events_tid_seen = FALSE;
+#endif
+
+static int GC_CALLBACK
+trace_events_write(void *client_data, const char *buf, size_t len)
+{
+  static const char header[] = "{\"traceEvents\":[";
+  static const char name[] = "\"name\":\"collection\"";
+  size_t i;
+
+  UNUSED_ARG(client_data);
+  if (len < sizeof(header) - 1
+      || strncmp(buf, header, sizeof(header) - 1) != 0) {
+    GC_printf("Bad trace events header\n");
+    FAIL;
+  }
+  for (i = 0; i + sizeof(name) - 1 <= len; i++) {
+    if (strncmp(buf + i, name, sizeof(name) - 1) == 0) {
+      trace_events_collection_seen = TRUE;
+      break;
+    }
+  }
+#ifdef TEST_TRACE_RING_REUSE
+  if (trace_events_tid_field[0] != '\0') {
+    size_t tid_len = strlen(trace_events_tid_field);
+
+    for (i = 0; i + tid_len <= len; i++) {
+      if (strncmp(buf + i, trace_events_tid_field, tid_len) == 0) {
+        trace_events_tid_seen = TRUE;
+        break;
+      }
+    }
+  }
+#endif
+  return 0;
+}
+
+#ifdef TEST_TRACE_RING_REUSE
+static void *
+trace_ring_reuse_thread(void *arg)
+{
+  gcollect_retried();
+  if (arg != NULL) {
+    /* The last thread: check its events are recorded. */
+    sprintf(trace_events_tid_field, "\"tid\":%ld,", (long)syscall(SYS_gettid));
+    if (GC_dump_trace_events(trace_events_write, NULL) != 0) {
+      GC_printf("GC_dump_trace_events failed\n");
+      FAIL;
+    }
+  }
+  return arg;
+}
+
+/*
+ * Check the ring of a thread is released when the thread exits, i.e.
+ * the events of a thread are recorded even after many threads (more
+ * than the number of the rings) have emitted the events and exited.
+ */
+static void
+trace_ring_reuse_test(void)
+{
+  int i;
+
+  for (i = 0; i < TRACE_RING_REUSE_THREADS; i++) {
+    pthread_t t;
+    void *arg
+        = i == TRACE_RING_REUSE_THREADS - 1 ? &trace_events_tid_seen : NULL;
+    int err = pthread_create(&t, NULL, trace_ring_reuse_thread, arg);
+
+    if (err != 0) {
+      GC_printf("Trace thread creation failed, errno= %d\n", err);
+      FAIL;
+    }
+    err = pthread_join(t, NULL);
+    if (err != 0) {
+      GC_printf("Trace thread join failed, errno= %d\n", err);
+      FAIL;
+    }
+  }
+  if (!trace_events_tid_seen && !GC_is_disabled()) {
+    GC_printf("No events of last thread recorded in trace buffer\n");
+    FAIL;
+  }
+}
+#endif
+
+static AO_t trace_events_test_cnt = 0;
+
+static void
+trace_events_test(void)
+{
+  size_t old_size;
+  int res;
+
+  /* The trace buffer is global, thus run by one thread. */
+  if (AO_fetch_and_add1(&trace_events_test_cnt) != 0)
+    return;
+  old_size = GC_get_trace_buffer_size();
+  GC_set_trace_buffer_size(256);
+  gcollect_retried();
+  res = GC_dump_trace_events(trace_events_write, NULL);
+  if (res == GC_UNIMPLEMENTED) {
+    /* The trace buffer is not supported. */
+  } else if (res != 0) {
+    GC_printf("GC_dump_trace_events failed\n");
+    FAIL;
+  } else if (!trace_events_collection_seen && !GC_is_disabled()) {
+    GC_printf("No collection recorded in trace buffer\n");
+    FAIL;
+  } else {
+#ifdef TEST_TRACE_RING_REUSE
+    trace_ring_reuse_test();
+#endif
+  }
+  GC_set_trace_buffer_size(old_size);
+}
+
 unsigned n_tests = 0;
 
 #ifndef NO_TYPED_TEST
@@ -1739,6 +2398,24 @@ run_one_test(void)
     GC_noop1_ptr(p);
     AO_fetch_and_add1(&collectable_count);
   }
+  {
+    void *p = checkOOM(GC_malloc_hinted(24, GC_HINT_SHORT_LIVED));
+    void *q = checkOOM(GC_malloc(24));
+    void *r = checkOOM(GC_malloc_atomic_hinted(24, GC_HINT_SHORT_LIVED));
+
+    AO_fetch_and_add1(&collectable_count);
+    AO_fetch_and_add1(&collectable_count);
+    AO_fetch_and_add1(&atomic_count);
+    if (*(int *)p != 0 || GC_base(p) != p || GC_size(p) < 24
+        || HBLKPTR(p) == HBLKPTR(q) || HBLKPTR(p) == HBLKPTR(r)) {
+      GC_printf("GC_malloc_hinted() produced incorrect result: %p\n", p);
+      FAIL;
+    }
+    GC_noop1_ptr(q);
+    GC_noop1_ptr(r);
+    (void)checkOOM(GC_malloc_hinted(24, GC_HINT_LONG_LIVED));
+    AO_fetch_and_add1(&collectable_count);
+  }
 #  ifndef GC_NO_VALLOC
   {
     void *p = checkOOM(GC_valloc(78));
@@ -1958,6 +2635,21 @@ run_one_test(void)
 #  endif
 #endif /* !NO_TYPED_TEST */
   tree_test();
+  heap_profile_test();
+#ifndef NO_TEST_HANDLE_FORK
+  heap_snapshot_test();
+#endif
+  trace_events_test();
+#ifndef GC_NO_FINALIZATION
+  ephemeron_test();
+  soft_link_test();
+  batch_register_test();
+  deferred_dl_test();
+#  ifndef GC_TOGGLE_REFS_NOT_NEEDED
+  toggleref_test();
+#  endif
+  cycle_finalization_test();
+#endif
 #ifdef TEST_WITH_SYSTEM_MALLOC
   free(checkOOM(calloc(1, 1)));
   free(checkOOM(realloc(NULL, 64)));
@@ -2269,6 +2961,44 @@ check_heap_stats(void)
   }
   (void)GC_get_size_map_at(-1);
   (void)GC_get_size_map_at(1);
+  {
+    size_t n_granules = GC_get_size_class_stats(NULL, 0, 0);
+    struct GC_size_class_stats_s *sc_stats
+        = (struct GC_size_class_stats_s *)checkOOM(
+            GC_MALLOC_ATOMIC(2 * n_granules * sizeof(*sc_stats)));
+    GC_word live_bytes = 0;
+    size_t i;
+
+    /* The first call starts gathering the counters during the sweep. */
+    (void)GC_get_size_class_stats(sc_stats, 2, n_granules);
+    GC_gcollect();
+    (void)GC_get_size_class_stats(sc_stats, 2, n_granules);
+    for (i = 0; i < 2 * n_granules; i++) {
+      live_bytes += sc_stats[i].live_bytes;
+    }
+    if (0 == live_bytes) {
+      GC_printf("GC_get_size_class_stats failed\n");
+      FAIL;
+    }
+  }
+  {
+    struct GC_tag_stats_s tag_stats[8];
+    void *p;
+
+    GC_set_allocation_tag(7);
+    p = checkOOM(GC_MALLOC(4 * HBLKSIZE));
+    if (GC_get_allocation_tag() == 7 && GC_get_tag_stats(tag_stats, 8) > 0) {
+      GC_gcollect();
+      (void)GC_get_tag_stats(tag_stats, 8);
+      if (tag_stats[7].heap_bytes < 4 * HBLKSIZE
+          || tag_stats[7].live_bytes < 4 * HBLKSIZE) {
+        GC_printf("GC_get_tag_stats failed\n");
+        FAIL;
+      }
+    }
+    GC_set_allocation_tag(0);
+    GC_reachable_here(p);
+  }
 #endif
   if (GC_size(NULL) != 0) {
     GC_printf("GC_size(NULL) failed\n");
@@ -2671,6 +3401,56 @@ has_static_roots(const char *dlpi_name, void *section_start,
   return 1;
 }
 
+#  ifndef GC_NO_FINALIZATION
+#    define N_FNLZ_THREADS_OBJS 10
+
+static AO_t fnlz_threads_finalized = 0;
+
+static void GC_CALLBACK
+fnlz_threads_finalizer(void *obj, void *client_data)
+{
+  UNUSED_ARG(obj);
+  UNUSED_ARG(client_data);
+  AO_fetch_and_add1(&fnlz_threads_finalized);
+}
+
+/*
+ * Start the finalizer worker threads and wait for them to run at least
+ * one finalizer.  The workers could not be stopped, thus this is done
+ * once the other tests are finished.
+ */
+static void
+finalizer_threads_test(void)
+{
+  int i, res;
+
+  if (GC_is_disabled() || GC_get_find_leak())
+    return;
+  res = GC_start_finalizer_threads(2);
+  if (GC_UNIMPLEMENTED == res)
+    return;
+  if (res != GC_SUCCESS || GC_get_finalizer_threads() != 2) {
+    GC_printf("GC_start_finalizer_threads failed, result= %d\n", res);
+    FAIL;
+  }
+  if (GC_start_finalizer_threads(1) != GC_DUPLICATE) {
+    GC_printf("Finalizer threads have been started twice\n");
+    FAIL;
+  }
+  for (i = 0; i < N_FNLZ_THREADS_OBJS; i++) {
+    GC_REGISTER_FINALIZER(checkOOM(GC_MALLOC(2 * sizeof(void *))),
+                          fnlz_threads_finalizer, NULL, NULL, NULL);
+  }
+  for (i = 0; AO_load(&fnlz_threads_finalized) == 0; i++) {
+    if (i > 10000) {
+      GC_printf("Finalizer threads have not run any finalizer\n");
+      FAIL;
+    }
+    GC_gcollect();
+  }
+}
+#  endif
+
 #  ifdef GC_DEBUG
 #    define GC_free GC_debug_free
 #  endif
@@ -2796,6 +3576,9 @@ main(void)
   GC_print_trace(0);
 #  endif
   check_heap_stats();
+#  ifndef GC_NO_FINALIZATION
+  finalizer_threads_test();
+#  endif
   (void)fflush(stdout);
   (void)pthread_attr_destroy(&attr);
 
@@ -2809,6 +3592,7 @@ main(void)
   (void)GC_get_warn_proc();
   (void)GC_is_disabled();
   GC_set_allocd_bytes_per_finalizer(GC_get_allocd_bytes_per_finalizer());
+  GC_set_check_heap_slices(GC_get_check_heap_slices());
   GC_set_disable_automatic_collection(GC_get_disable_automatic_collection());
   GC_set_dont_expand(GC_get_dont_expand());
   GC_set_dont_precollect(GC_get_dont_precollect());
@@ -2833,15 +3617,21 @@ main(void)
   GC_set_stop_func(GC_get_stop_func());
   GC_set_thr_restart_signal(GC_get_thr_restart_signal());
   GC_set_time_limit(GC_get_time_limit());
+  GC_set_heap_profile_sample_rate(GC_get_heap_profile_sample_rate());
   GC_set_abort_func(GC_get_abort_func());
 #  ifndef NO_CLOCK
   GC_set_time_limit_tv(GC_get_time_limit_tv());
 #  endif
 #  ifndef GC_NO_FINALIZATION
   GC_set_await_finalize_proc(GC_get_await_finalize_proc());
+  GC_set_deferred_dl_registration(GC_get_deferred_dl_registration());
   GC_set_interrupt_finalizers(GC_get_interrupt_finalizers());
+  GC_set_cycle_finalization(GC_get_cycle_finalization());
+  (void)GC_get_finalizer_queue_depth();
+  (void)GC_get_finalizer_threads();
 #    ifndef GC_TOGGLE_REFS_NOT_NEEDED
   GC_set_toggleref_func(GC_get_toggleref_func());
+  GC_set_toggleref_dirty_tracking(GC_get_toggleref_dirty_tracking());
 #    endif
 #  endif
 #  if defined(CPPCHECK)
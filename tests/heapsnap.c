@@ -0,0 +1,78 @@
+/*
+ * THIS MATERIAL IS PROVIDED AS IS, WITH ABSOLUTELY NO WARRANTY EXPRESSED
+ * OR IMPLIED.  ANY USE IS AT YOUR OWN RISK.
+ *
+ * Permission is hereby granted to use or copy this program
+ * for any purpose, provided the above notices are retained on all copies.
+ * Permission to modify the code and to distribute modified code is granted,
+ * provided the above notices are retained, and a notice that the code was
+ * modified is included with the above copyright notice.
+ */
+
+/*
+ * Write a heap snapshot (with the references) of a small heap to the
+ * file given by the argument (or to `heapsnap.out` by default).  The
+ * snapshot is checked by running `snapstat` tool on the written file.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "gc.h"
+
+#define N_LIST_NODES 1000
+
+#define CHECK_OUT_OF_MEMORY(p)            \
+  do {                                    \
+    if (NULL == (p)) {                    \
+      fprintf(stderr, "Out of memory\n"); \
+      exit(69);                           \
+    }                                     \
+  } while (0)
+
+/* A list referenced from the static data, thus from a recorded root. */
+static void **list_head;
+
+int
+main(int argc, char **argv)
+{
+  const char *fname = argc > 1 ? argv[1] : "heapsnap.out";
+  FILE *f;
+  int i, res;
+
+  GC_INIT();
+  if (GC_get_find_leak()) {
+    printf("This test does not work in the find-leak mode\n");
+    return 0;
+  }
+  for (i = 0; i < N_LIST_NODES; i++) {
+    void **p = (void **)GC_MALLOC(2 * sizeof(void *) + (unsigned)i % 64);
+
+    CHECK_OUT_OF_MEMORY(p);
+    p[0] = list_head;
+    list_head = p;
+  }
+  CHECK_OUT_OF_MEMORY(GC_MALLOC_ATOMIC(64 * 1024));
+  GC_gcollect();
+
+  f = fopen(fname, "wb");
+  if (NULL == f) {
+    perror(fname);
+    return 1;
+  }
+  res = GC_dump_heap_snapshot(fileno(f), GC_HEAP_SNAPSHOT_EDGES);
+  if (fclose(f) != 0) {
+    perror(fname);
+    return 1;
+  }
+  if (GC_UNIMPLEMENTED == res) {
+    printf("Heap snapshot is not supported on the platform\n");
+    return 0;
+  }
+  if (res != GC_SUCCESS) {
+    fprintf(stderr, "GC_dump_heap_snapshot failed, result= %d\n", res);
+    return 1;
+  }
+  printf("SUCCEEDED\n");
+  return 0;
+}
@@ -8,10 +8,20 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#if !defined(_WIN32) && !defined(SHORT_DBG_HDRS)
+#  include <unistd.h>
+/* The smashed object reports are written to `stderr` (fd 2). */
+#  define CHECK_SMASH_REPORTED
+#endif
 
 #define COUNT 7000
 #define SIZE 40
 
+/* The number of collections the heap check is spread over. */
+#define N_SLICES 3
+
 #define CHECK_OUT_OF_MEMORY(p)            \
   do {                                    \
     if (NULL == (p)) {                    \
@@ -24,13 +34,70 @@ char *A[COUNT];
 
 char *volatile q;
 
+/*
+ * Run as many collections as needed to check the whole heap, and check
+ * that the smashed object is reported (while the object is reachable,
+ * it is reported every time its block is checked).
+ */
+static void
+collect_and_check_smash_reported(const char *what)
+{
+  int i;
+#ifdef CHECK_SMASH_REPORTED
+  char buf[4096];
+  ssize_t len;
+  int saved_fd;
+  FILE *f = tmpfile();
+
+  if (NULL == f) {
+    perror("tmpfile");
+    exit(1);
+  }
+  (void)fflush(stderr);
+  saved_fd = dup(2);
+  if (saved_fd < 0 || dup2(fileno(f), 2) < 0) {
+    perror("dup");
+    exit(1);
+  }
+#endif
+  for (i = 0; i < N_SLICES; i++) {
+    GC_gcollect();
+  }
+#ifdef CHECK_SMASH_REPORTED
+  if (dup2(saved_fd, 2) < 0) {
+    perror("dup2");
+    exit(1);
+  }
+  (void)close(saved_fd);
+  len = lseek(fileno(f), 0, SEEK_SET) == 0
+            ? read(fileno(f), buf, sizeof(buf) - 1)
+            : -1;
+  (void)fclose(f);
+  if (len < 0) {
+    perror("read");
+    exit(1);
+  }
+  buf[len] = '\0';
+  fputs(buf, stderr);
+  if (NULL == strstr(buf, "smashed")) {
+    fprintf(stderr, "Smashed object is not reported by %s check\n", what);
+    exit(1);
+  }
+#else
+  (void)what;
+#endif
+}
+
 int
 main(void)
 {
   int i;
   char *p;
 
+  /* Use the parallel heap check once the marker threads are started. */
+  GC_set_markers_count(4);
   GC_INIT();
+  GC_set_check_heap_slices(N_SLICES);
   for (i = 0; i < COUNT; ++i) {
     A[i] = p = (char *)GC_MALLOC(SIZE);
     CHECK_OUT_OF_MEMORY(p);
@@ -48,6 +115,11 @@ main(void)
       *q = 42;
     }
   }
+  collect_and_check_smash_reported("serial");
+
+  /* Test delayed start of marker threads, if they are enabled. */
+  GC_start_mark_threads();
+  collect_and_check_smash_reported("parallel");
   printf("SUCCEEDED\n");
   return 0;
 }
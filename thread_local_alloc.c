@@ -126,6 +126,12 @@ GC_init_thread_local(GC_tlfs p)
     for (kind = 0; kind < THREAD_FREELISTS_KINDS; ++kind) {
       p->_freelists[kind][j] = NUMERIC_TO_VPTR(1);
     }
+    for (kind = 0; kind <= NORMAL; ++kind) {
+      p->short_lived_freelists[kind][j] = NUMERIC_TO_VPTR(1);
+    }
+#  ifdef ENABLE_DISCLAIM
+    p->finalized_freelists[j] = NUMERIC_TO_VPTR(1);
+#  endif
 #  ifdef GC_GCJ_SUPPORT
     p->gcj_freelists[j] = NUMERIC_TO_VPTR(1);
 #  endif
@@ -138,6 +144,9 @@ GC_init_thread_local(GC_tlfs p)
 #  ifdef GC_GCJ_SUPPORT
   p->gcj_freelists[0] = MAKE_CPTR(ERROR_FL);
 #  endif
+#  ifdef ALLOC_TAGS
+  p->alloc_tag = 0;
+#  endif
 }
 
 GC_INNER void
@@ -156,6 +165,19 @@ GC_destroy_thread_local(GC_tlfs p)
     }
     return_freelists(p->_freelists[kind], GC_obj_kinds[kind].ok_freelist);
   }
+  if (GC_short_lived_kinds_initialized) {
+    for (kind = 0; kind <= NORMAL; ++kind) {
+      return_freelists(
+          p->short_lived_freelists[kind],
+          GC_obj_kinds[GC_short_lived_kinds[kind]].ok_freelist);
+    }
+  }
+#  ifdef ENABLE_DISCLAIM
+  if (GC_finalized_kind != 0) {
+    return_freelists(p->finalized_freelists,
+                     GC_obj_kinds[GC_finalized_kind].ok_freelist);
+  }
+#  endif
 #  ifdef GC_GCJ_SUPPORT
   return_freelists(p->gcj_freelists, (void **)GC_gcjobjfreelist);
 #  endif
@@ -183,6 +205,35 @@ GC_get_tlfs(void)
 #  endif
 }
 
+#  ifdef ALLOC_TAGS
+GC_API void GC_CALL
+GC_set_allocation_tag(unsigned tag)
+{
+  void *tsd;
+
+  if (!EXPECT(GC_is_initialized, TRUE))
+    GC_init();
+  tsd = GC_get_tlfs();
+  if (EXPECT(tsd != NULL, TRUE))
+    ((GC_tlfs)tsd)->alloc_tag
+        = (unsigned short)(tag < GC_MAX_ALLOC_TAGS ? tag : 0);
+}
+
+GC_API unsigned GC_CALL
+GC_get_allocation_tag(void)
+{
+  void *tsd = GC_get_tlfs();
+
+  return tsd != NULL ? ((GC_tlfs)tsd)->alloc_tag : 0;
+}
+
+GC_INNER unsigned
+GC_current_alloc_tag(void)
+{
+  return GC_get_allocation_tag();
+}
+#  endif
+
 GC_API GC_ATTR_MALLOC void *GC_CALL
 GC_malloc_kind(size_t lb, int kind)
 {
@@ -218,6 +269,57 @@ GC_malloc_kind(size_t lb, int kind)
   return result;
 }
 
+GC_INNER void *
+GC_malloc_kind_hinted(size_t lb, int kind, int hint)
+{
+  int short_lived_kind;
+  size_t lg;
+  void *tsd;
+  void *result;
+
+  GC_ASSERT(PTRFREE == kind || NORMAL == kind);
+  if (hint != GC_HINT_SHORT_LIVED)
+    return GC_malloc_kind(lb, kind);
+
+  short_lived_kind = GC_get_short_lived_kind(kind);
+  tsd = GC_get_tlfs();
+  if (EXPECT(NULL == tsd, FALSE)) {
+    return GC_malloc_kind_global(lb, short_lived_kind);
+  }
+  GC_ASSERT(GC_is_thread_tsd_valid(tsd));
+  lg = ALLOC_REQUEST_GRANS(lb);
+  GC_FAST_MALLOC_GRANS(
+      result, lg, ((GC_tlfs)tsd)->short_lived_freelists[kind],
+      DIRECT_GRANULES, short_lived_kind,
+      GC_malloc_kind_global(lb, short_lived_kind),
+      (void)(kind == PTRFREE ? MALLOC_KIND_PTRFREE_INIT
+                             : (obj_link(result) = 0)));
+  return result;
+}
+
+#  ifdef ENABLE_DISCLAIM
+GC_INNER void *
+GC_malloc_finalized_kind(size_t lb)
+{
+  int kind = (int)GC_finalized_kind;
+  size_t lg;
+  void *tsd;
+  void *result;
+
+  GC_ASSERT(kind != 0);
+  tsd = GC_get_tlfs();
+  if (EXPECT(NULL == tsd, FALSE)) {
+    return GC_malloc_kind_global(lb, kind);
+  }
+  GC_ASSERT(GC_is_thread_tsd_valid(tsd));
+  lg = ALLOC_REQUEST_GRANS(lb);
+  GC_FAST_MALLOC_GRANS(result, lg, ((GC_tlfs)tsd)->finalized_freelists,
+                       DIRECT_GRANULES, kind, GC_malloc_kind_global(lb, kind),
+                       (void)(obj_link(result) = 0));
+  return result;
+}
+#  endif /* ENABLE_DISCLAIM */
+
 #  ifdef GC_GCJ_SUPPORT
 
 #    include "gc/gc_gcj.h"
@@ -301,6 +403,16 @@ GC_mark_thread_local_fls_for(GC_tlfs p)
       if (ADDR(q) > HBLKSIZE)
         GC_set_fl_marks(q);
     }
+    for (kind = 0; kind <= NORMAL; ++kind) {
+      q = GC_cptr_load((volatile ptr_t *)&p->short_lived_freelists[kind][j]);
+      if (ADDR(q) > HBLKSIZE)
+        GC_set_fl_marks(q);
+    }
+#  ifdef ENABLE_DISCLAIM
+    q = GC_cptr_load((volatile ptr_t *)&p->finalized_freelists[j]);
+    if (ADDR(q) > HBLKSIZE)
+      GC_set_fl_marks(q);
+#  endif
 #  ifdef GC_GCJ_SUPPORT
     if (EXPECT(j > 0, TRUE)) {
       q = GC_cptr_load((volatile ptr_t *)&p->gcj_freelists[j]);
@@ -322,6 +434,12 @@ GC_check_tls_for(GC_tlfs p)
     for (kind = 0; kind < THREAD_FREELISTS_KINDS; ++kind) {
       GC_check_fl_marks(&p->_freelists[kind][j]);
     }
+    for (kind = 0; kind <= NORMAL; ++kind) {
+      GC_check_fl_marks(&p->short_lived_freelists[kind][j]);
+    }
+#    ifdef ENABLE_DISCLAIM
+    GC_check_fl_marks(&p->finalized_freelists[j]);
+#    endif
 #    ifdef GC_GCJ_SUPPORT
     GC_check_fl_marks(&p->gcj_freelists[j]);
 #    endif
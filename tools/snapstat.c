@@ -0,0 +1,598 @@
+/*
+ * THIS MATERIAL IS PROVIDED AS IS, WITH ABSOLUTELY NO WARRANTY EXPRESSED
+ * OR IMPLIED.  ANY USE IS AT YOUR OWN RISK.
+ *
+ * Permission is hereby granted to use or copy this program
+ * for any purpose, provided the above notices are retained on all copies.
+ * Permission to modify the code and to distribute modified code is granted,
+ * provided the above notices are retained, and a notice that the code was
+ * modified is included with the above copyright notice.
+ */
+
+/*
+ * An offline analyzer of the heap snapshots produced by
+ * `GC_dump_heap_snapshot()` (the format is described in `heapsnap.c`
+ * file).  Does not depend on the collector, thus could be built
+ * separately, e.g.:
+ *   `cc -O2 -o snapstat tools/snapstat.c`
+ * Usage:
+ *   `snapstat [-n <count>] <snapshot-file>`
+ * Prints the per-kind and per-size statistics of the heap blocks and, if
+ * the snapshot contains the references, the marked objects retaining the
+ * most memory (the retained size of an object is the total size of the
+ * objects dominated by it in the reference graph, i.e. which would become
+ * unreachable if the object were).  The objects not reachable from the
+ * recorded roots (e.g. referenced only from the thread stacks) are treated
+ * as the roots themselves.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SNAPSHOT_HEADER 1
+#define SNAPSHOT_BLOCK 2
+#define SNAPSHOT_EDGES 3
+#define SNAPSHOT_ROOTS 4
+#define SNAPSHOT_END 5
+
+#define SNAPSHOT_VERSION 1
+
+#define DEFAULT_TOP_COUNT 20
+
+/* The number of object kinds reported separately. */
+#define MAX_KINDS 32
+
+struct size_class_s {
+  unsigned kind;
+  uint64_t obj_sz;
+  uint64_t blocks;
+  uint64_t objs;
+  uint64_t marked;
+};
+
+struct node_s {
+  uint64_t addr;
+  uint64_t sz;
+  unsigned kind;
+};
+
+struct edge_s {
+  uint64_t src;
+  uint64_t dst;
+};
+
+static unsigned word_sz;
+
+static struct size_class_s *classes;
+static size_t n_classes, classes_cap;
+
+static struct node_s *nodes;
+static size_t n_nodes, nodes_cap;
+
+static struct edge_s *edges;
+static size_t n_edges, edges_cap;
+
+static uint64_t *roots;
+static size_t n_roots, roots_cap;
+
+static void
+die(const char *msg)
+{
+  fprintf(stderr, "snapstat: %s\n", msg);
+  exit(1);
+}
+
+static void *
+grow(void *p, size_t *pcap, size_t elem_sz)
+{
+  size_t cap = *pcap != 0 ? *pcap * 2 : 1024;
+
+  p = realloc(p, cap * elem_sz);
+  if (NULL == p)
+    die("out of memory");
+  *pcap = cap;
+  return p;
+}
+
+static uint32_t
+get_u32(const unsigned char *p)
+{
+  uint32_t v;
+
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static uint64_t
+get_word(const unsigned char *p)
+{
+  if (4 == word_sz)
+    return get_u32(p);
+  {
+    uint64_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return v;
+  }
+}
+
+static void
+add_block(const unsigned char *p, size_t len)
+{
+  uint64_t addr, obj_sz;
+  unsigned kind;
+  uint32_t n_objs, n_marks, i;
+  const unsigned char *bits;
+  size_t j;
+
+  if (len < 2 * (size_t)word_sz + 16)
+    die("malformed block record");
+  addr = get_word(p);
+  obj_sz = get_word(p + word_sz);
+  p += 2 * word_sz;
+  kind = get_u32(p);
+  n_objs = get_u32(p + 8);
+  n_marks = get_u32(p + 12);
+  bits = p + 16;
+  if (len < 2 * (size_t)word_sz + 16 + (n_objs + 7) / 8)
+    die("malformed block record");
+
+  for (j = 0; j < n_classes; j++) {
+    if (classes[j].kind == kind && classes[j].obj_sz == obj_sz)
+      break;
+  }
+  if (j == n_classes) {
+    if (n_classes == classes_cap)
+      classes = (struct size_class_s *)grow(classes, &classes_cap,
+                                            sizeof(struct size_class_s));
+    memset(&classes[j], 0, sizeof(struct size_class_s));
+    classes[j].kind = kind;
+    classes[j].obj_sz = obj_sz;
+    n_classes++;
+  }
+  classes[j].blocks++;
+  classes[j].objs += n_objs;
+  classes[j].marked += n_marks;
+
+  for (i = 0; i < n_objs; i++) {
+    if ((bits[i >> 3] & (1U << (i & 7))) == 0)
+      continue;
+    if (n_nodes == nodes_cap)
+      nodes = (struct node_s *)grow(nodes, &nodes_cap,
+                                    sizeof(struct node_s));
+    nodes[n_nodes].addr = addr + (uint64_t)i * obj_sz;
+    nodes[n_nodes].sz = obj_sz;
+    nodes[n_nodes].kind = kind;
+    n_nodes++;
+  }
+}
+
+static void
+add_refs(const unsigned char *p, size_t len, int is_roots)
+{
+  uint64_t src = 0;
+
+  if (!is_roots) {
+    if (len < word_sz)
+      die("malformed edges record");
+    src = get_word(p);
+    p += word_sz;
+    len -= word_sz;
+  }
+  for (; len >= word_sz; p += word_sz, len -= word_sz) {
+    if (is_roots) {
+      if (n_roots == roots_cap)
+        roots = (uint64_t *)grow(roots, &roots_cap, sizeof(uint64_t));
+      roots[n_roots++] = get_word(p);
+    } else {
+      if (n_edges == edges_cap)
+        edges = (struct edge_s *)grow(edges, &edges_cap,
+                                      sizeof(struct edge_s));
+      edges[n_edges].src = src;
+      edges[n_edges].dst = get_word(p);
+      n_edges++;
+    }
+  }
+}
+
+/* Returns nonzero if the snapshot has the references. */
+static int
+read_snapshot(FILE *f)
+{
+  unsigned char hdr[8];
+  unsigned char *buf = NULL;
+  size_t buf_cap = 0;
+  int seen_header = 0;
+  int seen_end = 0;
+  int has_edges = 0;
+
+  while (!seen_end && fread(hdr, 1, sizeof(hdr), f) == sizeof(hdr)) {
+    uint32_t type = get_u32(hdr);
+    size_t len = get_u32(hdr + 4);
+
+    if (len > buf_cap) {
+      buf_cap = len;
+      buf = (unsigned char *)realloc(buf, buf_cap);
+      if (NULL == buf)
+        die("out of memory");
+    }
+    if (len > 0 && fread(buf, 1, len, f) != len)
+      break;
+    if (!seen_header && type != SNAPSHOT_HEADER)
+      die("not a heap snapshot");
+    switch (type) {
+    case SNAPSHOT_HEADER:
+      if (len < 24 || get_u32(buf) != 0x01020304)
+        die("not a heap snapshot or byte order mismatch");
+      if (get_u32(buf + 4) != SNAPSHOT_VERSION)
+        die("unsupported snapshot version");
+      word_sz = get_u32(buf + 8);
+      if ((word_sz != 4 && word_sz != 8) || len < 24 + 2 * (size_t)word_sz)
+        die("malformed header record");
+      has_edges = (get_u32(buf + 20) & 1) != 0;
+      printf("GC #%lu, heap size: %lu bytes, block size: %lu bytes\n",
+             (unsigned long)get_word(buf + 24),
+             (unsigned long)get_word(buf + 24 + word_sz),
+             (unsigned long)get_u32(buf + 12));
+      seen_header = 1;
+      break;
+    case SNAPSHOT_BLOCK:
+      add_block(buf, len);
+      break;
+    case SNAPSHOT_EDGES:
+    case SNAPSHOT_ROOTS:
+      add_refs(buf, len, SNAPSHOT_ROOTS == type);
+      break;
+    case SNAPSHOT_END:
+      seen_end = 1;
+      break;
+    default:
+      /* Skip an unknown record. */
+      break;
+    }
+  }
+  free(buf);
+  if (!seen_header)
+    die("not a heap snapshot");
+  if (!seen_end)
+    fprintf(stderr, "snapstat: warning: truncated snapshot\n");
+  return has_edges;
+}
+
+static int
+cmp_classes(const void *a, const void *b)
+{
+  const struct size_class_s *x = (const struct size_class_s *)a;
+  const struct size_class_s *y = (const struct size_class_s *)b;
+
+  if (x->kind != y->kind)
+    return x->kind < y->kind ? -1 : 1;
+  if (x->obj_sz != y->obj_sz)
+    return x->obj_sz < y->obj_sz ? -1 : 1;
+  return 0;
+}
+
+static void
+print_histogram(void)
+{
+  uint64_t kind_blocks[MAX_KINDS], kind_objs[MAX_KINDS];
+  uint64_t kind_marked[MAX_KINDS], kind_bytes[MAX_KINDS];
+  size_t i;
+
+  memset(kind_blocks, 0, sizeof(kind_blocks));
+  memset(kind_objs, 0, sizeof(kind_objs));
+  memset(kind_marked, 0, sizeof(kind_marked));
+  memset(kind_bytes, 0, sizeof(kind_bytes));
+  qsort(classes, n_classes, sizeof(struct size_class_s), cmp_classes);
+  printf("\n%4s %10s %10s %12s %12s %14s\n", "kind", "obj_sz", "blocks",
+         "objs", "marked", "marked_bytes");
+  for (i = 0; i < n_classes; i++) {
+    const struct size_class_s *c = &classes[i];
+    unsigned k = c->kind < MAX_KINDS ? c->kind : MAX_KINDS - 1;
+
+    printf("%4u %10lu %10lu %12lu %12lu %14lu\n", c->kind,
+           (unsigned long)c->obj_sz, (unsigned long)c->blocks,
+           (unsigned long)c->objs, (unsigned long)c->marked,
+           (unsigned long)(c->marked * c->obj_sz));
+    kind_blocks[k] += c->blocks;
+    kind_objs[k] += c->objs;
+    kind_marked[k] += c->marked;
+    kind_bytes[k] += c->marked * c->obj_sz;
+  }
+  printf("\n%4s %10s %12s %12s %14s\n", "kind", "blocks", "objs", "marked",
+         "marked_bytes");
+  for (i = 0; i < MAX_KINDS; i++) {
+    if (0 == kind_blocks[i])
+      continue;
+    printf("%4u %10lu %12lu %12lu %14lu\n", (unsigned)i,
+           (unsigned long)kind_blocks[i], (unsigned long)kind_objs[i],
+           (unsigned long)kind_marked[i], (unsigned long)kind_bytes[i]);
+  }
+}
+
+static int
+cmp_nodes(const void *a, const void *b)
+{
+  const struct node_s *x = (const struct node_s *)a;
+  const struct node_s *y = (const struct node_s *)b;
+
+  return x->addr < y->addr ? -1 : x->addr > y->addr ? 1 : 0;
+}
+
+/* Returns the index of the node at `addr`, or `n_nodes` if none. */
+static size_t
+find_node(uint64_t addr)
+{
+  size_t lo = 0, hi = n_nodes;
+
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+
+    if (nodes[mid].addr < addr) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo < n_nodes && nodes[lo].addr == addr ? lo : n_nodes;
+}
+
+static void *
+xcalloc(size_t n, size_t elem_sz)
+{
+  void *p = calloc(n != 0 ? n : 1, elem_sz);
+
+  if (NULL == p)
+    die("out of memory");
+  return p;
+}
+
+/* Builds the compressed adjacency lists (by source or by target). */
+static void
+build_csr(const size_t *from, const size_t *to, size_t n, size_t **pstart,
+          size_t **padj)
+{
+  size_t *start = (size_t *)xcalloc(n_nodes + 2, sizeof(size_t));
+  size_t *adj = (size_t *)xcalloc(n, sizeof(size_t));
+  size_t *fill;
+  size_t i;
+
+  for (i = 0; i < n; i++)
+    start[from[i] + 1]++;
+  for (i = 0; i <= n_nodes; i++)
+    start[i + 1] += start[i];
+  fill = (size_t *)xcalloc(n_nodes + 1, sizeof(size_t));
+  memcpy(fill, start, (n_nodes + 1) * sizeof(size_t));
+  for (i = 0; i < n; i++)
+    adj[fill[from[i]]++] = to[i];
+  free(fill);
+  *pstart = start;
+  *padj = adj;
+}
+
+static uint64_t *retained;
+
+static int
+cmp_retained(const void *a, const void *b)
+{
+  uint64_t x = retained[*(const size_t *)a];
+  uint64_t y = retained[*(const size_t *)b];
+
+  return x > y ? -1 : x < y ? 1 : 0;
+}
+
+/*
+ * Computes the dominator tree using the iterative algorithm by Cooper,
+ * Harvey and Kennedy, and prints the nodes with the largest retained
+ * sizes.  The node with `n_nodes` index is the virtual root.
+ */
+static void
+print_retainers(size_t top_count)
+{
+  size_t root = n_nodes;
+  size_t n_refs = n_edges + n_roots;
+  size_t *from = (size_t *)xcalloc(n_refs, sizeof(size_t));
+  size_t *to = (size_t *)xcalloc(n_refs, sizeof(size_t));
+  size_t *succ_start, *succ, *pred_start, *pred;
+  size_t *rpo_num, *order, *idom, *stack, *next_child, *top;
+  size_t i, n = 0, n_order, sp;
+  int changed;
+
+  qsort(nodes, n_nodes, sizeof(struct node_s), cmp_nodes);
+  for (i = 0; i < n_roots; i++) {
+    size_t dst = find_node(roots[i]);
+
+    if (dst < n_nodes) {
+      from[n] = root;
+      to[n++] = dst;
+    }
+  }
+  for (i = 0; i < n_edges; i++) {
+    size_t src = find_node(edges[i].src);
+    size_t dst = find_node(edges[i].dst);
+
+    if (src < n_nodes && dst < n_nodes && src != dst) {
+      from[n] = src;
+      to[n++] = dst;
+    }
+  }
+  n_refs = n;
+
+  /*
+   * Number the nodes in the reverse postorder of the depth-first search
+   * from the virtual root.  Each node left unreached is linked to the
+   * virtual root (and searched from) afterwards.
+   */
+  build_csr(from, to, n_refs, &succ_start, &succ);
+  rpo_num = (size_t *)xcalloc(n_nodes + 1, sizeof(size_t));
+  order = (size_t *)xcalloc(n_nodes + 1, sizeof(size_t));
+  stack = (size_t *)xcalloc(n_nodes + 1, sizeof(size_t));
+  next_child = (size_t *)xcalloc(n_nodes + 1, sizeof(size_t));
+  idom = (size_t *)xcalloc(n_nodes + 1, sizeof(size_t));
+  for (i = 0; i <= n_nodes; i++)
+    idom[i] = (size_t)-1; /*< not visited yet */
+  n_order = 0;
+  n = 0; /*< the next node to check whether it is unreached */
+  idom[root] = 0;
+  sp = 0;
+  stack[sp++] = root;
+  next_child[root] = succ_start[root];
+  while (sp > 0) {
+    size_t v = stack[sp - 1];
+    size_t w;
+
+    if (next_child[v] < succ_start[v + 1]) {
+      w = succ[next_child[v]++];
+    } else if (v == root) {
+      while (n < n_nodes && idom[n] != (size_t)-1)
+        n++;
+      if (n == n_nodes) {
+        order[n_order++] = v;
+        sp--;
+        continue;
+      }
+      /* Link the unreached node to the virtual root. */
+      w = n;
+      from = (size_t *)realloc(from, (n_refs + 1) * sizeof(size_t));
+      to = (size_t *)realloc(to, (n_refs + 1) * sizeof(size_t));
+      if (NULL == from || NULL == to)
+        die("out of memory");
+      from[n_refs] = root;
+      to[n_refs++] = w;
+    } else {
+      order[n_order++] = v; /*< postorder */
+      sp--;
+      continue;
+    }
+    if (idom[w] == (size_t)-1) {
+      idom[w] = 0;
+      next_child[w] = succ_start[w];
+      stack[sp++] = w;
+    }
+  }
+  /* Now the virtual root is the last one (in the postorder). */
+  for (i = 0; i < n_order / 2; i++) {
+    size_t t = order[i];
+
+    order[i] = order[n_order - 1 - i];
+    order[n_order - 1 - i] = t;
+  }
+  for (i = 0; i < n_order; i++)
+    rpo_num[order[i]] = i;
+  free(succ_start);
+  free(succ);
+  free(stack);
+  free(next_child);
+
+  build_csr(to, from, n_refs, &pred_start, &pred);
+  free(from);
+  free(to);
+  for (i = 0; i <= n_nodes; i++)
+    idom[i] = (size_t)-1;
+  idom[root] = root;
+  do {
+    changed = 0;
+    for (i = 1; i < n_order; i++) {
+      size_t v = order[i];
+      size_t new_idom = (size_t)-1;
+      size_t j;
+
+      for (j = pred_start[v]; j < pred_start[v + 1]; j++) {
+        size_t p = pred[j];
+
+        if (idom[p] == (size_t)-1)
+          continue;
+        if (new_idom == (size_t)-1) {
+          new_idom = p;
+        } else {
+          size_t a = p, b = new_idom;
+
+          while (a != b) {
+            while (rpo_num[a] > rpo_num[b])
+              a = idom[a];
+            while (rpo_num[b] > rpo_num[a])
+              b = idom[b];
+          }
+          new_idom = a;
+        }
+      }
+      if (new_idom != (size_t)-1 && idom[v] != new_idom) {
+        idom[v] = new_idom;
+        changed = 1;
+      }
+    }
+  } while (changed);
+  free(pred_start);
+  free(pred);
+
+  /* Accumulate the sizes bottom-up the dominator tree. */
+  retained = (uint64_t *)xcalloc(n_nodes + 1, sizeof(uint64_t));
+  for (i = 0; i < n_nodes; i++)
+    retained[i] = nodes[i].sz;
+  for (i = n_order; i-- > 1;) {
+    size_t v = order[i];
+
+    retained[idom[v]] += retained[v];
+  }
+
+  top = (size_t *)xcalloc(n_nodes, sizeof(size_t));
+  for (i = 0; i < n_nodes; i++)
+    top[i] = i;
+  qsort(top, n_nodes, sizeof(size_t), cmp_retained);
+  if (top_count > n_nodes)
+    top_count = n_nodes;
+  printf("\nmarked objects: %lu, references: %lu, retained total: %lu\n",
+         (unsigned long)n_nodes, (unsigned long)n_refs,
+         (unsigned long)retained[root]);
+  printf("\n%18s %4s %10s %14s %18s\n", "address", "kind", "size",
+         "retained", "dominator");
+  for (i = 0; i < top_count; i++) {
+    size_t v = top[i];
+
+    printf("%#18lx %4u %10lu %14lu ", (unsigned long)nodes[v].addr,
+           nodes[v].kind, (unsigned long)nodes[v].sz,
+           (unsigned long)retained[v]);
+    if (idom[v] == root) {
+      printf("%18s\n", "(root)");
+    } else {
+      printf("%#18lx\n", (unsigned long)nodes[idom[v]].addr);
+    }
+  }
+  free(top);
+  free(retained);
+  free(idom);
+  free(rpo_num);
+  free(order);
+}
+
+int
+main(int argc, char **argv)
+{
+  size_t top_count = DEFAULT_TOP_COUNT;
+  const char *fname;
+  FILE *f;
+  int has_edges;
+
+  if (argc == 4 && strcmp(argv[1], "-n") == 0) {
+    top_count = (size_t)strtoul(argv[2], NULL, 10);
+    fname = argv[3];
+  } else if (argc == 2) {
+    fname = argv[1];
+  } else {
+    fprintf(stderr, "Usage: %s [-n <count>] <snapshot-file>\n", argv[0]);
+    return 2;
+  }
+  f = fopen(fname, "rb");
+  if (NULL == f) {
+    perror(fname);
+    return 1;
+  }
+  has_edges = read_snapshot(f);
+  fclose(f);
+  print_histogram();
+  if (has_edges)
+    print_retainers(top_count);
+  return 0;
+}
@@ -0,0 +1,549 @@
+/*
+ * THIS MATERIAL IS PROVIDED AS IS, WITH ABSOLUTELY NO WARRANTY EXPRESSED
+ * OR IMPLIED.  ANY USE IS AT YOUR OWN RISK.
+ *
+ * Permission is hereby granted to use or copy this program
+ * for any purpose, provided the above notices are retained on all copies.
+ * Permission to modify the code and to distribute modified code is granted,
+ * provided the above notices are retained, and a notice that the code was
+ * modified is included with the above copyright notice.
+ */
+
+#include "private/gc_priv.h"
+
+/*
+ * The trace event recorder.  Each thread emitting the events (see
+ * `GC_TRACE()`) claims a ring buffer (of a fixed capacity) on its first
+ * event; the owner of a ring is the only writer of it, so no lock is
+ * needed: the event is stored and then the ring head is advanced (with
+ * the release semantic).  The rings are looked up by the thread id hash
+ * (with linear probing).  If all the rings are claimed, then the events
+ * of the other threads are not recorded.  The ring of a thread is
+ * released when the thread is unregistered; its events are dumped till
+ * the ring is claimed by another thread.  `GC_dump_trace_events()`
+ * copies each ring, then re-reads its head to drop the events which
+ * might be overwritten in the meantime, and formats the rest as Chrome
+ * trace-event JSON.
+ */
+
+#ifdef TRACE_BUFFER
+
+#  ifdef UNIX_LIKE
+#    include <fcntl.h>
+#    include <unistd.h>
+#    ifdef LINUX
+#      include <sys/syscall.h>
+#    endif
+#  endif
+
+#  ifndef TRACE_BUFFER_MAX_THREADS
+#    define TRACE_BUFFER_MAX_THREADS 64
+#  endif
+
+/* The maximum (log) capacity of a ring. */
+#  define TRACE_BUFFER_MAX_LOG_SIZE 24
+
+struct trace_event_s {
+  CLOCK_TYPE ts;
+  word arg;
+  unsigned ev;
+};
+
+struct trace_ring_s {
+#  ifdef THREADS
+  /* The owner thread id plus one, or zero if the ring is not claimed. */
+  volatile AO_t owner;
+  /* The total number of the events written to the ring. */
+  volatile AO_t head;
+#  else
+  word head;
+#  endif
+  /* The thread id reported in the output. */
+  word tid;
+};
+
+GC_INNER GC_bool GC_trace_on = FALSE;
+
+STATIC struct trace_ring_s GC_trace_rings[TRACE_BUFFER_MAX_THREADS];
+
+/*
+ * The events of all the rings (the capacity of each one is
+ * `1 << GC_trace_log_size`).  Allocated once.
+ */
+STATIC struct trace_event_s *GC_trace_events = NULL;
+STATIC unsigned GC_trace_log_size = 0;
+
+#  define TRACE_RING_SIZE() ((word)1 << GC_trace_log_size)
+
+#  ifdef THREADS
+#    ifdef GC_WIN32_THREADS
+#      define TRACE_SELF_ID() ((AO_t)GetCurrentThreadId())
+#    else
+#      define TRACE_SELF_ID() ((AO_t)NUMERIC_THREAD_ID(pthread_self()))
+#    endif
+#  endif
+
+STATIC word
+GC_trace_os_tid(void)
+{
+#  if defined(GC_WIN32_THREADS)
+  return (word)GetCurrentThreadId();
+#  elif defined(LINUX) && defined(SYS_gettid)
+  return (word)syscall(SYS_gettid);
+#  elif defined(THREADS)
+  return (word)TRACE_SELF_ID();
+#  else
+  return 0;
+#  endif
+}
+
+#  ifdef THREADS
+/*
+ * Return the ring owned by the current thread (identified by `self`), or
+ * `NULL` if none.  If `pfree` is non-`NULL`, then the first unclaimed
+ * ring (if any) passed by the probing is stored to it.  The probing does
+ * not stop at an unclaimed ring since the rings are released.
+ */
+STATIC struct trace_ring_s *
+GC_trace_find_ring(AO_t self, struct trace_ring_s **pfree)
+{
+  size_t i = (size_t)((self >> 4) ^ (self >> 12)) % TRACE_BUFFER_MAX_THREADS;
+  size_t k;
+
+  for (k = 0; k < TRACE_BUFFER_MAX_THREADS; k++) {
+    struct trace_ring_s *r = &GC_trace_rings[i];
+    AO_t owner = AO_load(&r->owner);
+
+    if (owner == self)
+      return r;
+    if (0 == owner && pfree != NULL && NULL == *pfree)
+      *pfree = r;
+    if (++i == TRACE_BUFFER_MAX_THREADS)
+      i = 0;
+  }
+  return NULL;
+}
+#  endif
+
+/*
+ * Return the ring of the current thread (claiming it if needed), or
+ * `NULL` if all the rings are claimed by other threads.
+ */
+STATIC struct trace_ring_s *
+GC_trace_get_ring(void)
+{
+#  ifdef THREADS
+  AO_t self = TRACE_SELF_ID() + 1;
+
+  for (;;) {
+    struct trace_ring_s *r_free = NULL;
+    struct trace_ring_s *r = GC_trace_find_ring(self, &r_free);
+
+    if (EXPECT(r != NULL, TRUE))
+      return r;
+    if (NULL == r_free)
+      return NULL;
+    if (AO_compare_and_swap_release(&r_free->owner, 0, self)) {
+      /* Drop the events of the previous owner (if any). */
+      AO_store_release(&r_free->head, 0);
+      r_free->tid = GC_trace_os_tid();
+      return r_free;
+    }
+    /* Another thread has claimed the ring, retry. */
+  }
+#  else
+  struct trace_ring_s *r = &GC_trace_rings[0];
+
+  if (0 == r->head)
+    r->tid = GC_trace_os_tid();
+  return r;
+#  endif
+}
+
+GC_INNER void
+GC_trace_record(unsigned ev, word arg)
+{
+  struct trace_ring_s *r = GC_trace_get_ring();
+  struct trace_event_s *e;
+  word h;
+
+  if (EXPECT(NULL == r, FALSE))
+    return;
+#  ifdef THREADS
+  h = (word)AO_load(&r->head);
+#  else
+  h = r->head;
+#  endif
+  e = &GC_trace_events[((size_t)(r - GC_trace_rings) << GC_trace_log_size)
+                       + (size_t)(h & (TRACE_RING_SIZE() - 1))];
+  GET_TIME(e->ts);
+  e->arg = arg;
+  e->ev = ev;
+#  ifdef THREADS
+  AO_store_release(&r->head, (AO_t)(h + 1));
+#  else
+  r->head = h + 1;
+#  endif
+}
+
+#  ifdef THREADS
+GC_INNER void
+GC_trace_release_ring(void)
+{
+  struct trace_ring_s *r = GC_trace_find_ring(TRACE_SELF_ID() + 1, NULL);
+
+  if (r != NULL)
+    AO_store_release(&r->owner, 0);
+}
+#  endif
+
+GC_INNER void
+GC_trace_set_size_inner(size_t n)
+{
+  GC_ASSERT(I_HOLD_LOCK());
+  if (0 == n) {
+    GC_trace_on = FALSE;
+    return;
+  }
+  if (NULL == GC_trace_events) {
+    unsigned log_size = 4;
+    size_t bytes;
+
+    while (log_size < TRACE_BUFFER_MAX_LOG_SIZE
+           && ((size_t)1 << log_size) < n)
+      log_size++;
+    bytes = ROUNDUP_PAGESIZE_IF_MMAP(sizeof(struct trace_event_s)
+                                     * TRACE_BUFFER_MAX_THREADS
+                                     << log_size);
+    GC_trace_events = (struct trace_event_s *)GC_os_get_mem(bytes);
+    if (EXPECT(NULL == GC_trace_events, FALSE)) {
+      WARN("Failed to allocate trace buffer\n", 0);
+      return;
+    }
+    GC_trace_log_size = log_size;
+  }
+  GC_trace_on = TRUE;
+}
+
+GC_API void GC_CALL
+GC_set_trace_buffer_size(size_t n)
+{
+  if (!EXPECT(GC_is_initialized, TRUE))
+    GC_init();
+  LOCK();
+  GC_trace_set_size_inner(n);
+  UNLOCK();
+}
+
+GC_API size_t GC_CALL
+GC_get_trace_buffer_size(void)
+{
+  size_t n;
+
+  READER_LOCK();
+  n = GC_trace_on ? (size_t)TRACE_RING_SIZE() : 0;
+  READER_UNLOCK();
+  return n;
+}
+
+/* The names of the events, the phase (in Chrome terms) and argument. */
+static const struct {
+  const char *name;
+  char ph;
+  const char *arg_name;
+} GC_trace_event_descr[] = {
+  { "collection", 'B', "gc_no" },  /*< `GC_EVENT_START` */
+  { "mark", 'B', "gc_no" },        /*< `GC_EVENT_MARK_START` */
+  { "mark", 'E', "gc_no" },        /*< `GC_EVENT_MARK_END` */
+  { "reclaim", 'B', "gc_no" },     /*< `GC_EVENT_RECLAIM_START` */
+  { "reclaim", 'E', "gc_no" },     /*< `GC_EVENT_RECLAIM_END` */
+  { "collection", 'E', "gc_no" },  /*< `GC_EVENT_END` */
+  { "stop_world", 'B', "gc_no" },  /*< `GC_EVENT_PRE_STOP_WORLD` */
+  { "stop_world", 'E', "gc_no" },  /*< `GC_EVENT_POST_STOP_WORLD` */
+  { "start_world", 'B', "gc_no" }, /*< `GC_EVENT_PRE_START_WORLD` */
+  { "start_world", 'E', "gc_no" }, /*< `GC_EVENT_POST_START_WORLD` */
+  { NULL, 0, NULL },
+  { NULL, 0, NULL },
+  { NULL, 0, NULL },
+  { NULL, 0, NULL },
+  { NULL, 0, NULL },
+  { NULL, 0, NULL },
+  { "collection", 'E', "abandoned_gc_no" }, /*< `GC_TRACE_ABANDON` */
+  { "mark", 'E', "abandoned_gc_no" },       /*< `GC_TRACE_MARK_ABANDON` */
+  { "alloc_slow", 'i', "bytes" },           /*< `GC_TRACE_ALLOC_SLOW` */
+  { "expand_heap", 'i', "bytes" },          /*< `GC_TRACE_EXPAND_HEAP` */
+  { "unmap", 'i', "bytes" },                /*< `GC_TRACE_UNMAP` */
+  { "mark_helper", 'B', "id" },             /*< `GC_TRACE_MARKER_START` */
+  { "mark_helper", 'E', "id" }              /*< `GC_TRACE_MARKER_END` */
+};
+
+/* The upper bound of the length of a formatted event. */
+#  define TRACE_EVENT_JSON_LEN (128 + 5 * HEAP_PROFILE_NUM_LEN)
+
+/* Print the number padded with zeros to the given width. */
+STATIC char *
+GC_trace_put_padded(char *q, word v, unsigned width)
+{
+  unsigned i;
+
+  for (i = width; i > 0; i--) {
+    q[i - 1] = (char)('0' + v % 10);
+    v /= 10;
+  }
+  return q + width;
+}
+
+STATIC char *
+GC_trace_put_event(char *q, const struct trace_event_s *e, word pid,
+                   word tid)
+{
+  /* The zero time, i.e. the timestamps are absolute ones. */
+  static CLOCK_TYPE zero_time;
+  unsigned long ms = MS_TIME_DIFF(e->ts, zero_time);
+  unsigned long ns = NS_FRAC_TIME_DIFF(e->ts, zero_time);
+  word us = (word)(ms % 1000) * 1000 + ns / 1000;
+  char ph[2];
+
+  ph[0] = GC_trace_event_descr[e->ev].ph;
+  ph[1] = '\0';
+  q = GC_heap_profile_put_str(q, "{\"name\":\"");
+  q = GC_heap_profile_put_str(q, GC_trace_event_descr[e->ev].name);
+  q = GC_heap_profile_put_str(q, "\",\"cat\":\"gc\",\"ph\":\"");
+  q = GC_heap_profile_put_str(q, ph);
+  if ('i' == ph[0])
+    q = GC_heap_profile_put_str(q, "\",\"s\":\"t");
+  q = GC_heap_profile_put_str(q, "\",\"ts\":");
+  if (ms >= 1000) {
+    q = GC_heap_profile_put_num(q, (word)(ms / 1000), 10);
+    q = GC_trace_put_padded(q, us, 6);
+  } else {
+    q = GC_heap_profile_put_num(q, us, 10);
+  }
+  *q++ = '.';
+  q = GC_trace_put_padded(q, (word)(ns % 1000), 3);
+  q = GC_heap_profile_put_str(q, ",\"pid\":");
+  q = GC_heap_profile_put_num(q, pid, 10);
+  q = GC_heap_profile_put_str(q, ",\"tid\":");
+  q = GC_heap_profile_put_num(q, tid, 10);
+  q = GC_heap_profile_put_str(q, ",\"args\":{\"");
+  q = GC_heap_profile_put_str(q, GC_trace_event_descr[e->ev].arg_name);
+  q = GC_heap_profile_put_str(q, "\":");
+  q = GC_heap_profile_put_num(q, e->arg, 10);
+  return GC_heap_profile_put_str(q, "}}");
+}
+
+/*
+ * Does the ring have events?  A released ring is not reset until it is
+ * claimed again.
+ */
+#  ifdef THREADS
+#    define TRACE_RING_USED(r) \
+      (AO_load(&(r)->owner) != 0 || AO_load(&(r)->head) != 0)
+#  else
+#    define TRACE_RING_USED(r) ((r)->head != 0)
+#  endif
+
+/*
+ * Copy the valid events of the ring to `copy`; return the number of
+ * the events copied.  The ring might be written concurrently.
+ */
+GC_ATTR_NO_SANITIZE_THREAD
+STATIC size_t
+GC_trace_copy_ring(const struct trace_ring_s *r, struct trace_event_s *copy)
+{
+  const struct trace_event_s *events
+      = &GC_trace_events[(size_t)(r - GC_trace_rings) << GC_trace_log_size];
+  word mask = TRACE_RING_SIZE() - 1;
+  word h, start, i;
+
+#  ifdef THREADS
+  h = (word)AO_load_acquire(&r->head);
+#  else
+  h = r->head;
+#  endif
+  start = h > mask ? h - mask - 1 : 0;
+  for (i = start; i < h; i++)
+    copy[i - start] = events[i & mask];
+#  ifdef THREADS
+  /*
+   * The writer overwrites the event `h - size` while storing the event
+   * `h`, i.e. before advancing the head to `h + 1`.
+   */
+  AO_nop_full();
+  {
+    word first_valid = (word)AO_load_acquire(&r->head);
+
+    /* The ring is claimed by another thread in the meantime. */
+    if (first_valid < h)
+      return 0;
+    first_valid = first_valid > mask ? first_valid - mask : 0;
+    if (first_valid > start) {
+      if (first_valid >= h)
+        return 0;
+      BCOPY(&copy[first_valid - start], copy,
+            (size_t)(h - first_valid) * sizeof(struct trace_event_s));
+      start = first_valid;
+    }
+  }
+#  endif
+  return (size_t)(h - start);
+}
+
+GC_API int GC_CALL
+GC_dump_trace_events(GC_heap_profile_write_proc fn, void *client_data)
+{
+  static const char header[] = "{\"traceEvents\":[\n";
+  static const char footer[] = "\n]}\n";
+  size_t ring_size, n_rings = 0, bytes, copy_bytes, i;
+  /* The rings used at the buffer size computation. */
+  GC_bool ring_used[TRACE_BUFFER_MAX_THREADS];
+  struct trace_event_s *copy = NULL;
+  char *buf, *q;
+  word pid = 0;
+  GC_bool first = TRUE;
+  int res;
+
+  GC_ASSERT(NONNULL_ARG_NOT_NULL(fn));
+  LOCK();
+  ring_size = GC_trace_events != NULL ? (size_t)TRACE_RING_SIZE() : 0;
+  for (i = 0; i < TRACE_BUFFER_MAX_THREADS; i++) {
+    ring_used[i] = ring_size > 0 && TRACE_RING_USED(&GC_trace_rings[i]);
+    if (ring_used[i])
+      n_rings++;
+  }
+  copy_bytes = ROUNDUP_PAGESIZE_IF_MMAP(ring_size
+                                        * sizeof(struct trace_event_s));
+  bytes = ROUNDUP_PAGESIZE_IF_MMAP(sizeof(header) + sizeof(footer)
+                                   + n_rings * ring_size
+                                         * (TRACE_EVENT_JSON_LEN + 2));
+  buf = (char *)GC_os_get_mem(bytes);
+  if (buf != NULL && n_rings > 0) {
+    copy = (struct trace_event_s *)GC_os_get_mem(copy_bytes);
+    if (NULL == copy) {
+#  ifndef GWW_VDB
+      GC_scratch_recycle_no_gww(buf, bytes);
+#  endif
+      buf = NULL;
+    }
+  }
+  UNLOCK();
+  if (EXPECT(NULL == buf, FALSE))
+    return GC_NO_MEMORY;
+
+#  if defined(UNIX_LIKE)
+  pid = (word)getpid();
+#  elif defined(MSWIN32) || defined(MSWINCE)
+  pid = (word)GetCurrentProcessId();
+#  endif
+  q = GC_heap_profile_put_str(buf, header);
+  for (i = 0; i < TRACE_BUFFER_MAX_THREADS; i++) {
+    const struct trace_ring_s *r = &GC_trace_rings[i];
+    size_t j, cnt;
+
+    /*
+     * The rings claimed after the buffer size is computed are skipped,
+     * the other ones are dumped even if released in the meantime.
+     */
+    if (!ring_used[i])
+      continue;
+    cnt = GC_trace_copy_ring(r, copy);
+    for (j = 0; j < cnt; j++) {
+      if (EXPECT(copy[j].ev >= sizeof(GC_trace_event_descr)
+                                   / sizeof(GC_trace_event_descr[0])
+                     || NULL == GC_trace_event_descr[copy[j].ev].name,
+                 FALSE))
+        continue;
+      if (!first)
+        q = GC_heap_profile_put_str(q, ",\n");
+      first = FALSE;
+      q = GC_trace_put_event(q, &copy[j], pid, r->tid);
+    }
+  }
+  q = GC_heap_profile_put_str(q, footer);
+  GC_ASSERT(ADDR_GE(buf + bytes, q));
+
+  res = fn(client_data, buf, (size_t)(q - buf));
+
+  LOCK();
+#  ifndef GWW_VDB
+  GC_scratch_recycle_no_gww(buf, bytes);
+  if (copy != NULL)
+    GC_scratch_recycle_no_gww(copy, copy_bytes);
+#  endif
+  UNLOCK();
+  return res;
+}
+
+#  if defined(UNIX_LIKE) && !defined(DONT_USE_ATEXIT)
+STATIC const char *GC_trace_exit_fname = NULL;
+
+STATIC int GC_CALLBACK
+GC_trace_write_fd(void *client_data, const char *buf, size_t len)
+{
+  int fd = *(int *)client_data;
+
+  while (len > 0) {
+    ssize_t n = write(fd, buf, len);
+
+    if (n <= 0)
+      return -1;
+    buf += n;
+    len -= (size_t)n;
+  }
+  return 0;
+}
+
+STATIC void
+GC_trace_exit_dump(void)
+{
+  int fd = open(GC_trace_exit_fname, O_CREAT | O_WRONLY | O_TRUNC, 0644);
+
+  if (fd < 0) {
+    GC_err_printf("Failed to open %s as trace file\n", GC_trace_exit_fname);
+    return;
+  }
+  if (GC_dump_trace_events(GC_trace_write_fd, &fd) != 0)
+    GC_err_printf("Failed to write trace events to %s\n",
+                  GC_trace_exit_fname);
+  (void)close(fd);
+}
+
+GC_INNER void
+GC_trace_dump_at_exit(const char *fname)
+{
+  if (NULL == GC_trace_exit_fname)
+    atexit(GC_trace_exit_dump);
+  GC_trace_exit_fname = fname;
+}
+#  else
+GC_INNER void
+GC_trace_dump_at_exit(const char *fname)
+{
+  UNUSED_ARG(fname);
+  WARN("GC_TRACE_FILE is not supported on this platform\n", 0);
+}
+#  endif
+
+#else /* !TRACE_BUFFER */
+
+GC_API void GC_CALL
+GC_set_trace_buffer_size(size_t n)
+{
+  UNUSED_ARG(n);
+}
+
+GC_API size_t GC_CALL
+GC_get_trace_buffer_size(void)
+{
+  return 0;
+}
+
+GC_API int GC_CALL
+GC_dump_trace_events(GC_heap_profile_write_proc fn, void *client_data)
+{
+  UNUSED_ARG(fn);
+  UNUSED_ARG(client_data);
+  return GC_UNIMPLEMENTED;
+}
+
+#endif /* !TRACE_BUFFER */